@@ -12,10 +12,17 @@
 
 #include <irq/ipi.h>
 #include <sched/sched.h>
+#include <arch/sync.h>
 
 void arch_send_ipi(u32 cpu, u32 ipi)
 {
 	plat_send_ipi(cpu, ipi);
+	/*
+	 * Wake up the CPUs waiting in wait_for_kernel_stack, which handle IPIs
+	 * with interrupts masked. The IPI data is written before.
+	 */
+	dsb(ish);
+	sev();
 }
 
 void arch_handle_ipi(u32 ipi_vector)
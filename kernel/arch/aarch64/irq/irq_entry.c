@@ -150,13 +150,36 @@ u64 handle_entry_c(int type, u64 esr, u64 address)
 /* Interrupt handler for interrupts happening when in EL0. */
 void handle_irq(void)
 {
+	/*
+	 * No thread switch unless the handler schedules. Otherwise, a stale
+	 * prev_thread makes switch_context switch from it again.
+	 */
+	if (current_thread)
+		current_thread->prev_thread = THREAD_ITSELF;
+
 	plat_handle_irq();
+#ifdef CHCORE_KERNEL_RT
+	/* E.g., threads woken up by the interrupt, or IPI_RESCHED */
+	do_pending_resched();
+#endif
+	/* An idle CPU looks for threads at any interrupt (see kick_idle_cpu) */
+	if (current_thread && current_thread->thread_ctx->type == TYPE_IDLE)
+		sched();
 	eret_to_thread(switch_context());
 }
 
-/* Interrupt handler for interrupts happening when in EL1 (idle thread). */
-void handle_irq_el1(u64 elr_el1)
+/*
+ * Interrupt handler for interrupts happening when in EL1, i.e., in the idle
+ * thread, or at a preemption point (CHCORE_KERNEL_RT). @ctx is the exception
+ * context saved on the stack.
+ */
+void handle_irq_el1(u64 ctx)
 {
+#ifdef CHCORE_KERNEL_RT
+	/* Resume from @ctx instead of the user context if switched out */
+	if (current_thread->thread_ctx->type != TYPE_IDLE)
+		current_thread->preempted_ctx = ctx;
+#endif
 	/* Just reuse the same interrupt handler for EL0. */
 	handle_irq();
 }
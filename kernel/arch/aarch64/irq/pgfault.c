@@ -56,7 +56,10 @@ void do_page_fault(u64 esr, u64 fault_ins_addr, int type, u64 *fix_addr)
         case DFSC_TRANS_FAULT_L2:
         case DFSC_TRANS_FAULT_L3: {
 
-                ret = handle_trans_fault(current_thread->vmspace, fault_addr);
+                wnr = GET_ESR_EL1_WnR(esr);
+                ret = handle_trans_fault(current_thread->vmspace,
+                                         fault_addr,
+                                         wnr ? VMR_WRITE : VMR_READ);
                 if (ret != 0) {
                         /* The trap happens in the kernel */
                         if (type < SYNC_EL0_64) {
@@ -92,6 +95,16 @@ void do_page_fault(u64 esr, u64 fault_ins_addr, int type, u64 *fix_addr)
                                 current_thread->vmspace, fault_addr, VMR_READ);
                 }
 
+                if (ret != 0) {
+                        /* The trap happens in the kernel */
+                        if (type < SYNC_EL0_64) {
+                                goto no_context;
+                        }
+                        sys_exit_group(-1);
+                }
+                break;
+        case DFSC_ACCESS_FAULT_L3:
+                ret = handle_access_fault(current_thread->vmspace, fault_addr);
                 if (ret != 0) {
                         /* The trap happens in the kernel */
                         if (type < SYNC_EL0_64) {
@@ -102,7 +115,6 @@ void do_page_fault(u64 esr, u64 fault_ins_addr, int type, u64 *fix_addr)
                 break;
         case DFSC_ACCESS_FAULT_L1:
         case DFSC_ACCESS_FAULT_L2:
-        case DFSC_ACCESS_FAULT_L3:
                 kinfo("do_page_fault: fsc is access_fault (0b%b)\n", fsc);
                 BUG_ON(1);
                 break;
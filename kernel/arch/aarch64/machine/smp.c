@@ -84,6 +84,9 @@ void init_per_cpu_info(u32 cpuid)
 	info->fpu_owner = NULL;
 	info->fpu_disable = 0;
 
+	/* Outside preemptible sections */
+	info->preempt_count = 1;
+
 	asm volatile("msr tpidr_el1, %0"::"r" (info));
 }
 
@@ -27,6 +27,7 @@
 #include <machine.h>
 #include <irq/irq.h>
 #include <object/thread.h>
+#include <ipc/futex.h>
 #include "../../tests/runtime/tests.h"
 
 ALIGN(STACK_ALIGNMENT)
@@ -92,6 +93,8 @@ void main(paddr_t boot_flag, void *info)
 	/* Init scheduler with specified policy */
 #if defined(CHCORE_KERNEL_SCHED_PBFIFO)
 	sched_init(&pbfifo);
+#elif defined(CHCORE_KERNEL_SCHED_FAIR)
+	sched_init(&fair);
 #elif defined(CHCORE_KERNEL_RT)
 	sched_init(&pbrr);
 #else
@@ -99,6 +102,8 @@ void main(paddr_t boot_flag, void *info)
 #endif
 	kinfo("[ChCore] sched init finished\n");
 
+	futex_hash_init();
+
 	init_fpu_owner_locks();
 
 	/* Other cores are busy looping on the boot_flag, wake up those cores */
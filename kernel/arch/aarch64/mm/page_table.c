@@ -27,6 +27,7 @@
 #include <arch/sync.h>
 
 #include <arch/mm/page_table.h>
+#include <sched/preempt.h>
 
 /* Page_table.c: Use simple impl for now. */
 
@@ -280,6 +281,9 @@ void free_page_table(void *pgtbl)
 
                         /* Free the l2 page table page */
                         kfree(l2_ptp);
+
+                        /* Up to 512 pages freed since the last point */
+                        cond_resched();
                 }
 
                 /* Free the l1 page table page */
@@ -387,9 +391,10 @@ static int map_range_in_pgtbl_common(void *pgtbl, vaddr_t va, paddr_t pa, size_t
                         l3_ptp->ent[i].pte = new_pte_val.pte;
 
                         va += PAGE_SIZE;
-                        pa += PAGE_SIZE;
-                        if (rss)
+                        /* The zero page is shared, see is_zero_page */
+                        if (rss && !is_zero_page(pa))
                                 *rss += PAGE_SIZE;
+                        pa += PAGE_SIZE;
                         total_page_cnt -= 1;
                         if (total_page_cnt == 0)
                                 break;
@@ -528,7 +533,9 @@ int unmap_range_in_pgtbl(void *pgtbl, vaddr_t va, size_t len, long *rss)
                 // step-1: get the index of pte
                 pte_index = GET_L3_INDEX(va);
                 for (i = pte_index; i < PTP_ENTRIES; ++i) {
-                        if (l3_ptp->ent[i].l3_page.is_valid && rss)
+                        if (l3_ptp->ent[i].l3_page.is_valid && rss
+                            && !is_zero_page((paddr_t)l3_ptp->ent[i].l3_page.pfn
+                                             << PAGE_SHIFT))
                                 *rss -= PAGE_SIZE;
 
                         l3_ptp->ent[i].pte = PTE_DESCRIPTOR_INVALID;
@@ -551,6 +558,7 @@ int mprotect_in_pgtbl(void *pgtbl, vaddr_t va, size_t len, vmr_prop_t flags)
         s64 total_page_cnt; // must be signed
         ptp_t *l0_ptp, *l1_ptp, *l2_ptp, *l3_ptp;
         pte_t *pte;
+        vmr_prop_t pte_flags;
         int ret;
         int pte_index; // the index of pte in the last level page table
         int i;
@@ -591,9 +599,16 @@ int mprotect_in_pgtbl(void *pgtbl, vaddr_t va, size_t len, vmr_prop_t flags)
                 pte_index = GET_L3_INDEX(va);
                 for (i = pte_index; i < PTP_ENTRIES; ++i) {
                         /* Modify the permission in the pte if it exists */
-                        if (!IS_PTE_INVALID(l3_ptp->ent[i].pte))
+                        if (!IS_PTE_INVALID(l3_ptp->ent[i].pte)) {
+                                pte_flags = flags;
+                                /* The zero page stays read-only until written */
+                                if (is_zero_page(
+                                            (paddr_t)l3_ptp->ent[i].l3_page.pfn
+                                            << PAGE_SHIFT))
+                                        pte_flags &= ~VMR_WRITE;
                                 set_pte_flags(
-                                        &(l3_ptp->ent[i]), flags, USER_PTE);
+                                        &(l3_ptp->ent[i]), pte_flags, USER_PTE);
+                        }
 
                         va += PAGE_SIZE;
                         total_page_cnt -= 1;
@@ -641,12 +656,16 @@ void update_pte(pte_t *dest, unsigned int level, struct common_pte_t *src)
                                              AARCH64_MMU_ATTR_PAGE_UXN);
 
                 dest->l3_page.is_valid = src->valid;
+                /*
+                 * On platforms without hardware AF management, a cleared AF
+                 * is set again in handle_access_fault.
+                 */
+                dest->l3_page.AF = src->access;
 #if !(defined(CHCORE_PLAT_RASPI3) || defined(CHCORE_PLAT_RASPI4) || defined(CHCORE_PLAT_FT2000))
                 /**
-                 * Some platforms do not support setting AF and DBM
-                 * by hardware, so on these platforms we ignored them.
+                 * Some platforms do not support setting DBM by hardware, so
+                 * on these platforms we ignored it.
                  */
-                dest->l3_page.AF = src->access;
                 dest->l3_page.DBM = src->dirty;
 #endif
                 break;
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <common/lock.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <arch/sync.h>
+#include <arch/machine/smp.h>
+#include <machine.h>
+
+#include "mcs.h"
+
+/*
+ * MCS queued lock packed in the word of a struct lock, like Linux's
+ * qspinlock: the low byte is set by the holder, and the high half is the
+ * tail of the queue of waiters (0 if empty).
+ *
+ * Each waiter spins on its own per-CPU node until its predecessor hands over
+ * the head of the queue. The head spins on the lock word instead, and leaves
+ * the queue as soon as it gets the lock. So a node is only used while its CPU
+ * waits. The kernel runs with interrupts masked, and a waiter has disabled
+ * kernel preemption already (see sched/preempt.h), so one node per CPU is
+ * needed. A few more are kept for safety.
+ */
+
+#define MCS_MAX_NESTING 4
+#define MCS_LOCKED      1
+
+struct mcs_node {
+	struct mcs_node *volatile next;
+	volatile u32 locked;
+};
+
+struct mcs_cpu_nodes {
+	struct mcs_node nodes[MCS_MAX_NESTING];
+	int count;
+} __attribute__((aligned(64)));
+
+static struct mcs_cpu_nodes mcs_nodes[PLAT_CPU_NUM];
+
+/* 0 stands for an empty queue, so CPU ids are shifted by one */
+static inline u16 mcs_encode_tail(u32 cpuid, int idx)
+{
+	return ((cpuid + 1) << 2) | idx;
+}
+
+static inline struct mcs_node *mcs_decode_tail(u16 tail)
+{
+	return &mcs_nodes[(tail >> 2) - 1].nodes[tail & 3];
+}
+
+/* Return whether the caller had to wait */
+bool mcs_lock(struct lock *lock)
+{
+	struct mcs_cpu_nodes *cpu_nodes;
+	struct mcs_node *node, *prev, *next;
+	u32 cpuid, val;
+	u16 tail, old_tail;
+	int idx;
+
+	BUILD_BUG_ON(MCS_MAX_NESTING != 4);
+	BUILD_BUG_ON(PLAT_CPU_NUM >= (1 << 14));
+
+	if (atomic_cmpxchg_32(&lock->val, 0, MCS_LOCKED) == 0)
+		return false;
+
+	cpuid = smp_get_cpu_id();
+	cpu_nodes = &mcs_nodes[cpuid];
+	idx = cpu_nodes->count++;
+	BUG_ON(idx >= MCS_MAX_NESTING);
+
+	node = &cpu_nodes->nodes[idx];
+	node->next = NULL;
+	node->locked = 0;
+	tail = mcs_encode_tail(cpuid, idx);
+
+	/* The exchange has release semantics, which publishes the node */
+	old_tail = atomic_exchange_16((u16 *)&lock->mcs.tail, tail);
+	if (old_tail != 0) {
+		prev = mcs_decode_tail(old_tail);
+		stlr_64(&prev->next, node);
+		for (;;) {
+			ldar_32(&node->locked, val);
+			if (val)
+				break;
+			cmpwait_32(&node->locked, 0);
+		}
+	}
+
+	/* Now at the head of the queue, wait for the holder */
+	for (;;) {
+		ldar_32(&lock->val, val);
+		if (val & 0xff) {
+			cmpwait_32(&lock->val, val);
+			continue;
+		}
+		if ((val >> 16) != tail)
+			break;
+		/* The last in the queue, so also clear the tail */
+		if (atomic_cmpxchg_32(&lock->val, val, MCS_LOCKED) == val)
+			goto out;
+	}
+
+	/*
+	 * Others are queued behind. Only the head sets the locked byte while
+	 * the queue is not empty, so a plain store suffices. The release store
+	 * below makes it visible before the next waiter becomes the head.
+	 */
+	lock->mcs.locked = MCS_LOCKED;
+	while ((next = node->next) == NULL)
+		COMPILER_BARRIER();
+	stlr_32(&next->locked, 1);
+
+out:
+	cpu_nodes->count--;
+	return true;
+}
+
+/* returns 0 on success, -1 otherwise */
+int mcs_try_lock(struct lock *lock)
+{
+	return atomic_cmpxchg_32(&lock->val, 0, MCS_LOCKED) == 0 ? 0 : -1;
+}
+
+void mcs_unlock(struct lock *lock)
+{
+	stlr_8(&lock->mcs.locked, 0);
+}
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef ARCH_AARCH64_SYNC_MCS_H
+#define ARCH_AARCH64_SYNC_MCS_H
+
+#include <common/lock.h>
+
+/* Used by ticket.c for locks of LOCK_TYPE_MCS */
+bool mcs_lock(struct lock *lock);
+int mcs_try_lock(struct lock *lock);
+void mcs_unlock(struct lock *lock);
+
+#endif /* ARCH_AARCH64_SYNC_MCS_H */
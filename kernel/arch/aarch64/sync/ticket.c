@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <common/lock.h>
+#include <common/lockstat.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <arch/sync.h>
+#include <sched/preempt.h>
+
+#include "mcs.h"
+
+/*
+ * The lock interfaces dispatch on the type of the lock. Ticket locks keep the
+ * owner and the next ticket in the two halves of one word.
+ */
+
+static inline bool lock_is_mcs(struct lock *lock)
+{
+	return (lock->meta & LOCK_TYPE_MASK) == LOCK_TYPE_MCS;
+}
+
+/* Holding a lock disables kernel preemption, see sched/preempt.h */
+static inline void lock_preempt_disable(struct lock *lock)
+{
+	if (!(lock->meta & LOCK_FLAG_HANDOFF))
+		preempt_disable();
+}
+
+static inline void lock_preempt_enable(struct lock *lock)
+{
+	if (!(lock->meta & LOCK_FLAG_HANDOFF))
+		preempt_enable();
+}
+
+int lock_init(struct lock *lock)
+{
+	BUG_ON(!lock);
+	BUILD_BUG_ON(sizeof(struct lock) != sizeof(u64));
+
+	lock->val = 0;
+	lock->meta = LOCK_TYPE_TICKET;
+	smp_wmb();
+	return 0;
+}
+
+int mcs_lock_init(struct lock *lock)
+{
+	BUG_ON(!lock);
+
+	lock->val = 0;
+	lock->meta = LOCK_TYPE_MCS;
+	smp_wmb();
+	return 0;
+}
+
+int handoff_lock_init(struct lock *lock)
+{
+	BUG_ON(!lock);
+
+	lock->val = 0;
+	lock->meta = LOCK_TYPE_TICKET | LOCK_FLAG_HANDOFF;
+	smp_wmb();
+	return 0;
+}
+
+/* Return whether the caller had to wait */
+static inline bool ticket_lock(struct lock *lock)
+{
+	u32 val;
+	u16 ticket;
+
+	val = atomic_fetch_add_32(&lock->val, 1 << 16);
+	ticket = val >> 16;
+	if ((u16)val == ticket)
+		return false;
+
+	for (;;) {
+		ldar_32(&lock->val, val);
+		if ((u16)val == ticket)
+			break;
+		cmpwait_32(&lock->val, val);
+	}
+	return true;
+}
+
+static inline int ticket_try_lock(struct lock *lock)
+{
+	u32 val;
+
+	ldar_32(&lock->val, val);
+	if ((u16)val != (u16)(val >> 16))
+		return -1;
+	if (atomic_cmpxchg_32(&lock->val, val, val + (1 << 16)) != val)
+		return -1;
+	return 0;
+}
+
+static inline void ticket_unlock(struct lock *lock)
+{
+	/* Only the owner writes the owner half, so there is no carry */
+	stlr_16(&lock->ticket.owner, (u16)(lock->ticket.owner + 1));
+}
+
+void lock(struct lock *lock)
+{
+	u64 start;
+	bool contended;
+
+	BUG_ON(!lock);
+
+	lock_preempt_disable(lock);
+	start = lockstat_clock(lock);
+	if (lock_is_mcs(lock))
+		contended = mcs_lock(lock);
+	else
+		contended = ticket_lock(lock);
+	lockstat_acquired(lock, start, contended);
+}
+
+/* returns 0 on success, -1 otherwise */
+int try_lock(struct lock *lock)
+{
+	int ret;
+
+	BUG_ON(!lock);
+
+	if (lock_is_mcs(lock))
+		ret = mcs_try_lock(lock);
+	else
+		ret = ticket_try_lock(lock);
+	if (ret == 0) {
+		lock_preempt_disable(lock);
+		lockstat_acquired(lock, lockstat_clock(lock), false);
+	}
+	return ret;
+}
+
+void unlock(struct lock *lock)
+{
+	BUG_ON(!lock);
+
+	lockstat_released(lock);
+	if (lock_is_mcs(lock))
+		mcs_unlock(lock);
+	else
+		ticket_unlock(lock);
+	lock_preempt_enable(lock);
+}
+
+int is_locked(struct lock *lock)
+{
+	u32 val = lock->val;
+
+	if (lock_is_mcs(lock))
+		return val != 0;
+	return (u16)val != (u16)(val >> 16);
+}
@@ -12,4 +12,7 @@ chcore_config(CHCORE_KERNEL_DEBUG BOOL OFF "Build debug version of the kernel?")
 chcore_config(CHCORE_KERNEL_TEST BOOL OFF "Enable kernel tests?")
 chcore_config(CHCORE_KERNEL_RT BOOL OFF "Enable realtime support in kernel?")
 chcore_config(CHCORE_KERNEL_SCHED_PBFIFO BOOL OFF "Use priority-based FIFO?")
+chcore_config(CHCORE_KERNEL_SCHED_FAIR BOOL OFF "Use weighted fair scheduling?")
+chcore_config(CHCORE_KERNEL_LOCKSTAT BOOL OFF "Collect contention statistics of kernel locks?")
+chcore_config(CHCORE_KERNEL_SCHED_TRACE BOOL OFF "Record scheduler events for tracing?")
 chcore_config(CHCORE_KERNEL_ENABLE_QEMU_VIRTIO_NET BOOL ON "Enable virtio-net nic on x86_64 QEMU?")
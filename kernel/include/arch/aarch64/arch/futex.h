@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef ARCH_AARCH64_ARCH_FUTEX_H
+#define ARCH_AARCH64_ARCH_FUTEX_H
+
+#include <common/types.h>
+#include <common/errno.h>
+
+/*
+ * Atomically compare the user word at @uaddr with @oldval and replace it with
+ * @newval if they are equal. The value found is stored in @curval.
+ *
+ * Faults on @uaddr are handled like copy_from/to_user: the page fault handler
+ * maps the page, or the extable entries redirect the access to the fixup code
+ * which returns -EFAULT. The caller should check @uaddr with
+ * check_user_addr_range() beforehand.
+ */
+// clang-format off
+static inline int futex_atomic_cmpxchg(int *uaddr, int oldval, int newval,
+                                       int *curval)
+{
+        int ret = 0, val = 0;
+        u32 tmp;
+
+        asm volatile (  "1: ldaxr   %w1, [%3]\n"
+                        "   cmp     %w1, %w4\n"
+                        "   b.ne    3f\n"
+                        "2: stlxr   %w2, %w5, [%3]\n"
+                        "   cbnz    %w2, 1b\n"
+                        "3: b       5f\n"
+                        "4: mov     %w0, %w6\n"
+                        "5:\n"
+                        "   .pushsection .extable, \"a\"\n"
+                        "   .align  4\n"
+                        "   .quad   1b, 4b\n"
+                        "   .align  4\n"
+                        "   .quad   2b, 4b\n"
+                        "   .popsection\n"
+                        : "+r"(ret), "+r"(val), "=&r"(tmp)
+                        : "r"(uaddr), "r"(oldval), "r"(newval), "r"(-EFAULT)
+                        : "cc", "memory");
+        *curval = val;
+        return ret;
+}
+// clang-format on
+
+#endif /* ARCH_AARCH64_ARCH_FUTEX_H */
@@ -36,6 +36,7 @@ enum cpu_state {
 #define OFFSET_LOCAL_CPU_STACK		8
 #define OFFSET_CURRENT_FPU_OWNER	16
 #define OFFSET_FPU_DISABLE		24
+#define OFFSET_PREEMPT_COUNT		28
 
 #ifndef __ASM__
 struct per_cpu_info {
@@ -49,9 +50,13 @@ struct per_cpu_info {
 	void *fpu_owner;
 	u32 fpu_disable;
 
+	/* Kernel preemption is disabled unless 0, see sched/preempt.h */
+	u32 preempt_count;
+
 	char pad[pad_to_cache_line(sizeof(u64) +
 				   sizeof(char *) +
 				   sizeof(void *) +
+				   sizeof(u32) +
 				   sizeof(u32))];
 } __attribute__((packed, aligned(64)));
 
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef ARCH_AARCH64_ARCH_PREEMPT_H
+#define ARCH_AARCH64_ARCH_PREEMPT_H
+
+#include <common/types.h>
+#include <arch/machine/smp.h>
+
+/* ISR_EL1.I: an IRQ is pending, even if masked by PSTATE.I */
+#define ISR_EL1_I	(1UL << 7)
+
+static inline struct per_cpu_info *arch_this_cpu_info(void)
+{
+	struct per_cpu_info *info;
+
+	asm volatile("mrs %0, tpidr_el1" : "=r"(info));
+	return info;
+}
+
+static inline u32 arch_preempt_count(void)
+{
+	return *(volatile u32 *)((char *)arch_this_cpu_info() +
+				 OFFSET_PREEMPT_COUNT);
+}
+
+static inline void arch_preempt_count_add(int val)
+{
+	volatile u32 *count = (volatile u32 *)((char *)arch_this_cpu_info() +
+					       OFFSET_PREEMPT_COUNT);
+
+	asm volatile("" ::: "memory");
+	*count += val;
+	asm volatile("" ::: "memory");
+}
+
+static inline bool arch_irq_pending(void)
+{
+	u64 isr;
+
+	asm volatile("mrs %0, isr_el1" : "=r"(isr));
+	return (isr & ISR_EL1_I) != 0;
+}
+
+/* Unmask IRQs for a moment so that pending ones are taken (irq_el1h) */
+static inline void arch_take_pending_irq(void)
+{
+	asm volatile("msr daifclr, #2\n\t"
+		     "isb\n\t"
+		     "msr daifset, #2" ::: "memory");
+}
+
+/*
+ * Save the context of the caller as an exception frame and call
+ * preempt_schedule with it. Returns when the thread is scheduled again.
+ */
+void arch_preempt_schedule(void);
+
+#endif /* ARCH_AARCH64_ARCH_PREEMPT_H */
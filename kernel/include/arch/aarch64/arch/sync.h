@@ -42,6 +42,9 @@
 #define ldar_64(ptr, value) asm volatile("ldar %x0, [%1]" : "=r" (value) : "r" (ptr))
 #define stlr_64(ptr, value) asm volatile("stlr %x0, [%1]" : : "rZ" (value) , "r" (ptr))
 
+#define stlr_8(ptr, value)  asm volatile("stlrb %w0, [%1]" : : "rZ" (value) , "r" (ptr) : "memory")
+#define stlr_16(ptr, value) asm volatile("stlrh %w0, [%1]" : : "rZ" (value) , "r" (ptr) : "memory")
+
 // clang-format off
 #define __atomic_compare_exchange(ptr, compare, exchange, len, width)	\
 ({									\
@@ -81,6 +84,60 @@ static inline s64 atomic_exchange_64(s64 * ptr, s64 exchange)
         return oldval;
 }
 
+static inline u16 atomic_exchange_16(u16 *ptr, u16 exchange)
+{
+        u32 oldval;
+        s32 ret;
+        asm volatile (  "1: ldaxrh  %w0, %2\n"
+                        "   stlxrh  %w1, %w3, %2\n"
+                        "   cbnz    %w1, 1b\n"
+                        :"=&r" (oldval), "=&r"(ret), "+Q"(*ptr)
+                        :"r"(exchange)
+                        :"memory"
+                     );
+        return (u16)oldval;
+}
+
+/*
+ * Wait (in low-power state) until the 32-bit word at @ptr may differ from
+ * @val. The exclusive load arms the monitor, so a store to the word by
+ * another CPU generates the event that ends WFE. Callers should re-check the
+ * word as the wakeup can be spurious.
+ */
+static inline void cmpwait_32(volatile u32 *ptr, u32 val)
+{
+        u32 tmp;
+        asm volatile (  "   sevl\n"
+                        "   wfe\n"
+                        "   ldxr    %w0, %1\n"
+                        "   eor     %w0, %w0, %w2\n"
+                        "   cbnz    %w0, 1f\n"
+                        "   wfe\n"
+                        "1:":"=&r" (tmp), "+Q"(*ptr)
+                        :"r"(val)
+                        :"memory"
+                     );
+}
+
+/*
+ * Same as cmpwait_32, but an event signaled before the call (e.g., by sev of
+ * another CPU) is not discarded and ends the wait at once. For waiting on a
+ * word and on sev-signaled conditions together, which are checked by the
+ * caller before calling.
+ */
+static inline void cmpwait_or_event_32(volatile u32 *ptr, u32 val)
+{
+        u32 tmp;
+        asm volatile (  "   ldxr    %w0, %1\n"
+                        "   eor     %w0, %w0, %w2\n"
+                        "   cbnz    %w0, 1f\n"
+                        "   wfe\n"
+                        "1:":"=&r" (tmp), "+Q"(*ptr)
+                        :"r"(val)
+                        :"memory"
+                     );
+}
+
 #define __atomic_fetch_op(ptr, val, len, width, op)			\
 ({									\
         u##len oldval, newval;						\
@@ -15,10 +15,48 @@
 
 #include <common/types.h>
 
-/* Simple/Compact ticket/rwlock impl */
+/*
+ * Simple/Compact ticket/rwlock impl
+ *
+ * A struct lock is either a ticket lock (the default) or an MCS queued lock,
+ * chosen when it is initialized. Waiters of a ticket lock all spin on the
+ * lock word, while waiters of an MCS lock spin on their own per-CPU queue
+ * nodes, which scales better for locks contended by many CPUs.
+ */
+
+#define LOCK_TYPE_TICKET	0
+#define LOCK_TYPE_MCS		1
+#define LOCK_TYPE_MASK		0xf
+
+/*
+ * A hand-off lock is released by another thread than the one acquiring it,
+ * e.g., the IPC locks released by the server, and stays held across returns
+ * to user mode. So it does not disable kernel preemption like other locks.
+ */
+#define LOCK_FLAG_HANDOFF	(1 << 4)
 
 struct lock {
-	volatile u64 slock;
+	union {
+		volatile u64 slock;
+		struct {
+			union {
+				volatile u32 val;
+				/* Ticket lock */
+				struct {
+					volatile u16 owner;
+					volatile u16 next;
+				} ticket;
+				/* MCS lock: tail encodes the last queued node */
+				struct {
+					volatile u8 locked;
+					u8 pad;
+					volatile u16 tail;
+				} mcs;
+			};
+			/* LOCK_TYPE_* and LOCK_FLAG_* in bits [7:0], lockstat class above */
+			u32 meta;
+		};
+	};
 };
 
 struct rwlock {
@@ -26,9 +64,12 @@ struct rwlock {
 };
 
 #define DEFINE_SPINLOCK(x)	struct lock x = { .slock = 0 }
+#define DEFINE_MCS_SPINLOCK(x)	struct lock x = { .meta = LOCK_TYPE_MCS }
 #define DEFINE_RWLOCK(x)	struct rwlock x = { .lock = 0 }
 
 int lock_init(struct lock *lock);
+int mcs_lock_init(struct lock *lock);
+int handoff_lock_init(struct lock *lock);
 void lock(struct lock *lock);
 /* returns 0 on success, -1 otherwise */
 int try_lock(struct lock *lock);
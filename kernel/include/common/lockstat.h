@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef COMMON_LOCKSTAT_H
+#define COMMON_LOCKSTAT_H
+
+#include <common/types.h>
+#include <common/lock.h>
+#include <arch/time.h>
+#include <uapi/lockstat.h>
+
+/*
+ * Lock statistics, collected if CHCORE_KERNEL_LOCKSTAT is enabled.
+ *
+ * Locks are grouped into classes by name with lockstat_register(), e.g., all
+ * the vmspace_locks share one class. The class is recorded in the meta field
+ * of struct lock, so locks which are not registered only pay for checking it.
+ */
+
+#define LOCKSTAT_MAX_CLASSES 64
+
+#ifdef CHCORE_KERNEL_LOCKSTAT
+
+void lockstat_register(struct lock *lk, const char *name);
+void __lockstat_acquired(struct lock *lock, u64 start, bool contended);
+void __lockstat_released(struct lock *lock);
+
+static inline bool lockstat_enabled(struct lock *lock)
+{
+        return (lock->meta >> 8) != 0;
+}
+
+static inline u64 lockstat_clock(struct lock *lock)
+{
+        return lockstat_enabled(lock) ? get_cycles() : 0;
+}
+
+static inline void lockstat_acquired(struct lock *lock, u64 start,
+                                     bool contended)
+{
+        if (lockstat_enabled(lock))
+                __lockstat_acquired(lock, start, contended);
+}
+
+static inline void lockstat_released(struct lock *lock)
+{
+        if (lockstat_enabled(lock))
+                __lockstat_released(lock);
+}
+
+#else /* CHCORE_KERNEL_LOCKSTAT */
+
+static inline void lockstat_register(struct lock *lk, const char *name)
+{
+}
+
+static inline u64 lockstat_clock(struct lock *lock)
+{
+        return 0;
+}
+
+static inline void lockstat_acquired(struct lock *lock, u64 start,
+                                     bool contended)
+{
+}
+
+static inline void lockstat_released(struct lock *lock)
+{
+}
+
+#endif /* CHCORE_KERNEL_LOCKSTAT */
+
+/*
+ * Copy the statistics of at most @nr classes to @ubuf, and clear them if
+ * @reset is set. Return the number of classes copied.
+ */
+int sys_get_lockstat(struct lockstat_info *ubuf, unsigned long nr, bool reset);
+
+#endif /* COMMON_LOCKSTAT_H */
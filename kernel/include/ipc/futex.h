@@ -2,8 +2,9 @@
 #define IPC_FUTEX_H
 
 #include <common/types.h>
+#include <common/list.h>
+#include <common/lock.h>
 #include <common/hashtable.h>
-#include <ipc/notification.h>
 
 #define FUTEX_WAIT		0
 #define FUTEX_WAKE		1
@@ -15,27 +16,108 @@
 #define FUTEX_UNLOCK_PI		7
 #define FUTEX_TRYLOCK_PI	8
 #define FUTEX_WAIT_BITSET	9
+#define FUTEX_WAKE_BITSET	10
 
 #define FUTEX_PRIVATE 128
 
 #define FUTEX_CLOCK_REALTIME 256
 
+/* Wait/wake all the waiters regardless of their bitsets */
+#define FUTEX_BITSET_MATCH_ANY	0xffffffff
 
+/*
+ * Encoding of the operation of FUTEX_WAKE_OP in val3:
+ * op (4 bits) | cmp (4 bits) | oparg (12 bits) | cmparg (12 bits)
+ */
+#define FUTEX_OP_SET		0 /* uaddr2 = oparg */
+#define FUTEX_OP_ADD		1 /* uaddr2 += oparg */
+#define FUTEX_OP_OR		2 /* uaddr2 |= oparg */
+#define FUTEX_OP_ANDN		3 /* uaddr2 &= ~oparg */
+#define FUTEX_OP_XOR		4 /* uaddr2 ^= oparg */
+#define FUTEX_OP_OPARG_SHIFT	8 /* use (1 << oparg) as operand */
+
+#define FUTEX_OP_CMP_EQ		0 /* if (oldval == cmparg) wake */
+#define FUTEX_OP_CMP_NE		1 /* if (oldval != cmparg) wake */
+#define FUTEX_OP_CMP_LT		2 /* if (oldval < cmparg) wake */
+#define FUTEX_OP_CMP_LE		3 /* if (oldval <= cmparg) wake */
+#define FUTEX_OP_CMP_GT		4 /* if (oldval > cmparg) wake */
+#define FUTEX_OP_CMP_GE		5 /* if (oldval >= cmparg) wake */
+
+/*
+ * Layout of the word of a PI futex: the owner TID (i.e., the cap of the owner
+ * thread in its cap_group), or 0 if it is free. FUTEX_WAITERS makes the owner
+ * unlock it through the kernel. FUTEX_OWNER_DIED is set when the lock is
+ * handed over by an exiting owner.
+ */
+#define FUTEX_WAITERS		0x80000000
+#define FUTEX_OWNER_DIED	0x40000000
+#define FUTEX_TID_MASK		0x3fffffff
+
+/* Max length of a chain of PI futexes to boost or to check for deadlocks */
+#define FUTEX_PI_MAX_DEPTH	16
+
+struct thread;
+struct notification;
+
+/*
+ * Non-PI futexes live in a global hash table of FUTEX_BUCKET_NUM buckets, each
+ * with its own lock. A futex is identified by (vmspace, uaddr) if it is
+ * private to a process, or by (pmo, offset) if it is shared among processes.
+ */
+#define FUTEX_HASH_BITS		8
+#define FUTEX_BUCKET_NUM	(1 << FUTEX_HASH_BITS)
+
+struct futex_key {
+        void *object;
+        unsigned long offset;
+};
+
+struct futex_bucket;
+
+/* Embedded in struct thread, protected by the lock of the bucket */
+struct futex_waiter {
+        struct list_head node;          // link waiters in a bucket
+        struct futex_bucket *bucket;    // NULL if the thread is not waiting
+        struct futex_key key;
+        u32 bitset;
+};
+
+/* PI futexes of a cap_group, protected by its futex_lock */
 struct futex_entry {
         struct notification *notific;
         int *uaddr;
         int waiter_count;
         struct hlist_node hash_node;
+
+        struct thread *pi_owner;
+        /* Link PI futexes held by pi_owner */
+        struct list_head pi_node;
+        /* Waiting threads, in descending order of priority */
+        struct list_head pi_waiters;
 };
 
 struct cap_group;
 void futex_deinit(struct cap_group *cap_group);
 void futex_init(struct cap_group *cap_group);
 
+/* Execute once during kernel init */
+void futex_hash_init(void);
+/* Remove a destroyed thread from the bucket it is waiting in, if any */
+void futex_waiter_deinit(struct thread *thread);
+
+/* Hand PI futexes held by the exiting current thread over to their waiters */
+void futex_exit_pi(void);
+/* Set the priority of @thread, which may be boosted by PI futexes it holds */
+void futex_pi_set_prio(struct thread *thread, unsigned int prio);
+
 /* Syscalls */
-int sys_futex_wait(int *uaddr, int futex_op, int val, struct timespec *timeout);
-int sys_futex_wake(int *uaddr, int futex_op, int val);
-int sys_futex_requeue(int *uaddr, int *uaddr2, int nr_wake, int nr_requeue);
+int sys_futex_wait(int *uaddr, int futex_op, int val, struct timespec *timeout,
+                   u32 bitset);
+int sys_futex_wake(int *uaddr, int futex_op, int val, u32 bitset);
+int sys_futex_requeue(int *uaddr, int *uaddr2, int futex_op, int nr_wake,
+                      int nr_requeue, bool cmp, int cmpval);
+int sys_futex_wake_op(int *uaddr, int *uaddr2, int futex_op, int nr_wake,
+                      int nr_wake2, int encoded_op);
 int sys_futex(int *uaddr, int futex_op, int val, struct timespec *timeout, int *uaddr2, int val3);
 
 #endif /* IPC_FUTEX_H */
@@ -37,6 +37,8 @@ struct page {
         void *slab;
         /* The physical memory pool this page belongs to */
         struct phys_mem_pool *pool;
+        /* Used by KSM: the stable node if it is a merged frame */
+        void *ksm;
 };
 
 struct free_list {
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) Licensed under the Mulan PSL v2. You can
+ * use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v2 for more details.
+ */
+
+#ifndef MM_KSM_H
+#define MM_KSM_H
+
+#include <common/types.h>
+#include <mm/vmspace.h>
+#include <object/memory.h>
+
+/*
+ * KSM: kernel same-page merging for PMO_ANONYM.
+ *
+ * Processes opt in ranges of anonymous memory with madvise(MADV_MERGEABLE).
+ * A scanner (driven by a thread in procmgr) walks committed pages of those
+ * pmos, and merges pages with identical contents into one read-only frame
+ * shared by all their radix slots. Writing such a page takes a permission
+ * fault, which copies the frame into a private page again (see
+ * handle_perm_fault).
+ *
+ * Merged frames are tracked in a stable tree keyed by contents. Candidates
+ * which have not been merged yet are collected in an unstable tree, and they
+ * are checked again before being merged.
+ *
+ * Lock ordering: vmspace_lock -> pgtbl_lock -> ksm lock, and the ksm lock ->
+ * zswap lock. Like zswap, the scanner only *tries* to grab the locks of a
+ * vmspace.
+ */
+
+/* Execute once during kernel init */
+void ksm_init(void);
+
+/* Stop scanning @pmo, before it is destroyed */
+void ksm_unregister_pmo(struct pmobject *pmo);
+
+/* Whether @pa is a frame shared by merged pages */
+bool ksm_is_page(paddr_t pa);
+
+/* Drop one reference to a merged frame, and free it on the last one */
+void ksm_put_page(paddr_t pa);
+
+/*
+ * Replacing a merged page (or the zero page mapped for an untouched slot) of
+ * @pmo with a private one goes like:
+ *
+ *   zswap_lock_mappings(pmo);
+ *   ksm_lock_other_mappings(pmo, keep_vmr);
+ *   (commit the new page to the radix of pmo)
+ *   ksm_unmap_other_mappings(pmo, index, keep_vmr);
+ *   ksm_unlock_other_mappings(pmo, keep_vmr);
+ *   zswap_unlock_mappings(pmo);
+ *   ksm_put_page(old_pa);     (unless it is the zero page)
+ *
+ * where @keep_vmr is the mapping whose vmspace is locked by the caller (or
+ * NULL), and its pte is updated by the caller. Holding the vmspace_lock of the
+ * other mappings keeps their page faults from mapping the old page again
+ * before the radix is updated, so the locks are only *tried*: it returns
+ * -EAGAIN if some of them are busy, and nothing is held then.
+ */
+int ksm_lock_other_mappings(struct pmobject *pmo, struct vmregion *keep_vmr);
+void ksm_unmap_other_mappings(struct pmobject *pmo, unsigned long index,
+                              struct vmregion *keep_vmr);
+void ksm_unlock_other_mappings(struct pmobject *pmo, struct vmregion *keep_vmr);
+
+/*
+ * Replace the merged page at @index of @pmo (if any) with a private copy, or
+ * commit a zeroed page if it is untouched (the zero page is never recorded in
+ * the radix), for kernel paths writing a pmo without mapping it, e.g.,
+ * write_pmo. Return the physical address of the page, or 0 if it is out of
+ * memory.
+ */
+paddr_t ksm_break_page(struct pmobject *pmo, unsigned long index);
+
+/*
+ * Drop write permission of merged pages mapped in [start, start + len), which
+ * may have been granted by mprotect. Should be called with pgtbl_lock held.
+ */
+void ksm_protect_range(struct vmspace *vmspace, vaddr_t start, size_t len);
+
+/* Print merging statistics, as a part of the memory usage message */
+void ksm_print_stat(void);
+
+/* Syscalls */
+int sys_ksm_advise(unsigned long addr, unsigned long len, bool mergeable);
+long sys_ksm_scan(unsigned long nr_pages);
+
+#endif /* MM_KSM_H */
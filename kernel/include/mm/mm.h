@@ -26,9 +26,24 @@ extern void parse_mem_map(void *);
 /* Execute once during kernel init. */
 void mm_init(void* physmem_info);
 
+/*
+ * A page of zeros. Reading untouched anonymous memory maps it read-only, and
+ * the first write replaces it with a private page (see handle_perm_fault).
+ * It is never counted in rss.
+ */
+extern paddr_t zero_page_pa;
+
+static inline bool is_zero_page(paddr_t pa)
+{
+        return pa == zero_page_pa;
+}
+
 /* Return the size of free memory in the buddy and slab allocator. */
 unsigned long get_free_mem_size(void);
 
+/* Print memory usage messages */
+void sys_get_mem_usage_msg(void);
+
 /* Implementations differ on different architectures. */
 void set_page_table(paddr_t pgtbl);
 void flush_tlb_by_range(struct vmspace*, vaddr_t start_va, size_t size);
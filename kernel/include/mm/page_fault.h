@@ -17,9 +17,12 @@
 #include <common/types.h>
 #include <arch/mmu.h>
 
-int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr);
+int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr,
+                       vmr_prop_t desired_perm);
 
 int handle_perm_fault(struct vmspace *vmspace, vaddr_t fault_addr,
                       vmr_prop_t desired_perm);
 
+int handle_access_fault(struct vmspace *vmspace, vaddr_t fault_addr);
+
 #endif /* MM_PAGE_FAULT_H */
\ No newline at end of file
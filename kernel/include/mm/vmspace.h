@@ -33,7 +33,8 @@ struct vmregion {
         size_t offset;
         vmr_prop_t perm;
         struct pmobject *pmo;
-        struct list_head cow_private_pages;
+        /* Private pages allocated by CoW, indexed by vaddr */
+        struct rb_root cow_private_pages;
 };
 
 /* This struct represents one virtual address space */
@@ -102,5 +103,7 @@ struct vmspace *create_idle_vmspace(void);
 /* Interfaces on CoW implementation */
 int vmregion_record_cow_private_page(struct vmregion *vmr, vaddr_t vaddr,
                                      void *private_page);
+/* Return the CoW private page mapped at @vaddr in @vmr, or NULL if none */
+void *vmregion_find_cow_private_page(struct vmregion *vmr, vaddr_t vaddr);
 
 #endif /* MM_VMSPACE_H */
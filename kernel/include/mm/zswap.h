@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) Licensed under the Mulan PSL v2. You can
+ * use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v2 for more details.
+ */
+
+#ifndef MM_ZSWAP_H
+#define MM_ZSWAP_H
+
+#include <common/types.h>
+#include <object/memory.h>
+#include <uapi/memory.h>
+
+/*
+ * zswap: a compressed in-memory swap tier for PMO_ANONYM.
+ *
+ * Cold pages (whose access flag stays clear for a whole scan round) of
+ * anonymous PMOs are compressed into a pool, unmapped and freed. The radix
+ * slot of such a page then holds a zswap entry instead of a physical address,
+ * and get_page_from_pmo() decompresses it into a fresh page transparently.
+ *
+ * Lock ordering: vmspace_lock -> pgtbl_lock -> zswap lock. Reclaim runs with
+ * the zswap lock held, so it only *tries* to grab the locks of a vmspace and
+ * skips it if they are busy.
+ */
+
+/*
+ * Radix values of PMO_ANONYM are either physical addresses of committed pages,
+ * which are page aligned, or zswap entries tagged with ZSWAP_ENTRY_TAG.
+ */
+#define ZSWAP_ENTRY_TAG (1UL)
+
+static inline bool is_zswap_entry(void *value)
+{
+        return ((unsigned long)value & ZSWAP_ENTRY_TAG) != 0;
+}
+
+/* Execute once during kernel init, after the buddy system is ready. */
+void zswap_init(void);
+
+/* Track anonymous pmos as candidates of reclaim */
+void zswap_register_pmo(struct pmobject *pmo);
+void zswap_unregister_pmo(struct pmobject *pmo);
+
+/*
+ * Reclaim looks up the mappings of a pmo, so changes to pmo->mapping_list of
+ * anonymous pmos should be done with this lock held.
+ */
+void zswap_lock_mappings(struct pmobject *pmo);
+void zswap_unlock_mappings(struct pmobject *pmo);
+
+/*
+ * Keep pages of @pmo from being reclaimed, for kernel paths that access the
+ * pages without holding the vmspace_lock of the mapping, e.g., read_pmo.
+ */
+void zswap_pin_pmo(struct pmobject *pmo);
+void zswap_unpin_pmo(struct pmobject *pmo);
+
+/*
+ * Decompress the page at @index of @pmo if it is swapped out, and store its
+ * physical address in @pa, which is 0 if the page has not been committed.
+ * Return -ENOMEM if no page can be allocated for decompression.
+ */
+int zswap_load_page(struct pmobject *pmo, unsigned long index, paddr_t *pa);
+
+/* Release a zswap entry found in the radix of a destroyed pmo */
+void zswap_free_entry(void *entry);
+
+/*
+ * Allocate a page for anonymous memory. If memory is exhausted, reclaim some
+ * pages directly and retry once. Return NULL on failure.
+ */
+void *zswap_get_page(void);
+
+/*
+ * Try to reclaim @nr_pages pages. In @direct mode (i.e., in an allocation
+ * path), it gives up at once if reclaim is already running. Return the number
+ * of pages reclaimed.
+ */
+unsigned long zswap_reclaim(unsigned long nr_pages, bool direct);
+
+/* Syscalls */
+long sys_zswap_reclaim(void);
+int sys_zswap_get_stat(struct zswap_stat *user_stat);
+
+#endif /* MM_ZSWAP_H */
@@ -22,6 +22,8 @@
 #include <common/lock.h>
 #include <common/hashtable.h>
 #include <arch/sync.h>
+#include <sched/fair.h>
+#include <sched/acct.h>
 
 struct object_slot {
 	int slot_id;
@@ -78,10 +80,25 @@ struct cap_group {
 	/* Each Process has its own futex status */
 	struct lock futex_lock;
 	struct htable futex_entries;
+
+	/* Weight and ready threads for the fair policy */
+	struct fair_group fair_group;
+
+	/* CPU time of exited threads, protected by threads_lock */
+	struct sched_acct exited_acct;
+	/* Link in cap_group_list */
+	struct list_head acct_node;
+
+	/* Id of the cpuset, where its threads may run */
+	int cpuset;
 };
 
 #define current_cap_group (current_thread->cap_group)
 
+/* All the cap_groups, for collecting statistics */
+extern struct list_head cap_group_list;
+extern struct lock cap_group_list_lock;
+
 /*
  * ATTENTION: These interfaces are for capability internal use.
  * As a cap user, check object.h for interfaces for cap.
@@ -30,12 +30,25 @@ struct pmobject {
          */
         void *private;
         struct list_head mapping_list;
+
+        /* Used by zswap for PMO_ANONYM only, protected by the zswap lock */
+        struct list_head swap_node;
+        unsigned long swap_cursor; /* next page to scan in reclaim */
+        unsigned long swap_pin; /* pages cannot be reclaimed if not 0 */
+
+        /* Used by KSM for PMO_ANONYM only, protected by the ksm lock */
+        struct list_head ksm_node;
+        unsigned long ksm_cursor; /* next page to scan */
+        bool ksm_mergeable; /* opted in by madvise(MADV_MERGEABLE) */
 };
 
 /* kernel internal interfaces */
 cap_t create_pmo(size_t size, pmo_type_t type, struct cap_group *cap_group,
                  paddr_t paddr, struct pmobject **new_pmo);
 void commit_page_to_pmo(struct pmobject *pmo, unsigned long index, paddr_t pa);
+void replace_page_in_pmo(struct pmobject *pmo, unsigned long index, paddr_t pa);
+int try_get_page_from_pmo(struct pmobject *pmo, unsigned long index,
+                          paddr_t *pa);
 paddr_t get_page_from_pmo(struct pmobject *pmo, unsigned long index);
 int map_pmo_in_current_cap_group(cap_t pmo_cap, unsigned long addr,
                                  unsigned long perm);
@@ -16,9 +16,13 @@
 #include <common/list.h>
 #include <mm/vmspace.h>
 #include <sched/sched.h>
+#include <sched/fair.h>
+#include <sched/acct.h>
+#include <sched/cpuset.h>
 #include <object/cap_group.h>
 #include <arch/machine/smp.h>
 #include <ipc/connection.h>
+#include <ipc/futex.h>
 #include <irq/timer.h>
 #include <common/debug.h>
 
@@ -72,8 +76,40 @@ struct thread {
 
 	/* Used for wake other threads in thread_exit */
 	int *clear_child_tid;
+
+	/* Priority inheritance, protected by futex_lock of the cap_group */
+	unsigned int base_prio;                 // priority without PI boosting
+	struct list_head pi_futexes;            // PI futexes held by the thread
+	struct futex_entry *pi_blocked_on;      // PI futex the thread waits for
+	struct list_head pi_waiter_node;        // link waiters of pi_blocked_on
+
+	/* Waiting on a non-PI futex */
+	struct futex_waiter futex_waiter;
+
+	/* Used by the fair policy */
+	struct fair_entity fair_se;
+
+	/* CPU time accounting */
+	struct sched_acct acct;
+
+	/* Where to resume the thread if preempted in kernel mode */
+	vaddr_t preempted_ctx;
+
+	/* CPUs allowed within the cpuset of its cap_group, 0 for all */
+	cpumask_t cpu_mask;
 };
 
+/*
+ * Whether the scheduler should retire @thread instead of running it. A thread
+ * preempted in kernel mode finishes the kernel work first (CHCORE_KERNEL_RT).
+ */
+static inline bool thread_should_exit(struct thread *thread)
+{
+	return (thread->thread_ctx->thread_exit_state == TE_EXITING
+		&& !thread->preempted_ctx)
+	       || thread->thread_ctx->thread_exit_state == TE_EXITED;
+}
+
 extern struct thread *current_threads[PLAT_CPU_NUM];
 extern struct thread idle_threads[PLAT_CPU_NUM];
 
@@ -92,6 +128,8 @@ int sys_set_affinity(cap_t thread_cap, s32 aff);
 s32 sys_get_affinity(cap_t thread_cap);
 int sys_set_prio(cap_t thread_cap, int prio);
 int sys_get_prio(cap_t thread_cap);
+int sys_set_nice(cap_t cap, int nice);
+int sys_get_nice(cap_t cap);
 int sys_set_tid_address(int *tidptr);
 
 #endif /* OBJECT_THREAD_H */
\ No newline at end of file
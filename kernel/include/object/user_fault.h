@@ -50,6 +50,8 @@ struct fmap_fault_pool {
         struct list_head pending_threads;
 
         struct lock lock;
+        /* Serializes committing private copies to the file pmos */
+        struct lock commit_lock;
         struct list_head node;
 };
 
@@ -62,5 +64,8 @@ void handle_user_fault(struct pmobject *pmo, vaddr_t fault_va);
 int sys_user_fault_register(cap_t notific_cap, vaddr_t msg_buffer);
 int sys_user_fault_map(badge_t client_badge, vaddr_t fault_va, vaddr_t remap_va,
                        bool copy, unsigned long perm);
+long sys_user_fault_map_batch(badge_t client_badge, vaddr_t fault_va,
+                              vaddr_t remap_vas, unsigned long nr_pages,
+                              bool copy, unsigned long perm);
 
 #endif /* OBJECT_USER_FAULT_H */
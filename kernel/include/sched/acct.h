@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef SCHED_ACCT_H
+#define SCHED_ACCT_H
+
+#include <common/types.h>
+#include <uapi/sched_stat.h>
+
+/*
+ * CPU time accounting.
+ *
+ * The time of a thread is split at kernel entries from user mode, returns to
+ * user mode and context switches. Time between a return to user mode and the
+ * next kernel entry is user time, and the rest is kernel time. The time of a
+ * thread running in user mode is therefore brought up to date at the next
+ * timer interrupt at the latest.
+ *
+ * All the fields are only written on the CPU running the thread, except
+ * ready_stamp, which is written by the CPU enqueuing it.
+ */
+struct sched_acct {
+        u64 user_ns;
+        u64 kernel_ns;
+        /* Time spent serving IPC with a scheduling context of the caller */
+        u64 ipc_ns;
+        /* Time spent in ready queues */
+        u64 wait_ns;
+        u64 nr_switches;
+        /* Switched out while still ready, i.e., preempted */
+        u64 nr_preempted;
+        /* Start of the current user or kernel interval */
+        u64 stamp;
+        /* When the thread became ready, 0 if not ready */
+        u64 ready_stamp;
+};
+
+struct thread;
+
+/* Called on kernel entries from and returns to user mode of current_thread */
+void sched_acct_enter_kernel(void);
+void sched_acct_exit_kernel(void);
+/* Called by switch_to_thread before current_thread becomes @next */
+void sched_acct_switch(struct thread *prev, struct thread *next);
+/* Called by policies when @thread is put into a ready queue */
+void sched_acct_ready(struct thread *thread);
+/* Sum @src into @dst, e.g., to keep the time of exited threads */
+void sched_acct_add(struct sched_acct *dst, const struct sched_acct *src);
+
+/* Syscalls */
+int sys_get_sched_stat(struct sched_stat_info *ubuf, unsigned long nr);
+
+#endif /* SCHED_ACCT_H */
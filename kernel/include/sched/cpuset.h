@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef SCHED_CPUSET_H
+#define SCHED_CPUSET_H
+
+#include <common/types.h>
+#include <machine.h>
+#include <uapi/cpuset.h>
+
+/*
+ * CPU masks and cpusets.
+ *
+ * The CPUs a thread may run on are those of the cpuset of its cap_group,
+ * narrowed by the CPU mask of the thread if they overlap. A thread pinned to
+ * one CPU with sys_set_affinity only runs on that CPU.
+ *
+ * Changes take effect when the threads are enqueued again (or at the next
+ * scheduling on the CPU for the running ones).
+ */
+
+typedef u64 cpumask_t;
+
+#define CPUMASK_ALL ((cpumask_t)((1UL << PLAT_CPU_NUM) - 1))
+
+struct thread;
+struct cap_group;
+
+/* A new process is in the cpuset of its creator */
+void cpuset_init_cap_group(struct cap_group *cap_group,
+                           struct cap_group *creator);
+
+cpumask_t sched_allowed_cpus(struct thread *thread);
+
+static inline bool sched_cpu_allowed(struct thread *thread, unsigned int cpuid)
+{
+        return (sched_allowed_cpus(thread) & (1UL << cpuid)) != 0;
+}
+
+/* @hint if it is in @allowed, or the next CPU in it */
+unsigned int sched_pick_allowed_cpu(cpumask_t allowed, unsigned int hint);
+
+/* Syscalls */
+long sys_cpuset(int op, unsigned long arg0, unsigned long arg1);
+int sys_set_cpu_mask(cap_t thread_cap, unsigned long mask);
+/* Returns the CPUs the thread may run on */
+long sys_get_cpu_mask(cap_t thread_cap);
+
+#endif /* SCHED_CPUSET_H */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef SCHED_FAIR_H
+#define SCHED_FAIR_H
+
+#include <common/types.h>
+#include <common/rbtree.h>
+#include <machine.h>
+
+/*
+ * Weighted fair scheduling (the "fair" policy).
+ *
+ * CPU time is shared among cap_groups first, and then among the threads of
+ * a cap_group, in proportion to their weights. Weights are given as nice
+ * values like Linux: nice 0 stands for a weight of 1024, and each step
+ * changes the weight by about 25%.
+ *
+ * Each CPU orders the cap_groups with ready threads on it by their virtual
+ * runtime (runtime scaled by the inverse of the weight) in a tree, and each
+ * of such cap_groups orders its ready threads on the CPU in another tree. The
+ * scheduler runs the leftmost thread of the leftmost cap_group.
+ */
+
+#define FAIR_MIN_NICE      (-20)
+#define FAIR_MAX_NICE      19
+#define FAIR_NICE_0_WEIGHT 1024
+
+/* Scheduling entity of a thread */
+struct fair_entity {
+        /* Link in the tree of the fair_group_rq when ready */
+        struct rb_node node;
+        u64 vruntime;
+        u32 weight;
+        int nice;
+        /* The CPU on which vruntime is measured, -1 for none */
+        int last_cpu;
+        /* Runtime in ns */
+        u64 sum_exec;
+};
+
+/* Ready threads of a cap_group on one CPU */
+struct fair_group_rq {
+        /* Link in the tree of the CPU when nr_queued > 0 */
+        struct rb_node node;
+        u64 vruntime;
+        /* Lower bound for vruntime of threads becoming ready */
+        u64 min_vruntime;
+        struct rb_root threads;
+        unsigned int nr_queued;
+};
+
+/* Scheduling states of a cap_group */
+struct fair_group {
+        u32 weight;
+        int nice;
+        struct fair_group_rq rqs[PLAT_CPU_NUM];
+};
+
+struct thread;
+struct cap_group;
+
+void fair_entity_init(struct fair_entity *se);
+void fair_group_init(struct fair_group *group);
+
+/* Set the weight of a thread or a cap_group, return -EINVAL for bad @nice */
+int sched_set_nice(struct thread *thread, int nice);
+int sched_set_group_nice(struct cap_group *cap_group, int nice);
+
+#endif /* SCHED_FAIR_H */
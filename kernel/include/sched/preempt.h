@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef SCHED_PREEMPT_H
+#define SCHED_PREEMPT_H
+
+#include <common/types.h>
+
+/*
+ * Kernel preemption (CHCORE_KERNEL_RT only).
+ *
+ * Threads in kernel mode are only switched out at preemption points, i.e.,
+ * cond_resched() in long loops. A point takes the pending interrupts (e.g.,
+ * the timer) and does the pending reschedulings (see add_pending_resched)
+ * when the preempt count of the local CPU is 0:
+ * - The count is 1 outside preemptible sections, which are opened by syscalls
+ *   with preempt_section_enter() around long operations, without any lock
+ *   held. rwlocks are not counted, so a section must not reach a point with
+ *   one held.
+ * - Each spinlock held adds 1, except hand-off locks (see handoff_lock_init).
+ *
+ * Without CHCORE_KERNEL_RT, all of these are no-ops.
+ */
+
+#ifdef CHCORE_KERNEL_RT
+#include <arch/preempt.h>
+
+static inline void preempt_disable(void)
+{
+        arch_preempt_count_add(1);
+}
+
+static inline void preempt_enable(void)
+{
+        arch_preempt_count_add(-1);
+}
+
+static inline u32 preempt_count(void)
+{
+        return arch_preempt_count();
+}
+
+/* Whether the local CPU has interrupts or reschedulings pending */
+bool need_resched(void);
+void __cond_resched(void);
+
+static inline void cond_resched(void)
+{
+        if (preempt_count() == 0 && need_resched())
+                __cond_resched();
+}
+
+#else /* CHCORE_KERNEL_RT */
+
+static inline void preempt_disable(void)
+{
+}
+
+static inline void preempt_enable(void)
+{
+}
+
+static inline u32 preempt_count(void)
+{
+        return 1;
+}
+
+static inline bool need_resched(void)
+{
+        return false;
+}
+
+static inline void cond_resched(void)
+{
+}
+
+#endif /* CHCORE_KERNEL_RT */
+
+static inline void preempt_section_enter(void)
+{
+        preempt_enable();
+}
+
+static inline void preempt_section_exit(void)
+{
+        preempt_disable();
+}
+
+/*
+ * For lock-breaks: whether releasing the only lock held lets cond_resched()
+ * do something.
+ */
+static inline bool need_lockbreak(void)
+{
+        return preempt_count() == 1 && need_resched();
+}
+
+#endif /* SCHED_PREEMPT_H */
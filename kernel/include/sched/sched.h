@@ -88,6 +88,7 @@ struct sched_ops {
 extern struct sched_ops pbrr;	/* Priority Based Round Robin */
 extern struct sched_ops pbfifo;	/* Priority Based FIFO */
 extern struct sched_ops rr;	/* Simple Round Robin */
+extern struct sched_ops fair;	/* Weighted Fair Share */
 
 /* Chosen Scheduling Policies */
 extern struct sched_ops *cur_sched_ops;
@@ -121,6 +122,12 @@ extern void __eret_to_thread(unsigned long sp);
 void sched_to_thread(struct thread *target);
 /* Add a mark indicating re-sched is needed on cpuid */
 void add_pending_resched(unsigned int cpuid);
+#ifdef CHCORE_KERNEL_RT
+/* Do the marked re-scheds of the local CPU, never returns if it has one */
+void do_pending_resched(void);
+#endif
+/* Change the priority of a thread, which may be in a ready queue */
+void sched_set_prio(struct thread *thread, unsigned int prio);
 /* Wait until the kernel stack of target thread is free */
 void wait_for_kernel_stack(struct thread *thread);
 
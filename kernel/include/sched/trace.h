@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef SCHED_TRACE_H
+#define SCHED_TRACE_H
+
+#include <common/types.h>
+#include <uapi/sched_trace.h>
+
+/*
+ * Scheduler event tracing, compiled in if CHCORE_KERNEL_SCHED_TRACE is
+ * enabled, and recording after SCHED_TRACE_ENABLE.
+ *
+ * Each CPU records its events into its own ring buffer, so recording only
+ * contends with draining. Events are dropped (and counted) when the buffer of
+ * a CPU is full.
+ */
+
+struct thread;
+struct timespec;
+
+#ifdef CHCORE_KERNEL_SCHED_TRACE
+
+extern bool sched_trace_enabled;
+
+void __sched_trace(unsigned int type, struct thread *thread,
+                   unsigned long arg);
+void __sched_trace_pair(unsigned int type, struct thread *thread,
+                        struct thread *other);
+
+static inline void sched_trace(unsigned int type, struct thread *thread,
+                               unsigned long arg)
+{
+        if (unlikely(sched_trace_enabled))
+                __sched_trace(type, thread, arg);
+}
+
+/* For events whose arg is another thread */
+static inline void sched_trace_pair(unsigned int type, struct thread *thread,
+                                    struct thread *other)
+{
+        if (unlikely(sched_trace_enabled))
+                __sched_trace_pair(type, thread, other);
+}
+
+#else /* CHCORE_KERNEL_SCHED_TRACE */
+
+static inline void sched_trace(unsigned int type, struct thread *thread,
+                               unsigned long arg)
+{
+}
+
+static inline void sched_trace_pair(unsigned int type, struct thread *thread,
+                                    struct thread *other)
+{
+}
+
+#endif /* CHCORE_KERNEL_SCHED_TRACE */
+
+/* Syscalls */
+long sys_sched_trace(int cmd, struct sched_trace_event *ubuf,
+                     unsigned long nr);
+/* sys_wait and sys_notify recording SCHED_EV_WAIT and SCHED_EV_NOTIFY */
+int sys_traced_wait(cap_t notifc_cap, bool is_block, struct timespec *timeout);
+int sys_traced_notify(cap_t notifc_cap);
+
+#endif /* SCHED_TRACE_H */
@@ -58,6 +58,7 @@
 #include <mm/uaccess.h>
 #include <object/memory.h>
 #include <sched/context.h>
+#include <sched/trace.h>
 #include <common/util.h>
 
 /*
@@ -125,7 +126,7 @@ static int register_server(struct thread *server, unsigned long ipc_routine,
          * In other words, a register_cb_thread can only serve
          * registration requests one-by-one.
          */
-        lock_init(&register_cb_config->register_lock);
+        handoff_lock_init(&register_cb_config->register_lock);
 
         /* Record PC as well as the thread's initial stack (SP). */
         register_cb_config->register_cb_entry =
@@ -262,7 +263,7 @@ static int create_connection(struct thread *client, struct thread *server,
         conn->shm.shm_cap_in_client = shm_cap_client;
         conn->shm.shm_cap_in_server = shm_cap_server;
 
-        lock_init(&conn->ownership);
+        handoff_lock_init(&conn->ownership);
         /* Initialize the connection (end) */
 
         /* After initializing the object,
@@ -683,6 +684,9 @@ unsigned long sys_ipc_call(cap_t conn_cap, unsigned int cap_num)
         */
 
         /* Call server (handler thread) */
+        sched_trace_pair(SCHED_EV_IPC_CALL,
+                         current_thread,
+                         conn->server_handler_thread);
         ipc_thread_migrate_to_server(conn, conn->shm.server_shm_uaddr, conn->shm.shm_size, cap_num);
 
         BUG("should not reach here\n");
@@ -820,6 +824,7 @@ int sys_ipc_return(unsigned long ret, unsigned int cap_num)
         obj_put(conn);
 
         /* Return to client */
+        sched_trace_pair(SCHED_EV_IPC_RETURN, current_thread, client);
         thread_migrate_to_client(client, ret);
         BUG("should not reach here\n");
         __builtin_unreachable();
@@ -886,7 +891,7 @@ int sys_ipc_register_cb_return(cap_t server_handler_thread_cap,
                 handler_config = (struct ipc_server_handler_config *)kmalloc(
                         sizeof(*handler_config));
                 ipc_server_handler_thread->general_ipc_config = handler_config;
-                lock_init(&handler_config->ipc_lock);
+                handoff_lock_init(&handler_config->ipc_lock);
 
                 /*
                  * Record the initial PC & SP for the handler_thread.
@@ -0,0 +1,995 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <common/errno.h>
+#include <common/kprint.h>
+#include <common/lock.h>
+#include <common/lockstat.h>
+#include <common/macro.h>
+#include <ipc/futex.h>
+#include <ipc/notification.h>
+#include <mm/common_pte.h>
+#include <mm/kmalloc.h>
+#include <mm/mm.h>
+#include <mm/uaccess.h>
+#include <mm/vmspace.h>
+#include <object/cap_group.h>
+#include <object/object.h>
+#include <object/thread.h>
+#include <sched/context.h>
+#include <sched/sched.h>
+#include <arch/futex.h>
+
+/*
+ * Non-PI futexes.
+ *
+ * Waiting threads are queued in the bucket of their futex key directly, so a
+ * wait needs no allocation, and futexes of different addresses rarely contend
+ * on the same lock. The lock of a bucket is held from checking the futex word
+ * until the waiter is blocked, which makes wait and wake atomic to each other.
+ *
+ * Futex words are never accessed through their user address with a futex lock
+ * held, since a fault there may sleep (e.g., in a pager) or take the
+ * vmspace_lock. They are faulted in with no lock held first, and then read or
+ * updated through the kernel mapping of the page, see futex_read_locked.
+ */
+
+struct futex_bucket {
+        struct lock lock;
+        struct list_head waiters;
+        char pad[pad_to_cache_line(sizeof(struct lock)
+                                   + sizeof(struct list_head))];
+};
+
+static struct futex_bucket futex_buckets[FUTEX_BUCKET_NUM];
+
+void futex_hash_init(void)
+{
+        int i;
+
+        for (i = 0; i < FUTEX_BUCKET_NUM; i++) {
+                lock_init(&futex_buckets[i].lock);
+                lockstat_register(&futex_buckets[i].lock, "futex_bucket");
+                init_list_head(&futex_buckets[i].waiters);
+        }
+}
+
+static struct futex_bucket *futex_get_bucket(struct futex_key *key)
+{
+        u64 hash;
+
+        /* Multiplicative hashing with the golden ratio */
+        hash = ((u64)key->object ^ (key->offset >> 2)) * 0x9e3779b97f4a7c15UL;
+        return &futex_buckets[hash >> (64 - FUTEX_HASH_BITS)];
+}
+
+static inline bool futex_key_equal(struct futex_key *a, struct futex_key *b)
+{
+        return a->object == b->object && a->offset == b->offset;
+}
+
+/*
+ * Shared futexes are keyed by the pmo under @uaddr, so that processes mapping
+ * the same pmo meet in the same bucket, unless the mapping is private (CoW).
+ */
+static int futex_get_key(int *uaddr, bool shared, struct futex_key *key)
+{
+        struct vmspace *vmspace = current_thread->vmspace;
+        struct vmregion *vmr;
+        vaddr_t addr = (vaddr_t)uaddr;
+
+        if (check_user_addr_range(addr, sizeof(int)) != 0)
+                return -EFAULT;
+        if (addr % sizeof(int))
+                return -EINVAL;
+
+        key->object = vmspace;
+        key->offset = addr;
+        if (!shared)
+                return 0;
+
+        lock(&vmspace->vmspace_lock);
+        vmr = find_vmr_for_va(vmspace, addr);
+        if (!vmr) {
+                unlock(&vmspace->vmspace_lock);
+                return -EFAULT;
+        }
+        if (!(vmr->perm & VMR_COW)) {
+                key->object = vmr->pmo;
+                key->offset = addr - vmr->start + vmr->offset;
+        }
+        unlock(&vmspace->vmspace_lock);
+        return 0;
+}
+
+/* Lock two buckets in the order of their addresses */
+static void futex_lock_buckets(struct futex_bucket *b1, struct futex_bucket *b2)
+{
+        if (b1 > b2) {
+                struct futex_bucket *tmp = b1;
+                b1 = b2;
+                b2 = tmp;
+        }
+        lock(&b1->lock);
+        if (b1 != b2)
+                lock(&b2->lock);
+}
+
+static void futex_unlock_buckets(struct futex_bucket *b1,
+                                 struct futex_bucket *b2)
+{
+        unlock(&b1->lock);
+        if (b1 != b2)
+                unlock(&b2->lock);
+}
+
+/*
+ * Find the kernel address of the futex word at @uaddr, whose page should be
+ * mapped (writable for @write) in the current vmspace. Should be called with
+ * the pgtbl_lock held, which keeps the page from being unmapped, swapped out
+ * or merged. Return -EAGAIN if it is not mapped so.
+ */
+static int futex_word_kva(struct vmspace *vmspace, int *uaddr, bool write,
+                          int **kva)
+{
+        struct common_pte_t pte_info;
+        paddr_t pa;
+        pte_t *pte;
+
+        if (query_in_pgtbl(vmspace->pgtbl, (vaddr_t)uaddr, &pa, &pte) != 0)
+                return -EAGAIN;
+        if (write) {
+                parse_pte_to_common(pte, L3, &pte_info);
+                if (!(pte_info.perm & VMR_WRITE))
+                        return -EAGAIN;
+        }
+        *kva = (int *)phys_to_virt(pa);
+        return 0;
+}
+
+/*
+ * Read the futex word at @uaddr without faulting, so it can be called with
+ * futex locks held. Return -EAGAIN if the page is not mapped, and then the
+ * caller should drop its locks, call futex_fault_in and try again.
+ */
+static int futex_read_locked(int *uaddr, int *val)
+{
+        struct vmspace *vmspace = current_thread->vmspace;
+        int *kva;
+        int ret;
+
+        lock(&vmspace->pgtbl_lock);
+        ret = futex_word_kva(vmspace, uaddr, false, &kva);
+        if (ret == 0)
+                *val = *(volatile int *)kva;
+        unlock(&vmspace->pgtbl_lock);
+        return ret;
+}
+
+/* Like futex_atomic_cmpxchg, but never faults like futex_read_locked */
+static int futex_cmpxchg_locked(int *uaddr, int oldval, int newval,
+                                int *curval)
+{
+        struct vmspace *vmspace = current_thread->vmspace;
+        int *kva;
+        int ret;
+
+        lock(&vmspace->pgtbl_lock);
+        ret = futex_word_kva(vmspace, uaddr, true, &kva);
+        if (ret == 0)
+                *curval = (int)atomic_cmpxchg_32(
+                        (u32 *)kva, (u32)oldval, (u32)newval);
+        unlock(&vmspace->pgtbl_lock);
+        return ret;
+}
+
+/*
+ * Fault in the page of the futex word at @uaddr (writable for @write), with no
+ * futex lock held. Return -EFAULT if it is not accessible.
+ */
+static int futex_fault_in(int *uaddr, bool write)
+{
+        int uval, curval;
+
+        if (copy_from_user(&uval, uaddr, sizeof(int)) != 0)
+                return -EFAULT;
+        /* Storing the same value takes the write fault, e.g., CoW */
+        if (write && futex_atomic_cmpxchg(uaddr, uval, uval, &curval) != 0)
+                return -EFAULT;
+        return 0;
+}
+
+/* Should be called with the lock of the bucket held */
+static void futex_wake_waiter(struct futex_waiter *waiter)
+{
+        struct thread *thread = container_of(waiter, struct thread, futex_waiter);
+
+        list_del(&waiter->node);
+        waiter->bucket = NULL;
+        thread->thread_ctx->state = TS_INTER;
+        BUG_ON(sched_enqueue(thread));
+}
+
+/* Wake up to @nr_wake waiters of @key in @bucket, return the number woken */
+static int futex_wake_bucket(struct futex_bucket *bucket, struct futex_key *key,
+                             int nr_wake, u32 bitset)
+{
+        struct futex_waiter *waiter, *tmp;
+        int woken = 0;
+
+        for_each_in_list_safe (waiter, tmp, node, &bucket->waiters) {
+                if (woken >= nr_wake)
+                        break;
+                if (!futex_key_equal(&waiter->key, key)
+                    || !(waiter->bitset & bitset))
+                        continue;
+                futex_wake_waiter(waiter);
+                woken++;
+        }
+        return woken;
+}
+
+void futex_waiter_deinit(struct thread *thread)
+{
+        struct futex_waiter *waiter = &thread->futex_waiter;
+        struct futex_bucket *bucket;
+
+        /* The bucket may be changed by requeue until its lock is held */
+        while ((bucket = waiter->bucket) != NULL) {
+                lock(&bucket->lock);
+                if (waiter->bucket == bucket) {
+                        list_del(&waiter->node);
+                        waiter->bucket = NULL;
+                }
+                unlock(&bucket->lock);
+        }
+}
+
+int sys_futex_wait(int *uaddr, int futex_op, int val, struct timespec *timeout,
+                   u32 bitset)
+{
+        struct thread *thread = current_thread;
+        struct futex_waiter *waiter = &thread->futex_waiter;
+        struct futex_bucket *bucket;
+        struct futex_key key;
+        int uval, ret;
+
+        if (bitset == 0)
+                return -EINVAL;
+        ret = futex_get_key(uaddr, !(futex_op & FUTEX_PRIVATE), &key);
+        if (ret != 0)
+                return ret;
+
+        bucket = futex_get_bucket(&key);
+retry:
+        lock(&bucket->lock);
+
+        if (futex_read_locked(uaddr, &uval) != 0) {
+                unlock(&bucket->lock);
+                ret = futex_fault_in(uaddr, false);
+                if (ret != 0)
+                        return ret;
+                goto retry;
+        }
+        if (uval != val) {
+                ret = -EAGAIN;
+                goto out_unlock;
+        }
+
+        waiter->key = key;
+        waiter->bitset = bitset;
+        waiter->bucket = bucket;
+        list_append(&waiter->node, &bucket->waiters);
+
+        /* Block until futex_wake_waiter, with the bucket unlocked */
+        thread->thread_ctx->state = TS_WAITING;
+        arch_set_thread_return(thread, 0);
+        sched();
+        unlock(&bucket->lock);
+        eret_to_thread(switch_context());
+        /* No return */
+
+out_unlock:
+        unlock(&bucket->lock);
+        return ret;
+}
+
+int sys_futex_wake(int *uaddr, int futex_op, int val, u32 bitset)
+{
+        struct futex_bucket *bucket;
+        struct futex_key key;
+        int ret;
+
+        if (bitset == 0)
+                return -EINVAL;
+        ret = futex_get_key(uaddr, !(futex_op & FUTEX_PRIVATE), &key);
+        if (ret != 0)
+                return ret;
+
+        bucket = futex_get_bucket(&key);
+        lock(&bucket->lock);
+        ret = futex_wake_bucket(bucket, &key, val, bitset);
+        unlock(&bucket->lock);
+        return ret;
+}
+
+/*
+ * Wake up to @nr_wake waiters of @uaddr, and move up to @nr_requeue others to
+ * wait on @uaddr2. With @cmp (FUTEX_CMP_REQUEUE), nothing is done unless
+ * @uaddr holds @cmpval. Return the number of waiters woken or requeued.
+ */
+int sys_futex_requeue(int *uaddr, int *uaddr2, int futex_op, int nr_wake,
+                      int nr_requeue, bool cmp, int cmpval)
+{
+        struct futex_bucket *b1, *b2;
+        struct futex_key key1, key2;
+        struct futex_waiter *waiter, *tmp;
+        bool shared = !(futex_op & FUTEX_PRIVATE);
+        int uval, woken = 0, requeued = 0, ret;
+
+        if (nr_wake < 0 || nr_requeue < 0)
+                return -EINVAL;
+        ret = futex_get_key(uaddr, shared, &key1);
+        if (ret != 0)
+                return ret;
+        ret = futex_get_key(uaddr2, shared, &key2);
+        if (ret != 0)
+                return ret;
+        if (futex_key_equal(&key1, &key2))
+                return -EINVAL;
+
+        b1 = futex_get_bucket(&key1);
+        b2 = futex_get_bucket(&key2);
+retry:
+        futex_lock_buckets(b1, b2);
+
+        if (cmp) {
+                if (futex_read_locked(uaddr, &uval) != 0) {
+                        futex_unlock_buckets(b1, b2);
+                        ret = futex_fault_in(uaddr, false);
+                        if (ret != 0)
+                                return ret;
+                        goto retry;
+                }
+                if (uval != cmpval) {
+                        ret = -EAGAIN;
+                        goto out_unlock;
+                }
+        }
+
+        for_each_in_list_safe (waiter, tmp, node, &b1->waiters) {
+                if (!futex_key_equal(&waiter->key, &key1))
+                        continue;
+                if (woken < nr_wake) {
+                        futex_wake_waiter(waiter);
+                        woken++;
+                } else if (requeued < nr_requeue) {
+                        list_del(&waiter->node);
+                        waiter->key = key2;
+                        waiter->bucket = b2;
+                        list_append(&waiter->node, &b2->waiters);
+                        requeued++;
+                } else {
+                        break;
+                }
+        }
+        ret = woken + requeued;
+
+out_unlock:
+        futex_unlock_buckets(b1, b2);
+        return ret;
+}
+
+/*
+ * Apply the operation of FUTEX_WAKE_OP to @uaddr, return the comparison. It
+ * never faults, and returns -EAGAIN like futex_cmpxchg_locked.
+ */
+static int futex_atomic_op(int *uaddr, int encoded_op)
+{
+        u32 op = ((u32)encoded_op >> 28) & 7;
+        u32 cmp = ((u32)encoded_op >> 24) & 15;
+        int oparg = (int)((u32)encoded_op << 8) >> 20;
+        int cmparg = (int)((u32)encoded_op << 20) >> 20;
+        int oldval, newval, curval, ret;
+
+        if ((u32)encoded_op & (FUTEX_OP_OPARG_SHIFT << 28)) {
+                if (oparg < 0 || oparg > 31)
+                        return -EINVAL;
+                oparg = 1 << oparg;
+        }
+
+        do {
+                ret = futex_read_locked(uaddr, &oldval);
+                if (ret != 0)
+                        return ret;
+                switch (op) {
+                case FUTEX_OP_SET:
+                        newval = oparg;
+                        break;
+                case FUTEX_OP_ADD:
+                        newval = oldval + oparg;
+                        break;
+                case FUTEX_OP_OR:
+                        newval = oldval | oparg;
+                        break;
+                case FUTEX_OP_ANDN:
+                        newval = oldval & ~oparg;
+                        break;
+                case FUTEX_OP_XOR:
+                        newval = oldval ^ oparg;
+                        break;
+                default:
+                        return -ENOSYS;
+                }
+                ret = futex_cmpxchg_locked(uaddr, oldval, newval, &curval);
+                if (ret != 0)
+                        return ret;
+        } while (curval != oldval);
+
+        switch (cmp) {
+        case FUTEX_OP_CMP_EQ:
+                return oldval == cmparg;
+        case FUTEX_OP_CMP_NE:
+                return oldval != cmparg;
+        case FUTEX_OP_CMP_LT:
+                return oldval < cmparg;
+        case FUTEX_OP_CMP_LE:
+                return oldval <= cmparg;
+        case FUTEX_OP_CMP_GT:
+                return oldval > cmparg;
+        case FUTEX_OP_CMP_GE:
+                return oldval >= cmparg;
+        default:
+                return -ENOSYS;
+        }
+}
+
+/*
+ * Update @uaddr2 with @encoded_op, wake up to @nr_wake waiters of @uaddr, and
+ * also up to @nr_wake2 waiters of @uaddr2 if the old value of @uaddr2 passes
+ * the comparison. Return the number of waiters woken.
+ */
+int sys_futex_wake_op(int *uaddr, int *uaddr2, int futex_op, int nr_wake,
+                      int nr_wake2, int encoded_op)
+{
+        struct futex_bucket *b1, *b2;
+        struct futex_key key1, key2;
+        bool shared = !(futex_op & FUTEX_PRIVATE);
+        int woken, ret;
+
+        ret = futex_get_key(uaddr, shared, &key1);
+        if (ret != 0)
+                return ret;
+        ret = futex_get_key(uaddr2, shared, &key2);
+        if (ret != 0)
+                return ret;
+
+        b1 = futex_get_bucket(&key1);
+        b2 = futex_get_bucket(&key2);
+retry:
+        futex_lock_buckets(b1, b2);
+
+        ret = futex_atomic_op(uaddr2, encoded_op);
+        if (ret == -EAGAIN) {
+                futex_unlock_buckets(b1, b2);
+                ret = futex_fault_in(uaddr2, true);
+                if (ret != 0)
+                        return ret;
+                goto retry;
+        }
+        if (ret < 0)
+                goto out_unlock;
+
+        woken = futex_wake_bucket(b1, &key1, nr_wake, FUTEX_BITSET_MATCH_ANY);
+        if (ret)
+                woken += futex_wake_bucket(
+                        b2, &key2, nr_wake2, FUTEX_BITSET_MATCH_ANY);
+        ret = woken;
+
+out_unlock:
+        futex_unlock_buckets(b1, b2);
+        return ret;
+}
+
+/*
+ * PI futexes of a cap_group are kept in its futex_entries, which are
+ * protected by its futex_lock. An entry only exists while some thread is
+ * waiting on it.
+ */
+#define FUTEX_PI_BUCKET_NUM 16
+
+void futex_init(struct cap_group *cap_group)
+{
+        lock_init(&cap_group->futex_lock);
+        init_htable(&cap_group->futex_entries, FUTEX_PI_BUCKET_NUM);
+}
+
+void futex_deinit(struct cap_group *cap_group)
+{
+        struct futex_entry *entry, *tmp;
+        int b;
+
+        for_each_in_htable_safe (
+                entry, tmp, b, hash_node, &cap_group->futex_entries) {
+                htable_del(&entry->hash_node);
+                deinit_notific(entry->notific);
+                kfree(entry->notific);
+                kfree(entry);
+        }
+        htable_free(&cap_group->futex_entries);
+}
+
+static inline u32 futex_pi_key(int *uaddr)
+{
+        return (long)uaddr % PAGE_SIZE;
+}
+
+static struct futex_entry *futex_find_entry(struct cap_group *cap_group,
+                                            int *uaddr)
+{
+        struct futex_entry *entry;
+        struct hlist_head *bucket;
+
+        bucket = htable_get_bucket(&cap_group->futex_entries,
+                                   futex_pi_key(uaddr));
+        for_each_in_hlist (entry, hash_node, bucket) {
+                if (entry->waiter_count > 0 && entry->uaddr == uaddr)
+                        return entry;
+        }
+        return NULL;
+}
+
+static struct futex_entry *futex_alloc_entry(struct cap_group *cap_group,
+                                             int *uaddr)
+{
+        struct futex_entry *entry;
+        struct notification *notific;
+
+        entry = kmalloc(sizeof(*entry));
+        if (!entry)
+                return NULL;
+        notific = kmalloc(sizeof(*notific));
+        if (!notific) {
+                kfree(entry);
+                return NULL;
+        }
+        init_notific(notific);
+
+        entry->notific = notific;
+        entry->uaddr = uaddr;
+        entry->waiter_count = 0;
+        entry->pi_owner = NULL;
+        init_list_head(&entry->pi_node);
+        init_list_head(&entry->pi_waiters);
+        htable_add(&cap_group->futex_entries,
+                   futex_pi_key(uaddr),
+                   &entry->hash_node);
+        return entry;
+}
+
+static void futex_free_entry(struct futex_entry *entry)
+{
+        /* A PI futex without waiters is not tracked by its owner anymore */
+        if (entry->pi_owner)
+                list_del(&entry->pi_node);
+
+        htable_del(&entry->hash_node);
+        deinit_notific(entry->notific);
+        kfree(entry->notific);
+        kfree(entry);
+}
+
+/*
+ * Priority-inheritance futexes.
+ *
+ * The futex word holds the TID of the owner, so an uncontended lock/unlock is
+ * a cmpxchg in user space. A contended one sets FUTEX_WAITERS and comes here:
+ * the waiter queues itself in pi_waiters of the entry (ordered by priority)
+ * and blocks, and the owner is boosted to the priority of its top waiter.
+ * Boosting is transitive: if the owner is blocked on another PI futex, its
+ * position there and the priority of that owner are updated as well.
+ *
+ * On unlock, the lock is handed over to the top waiter directly, i.e., the
+ * word is set to its TID before it is woken up.
+ *
+ * Only threads running with their own scheduling context (TYPE_USER) are
+ * boosted. The priority a thread sets for itself is kept in base_prio.
+ */
+
+static inline unsigned int futex_pi_prio(struct thread *thread)
+{
+        return thread->thread_ctx->sc ? thread->thread_ctx->sc->prio : 0;
+}
+
+static inline struct thread *futex_pi_top_waiter(struct futex_entry *entry)
+{
+        return list_entry(entry->pi_waiters.next, struct thread, pi_waiter_node);
+}
+
+/* Queue @thread to pi_waiters of @entry, after waiters of the same priority */
+static void futex_pi_enqueue_waiter(struct futex_entry *entry,
+                                    struct thread *thread)
+{
+        struct thread *waiter;
+        unsigned int prio = futex_pi_prio(thread);
+
+        for_each_in_list (waiter, struct thread, pi_waiter_node, &entry->pi_waiters) {
+                if (futex_pi_prio(waiter) < prio)
+                        break;
+        }
+        /* Insert before @waiter, or at the tail if the loop ends */
+        list_append(&thread->pi_waiter_node, &waiter->pi_waiter_node);
+}
+
+/* The priority @thread should run at, considering PI futexes it holds */
+static unsigned int futex_pi_eff_prio(struct thread *thread)
+{
+        struct futex_entry *entry;
+        unsigned int prio = thread->base_prio, top_prio;
+
+        for_each_in_list (entry, struct futex_entry, pi_node, &thread->pi_futexes) {
+                top_prio = futex_pi_prio(futex_pi_top_waiter(entry));
+                if (top_prio > prio)
+                        prio = top_prio;
+        }
+        return prio;
+}
+
+/* Recompute the priority of @thread and propagate it along the PI chain */
+static void futex_pi_adjust_prio(struct thread *thread)
+{
+        struct futex_entry *entry;
+        unsigned int prio;
+        int depth;
+
+        for (depth = 0; thread && depth < FUTEX_PI_MAX_DEPTH; depth++) {
+                if (thread->thread_ctx->type != TYPE_USER
+                    || !thread->thread_ctx->sc)
+                        break;
+
+                prio = futex_pi_eff_prio(thread);
+                if (prio == thread->thread_ctx->sc->prio)
+                        break;
+                sched_set_prio(thread, prio);
+
+                entry = thread->pi_blocked_on;
+                if (!entry)
+                        break;
+                list_del(&thread->pi_waiter_node);
+                futex_pi_enqueue_waiter(entry, thread);
+                thread = entry->pi_owner;
+        }
+}
+
+/* Whether blocking on a PI futex held by @owner would never return */
+static bool futex_pi_deadlock(struct thread *owner)
+{
+        int depth;
+
+        for (depth = 0; depth < FUTEX_PI_MAX_DEPTH; depth++) {
+                if (owner == current_thread)
+                        return true;
+                if (!owner || !owner->pi_blocked_on)
+                        return false;
+                owner = owner->pi_blocked_on->pi_owner;
+        }
+        /* Too long to check, treat it as a deadlock */
+        return true;
+}
+
+static void futex_pi_set_owner(struct futex_entry *entry, struct thread *owner)
+{
+        if (entry->pi_owner)
+                list_del(&entry->pi_node);
+        entry->pi_owner = owner;
+        list_add(&entry->pi_node, &owner->pi_futexes);
+}
+
+/*
+ * Wake the top waiter of @entry up, which becomes the new owner. The caller
+ * should have stored its TID in the futex word.
+ */
+static void futex_pi_wake_top(struct futex_entry *entry)
+{
+        struct notification *notific = entry->notific;
+        struct thread *old_owner = entry->pi_owner;
+        struct thread *new_owner = futex_pi_top_waiter(entry);
+
+        list_del(&new_owner->pi_waiter_node);
+        new_owner->pi_blocked_on = NULL;
+
+        /* signal_notific wakes the first waiting thread, so move it ahead */
+        lock(&notific->notifc_lock);
+        list_del(&new_owner->notification_queue_node);
+        list_add(&new_owner->notification_queue_node,
+                 &notific->waiting_threads);
+        unlock(&notific->notifc_lock);
+        BUG_ON(signal_notific(notific));
+
+        if (--entry->waiter_count > 0) {
+                futex_pi_set_owner(entry, new_owner);
+                futex_pi_adjust_prio(new_owner);
+        } else {
+                futex_free_entry(entry);
+        }
+        futex_pi_adjust_prio(old_owner);
+}
+
+static int futex_lock_pi(int *uaddr, bool trylock)
+{
+        struct cap_group *cap_group = current_cap_group;
+        struct futex_entry *entry;
+        struct thread *owner, *old_owner;
+        int tid = current_thread->cap;
+        int uval, newval, curval, ret;
+
+        if (check_user_addr_range((vaddr_t)uaddr, sizeof(int)) != 0)
+                return -EFAULT;
+
+        lock(&cap_group->futex_lock);
+retry:
+        ret = futex_cmpxchg_locked(uaddr, 0, tid, &uval);
+        if (ret != 0)
+                goto out_fault;
+        if (uval == 0)
+                goto out_unlock;
+        if ((uval & FUTEX_TID_MASK) == tid) {
+                ret = -EDEADLK;
+                goto out_unlock;
+        }
+
+        entry = futex_find_entry(cap_group, uaddr);
+
+        /* No owner (e.g., FUTEX_OWNER_DIED only): take it over */
+        if ((uval & FUTEX_TID_MASK) == 0) {
+                newval = tid | (uval & FUTEX_OWNER_DIED)
+                         | (entry ? FUTEX_WAITERS : 0);
+                ret = futex_cmpxchg_locked(uaddr, uval, newval, &curval);
+                if (ret != 0)
+                        goto out_fault;
+                if (curval != uval)
+                        goto retry;
+                if (entry) {
+                        old_owner = entry->pi_owner;
+                        futex_pi_set_owner(entry, current_thread);
+                        futex_pi_adjust_prio(old_owner);
+                        futex_pi_adjust_prio(current_thread);
+                }
+                goto out_unlock;
+        }
+
+        if (trylock) {
+                ret = -EAGAIN;
+                goto out_unlock;
+        }
+
+        /* Make the owner unlock it through the kernel */
+        if (!(uval & FUTEX_WAITERS)) {
+                ret = futex_cmpxchg_locked(
+                        uaddr, uval, uval | FUTEX_WAITERS, &curval);
+                if (ret != 0)
+                        goto out_fault;
+                if (curval != uval)
+                        goto retry;
+        }
+
+        owner = obj_get(cap_group, uval & FUTEX_TID_MASK, TYPE_THREAD);
+        if (!owner) {
+                ret = -ESRCH;
+                goto out_unlock;
+        }
+        if (futex_pi_deadlock(owner)) {
+                ret = -EDEADLK;
+                goto out_put;
+        }
+
+        if (!entry) {
+                entry = futex_alloc_entry(cap_group, uaddr);
+                if (!entry) {
+                        ret = -ENOMEM;
+                        goto out_put;
+                }
+        }
+        if (entry->pi_owner != owner) {
+                old_owner = entry->pi_owner;
+                futex_pi_set_owner(entry, owner);
+                futex_pi_adjust_prio(old_owner);
+        }
+
+        entry->waiter_count++;
+        current_thread->pi_blocked_on = entry;
+        futex_pi_enqueue_waiter(entry, current_thread);
+        futex_pi_adjust_prio(owner);
+        obj_put(owner);
+
+        /*
+         * Release futex_lock and block. The owner hands the lock over to us
+         * before waking us up, so it is held when the syscall returns 0.
+         */
+        ret = wait_notific_internal(entry->notific, true, NULL, true, false);
+
+        /* Only get here if wait_notific_internal does not block */
+        list_del(&current_thread->pi_waiter_node);
+        current_thread->pi_blocked_on = NULL;
+        if (--entry->waiter_count <= 0) {
+                old_owner = entry->pi_owner;
+                futex_free_entry(entry);
+                futex_pi_adjust_prio(old_owner);
+        } else {
+                futex_pi_adjust_prio(entry->pi_owner);
+        }
+        if (ret == 0)
+                goto retry;
+        goto out_unlock;
+
+out_put:
+        obj_put(owner);
+out_unlock:
+        unlock(&cap_group->futex_lock);
+        return ret;
+
+out_fault:
+        unlock(&cap_group->futex_lock);
+        ret = futex_fault_in(uaddr, true);
+        if (ret != 0)
+                return ret;
+        lock(&cap_group->futex_lock);
+        goto retry;
+}
+
+static int futex_unlock_pi(int *uaddr)
+{
+        struct cap_group *cap_group = current_cap_group;
+        struct futex_entry *entry;
+        int tid = current_thread->cap;
+        int uval, newval, curval, ret;
+
+        if (check_user_addr_range((vaddr_t)uaddr, sizeof(int)) != 0)
+                return -EFAULT;
+
+        lock(&cap_group->futex_lock);
+retry:
+        ret = futex_read_locked(uaddr, &uval);
+        if (ret != 0)
+                goto out_fault;
+        if ((uval & FUTEX_TID_MASK) != tid) {
+                ret = -EPERM;
+                goto out_unlock;
+        }
+
+        entry = futex_find_entry(cap_group, uaddr);
+
+        if (!entry) {
+                /* No waiters: just release it */
+                newval = 0;
+        } else {
+                newval = futex_pi_top_waiter(entry)->cap;
+                if (entry->waiter_count > 1)
+                        newval |= FUTEX_WAITERS;
+        }
+        ret = futex_cmpxchg_locked(uaddr, uval, newval, &curval);
+        if (ret != 0)
+                goto out_fault;
+        if (curval != uval)
+                goto retry;
+
+        if (entry)
+                futex_pi_wake_top(entry);
+
+out_unlock:
+        unlock(&cap_group->futex_lock);
+        return ret;
+
+out_fault:
+        unlock(&cap_group->futex_lock);
+        ret = futex_fault_in(uaddr, true);
+        if (ret != 0)
+                return ret;
+        lock(&cap_group->futex_lock);
+        goto retry;
+}
+
+void futex_exit_pi(void)
+{
+        struct cap_group *cap_group = current_cap_group;
+        struct futex_entry *entry;
+        int *faulted = NULL, *uaddr;
+        int uval, newval, curval, ret;
+
+        lock(&cap_group->futex_lock);
+        while (!list_empty(&current_thread->pi_futexes)) {
+                entry = list_entry(current_thread->pi_futexes.next,
+                                   struct futex_entry,
+                                   pi_node);
+                newval = futex_pi_top_waiter(entry)->cap | FUTEX_OWNER_DIED;
+                if (entry->waiter_count > 1)
+                        newval |= FUTEX_WAITERS;
+
+                do {
+                        ret = futex_read_locked(entry->uaddr, &uval);
+                        if (ret == 0)
+                                ret = futex_cmpxchg_locked(
+                                        entry->uaddr, uval, newval, &curval);
+                } while (ret == 0 && curval != uval);
+
+                if (ret != 0 && entry->uaddr != faulted) {
+                        /* Entries may change without the lock, look again */
+                        uaddr = entry->uaddr;
+                        unlock(&cap_group->futex_lock);
+                        futex_fault_in(uaddr, true);
+                        faulted = uaddr;
+                        lock(&cap_group->futex_lock);
+                        continue;
+                }
+
+                /* The waiter is woken up even if the word is not accessible */
+                futex_pi_wake_top(entry);
+        }
+        unlock(&cap_group->futex_lock);
+}
+
+void futex_pi_set_prio(struct thread *thread, unsigned int prio)
+{
+        struct cap_group *cap_group = thread->cap_group;
+
+        lock(&cap_group->futex_lock);
+        thread->base_prio = prio;
+        if (thread->thread_ctx->type != TYPE_USER)
+                sched_set_prio(thread, prio);
+        else
+                futex_pi_adjust_prio(thread);
+        unlock(&cap_group->futex_lock);
+}
+
+int sys_futex(int *uaddr, int futex_op, int val, struct timespec *timeout,
+              int *uaddr2, int val3)
+{
+        int cmd = futex_op & ~(FUTEX_PRIVATE | FUTEX_CLOCK_REALTIME);
+        /* Ops taking two counts pass the second one in @timeout */
+        int val2 = (int)(long)timeout;
+
+        /*
+         * Ops without FUTEX_PRIVATE work on shared futexes, except that PI
+         * futexes are always private, since their owners are identified by
+         * caps in the cap_group. musl probes FUTEX_LOCK_PI without
+         * FUTEX_PRIVATE, so accept both for them.
+         */
+        switch (cmd) {
+        case FUTEX_WAIT:
+                return sys_futex_wait(
+                        uaddr, futex_op, val, timeout, FUTEX_BITSET_MATCH_ANY);
+        case FUTEX_WAIT_BITSET:
+                return sys_futex_wait(uaddr, futex_op, val, timeout, val3);
+        case FUTEX_WAKE:
+                return sys_futex_wake(
+                        uaddr, futex_op, val, FUTEX_BITSET_MATCH_ANY);
+        case FUTEX_WAKE_BITSET:
+                return sys_futex_wake(uaddr, futex_op, val, val3);
+        case FUTEX_REQUEUE:
+                return sys_futex_requeue(
+                        uaddr, uaddr2, futex_op, val, val2, false, 0);
+        case FUTEX_CMP_REQUEUE:
+                return sys_futex_requeue(
+                        uaddr, uaddr2, futex_op, val, val2, true, val3);
+        case FUTEX_WAKE_OP:
+                return sys_futex_wake_op(
+                        uaddr, uaddr2, futex_op, val, val2, val3);
+        case FUTEX_LOCK_PI:
+                return futex_lock_pi(uaddr, false);
+        case FUTEX_TRYLOCK_PI:
+                return futex_lock_pi(uaddr, true);
+        case FUTEX_UNLOCK_PI:
+                return futex_unlock_pi(uaddr);
+        default:
+                return -ENOSYS;
+        }
+}
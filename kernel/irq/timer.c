@@ -18,8 +18,10 @@
 #include <common/kprint.h>
 #include <common/list.h>
 #include <common/lock.h>
+#include <common/lockstat.h>
 #include <mm/uaccess.h>
 #include <sched/context.h>
+#include <sched/trace.h>
 
 /* Per-core timer states */
 struct time_state {
@@ -44,7 +46,9 @@ void timer_init(void)
         if (smp_get_cpu_id() == 0) {
                 for (i = 0; i < PLAT_CPU_NUM; i++) {
                         init_list_head(&time_states[i].sleep_list);
-                        lock_init(&time_states[i].sleep_list_lock);
+                        mcs_lock_init(&time_states[i].sleep_list_lock);
+                        lockstat_register(&time_states[i].sleep_list_lock,
+                                          "sleep_list_lock");
                 }
         }
 
@@ -89,6 +93,8 @@ void handle_timer_irq(void)
         struct sleep_state *iter = NULL, *tmp = NULL;
         struct thread *wakeup_thread;
 
+        sched_trace(SCHED_EV_TIMER_IRQ, current_thread, 0);
+
         /* Remove the thread to wakeup from sleep list */
         current_tick = plat_get_current_tick();
         local_time_state = &time_states[smp_get_cpu_id()];
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <common/lockstat.h>
+#include <common/errno.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <common/util.h>
+#include <arch/sync.h>
+#include <arch/machine/smp.h>
+#include <machine.h>
+#include <mm/uaccess.h>
+#include <sched/preempt.h>
+
+#ifdef CHCORE_KERNEL_LOCKSTAT
+
+/*
+ * Counters are updated with atomic operations, so collecting statistics never
+ * takes a lock, and they are reset with atomic exchanges. Hold times are
+ * measured with a small per-CPU stack of held locks. Holding a lock disables
+ * kernel preemption (see sched/preempt.h), so a lock is released on the CPU
+ * which acquired it. Hand-off locks are the exception: they are released by
+ * other threads, so their hold times are not measured.
+ */
+
+#define LOCKSTAT_MAX_HELD 16
+
+struct lockstat_class {
+        const char *name;
+        u64 nr_locks;
+        u64 acquisitions;
+        u64 contentions;
+        u64 total_wait;
+        u64 max_wait;
+        u64 total_hold;
+        u64 max_hold;
+} __attribute__((aligned(64)));
+
+struct lockstat_held {
+        struct lock *lock;
+        u64 start;
+};
+
+struct lockstat_cpu {
+        struct lockstat_held held[LOCKSTAT_MAX_HELD];
+        int depth;
+} __attribute__((aligned(64)));
+
+static struct lockstat_class lockstat_classes[LOCKSTAT_MAX_CLASSES];
+static int lockstat_nr_classes;
+/* Protects registering classes, not the counters */
+static DEFINE_SPINLOCK(lockstat_class_lock);
+
+static struct lockstat_cpu lockstat_cpus[PLAT_CPU_NUM];
+
+void lockstat_register(struct lock *lk, const char *name)
+{
+        int i;
+
+        lock(&lockstat_class_lock);
+        for (i = 0; i < lockstat_nr_classes; i++) {
+                if (strcmp(lockstat_classes[i].name, name) == 0)
+                        goto found;
+        }
+        if (lockstat_nr_classes == LOCKSTAT_MAX_CLASSES) {
+                kwarn("%s: too many lock classes, %s is not tracked\n",
+                      __func__,
+                      name);
+                goto out_unlock;
+        }
+        i = lockstat_nr_classes++;
+        lockstat_classes[i].name = name;
+found:
+        lockstat_classes[i].nr_locks++;
+        lk->meta = (lk->meta & 0xff) | ((i + 1) << 8);
+out_unlock:
+        unlock(&lockstat_class_lock);
+}
+
+static inline struct lockstat_class *lockstat_class_of(struct lock *lock)
+{
+        return &lockstat_classes[(lock->meta >> 8) - 1];
+}
+
+static void lockstat_update_max(u64 *max, u64 val)
+{
+        u64 old;
+
+        while ((old = *(volatile u64 *)max) < val) {
+                if (atomic_cmpxchg_64(max, old, val) == old)
+                        break;
+        }
+}
+
+void __lockstat_acquired(struct lock *lock, u64 start, bool contended)
+{
+        struct lockstat_class *class = lockstat_class_of(lock);
+        struct lockstat_cpu *cpu;
+        u64 now = get_cycles();
+
+        atomic_fetch_add_64(&class->acquisitions, 1);
+        if (contended) {
+                atomic_fetch_add_64(&class->contentions, 1);
+                atomic_fetch_add_64(&class->total_wait, now - start);
+                lockstat_update_max(&class->max_wait, now - start);
+        }
+
+        if (lock->meta & LOCK_FLAG_HANDOFF)
+                return;
+
+        preempt_disable();
+        cpu = &lockstat_cpus[smp_get_cpu_id()];
+        /* Forget the oldest one if too many locks are held */
+        if (cpu->depth == LOCKSTAT_MAX_HELD) {
+                memmove(&cpu->held[0],
+                        &cpu->held[1],
+                        sizeof(cpu->held[0]) * (LOCKSTAT_MAX_HELD - 1));
+                cpu->depth--;
+        }
+        cpu->held[cpu->depth].lock = lock;
+        cpu->held[cpu->depth].start = now;
+        cpu->depth++;
+        preempt_enable();
+}
+
+void __lockstat_released(struct lock *lock)
+{
+        struct lockstat_class *class = lockstat_class_of(lock);
+        struct lockstat_cpu *cpu;
+        u64 hold;
+        int i;
+
+        if (lock->meta & LOCK_FLAG_HANDOFF)
+                return;
+
+        preempt_disable();
+        cpu = &lockstat_cpus[smp_get_cpu_id()];
+        for (i = cpu->depth - 1; i >= 0; i--) {
+                if (cpu->held[i].lock == lock)
+                        break;
+        }
+        if (i < 0)
+                goto out;
+
+        hold = get_cycles() - cpu->held[i].start;
+        atomic_fetch_add_64(&class->total_hold, hold);
+        lockstat_update_max(&class->max_hold, hold);
+
+        memmove(&cpu->held[i],
+                &cpu->held[i + 1],
+                sizeof(cpu->held[0]) * (cpu->depth - i - 1));
+        cpu->depth--;
+out:
+        preempt_enable();
+}
+
+/* Read a counter, and clear it atomically if @reset */
+static u64 lockstat_read(u64 *counter, bool reset)
+{
+        if (reset)
+                return (u64)atomic_exchange_64((s64 *)counter, 0);
+        return *(volatile u64 *)counter;
+}
+
+int sys_get_lockstat(struct lockstat_info *ubuf, unsigned long nr, bool reset)
+{
+        struct lockstat_class *class;
+        struct lockstat_info info;
+        int i, nr_classes;
+
+        nr_classes = MIN(lockstat_nr_classes, nr);
+        if (check_user_addr_range((vaddr_t)ubuf, sizeof(*ubuf) * nr_classes)
+            != 0)
+                return -EINVAL;
+
+        /*
+         * Counters are read and cleared one by one while other CPUs keep
+         * updating them, so a reported class may be slightly inconsistent,
+         * but no update is lost across a reset.
+         */
+        for (i = 0; i < lockstat_nr_classes; i++) {
+                if (i >= nr_classes && !reset)
+                        break;
+                class = &lockstat_classes[i];
+                memset(&info, 0, sizeof(info));
+                memcpy(info.name,
+                       class->name,
+                       MIN(strlen(class->name), LOCKSTAT_NAME_LEN - 1));
+                info.nr_locks = class->nr_locks;
+                info.acquisitions = lockstat_read(&class->acquisitions, reset);
+                info.contentions = lockstat_read(&class->contentions, reset);
+                info.total_wait = lockstat_read(&class->total_wait, reset);
+                info.max_wait = lockstat_read(&class->max_wait, reset);
+                info.total_hold = lockstat_read(&class->total_hold, reset);
+                info.max_hold = lockstat_read(&class->max_hold, reset);
+                if (i < nr_classes
+                    && copy_to_user(&ubuf[i], &info, sizeof(info)))
+                        return -EINVAL;
+        }
+        return nr_classes;
+}
+
+#else /* CHCORE_KERNEL_LOCKSTAT */
+
+int sys_get_lockstat(struct lockstat_info *ubuf, unsigned long nr, bool reset)
+{
+        return -ENOSYS;
+}
+
+#endif /* CHCORE_KERNEL_LOCKSTAT */
@@ -13,6 +13,7 @@
 #include <common/util.h>
 #include <common/macro.h>
 #include <common/kprint.h>
+#include <common/lockstat.h>
 #include <mm/buddy.h>
 
 static struct page *get_buddy_chunk(struct phys_mem_pool *pool,
@@ -138,7 +139,8 @@ void init_buddy(struct phys_mem_pool *pool, struct page *start_page,
         int page_idx;
         struct page *page;
 
-        BUG_ON(lock_init(&pool->buddy_lock) != 0);
+        BUG_ON(mcs_lock_init(&pool->buddy_lock) != 0);
+        lockstat_register(&pool->buddy_lock, "buddy_lock");
 
         /* Init the physical memory pool. */
         pool->pool_start_addr = start_addr;
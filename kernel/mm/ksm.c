@@ -0,0 +1,738 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) Licensed under the Mulan PSL v2. You can
+ * use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v2 for more details.
+ */
+
+#include <common/errno.h>
+#include <common/kprint.h>
+#include <common/list.h>
+#include <common/lock.h>
+#include <common/rbtree.h>
+#include <common/util.h>
+#include <mm/common_pte.h>
+#include <mm/ksm.h>
+#include <mm/kmalloc.h>
+#include <mm/mm.h>
+#include <mm/zswap.h>
+#include <object/thread.h>
+
+/* Number of pages scanned in one pmo before moving to the next one */
+#define KSM_SCAN_BATCH 256
+/* Max number of pages scanned by one sys_ksm_scan */
+#define KSM_MAX_SCAN_PAGES 1024
+
+/* A frame shared by merged pages, as one node of the stable tree */
+struct ksm_stable_node {
+        struct rb_node node;
+        u64 checksum;
+        paddr_t pa;
+        /* Number of radix slots referring to the frame */
+        unsigned long refcnt;
+};
+
+/* A candidate page seen by earlier scans, as one node of the unstable tree */
+struct ksm_unstable_item {
+        struct rb_node node;
+        u64 checksum;
+        struct pmobject *pmo;
+        unsigned long index;
+        paddr_t pa;
+};
+
+struct ksm_stat {
+        /* Number of frames shared by merged pages */
+        unsigned long pages_shared;
+        /* Number of radix slots referring to the frames above */
+        unsigned long pages_sharing;
+        unsigned long pages_scanned;
+        unsigned long pages_unmerged;
+};
+
+/* Protect all the following states, and the ksm field of struct page */
+static struct lock ksm_lock;
+
+/* Mergeable pmos, rotated as a clock during scanning */
+static struct list_head ksm_pmo_list;
+static unsigned long ksm_pmo_nr;
+
+static struct rb_root ksm_stable_tree;
+/*
+ * Candidates are kept across scans, so that pages scanned by different calls
+ * can be merged. Their contents may change at any time, so a candidate is only
+ * trusted after its radix slot and checksum are checked again (see
+ * ksm_promote). The tree starts over once all the items are used. Allocated
+ * statically so that scanning never allocates memory except for merged frames.
+ */
+static struct rb_root ksm_unstable_tree;
+static struct ksm_unstable_item ksm_unstable_items[KSM_MAX_SCAN_PAGES];
+static unsigned long ksm_unstable_nr;
+
+static struct ksm_stat ksm_stat;
+
+/* Key to search the stable tree with */
+struct ksm_key {
+        u64 checksum;
+        const void *kva;
+};
+
+void ksm_init(void)
+{
+        lock_init(&ksm_lock);
+        init_list_head(&ksm_pmo_list);
+        init_rb_root(&ksm_stable_tree);
+        init_rb_root(&ksm_unstable_tree);
+}
+
+static inline struct ksm_stable_node *page_stable_node(paddr_t pa)
+{
+        struct page *page;
+
+        page = virt_to_page((void *)phys_to_virt(pa));
+        if (!page)
+                return NULL;
+        return page->ksm;
+}
+
+bool ksm_is_page(paddr_t pa)
+{
+        return page_stable_node(pa) != NULL;
+}
+
+/* FNV-1a on 64-bit words. It only filters candidates, pages are compared. */
+static u64 ksm_checksum(const u64 *kva)
+{
+        u64 hash = 0xcbf29ce484222325UL;
+        int i;
+
+        for (i = 0; i < PAGE_SIZE / sizeof(u64); i++) {
+                hash ^= kva[i];
+                hash *= 0x100000001b3UL;
+        }
+        return hash;
+}
+
+static int cmp_key_and_stable_node(const void *key, const struct rb_node *node)
+{
+        const struct ksm_key *k = key;
+        struct ksm_stable_node *stable;
+
+        stable = rb_entry(node, struct ksm_stable_node, node);
+        if (k->checksum != stable->checksum)
+                return k->checksum < stable->checksum ? -1 : 1;
+        return memcmp(k->kva, (void *)phys_to_virt(stable->pa), PAGE_SIZE);
+}
+
+static bool less_stable_node(const struct rb_node *lhs,
+                             const struct rb_node *rhs)
+{
+        struct ksm_stable_node *stable;
+        struct ksm_key key;
+
+        stable = rb_entry(lhs, struct ksm_stable_node, node);
+        key.checksum = stable->checksum;
+        key.kva = (void *)phys_to_virt(stable->pa);
+        return cmp_key_and_stable_node(&key, rhs) < 0;
+}
+
+static int cmp_checksum_and_unstable_item(const void *checksum,
+                                          const struct rb_node *node)
+{
+        u64 sum = *(const u64 *)checksum;
+        struct ksm_unstable_item *item;
+
+        item = rb_entry(node, struct ksm_unstable_item, node);
+        if (sum < item->checksum)
+                return -1;
+        if (sum > item->checksum)
+                return 1;
+        return 0;
+}
+
+static bool less_unstable_item(const struct rb_node *lhs,
+                               const struct rb_node *rhs)
+{
+        return rb_entry(lhs, struct ksm_unstable_item, node)->checksum
+               < rb_entry(rhs, struct ksm_unstable_item, node)->checksum;
+}
+
+void ksm_put_page(paddr_t pa)
+{
+        struct ksm_stable_node *stable;
+        struct page *page;
+
+        page = virt_to_page((void *)phys_to_virt(pa));
+
+        lock(&ksm_lock);
+        stable = page->ksm;
+        BUG_ON(stable == NULL || stable->refcnt == 0);
+        ksm_stat.pages_sharing--;
+        if (--stable->refcnt == 0) {
+                rb_erase(&ksm_stable_tree, &stable->node);
+                page->ksm = NULL;
+                ksm_stat.pages_shared--;
+                free_pages((void *)phys_to_virt(pa));
+                kfree(stable);
+        }
+        unlock(&ksm_lock);
+}
+
+static inline bool vmr_maps_index(struct vmregion *vmr, unsigned long index,
+                                  vaddr_t *va)
+{
+        unsigned long offset = index * PAGE_SIZE;
+
+        if (offset < vmr->offset || offset - vmr->offset >= vmr->size)
+                return false;
+        *va = vmr->start + offset - vmr->offset;
+        return true;
+}
+
+/* Whether the vmspace of @vmr is also used by an earlier mapping of @pmo */
+static bool vmspace_seen_before(struct pmobject *pmo, struct vmregion *vmr,
+                                struct vmregion *keep_vmr)
+{
+        struct vmregion *iter;
+
+        if (keep_vmr && vmr->vmspace == keep_vmr->vmspace)
+                return true;
+        for_each_in_list (
+                iter, struct vmregion, mapping_list_node, &pmo->mapping_list) {
+                if (iter == vmr)
+                        return false;
+                if (iter->vmspace == vmr->vmspace)
+                        return true;
+        }
+        return false;
+}
+
+static void __unlock_other_mappings(struct pmobject *pmo,
+                                    struct vmregion *keep_vmr,
+                                    struct vmregion *until)
+{
+        struct vmregion *vmr;
+
+        for_each_in_list (
+                vmr, struct vmregion, mapping_list_node, &pmo->mapping_list) {
+                if (vmr == until)
+                        break;
+                if (vmspace_seen_before(pmo, vmr, keep_vmr))
+                        continue;
+                unlock(&vmr->vmspace->pgtbl_lock);
+                unlock(&vmr->vmspace->vmspace_lock);
+        }
+}
+
+int ksm_lock_other_mappings(struct pmobject *pmo, struct vmregion *keep_vmr)
+{
+        struct vmregion *vmr;
+        struct vmspace *vmspace;
+
+        for_each_in_list (
+                vmr, struct vmregion, mapping_list_node, &pmo->mapping_list) {
+                if (vmspace_seen_before(pmo, vmr, keep_vmr))
+                        continue;
+                vmspace = vmr->vmspace;
+                if (try_lock(&vmspace->vmspace_lock) != 0)
+                        goto out_busy;
+                if (try_lock(&vmspace->pgtbl_lock) != 0) {
+                        unlock(&vmspace->vmspace_lock);
+                        goto out_busy;
+                }
+        }
+        return 0;
+
+out_busy:
+        __unlock_other_mappings(pmo, keep_vmr, vmr);
+        return -EAGAIN;
+}
+
+void ksm_unlock_other_mappings(struct pmobject *pmo, struct vmregion *keep_vmr)
+{
+        __unlock_other_mappings(pmo, keep_vmr, NULL);
+}
+
+void ksm_unmap_other_mappings(struct pmobject *pmo, unsigned long index,
+                              struct vmregion *keep_vmr)
+{
+        struct vmregion *vmr;
+        vaddr_t va;
+        long rss;
+
+        for_each_in_list (
+                vmr, struct vmregion, mapping_list_node, &pmo->mapping_list) {
+                if (vmr == keep_vmr || !vmr_maps_index(vmr, index, &va))
+                        continue;
+                rss = 0;
+                unmap_range_in_pgtbl(vmr->vmspace->pgtbl, va, PAGE_SIZE, &rss);
+                vmr->vmspace->rss += rss;
+                flush_tlb_by_range(vmr->vmspace, va, PAGE_SIZE);
+        }
+}
+
+paddr_t ksm_break_page(struct pmobject *pmo, unsigned long index)
+{
+        void *new_page;
+        paddr_t pa;
+
+        new_page = zswap_get_page();
+        if (!new_page)
+                return 0;
+
+        zswap_lock_mappings(pmo);
+        for (;;) {
+                pa = (paddr_t)radix_get(pmo->radix, index);
+                if (pa != 0 && !ksm_is_page(pa)) {
+                        /* Broken by a page fault in the meantime */
+                        zswap_unlock_mappings(pmo);
+                        free_pages(new_page);
+                        return pa;
+                }
+                if (ksm_lock_other_mappings(pmo, NULL) == 0)
+                        break;
+                /* Let the page faults holding the vmspaces go on */
+                zswap_unlock_mappings(pmo);
+                zswap_lock_mappings(pmo);
+        }
+
+        /* Untouched, but others may map the zero page for it */
+        if (pa == 0)
+                memset(new_page, 0, PAGE_SIZE);
+        else
+                memcpy(new_page, (void *)phys_to_virt(pa), PAGE_SIZE);
+        replace_page_in_pmo(pmo, index, virt_to_phys(new_page));
+        ksm_unmap_other_mappings(pmo, index, NULL);
+        ksm_unlock_other_mappings(pmo, NULL);
+        zswap_unlock_mappings(pmo);
+
+        if (pa != 0) {
+                ksm_put_page(pa);
+                lock(&ksm_lock);
+                ksm_stat.pages_unmerged++;
+                unlock(&ksm_lock);
+        }
+
+        return virt_to_phys(new_page);
+}
+
+void ksm_protect_range(struct vmspace *vmspace, vaddr_t start, size_t len)
+{
+        struct common_pte_t pte_info;
+        vaddr_t va;
+        paddr_t pa;
+        pte_t *pte;
+
+        /* Racy but fine: merging needs the vmspace_lock held by the caller */
+        if (ksm_stat.pages_shared == 0)
+                return;
+
+        for (va = start; va < start + len; va += PAGE_SIZE) {
+                if (query_in_pgtbl(vmspace->pgtbl, va, &pa, &pte))
+                        continue;
+                parse_pte_to_common(pte, L3, &pte_info);
+                if ((pte_info.perm & VMR_WRITE)
+                    && ksm_is_page(ROUND_DOWN(pa, PAGE_SIZE))) {
+                        pte_info.perm &= ~VMR_WRITE;
+                        pte_info.dirty = 0;
+                        update_pte(pte, L3, &pte_info);
+                }
+        }
+}
+
+/*
+ * Make the pte of a candidate read-only, so that its contents can be compared
+ * reliably. Return whether the permission should be restored if not merged.
+ */
+static bool write_protect_pte(struct vmspace *vmspace, vaddr_t va, pte_t *pte)
+{
+        struct common_pte_t pte_info;
+
+        parse_pte_to_common(pte, L3, &pte_info);
+        if (!(pte_info.perm & VMR_WRITE))
+                return false;
+
+        pte_info.perm &= ~VMR_WRITE;
+        pte_info.dirty = 0;
+        update_pte(pte, L3, &pte_info);
+        flush_tlb_by_range(vmspace, va, PAGE_SIZE);
+        return true;
+}
+
+static void restore_write_perm(pte_t *pte)
+{
+        struct common_pte_t pte_info;
+
+        parse_pte_to_common(pte, L3, &pte_info);
+        pte_info.perm |= VMR_WRITE;
+        update_pte(pte, L3, &pte_info);
+}
+
+/*
+ * Merge page @index of @pmo (at @pa, mapped by @pte if not NULL) into the
+ * frame of @stable. Should be called with the vmspace of the mapping locked.
+ * Return whether it is merged.
+ */
+static bool ksm_merge_page(struct vmspace *vmspace, vaddr_t va, pte_t *pte,
+                           struct pmobject *pmo, unsigned long index,
+                           paddr_t pa, struct ksm_stable_node *stable)
+{
+        struct common_pte_t pte_info;
+        bool protected = false;
+
+        if (pte)
+                protected = write_protect_pte(vmspace, va, pte);
+
+        /* It cannot be written from now on, compare it for real */
+        if (memcmp((void *)phys_to_virt(pa),
+                   (void *)phys_to_virt(stable->pa),
+                   PAGE_SIZE)
+            != 0) {
+                if (protected)
+                        restore_write_perm(pte);
+                return false;
+        }
+
+        if (pte) {
+                parse_pte_to_common(pte, L3, &pte_info);
+                pte_info.ppn = stable->pa >> PAGE_SHIFT;
+                update_pte(pte, L3, &pte_info);
+                flush_tlb_by_range(vmspace, va, PAGE_SIZE);
+        }
+        replace_page_in_pmo(pmo, index, stable->pa);
+        free_pages((void *)phys_to_virt(pa));
+
+        stable->refcnt++;
+        ksm_stat.pages_sharing++;
+        return true;
+}
+
+/*
+ * Turn the page of an unstable @item into a merged frame, so that the page
+ * being scanned can be merged into it. The mappings of @item->pmo may have
+ * changed since it was inserted, so look them up again.
+ *
+ * Should be called with ksm_lock and the zswap lock held, and @cur_vmspace
+ * (of the page being scanned) locked. Return NULL on failure.
+ */
+static struct ksm_stable_node *ksm_promote(struct ksm_unstable_item *item,
+                                           struct vmspace *cur_vmspace)
+{
+        struct pmobject *pmo = item->pmo;
+        struct ksm_stable_node *stable;
+        struct vmregion *vmr;
+        struct vmspace *vmspace;
+        struct page *page;
+        paddr_t pte_pa;
+        pte_t *pte = NULL;
+        vaddr_t va;
+        bool protected = false;
+
+        if (!pmo->ksm_mergeable || pmo->swap_pin
+            || list_empty(&pmo->mapping_list)
+            || pmo->mapping_list.next->next != &pmo->mapping_list)
+                return NULL;
+        if ((paddr_t)radix_get(pmo->radix, item->index) != item->pa
+            || ksm_is_page(item->pa))
+                return NULL;
+
+        vmr = container_of(
+                pmo->mapping_list.next, struct vmregion, mapping_list_node);
+        vmspace = vmr->vmspace;
+        if (vmspace != cur_vmspace) {
+                if (try_lock(&vmspace->vmspace_lock) != 0)
+                        return NULL;
+                if (try_lock(&vmspace->pgtbl_lock) != 0) {
+                        unlock(&vmspace->vmspace_lock);
+                        return NULL;
+                }
+        }
+
+        stable = NULL;
+        if (vmr_maps_index(vmr, item->index, &va)
+            && query_in_pgtbl(vmspace->pgtbl, va, &pte_pa, &pte) == 0) {
+                /* Mapped to a CoW private page instead */
+                if (ROUND_DOWN(pte_pa, PAGE_SIZE) != item->pa)
+                        goto out_unlock;
+                protected = write_protect_pte(vmspace, va, pte);
+        } else {
+                pte = NULL;
+        }
+
+        if (ksm_checksum((u64 *)phys_to_virt(item->pa)) != item->checksum) {
+                /* Changed since it was inserted, it is too volatile */
+                if (protected)
+                        restore_write_perm(pte);
+                goto out_unlock;
+        }
+
+        stable = kmalloc(sizeof(*stable));
+        if (!stable) {
+                if (protected)
+                        restore_write_perm(pte);
+                goto out_unlock;
+        }
+        stable->checksum = item->checksum;
+        stable->pa = item->pa;
+        stable->refcnt = 1;
+        rb_insert(&ksm_stable_tree, &stable->node, less_stable_node);
+        page = virt_to_page((void *)phys_to_virt(item->pa));
+        page->ksm = stable;
+
+        ksm_stat.pages_shared++;
+        ksm_stat.pages_sharing++;
+
+out_unlock:
+        if (vmspace != cur_vmspace) {
+                unlock(&vmspace->pgtbl_lock);
+                unlock(&vmspace->vmspace_lock);
+        }
+        return stable;
+}
+
+/*
+ * Scan page @index of @pmo mapped at @va. Should be called with ksm_lock, the
+ * zswap lock and the vmspace locks held. Return whether it is merged.
+ */
+static bool ksm_scan_page(struct vmspace *vmspace, struct pmobject *pmo,
+                          unsigned long index, vaddr_t va)
+{
+        struct ksm_stable_node *stable;
+        struct ksm_unstable_item *item;
+        struct rb_node *node;
+        struct ksm_key key;
+        paddr_t pa, pte_pa;
+        pte_t *pte;
+        void *value;
+
+        ksm_stat.pages_scanned++;
+
+        value = radix_get(pmo->radix, index);
+        if (value == NULL || is_zswap_entry(value))
+                return false;
+        pa = (paddr_t)value;
+        if (is_zero_page(pa) || ksm_is_page(pa))
+                return false;
+
+        if (query_in_pgtbl(vmspace->pgtbl, va, &pte_pa, &pte) == 0) {
+                /* Mapped to a CoW private page instead */
+                if (ROUND_DOWN(pte_pa, PAGE_SIZE) != pa)
+                        return false;
+        } else {
+                pte = NULL;
+        }
+
+        key.checksum = ksm_checksum((u64 *)phys_to_virt(pa));
+        key.kva = (void *)phys_to_virt(pa);
+
+        node = rb_search(&ksm_stable_tree, &key, cmp_key_and_stable_node);
+        if (node) {
+                stable = rb_entry(node, struct ksm_stable_node, node);
+                return ksm_merge_page(
+                        vmspace, va, pte, pmo, index, pa, stable);
+        }
+
+        node = rb_search(&ksm_unstable_tree,
+                         &key.checksum,
+                         cmp_checksum_and_unstable_item);
+        if (node) {
+                item = rb_entry(node, struct ksm_unstable_item, node);
+                /* Seen again and not changed, e.g., by the next scan */
+                if (item->pa == pa)
+                        return false;
+
+                stable = ksm_promote(item, vmspace);
+                /* It is either merged or not worth being a candidate again */
+                rb_erase(&ksm_unstable_tree, &item->node);
+                item->pmo = NULL;
+                if (stable)
+                        return ksm_merge_page(
+                                vmspace, va, pte, pmo, index, pa, stable);
+                /* Stale or busy, let the page being scanned take its place */
+        } else {
+                if (ksm_unstable_nr == KSM_MAX_SCAN_PAGES) {
+                        init_rb_root(&ksm_unstable_tree);
+                        ksm_unstable_nr = 0;
+                }
+                item = &ksm_unstable_items[ksm_unstable_nr++];
+        }
+        item->checksum = key.checksum;
+        item->pmo = pmo;
+        item->index = index;
+        item->pa = pa;
+        rb_insert(&ksm_unstable_tree, &item->node, less_unstable_item);
+        return false;
+}
+
+/*
+ * Scan at most KSM_SCAN_BATCH pages of @pmo, starting from its cursor.
+ * Should be called with ksm_lock held. Return the number of pages merged.
+ */
+static unsigned long ksm_scan_pmo(struct pmobject *pmo, unsigned long nr_pages,
+                                  unsigned long *scanned)
+{
+        struct vmregion *vmr;
+        struct vmspace *vmspace;
+        unsigned long i, nr_vmr_pages, index, merged = 0;
+        vaddr_t va;
+
+        zswap_lock_mappings(pmo);
+
+        /* Same restrictions as zswap, see zswap_reclaim_pmo */
+        if (pmo->swap_pin || list_empty(&pmo->mapping_list)
+            || pmo->mapping_list.next->next != &pmo->mapping_list)
+                goto out_unlock_mappings;
+
+        vmr = container_of(
+                pmo->mapping_list.next, struct vmregion, mapping_list_node);
+        vmspace = vmr->vmspace;
+        if (try_lock(&vmspace->vmspace_lock) != 0)
+                goto out_unlock_mappings;
+        if (try_lock(&vmspace->pgtbl_lock) != 0) {
+                unlock(&vmspace->vmspace_lock);
+                goto out_unlock_mappings;
+        }
+
+        nr_vmr_pages = vmr->size / PAGE_SIZE;
+        if (pmo->ksm_cursor >= nr_vmr_pages)
+                pmo->ksm_cursor = 0;
+
+        for (i = 0; i < MIN(nr_vmr_pages, KSM_SCAN_BATCH) && *scanned < nr_pages;
+             i++, (*scanned)++) {
+                va = vmr->start + pmo->ksm_cursor * PAGE_SIZE;
+                index = vmr->offset / PAGE_SIZE + pmo->ksm_cursor;
+                if (++pmo->ksm_cursor == nr_vmr_pages)
+                        pmo->ksm_cursor = 0;
+
+                if (ksm_scan_page(vmspace, pmo, index, va))
+                        merged++;
+        }
+
+        unlock(&vmspace->pgtbl_lock);
+        unlock(&vmspace->vmspace_lock);
+out_unlock_mappings:
+        zswap_unlock_mappings(pmo);
+        return merged;
+}
+
+void ksm_unregister_pmo(struct pmobject *pmo)
+{
+        struct ksm_unstable_item *item;
+        unsigned long i;
+
+        lock(&ksm_lock);
+        if (pmo->ksm_mergeable) {
+                list_del(&pmo->ksm_node);
+                pmo->ksm_mergeable = false;
+                ksm_pmo_nr--;
+        }
+        /* Candidates refer to the pmo, drop them before it is freed */
+        for (i = 0; i < ksm_unstable_nr; i++) {
+                item = &ksm_unstable_items[i];
+                if (item->pmo != pmo)
+                        continue;
+                rb_erase(&ksm_unstable_tree, &item->node);
+                item->pmo = NULL;
+        }
+        unlock(&ksm_lock);
+}
+
+/*
+ * madvise(MADV_MERGEABLE / MADV_UNMERGEABLE). It works on whole pmos, so all
+ * anonymous pmos mapped in the range are affected. Pages merged before are
+ * not split on MADV_UNMERGEABLE, they are split when written.
+ */
+int sys_ksm_advise(unsigned long addr, unsigned long len, bool mergeable)
+{
+        struct vmspace *vmspace;
+        struct vmregion *vmr;
+        struct pmobject *pmo;
+        unsigned long va, end_va;
+
+        if ((addr % PAGE_SIZE) || (addr + len < addr))
+                return -EINVAL;
+
+        vmspace = obj_get(current_cap_group, VMSPACE_OBJ_ID, TYPE_VMSPACE);
+        BUG_ON(vmspace == NULL);
+
+        lock(&vmspace->vmspace_lock);
+        lock(&ksm_lock);
+        end_va = addr + len;
+        for (va = addr; va < end_va; va += PAGE_SIZE) {
+                vmr = find_vmr_for_va(vmspace, va);
+                if (!vmr)
+                        continue;
+                /* Skip the rest of the vmr */
+                va = vmr->start + vmr->size - PAGE_SIZE;
+
+                pmo = vmr->pmo;
+                if (pmo->type != PMO_ANONYM || pmo->ksm_mergeable == mergeable)
+                        continue;
+
+                if (mergeable) {
+                        list_append(&pmo->ksm_node, &ksm_pmo_list);
+                        ksm_pmo_nr++;
+                } else {
+                        list_del(&pmo->ksm_node);
+                        ksm_pmo_nr--;
+                }
+                pmo->ksm_mergeable = mergeable;
+        }
+        unlock(&ksm_lock);
+        unlock(&vmspace->vmspace_lock);
+
+        obj_put(vmspace);
+        return 0;
+}
+
+/*
+ * Invoked periodically by the scanner thread in user space. Scan at most
+ * @nr_pages pages of mergeable pmos, and return the number of pages merged.
+ */
+long sys_ksm_scan(unsigned long nr_pages)
+{
+        struct pmobject *pmo;
+        unsigned long i, nr_pmos, scanned = 0, merged = 0;
+
+        if (current_cap_group->badge != PROCMGR_BADGE)
+                return -EPERM;
+
+        nr_pages = MIN(nr_pages, KSM_MAX_SCAN_PAGES);
+
+        lock(&ksm_lock);
+        nr_pmos = ksm_pmo_nr;
+        for (i = 0; i < nr_pmos && scanned < nr_pages; i++) {
+                pmo = container_of(
+                        ksm_pmo_list.next, struct pmobject, ksm_node);
+                /* Rotate it, so that the next round starts from another */
+                list_del(&pmo->ksm_node);
+                list_append(&pmo->ksm_node, &ksm_pmo_list);
+
+                merged += ksm_scan_pmo(pmo, nr_pages, &scanned);
+        }
+        unlock(&ksm_lock);
+
+        return merged;
+}
+
+void ksm_print_stat(void)
+{
+        struct ksm_stat stat;
+
+        lock(&ksm_lock);
+        stat = ksm_stat;
+        unlock(&ksm_lock);
+
+        printk("KSM: %lu shared frames, %lu merged pages (%lu pages saved), "
+               "%lu scanned, %lu unmerged\n",
+               stat.pages_shared,
+               stat.pages_sharing,
+               stat.pages_sharing - stat.pages_shared,
+               stat.pages_scanned,
+               stat.pages_unmerged);
+}
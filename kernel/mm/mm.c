@@ -15,6 +15,9 @@
 #include <common/macro.h>
 #include <mm/slab.h>
 #include <mm/buddy.h>
+#include <mm/kmalloc.h>
+#include <mm/ksm.h>
+#include <mm/zswap.h>
 #include <arch/mmu.h>
 
 /* The following two will be filled by parse_mem_map. */
@@ -23,6 +26,8 @@ int physmem_map_num;
 
 struct phys_mem_pool global_mem[N_PHYS_MEM_POOLS];
 
+paddr_t zero_page_pa;
+
 /*
  * The layout of each physmem:
  * | metadata (npages * sizeof(struct page)) | start_vaddr ... (npages *
@@ -73,6 +78,7 @@ static void init_buddy_for_one_physmem_map(int physmem_map_idx)
 void mm_init(void *physmem_info)
 {
         int physmem_map_idx;
+        void *zero_page;
 
         /* Step-1: parse the physmem_info to get each continuous range of the
          * physmem. */
@@ -87,6 +93,18 @@ void mm_init(void *physmem_info)
 
         /* Step-3: init the slab allocator. */
         init_slab();
+
+        /* Step-4: allocate the zero page shared by anonymous memory. */
+        zero_page = get_pages(0);
+        BUG_ON(zero_page == NULL);
+        memset(zero_page, 0, PAGE_SIZE);
+        zero_page_pa = virt_to_phys(zero_page);
+
+        /* Step-5: init the compressed swap for anonymous memory. */
+        zswap_init();
+
+        /* Step-6: init same-page merging for anonymous memory. */
+        ksm_init();
 }
 
 unsigned long get_free_mem_size(void)
@@ -100,3 +118,10 @@ unsigned long get_free_mem_size(void)
 
         return size;
 }
+
+/* Report memory usage of the allocators, and pages saved by KSM */
+void sys_get_mem_usage_msg(void)
+{
+        get_mem_usage_msg();
+        ksm_print_stat();
+}
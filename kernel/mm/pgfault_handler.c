@@ -23,6 +23,8 @@
 #include <object/user_fault.h>
 #include <object/thread.h>
 #include <mm/page_fault.h>
+#include <mm/ksm.h>
+#include <mm/zswap.h>
 
 static void dump_pgfault_error(void)
 {
@@ -40,17 +42,20 @@ static void dump_pgfault_error(void)
 /*
  * Perform general COW
  * Step-1: get PA of page containing fault_addr, so as kernal VA of that page
- * Step-2: allocate a new page and record in VMR
+ * Step-2: allocate a new page and record in VMR, or commit it to the pmo
+ *         instead if @to_pmo (breaking a KSM merged page, which is not
+ *         private to the vmr)
  * Step-3: copy using kernel VA to new page
  * Step-4(?): update VMR perm (How and when? Neccessary?)
  * Step-5: update PTE permission and PPN
- * Step-6: Flush TLB of user virtual page(user_vpa)
+ * Step-6: Flush TLB of user virtual page(user_vpa), which is left to the
+ *         caller so that a batch of pages can be flushed at once.
  */
 static int __do_general_cow(struct vmspace *vmspace, struct vmregion *vmr,
                             vaddr_t fault_addr, pte_t *fault_pte,
-                            struct common_pte_t *pte_info)
+                            struct common_pte_t *pte_info, bool to_pmo)
 {
-        vaddr_t kva, user_vpa;
+        vaddr_t kva;
         void *new_page;
         paddr_t new_pa;
         struct common_pte_t new_pte_attr;
@@ -68,9 +73,12 @@ static int __do_general_cow(struct vmspace *vmspace, struct vmregion *vmr,
         }
         new_pa = virt_to_phys(new_page);
 
-        ret = vmregion_record_cow_private_page(vmr, fault_addr, new_page);
-        if (ret)
-                goto out_free_page;
+        if (!to_pmo) {
+                ret = vmregion_record_cow_private_page(
+                        vmr, fault_addr, new_page);
+                if (ret)
+                        goto out_free_page;
+        }
 
         /* Step-3: copy using kernel VA to new page */
         memcpy(new_page, (void *)kva, PAGE_SIZE);
@@ -79,16 +87,22 @@ static int __do_general_cow(struct vmspace *vmspace, struct vmregion *vmr,
         new_pte_attr.ppn = new_pa >> PAGE_SHIFT;
         new_pte_attr.perm = pte_info->perm | VMR_WRITE;
         new_pte_attr.valid = 1;
-        new_pte_attr.access = 0;
+        /* It is being written right now */
+        new_pte_attr.access = 1;
         new_pte_attr.dirty = 0;
 
         update_pte(fault_pte, L3, &new_pte_attr);
 
-        vmspace->rss += PAGE_SIZE;
+        if (to_pmo)
+                replace_page_in_pmo(vmr->pmo,
+                                    (ROUND_DOWN(fault_addr, PAGE_SIZE)
+                                     - vmr->start + vmr->offset)
+                                            / PAGE_SIZE,
+                                    new_pa);
 
-        /* Step-6: Flush TLB of user virtual page(user_vpa) */
-        user_vpa = ROUND_DOWN(fault_addr, PAGE_SIZE);
-        flush_tlb_by_range(vmspace, user_vpa, PAGE_SIZE);
+        /* A merged page it replaces has been counted, but the zero page not */
+        if (!to_pmo || is_zero_page(pte_info->ppn << PAGE_SHIFT))
+                vmspace->rss += PAGE_SIZE;
 
         return 0;
 out_free_page:
@@ -97,10 +111,55 @@ out:
         return ret;
 }
 
+/* Max number of pages resolved by one do_cow on sequential writes */
+#define COW_BATCH_PAGES 8
+
+/*
+ * If the page right before @fault_addr has been made private by CoW, the
+ * process is likely writing sequentially (e.g., memset or memcpy on a forked
+ * buffer). Resolve the following read-only pages of @vmr in advance, so that
+ * they would not each take a permission fault. Stops at the first page that is
+ * not mapped or already writable.
+ *
+ * Should be called with pgtbl_lock held. Return the number of extra pages
+ * resolved.
+ */
+static int do_cow_batch(struct vmspace *vmspace, struct vmregion *vmr,
+                        vaddr_t fault_addr)
+{
+        vaddr_t va, vmr_end;
+        paddr_t pa;
+        pte_t *pte;
+        struct common_pte_t pte_info;
+        int i;
+
+        fault_addr = ROUND_DOWN(fault_addr, PAGE_SIZE);
+        if (fault_addr == vmr->start
+            || !vmregion_find_cow_private_page(vmr, fault_addr - PAGE_SIZE))
+                return 0;
+
+        vmr_end = vmr->start + vmr->size;
+        for (i = 1; i < COW_BATCH_PAGES; i++) {
+                va = fault_addr + i * PAGE_SIZE;
+                if (va >= vmr_end)
+                        break;
+                if (query_in_pgtbl(vmspace->pgtbl, va, &pa, &pte))
+                        break;
+                parse_pte_to_common(pte, L3, &pte_info);
+                if (pte_info.perm & VMR_WRITE)
+                        break;
+                if (__do_general_cow(vmspace, vmr, va, pte, &pte_info, false))
+                        break;
+        }
+
+        return i - 1;
+}
+
 static int do_cow(struct vmspace *vmspace, struct vmregion *fault_vmr,
                   vaddr_t fault_addr)
 {
         int ret = 0;
+        int batched;
         paddr_t pa;
         pte_t *fault_pte;
         struct common_pte_t pte_info;
@@ -131,7 +190,83 @@ static int do_cow(struct vmspace *vmspace, struct vmregion *fault_vmr,
                 goto out;
         }
         ret = __do_general_cow(
-                vmspace, fault_vmr, fault_addr, fault_pte, &pte_info);
+                vmspace, fault_vmr, fault_addr, fault_pte, &pte_info, false);
+        if (ret)
+                goto out;
+
+        /* Extra pages are best-effort, failing them is not an error */
+        batched = do_cow_batch(vmspace, fault_vmr, fault_addr);
+
+        flush_tlb_by_range(vmspace,
+                           ROUND_DOWN(fault_addr, PAGE_SIZE),
+                           (1 + batched) * PAGE_SIZE);
+
+out:
+        unlock(&vmspace->pgtbl_lock);
+        return ret;
+}
+
+/*
+ * Handle a write to a shared page in a writable anonymous vmr, i.e., a page
+ * merged by KSM or the zero page: copy it into a private page of the pmo
+ * (like CoW), and drop the reference to a merged frame. Other mappings of the
+ * pmo are unmapped, so that they would fault on the private page.
+ *
+ * Return -EPERM if it is not a shared page.
+ */
+static int do_unshare_anon(struct vmspace *vmspace, struct vmregion *fault_vmr,
+                           vaddr_t fault_addr)
+{
+        struct pmobject *pmo = fault_vmr->pmo;
+        struct common_pte_t pte_info;
+        unsigned long index;
+        pte_t *fault_pte;
+        paddr_t pa;
+        int ret;
+
+        lock(&vmspace->pgtbl_lock);
+        ret = query_in_pgtbl(vmspace->pgtbl, fault_addr, &pa, &fault_pte);
+        /* Downgrade to a translation fault, see do_cow */
+        if (ret) {
+                ret = -EFAULT;
+                goto out;
+        }
+        parse_pte_to_common(fault_pte, L3, &pte_info);
+
+        // Fast path: already handled page fault in other threads
+        if (pte_info.perm & VMR_WRITE)
+                goto out;
+
+        pa = pte_info.ppn << PAGE_SHIFT;
+        if (!is_zero_page(pa) && !ksm_is_page(pa)) {
+                ret = -EPERM;
+                goto out;
+        }
+
+        zswap_lock_mappings(pmo);
+        if (ksm_lock_other_mappings(pmo, fault_vmr) != 0) {
+                /* Leave the pte read-only and let it fault again */
+                zswap_unlock_mappings(pmo);
+                goto out;
+        }
+
+        ret = __do_general_cow(
+                vmspace, fault_vmr, fault_addr, fault_pte, &pte_info, true);
+        if (ret == 0) {
+                index = (ROUND_DOWN(fault_addr, PAGE_SIZE) - fault_vmr->start
+                         + fault_vmr->offset)
+                        / PAGE_SIZE;
+                ksm_unmap_other_mappings(pmo, index, fault_vmr);
+        }
+        ksm_unlock_other_mappings(pmo, fault_vmr);
+        zswap_unlock_mappings(pmo);
+        if (ret)
+                goto out;
+
+        flush_tlb_by_range(
+                vmspace, ROUND_DOWN(fault_addr, PAGE_SIZE), PAGE_SIZE);
+        if (!is_zero_page(pa))
+                ksm_put_page(pa);
 
 out:
         unlock(&vmspace->pgtbl_lock);
@@ -154,7 +289,41 @@ static int check_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
         return 0;
 }
 
-int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
+/*
+ * Commit @pa to the untouched slot @index of the pmo of @vmr. Other mappings of
+ * an anonymous pmo may map the zero page for the slot, and they are unmapped
+ * so that they would fault on the new page. Should be called with the locks
+ * of the vmspace of @vmr held. Return -EAGAIN if other mappings are busy.
+ */
+static int commit_untouched_page(struct vmregion *vmr, unsigned long index,
+                                 paddr_t pa)
+{
+        struct pmobject *pmo = vmr->pmo;
+
+        if (pmo->type != PMO_ANONYM) {
+                commit_page_to_pmo(pmo, index, pa);
+                return 0;
+        }
+
+        zswap_lock_mappings(pmo);
+        if (ksm_lock_other_mappings(pmo, vmr) != 0) {
+                zswap_unlock_mappings(pmo);
+                return -EAGAIN;
+        }
+        commit_page_to_pmo(pmo, index, pa);
+        ksm_unmap_other_mappings(pmo, index, vmr);
+        ksm_unlock_other_mappings(pmo, vmr);
+        zswap_unlock_mappings(pmo);
+
+        return 0;
+}
+
+/*
+ * @desired_perm is VMR_WRITE for writes, otherwise untouched anonymous memory
+ * is backed by the zero page until written.
+ */
+int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr,
+                       vmr_prop_t desired_perm)
 {
         struct vmregion *vmr;
         struct pmobject *pmo;
@@ -202,15 +371,30 @@ int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
 
                 fault_addr = ROUND_DOWN(fault_addr, PAGE_SIZE);
 
-                pa = get_page_from_pmo(pmo, index);
+                ret = try_get_page_from_pmo(pmo, index, &pa);
+                if (ret != 0)
+                        break;
+                if (pa == 0 && pmo->type == PMO_ANONYM
+                    && desired_perm != VMR_WRITE) {
+                        /*
+                         * Reading untouched memory, share the zero page
+                         * instead. It is only mapped (read-only below) and
+                         * never recorded in the radix tree, so that kernel
+                         * paths looking up the pmo would not write to it.
+                         */
+                        pa = zero_page_pa;
+                }
                 if (pa == 0) {
                         /*
                          * Not committed before. Then, allocate the physical
                          * page.
                          */
-                        void *new_va = get_pages(0);
+                        void *new_va = zswap_get_page();
                         long rss = 0;
-                        BUG_ON(new_va == NULL);
+                        if (new_va == NULL) {
+                                ret = -ENOMEM;
+                                break;
+                        }
                         pa = virt_to_phys(new_va);
                         BUG_ON(pa == 0);
                         /* Clear to 0 for the newly allocated page */
@@ -220,10 +404,15 @@ int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
                          * the offset is used as index in the radix tree
                          */
                         kdebug("commit: index: %ld, 0x%lx\n", index, pa);
-                        commit_page_to_pmo(pmo, index, pa);
+                        lock(&vmspace->pgtbl_lock);
+                        if (commit_untouched_page(vmr, index, pa) != 0) {
+                                /* Let it fault again */
+                                unlock(&vmspace->pgtbl_lock);
+                                free_pages(new_va);
+                                break;
+                        }
 
                         /* Add mapping in the page table */
-                        lock(&vmspace->pgtbl_lock);
                         map_range_in_pgtbl(vmspace->pgtbl,
                                            fault_addr,
                                            pa,
@@ -253,7 +442,14 @@ int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
                          * When type is PMO_SHM, the later faulting threads
                          * needs to add the mapping in the page table.
                          * Repeated mapping operations are harmless.
+                         *
+                         * The zero page and frames merged by KSM are always
+                         * mapped read-only, and replaced with private pages on
+                         * write in handle_perm_fault.
                          */
+                        if (pmo->type == PMO_ANONYM
+                            && (is_zero_page(pa) || ksm_is_page(pa)))
+                                perm &= ~VMR_WRITE;
                         if (pmo->type == PMO_SHM || pmo->type == PMO_ANONYM) {
                                 /* Add mapping in the page table */
                                 long rss = 0;
@@ -276,8 +472,38 @@ int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
                 break;
         }
         case PMO_FILE: {
-                unlock(&vmspace->vmspace_lock);
                 fault_addr = ROUND_DOWN(fault_addr, PAGE_SIZE);
+                index = offset / PAGE_SIZE;
+
+                /*
+                 * Private copies from the pager are committed at their page
+                 * index (see map_fault_pages), so the page may have been
+                 * committed when another vmspace sharing the pmo faulted on
+                 * it, e.g., text of a cached ELF segment. Map it directly
+                 * without bothering the pager again. Pages the pager maps
+                 * without copying are not committed and always go to it.
+                 */
+                pa = get_page_from_pmo(pmo, index);
+                if (pa != 0) {
+                        long rss = 0;
+                        lock(&vmspace->pgtbl_lock);
+                        map_range_in_pgtbl(vmspace->pgtbl,
+                                           fault_addr,
+                                           pa,
+                                           PAGE_SIZE,
+                                           perm,
+                                           &rss);
+                        vmspace->rss += rss;
+                        unlock(&vmspace->pgtbl_lock);
+
+                        if (perm & VMR_EXEC) {
+                                arch_flush_cache(
+                                        fault_addr, PAGE_SIZE, SYNC_IDCACHE);
+                        }
+                        break;
+                }
+
+                unlock(&vmspace->vmspace_lock);
                 handle_user_fault(pmo, ROUND_DOWN(fault_addr, PAGE_SIZE));
                 BUG("Should never be here!\n");
                 break;
@@ -392,6 +618,19 @@ int handle_perm_fault(struct vmspace *vmspace, vaddr_t fault_addr,
                                 goto out_succ;
                         }
                 }
+
+                // Handle writes to the zero page or pages merged by KSM
+                if ((declared_perm & VMR_WRITE)
+                    && vmr->pmo->type == PMO_ANONYM) {
+                        ret = do_unshare_anon(vmspace, vmr, fault_addr);
+                        if (ret == 0) {
+                                goto out_succ;
+                        } else if (ret == -EFAULT) {
+                                goto out_trans_fault;
+                        } else {
+                                goto out_illegal;
+                        }
+                }
         }
 
         /**
@@ -432,6 +671,38 @@ out_trans_fault:
          * handle it atomically.
          */
         unlock(&vmspace->vmspace_lock);
-        ret = handle_trans_fault(vmspace, fault_addr);
+        ret = handle_trans_fault(vmspace, fault_addr, desired_perm);
         return ret;
 }
+
+/**
+ * @brief Handle an access flag fault. Access flags of user pages are cleared
+ * by zswap to find cold pages, and on platforms that do not manage access
+ * flags by hardware, the first access to such a page faults into here. We
+ * just set the flag again. If the page has been unmapped in the meantime,
+ * it is handled as a translation fault.
+ */
+int handle_access_fault(struct vmspace *vmspace, vaddr_t fault_addr)
+{
+        struct common_pte_t pte_info;
+        paddr_t pa;
+        pte_t *pte;
+        int ret;
+
+        lock(&vmspace->pgtbl_lock);
+        ret = query_in_pgtbl(vmspace->pgtbl, fault_addr, &pa, &pte);
+        if (ret) {
+                unlock(&vmspace->pgtbl_lock);
+                /* A write faults again on the zero page, which is fine */
+                return handle_trans_fault(vmspace, fault_addr, VMR_READ);
+        }
+
+        parse_pte_to_common(pte, L3, &pte_info);
+        if (!pte_info.access) {
+                pte_info.access = 1;
+                update_pte(pte, L3, &pte_info);
+        }
+        unlock(&vmspace->pgtbl_lock);
+
+        return 0;
+}
@@ -14,6 +14,7 @@
 #include <common/types.h>
 #include <common/kprint.h>
 #include <common/lock.h>
+#include <common/lockstat.h>
 #include <common/debug.h>
 #include <mm/kmalloc.h>
 #include <mm/slab.h>
@@ -241,7 +242,8 @@ void init_slab(void)
 
         /* slab obj size: 32, 64, 128, 256, 512, 1024, 2048 */
         for (order = SLAB_MIN_ORDER; order <= SLAB_MAX_ORDER; order++) {
-                lock_init(&slabs_locks[order]);
+                mcs_lock_init(&slabs_locks[order]);
+                lockstat_register(&slabs_locks[order], "slabs_lock");
                 slab_pool[order].current_slab = NULL;
                 init_list_head(&(slab_pool[order].partial_slab_list));
         }
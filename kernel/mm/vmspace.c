@@ -13,14 +13,22 @@
 #include <common/types.h>
 #include <common/list.h>
 #include <common/errno.h>
+#include <common/lockstat.h>
 #include <mm/vmspace.h>
 #include <mm/kmalloc.h>
 #include <mm/mm.h>
 #include <mm/uaccess.h>
+#include <mm/zswap.h>
+#include <sched/preempt.h>
 #include <arch/mmu.h>
 
+/*
+ * Private pages allocated by CoW are indexed by their page-aligned vaddr in
+ * vmr->cow_private_pages, so that they can be looked up and split in
+ * O(log n) instead of scanning all records of a (possibly huge) vmr.
+ */
 struct cow_private_page {
-        struct list_head node;
+        struct rb_node node;
         vaddr_t vaddr;
         void *page;
 };
@@ -39,14 +47,16 @@ static struct vmregion *alloc_vmregion(vaddr_t start, size_t len, size_t offset,
         vmr->offset = offset;
         vmr->perm = perm;
         vmr->pmo = pmo;
+        zswap_lock_mappings(pmo);
         list_add(&vmr->mapping_list_node, &pmo->mapping_list);
+        zswap_unlock_mappings(pmo);
 
         if (pmo->type == PMO_DEVICE)
                 vmr->perm |= VMR_DEVICE;
         else if (pmo->type == PMO_DATA_NOCACHE)
                 vmr->perm |= VMR_NOCACHE;
 
-        init_list_head(&vmr->cow_private_pages);
+        init_rb_root(&vmr->cow_private_pages);
 
         return vmr;
 }
@@ -57,6 +67,30 @@ static void free_cow_private_page(struct cow_private_page *record)
         kfree(record);
 }
 
+static bool less_cow_private_page(const struct rb_node *lhs,
+                                  const struct rb_node *rhs)
+{
+        struct cow_private_page *r1, *r2;
+
+        r1 = rb_entry(lhs, struct cow_private_page, node);
+        r2 = rb_entry(rhs, struct cow_private_page, node);
+        return r1->vaddr < r2->vaddr;
+}
+
+static int cmp_vaddr_and_cow_private_page(const void *vaddr,
+                                          const struct rb_node *node)
+{
+        struct cow_private_page *record;
+        vaddr_t va = *(const vaddr_t *)vaddr;
+
+        record = rb_entry(node, struct cow_private_page, node);
+        if (va < record->vaddr)
+                return -1;
+        if (va > record->vaddr)
+                return 1;
+        return 0;
+}
+
 int vmregion_record_cow_private_page(struct vmregion *vmr, vaddr_t vaddr,
                                      void *private_page)
 {
@@ -65,20 +99,43 @@ int vmregion_record_cow_private_page(struct vmregion *vmr, vaddr_t vaddr,
         record = kmalloc(sizeof(*record));
         if (!record)
                 return -ENOMEM;
-        record->vaddr = vaddr;
+        record->vaddr = ROUND_DOWN(vaddr, PAGE_SIZE);
         record->page = private_page;
-        list_add(&record->node, &vmr->cow_private_pages);
+        rb_insert(&vmr->cow_private_pages, &record->node, less_cow_private_page);
         return 0;
 }
 
-static void free_vmregion(struct vmregion *vmr)
+void *vmregion_find_cow_private_page(struct vmregion *vmr, vaddr_t vaddr)
 {
-        struct cow_private_page *cur_record = NULL, *tmp = NULL;
+        struct rb_node *node;
 
-        for_each_in_list_safe (cur_record, tmp, node, &vmr->cow_private_pages) {
-                free_cow_private_page(cur_record);
-        }
+        vaddr = ROUND_DOWN(vaddr, PAGE_SIZE);
+        node = rb_search(
+                &vmr->cow_private_pages, &vaddr, cmp_vaddr_and_cow_private_page);
+        if (!node)
+                return NULL;
+        return rb_entry(node, struct cow_private_page, node)->page;
+}
+
+/*
+ * Free the records in a post-order walk, so that no rebalancing is needed.
+ * The depth of recursion is bounded by the height of the rbtree.
+ */
+static void free_cow_private_pages(struct rb_node *node)
+{
+        if (!node)
+                return;
+        free_cow_private_pages(node->left_child);
+        free_cow_private_pages(node->right_child);
+        free_cow_private_page(rb_entry(node, struct cow_private_page, node));
+}
+
+static void free_vmregion(struct vmregion *vmr)
+{
+        free_cow_private_pages(vmr->cow_private_pages.root_node);
+        zswap_lock_mappings(vmr->pmo);
         list_del(&vmr->mapping_list_node);
+        zswap_unlock_mappings(vmr->pmo);
         kfree((void *)vmr);
 }
 
@@ -263,8 +320,10 @@ int vmspace_init(struct vmspace *vmspace, unsigned long pcid)
          * Note: acquire vmspace_lock before pgtbl_lock
          * when locking them together.
          */
-        lock_init(&vmspace->vmspace_lock);
+        mcs_lock_init(&vmspace->vmspace_lock);
         lock_init(&vmspace->pgtbl_lock);
+        lockstat_register(&vmspace->vmspace_lock, "vmspace_lock");
+        lockstat_register(&vmspace->pgtbl_lock, "pgtbl_lock");
 
         /* The vmspace does not run on any CPU for now */
         reset_history_cpus(vmspace);
@@ -360,17 +419,41 @@ static void __vmspace_unmap_range(struct vmspace *vmspace, vaddr_t va,
         }
 }
 
+/* Unmap at most this much at a time, with lock-breaks in between */
+#define UNMAP_BATCH_SIZE (64UL << 20)
+
 static void __vmspace_unmap_range_pgtbl(struct vmspace *vmspace, vaddr_t va,
                                         size_t len)
 {
-        if (len != 0) {
-                long rss = 0;
-                lock(&vmspace->pgtbl_lock);
-                unmap_range_in_pgtbl(vmspace->pgtbl, va, len, &rss);
-                vmspace->rss += rss;
-                unlock(&vmspace->pgtbl_lock);
-                flush_tlb_by_range(vmspace, va, len);
+        vaddr_t cur = va;
+        size_t left = len, batch;
+        long rss = 0;
+
+        if (len == 0)
+                return;
+
+        lock(&vmspace->pgtbl_lock);
+        while (left != 0) {
+                batch = MIN(left, UNMAP_BATCH_SIZE);
+                unmap_range_in_pgtbl(vmspace->pgtbl, cur, batch, &rss);
+                cur += batch;
+                left -= batch;
+
+                /*
+                 * The range is no longer in any vmr, so it can be unmapped
+                 * piece by piece. TLBs are flushed once in the end.
+                 */
+                if (left != 0 && need_lockbreak()) {
+                        vmspace->rss += rss;
+                        rss = 0;
+                        unlock(&vmspace->pgtbl_lock);
+                        cond_resched();
+                        lock(&vmspace->pgtbl_lock);
+                }
         }
+        vmspace->rss += rss;
+        unlock(&vmspace->pgtbl_lock);
+        flush_tlb_by_range(vmspace, va, len);
 }
 
 static int check_unmap(struct vmspace *vmspace, vaddr_t va, size_t len,
@@ -482,7 +565,8 @@ int split_vmr_locked(struct vmspace *vmspace, struct vmregion *old_vmr,
         struct vmregion *new_vmr;
         vaddr_t new_vmr_start;
         size_t old_vmr_size, new_vmr_size, new_vmr_offset;
-        struct cow_private_page *cur_record = NULL, *tmp = NULL;
+        struct cow_private_page *cur_record;
+        struct rb_node *node;
 
         if ((split_vaddr <= old_vmr->start)
             || (split_vaddr >= old_vmr->start + old_vmr->size)
@@ -503,13 +587,15 @@ int split_vmr_locked(struct vmspace *vmspace, struct vmregion *old_vmr,
                 return -ENOMEM;
         }
 
-        for_each_in_list_safe (
-                cur_record, tmp, node, &old_vmr->cow_private_pages) {
-                if (cur_record->vaddr >= split_vaddr) {
-                        list_del(&cur_record->node);
-                        list_add(&cur_record->node,
-                                 &new_vmr->cow_private_pages);
-                }
+        /* Move records from the tail of old_vmr until split_vaddr */
+        while ((node = rb_last(&old_vmr->cow_private_pages)) != NULL) {
+                cur_record = rb_entry(node, struct cow_private_page, node);
+                if (cur_record->vaddr < split_vaddr)
+                        break;
+                rb_erase(&old_vmr->cow_private_pages, node);
+                rb_insert(&new_vmr->cow_private_pages,
+                          node,
+                          less_cow_private_page);
         }
 
         /*
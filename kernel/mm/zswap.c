@@ -0,0 +1,540 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) Licensed under the Mulan PSL v2. You can
+ * use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v2 for more details.
+ */
+
+#include <common/errno.h>
+#include <common/kprint.h>
+#include <common/list.h>
+#include <common/lock.h>
+#include <common/util.h>
+#include <mm/common_pte.h>
+#include <mm/ksm.h>
+#include <mm/mm.h>
+#include <mm/uaccess.h>
+#include <mm/vmspace.h>
+#include <mm/zswap.h>
+#include <object/thread.h>
+
+/*
+ * Compression format (word-based, in the spirit of WKdm but without a
+ * dictionary): each 64-bit word of a page is described by a 2-bit tag. Only
+ * words that are neither zero nor a repeat of the previous word are stored.
+ * Anonymous memory is dominated by such words, and it is cheap enough to run
+ * on every swap-out.
+ *
+ * | tags (ZSWAP_TAGS_SIZE bytes) | literal words ... |
+ */
+#define ZSWAP_WORDS     (PAGE_SIZE / sizeof(u64))
+#define ZSWAP_TAGS_SIZE (ZSWAP_WORDS / 4)
+
+#define ZSWAP_TAG_ZERO    (0)
+#define ZSWAP_TAG_REPEAT  (1)
+#define ZSWAP_TAG_LITERAL (2)
+
+/* Pages compressed to more than this are not worth storing */
+#define ZSWAP_MAX_OBJ_SIZE (PAGE_SIZE * 3 / 4)
+
+/*
+ * The pool is organized like zbud: each pool page stores at most two
+ * compressed objects, one from the beginning (after the header) and one from
+ * the end. It wastes some space, but needs no extra metadata, which is
+ * important since we are short of memory when storing pages.
+ */
+struct zswap_pool_page {
+        /* As one node of unbuddied_pages if exactly one slot is used */
+        struct list_head node;
+        /* Size of the object in each slot, 0 if the slot is free */
+        unsigned short size[2];
+};
+
+#define ZSWAP_HDR_SIZE    ROUND_UP(sizeof(struct zswap_pool_page), sizeof(u64))
+#define ZSWAP_FIRST_SLOT  0
+#define ZSWAP_LAST_SLOT   1
+#define ZSWAP_SLOT_SHIFT  1
+
+/* Number of pages scanned in one pmo before moving to the next one */
+#define ZSWAP_SCAN_BATCH 256
+/* Number of pages reclaimed when an allocation fails */
+#define ZSWAP_DIRECT_RECLAIM_PAGES 32
+
+/*
+ * Protect all the following states, and all the radix slots holding zswap
+ * entries.
+ */
+static struct lock zswap_lock;
+
+/* All anonymous pmos, rotated as a clock during reclaim */
+static struct list_head zswap_pmo_list;
+static unsigned long zswap_pmo_nr;
+/* Pool pages with one free slot */
+static struct list_head unbuddied_pages;
+/* Scratch buffer for compression */
+static u64 zswap_buffer[ZSWAP_WORDS];
+
+static struct zswap_stat zswap_stat;
+
+void zswap_init(void)
+{
+        unsigned long total = 0;
+        int i;
+
+        lock_init(&zswap_lock);
+        init_list_head(&zswap_pmo_list);
+        init_list_head(&unbuddied_pages);
+
+        for (i = 0; i < physmem_map_num; ++i)
+                total += global_mem[i].pool_mem_size;
+
+        /* Reclaim below 1/16 of memory is free, and until 1/8 is free */
+        zswap_stat.low_watermark = total / 16;
+        zswap_stat.high_watermark = total / 8;
+
+        kinfo("zswap: low watermark 0x%lx, high watermark 0x%lx\n",
+              zswap_stat.low_watermark,
+              zswap_stat.high_watermark);
+}
+
+void zswap_register_pmo(struct pmobject *pmo)
+{
+        lock(&zswap_lock);
+        list_append(&pmo->swap_node, &zswap_pmo_list);
+        zswap_pmo_nr++;
+        unlock(&zswap_lock);
+}
+
+void zswap_unregister_pmo(struct pmobject *pmo)
+{
+        lock(&zswap_lock);
+        list_del(&pmo->swap_node);
+        zswap_pmo_nr--;
+        unlock(&zswap_lock);
+}
+
+void zswap_lock_mappings(struct pmobject *pmo)
+{
+        if (pmo->type == PMO_ANONYM)
+                lock(&zswap_lock);
+}
+
+void zswap_unlock_mappings(struct pmobject *pmo)
+{
+        if (pmo->type == PMO_ANONYM)
+                unlock(&zswap_lock);
+}
+
+void zswap_pin_pmo(struct pmobject *pmo)
+{
+        lock(&zswap_lock);
+        pmo->swap_pin++;
+        unlock(&zswap_lock);
+}
+
+void zswap_unpin_pmo(struct pmobject *pmo)
+{
+        lock(&zswap_lock);
+        BUG_ON(pmo->swap_pin == 0);
+        pmo->swap_pin--;
+        unlock(&zswap_lock);
+}
+
+/* Return the size of compressed data, or 0 if it exceeds @max_len */
+static size_t zswap_compress(const u64 *src, u8 *dst, size_t max_len)
+{
+        u8 *tags = dst;
+        u64 *literals = (u64 *)(dst + ZSWAP_TAGS_SIZE);
+        size_t len = ZSWAP_TAGS_SIZE;
+        u64 word, prev = 0;
+        unsigned long tag;
+        int i;
+
+        memset(tags, 0, ZSWAP_TAGS_SIZE);
+        for (i = 0; i < ZSWAP_WORDS; i++) {
+                word = src[i];
+                if (word == 0) {
+                        tag = ZSWAP_TAG_ZERO;
+                } else if (word == prev) {
+                        tag = ZSWAP_TAG_REPEAT;
+                } else {
+                        if (len + sizeof(u64) > max_len)
+                                return 0;
+                        *literals++ = word;
+                        len += sizeof(u64);
+                        tag = ZSWAP_TAG_LITERAL;
+                }
+                tags[i / 4] |= tag << ((i % 4) * 2);
+                prev = word;
+        }
+
+        return len;
+}
+
+static void zswap_decompress(const u8 *src, u64 *dst)
+{
+        const u8 *tags = src;
+        const u64 *literals = (const u64 *)(src + ZSWAP_TAGS_SIZE);
+        u64 prev = 0;
+        int i;
+
+        for (i = 0; i < ZSWAP_WORDS; i++) {
+                switch ((tags[i / 4] >> ((i % 4) * 2)) & 0x3) {
+                case ZSWAP_TAG_ZERO:
+                        dst[i] = 0;
+                        break;
+                case ZSWAP_TAG_REPEAT:
+                        dst[i] = prev;
+                        break;
+                default:
+                        dst[i] = *literals++;
+                        break;
+                }
+                prev = dst[i];
+        }
+}
+
+static inline struct zswap_pool_page *entry_to_pool_page(void *entry)
+{
+        return (struct zswap_pool_page *)ROUND_DOWN((vaddr_t)entry, PAGE_SIZE);
+}
+
+static inline int entry_to_slot(void *entry)
+{
+        return ((vaddr_t)entry >> ZSWAP_SLOT_SHIFT) & 0x1;
+}
+
+static inline void *entry_to_obj(void *entry)
+{
+        struct zswap_pool_page *pp = entry_to_pool_page(entry);
+
+        if (entry_to_slot(entry) == ZSWAP_FIRST_SLOT)
+                return (void *)pp + ZSWAP_HDR_SIZE;
+        return (void *)pp + PAGE_SIZE - pp->size[ZSWAP_LAST_SLOT];
+}
+
+static inline size_t pool_page_free_space(struct zswap_pool_page *pp)
+{
+        return PAGE_SIZE - ZSWAP_HDR_SIZE - pp->size[ZSWAP_FIRST_SLOT]
+               - pp->size[ZSWAP_LAST_SLOT];
+}
+
+/* Copy an object of @len bytes into the pool. Return NULL on failure. */
+static void *zswap_store(const void *obj, size_t len)
+{
+        struct zswap_pool_page *pp;
+        void *entry;
+        int slot;
+
+        for_each_in_list (pp, struct zswap_pool_page, node, &unbuddied_pages) {
+                if (pool_page_free_space(pp) >= len)
+                        goto found;
+        }
+
+        /*
+         * We never reclaim recursively (see zswap_get_page), so failing here
+         * just leaves the page resident.
+         */
+        pp = get_pages(0);
+        if (!pp)
+                return NULL;
+        pp->size[ZSWAP_FIRST_SLOT] = 0;
+        pp->size[ZSWAP_LAST_SLOT] = 0;
+        list_add(&pp->node, &unbuddied_pages);
+        zswap_stat.pool_pages++;
+
+found:
+        slot = pp->size[ZSWAP_FIRST_SLOT] == 0 ? ZSWAP_FIRST_SLOT :
+                                                  ZSWAP_LAST_SLOT;
+        pp->size[slot] = len;
+        if (pp->size[ZSWAP_FIRST_SLOT] && pp->size[ZSWAP_LAST_SLOT])
+                list_del(&pp->node);
+
+        zswap_stat.compressed_bytes += len;
+        zswap_stat.stored_pages++;
+
+        entry = (void *)((vaddr_t)pp | (slot << ZSWAP_SLOT_SHIFT)
+                         | ZSWAP_ENTRY_TAG);
+        memcpy(entry_to_obj(entry), obj, len);
+        return entry;
+}
+
+/* Should be called with zswap_lock held */
+static void __zswap_free_entry(void *entry)
+{
+        struct zswap_pool_page *pp = entry_to_pool_page(entry);
+        int slot = entry_to_slot(entry);
+
+        BUG_ON(pp->size[slot] == 0);
+        zswap_stat.compressed_bytes -= pp->size[slot];
+        zswap_stat.stored_pages--;
+        pp->size[slot] = 0;
+
+        if (pp->size[!slot]) {
+                /* It was full and now has a free slot */
+                list_add(&pp->node, &unbuddied_pages);
+        } else {
+                list_del(&pp->node);
+                free_pages(pp);
+                zswap_stat.pool_pages--;
+        }
+}
+
+void zswap_free_entry(void *entry)
+{
+        lock(&zswap_lock);
+        __zswap_free_entry(entry);
+        unlock(&zswap_lock);
+}
+
+void *zswap_get_page(void)
+{
+        void *page;
+
+        page = get_pages(0);
+        if (page)
+                return page;
+
+        zswap_reclaim(ZSWAP_DIRECT_RECLAIM_PAGES, true);
+        return get_pages(0);
+}
+
+int zswap_load_page(struct pmobject *pmo, unsigned long index, paddr_t *pa)
+{
+        void *value, *page;
+
+        value = radix_get(pmo->radix, index);
+        if (value == NULL) {
+                /* The slot is empty for a moment while it is being swapped */
+                lock(&zswap_lock);
+                value = radix_get(pmo->radix, index);
+                unlock(&zswap_lock);
+        }
+        if (!is_zswap_entry(value)) {
+                *pa = (paddr_t)value;
+                return 0;
+        }
+
+        /* Allocate without zswap_lock held, since it may reclaim */
+        page = zswap_get_page();
+        if (page == NULL)
+                return -ENOMEM;
+
+        lock(&zswap_lock);
+        /* It may have been loaded by others in the meantime */
+        value = radix_get(pmo->radix, index);
+        if (!is_zswap_entry(value)) {
+                unlock(&zswap_lock);
+                free_pages(page);
+                *pa = (paddr_t)value;
+                return 0;
+        }
+
+        zswap_decompress(entry_to_obj(value), page);
+        /* The radix refuses to overwrite a key */
+        radix_del(pmo->radix, index);
+        radix_add(pmo->radix, index, (void *)virt_to_phys(page));
+        __zswap_free_entry(value);
+        zswap_stat.swap_ins++;
+        unlock(&zswap_lock);
+
+        *pa = virt_to_phys(page);
+        return 0;
+}
+
+/*
+ * Scan at most ZSWAP_SCAN_BATCH pages of @pmo, starting from its cursor. A
+ * page accessed since last scan gets its access flag cleared (second chance),
+ * and a page not accessed is compressed and unmapped.
+ *
+ * Should be called with zswap_lock held. Return the number of pages reclaimed.
+ */
+static unsigned long zswap_reclaim_pmo(struct pmobject *pmo,
+                                       unsigned long nr_pages)
+{
+        struct vmregion *vmr;
+        struct vmspace *vmspace;
+        struct common_pte_t pte_info;
+        unsigned long i, nr_vmr_pages, index, reclaimed = 0;
+        vaddr_t va, flush_start = -1UL, flush_end = 0;
+        paddr_t pa, pte_pa;
+        pte_t *pte;
+        void *value, *entry;
+        size_t len;
+        long rss;
+
+        /*
+         * Only private anonymous memory (e.g., heap, stack and anonymous
+         * mmap) mapped in exactly one place is reclaimed. And pages accessed
+         * by the kernel through other paths or kept by their kva (see
+         * trans_uva_to_kva) are pinned.
+         */
+        if (pmo->swap_pin)
+                return 0;
+        if (list_empty(&pmo->mapping_list)
+            || pmo->mapping_list.next->next != &pmo->mapping_list)
+                return 0;
+
+        vmr = container_of(
+                pmo->mapping_list.next, struct vmregion, mapping_list_node);
+        vmspace = vmr->vmspace;
+        if (try_lock(&vmspace->vmspace_lock) != 0)
+                return 0;
+        if (try_lock(&vmspace->pgtbl_lock) != 0) {
+                unlock(&vmspace->vmspace_lock);
+                return 0;
+        }
+
+        nr_vmr_pages = vmr->size / PAGE_SIZE;
+        if (pmo->swap_cursor >= nr_vmr_pages)
+                pmo->swap_cursor = 0;
+
+        for (i = 0; i < MIN(nr_vmr_pages, ZSWAP_SCAN_BATCH)
+                    && reclaimed < nr_pages;
+             i++) {
+                va = vmr->start + pmo->swap_cursor * PAGE_SIZE;
+                index = vmr->offset / PAGE_SIZE + pmo->swap_cursor;
+                if (++pmo->swap_cursor == nr_vmr_pages)
+                        pmo->swap_cursor = 0;
+
+                value = radix_get(pmo->radix, index);
+                if (value == NULL || is_zswap_entry(value))
+                        continue;
+                pa = (paddr_t)value;
+
+                if (query_in_pgtbl(vmspace->pgtbl, va, &pte_pa, &pte) == 0) {
+                        /* Mapped to a CoW private page instead */
+                        if (ROUND_DOWN(pte_pa, PAGE_SIZE) != pa)
+                                continue;
+
+                        parse_pte_to_common(pte, L3, &pte_info);
+                        if (pte_info.access) {
+                                pte_info.access = 0;
+                                update_pte(pte, L3, &pte_info);
+                                flush_start = MIN(flush_start, va);
+                                flush_end = MAX(flush_end, va + PAGE_SIZE);
+                                continue;
+                        }
+                } else {
+                        pte = NULL;
+                }
+
+                /* The zero page and merged frames are shared by others */
+                if (is_zero_page(pa) || ksm_is_page(pa))
+                        continue;
+
+                len = zswap_compress((u64 *)phys_to_virt(pa),
+                                     (u8 *)zswap_buffer,
+                                     ZSWAP_MAX_OBJ_SIZE);
+                if (len == 0) {
+                        zswap_stat.rejected++;
+                        continue;
+                }
+                entry = zswap_store(zswap_buffer, len);
+                if (!entry)
+                        break;
+
+                if (pte) {
+                        rss = 0;
+                        unmap_range_in_pgtbl(
+                                vmspace->pgtbl, va, PAGE_SIZE, &rss);
+                        vmspace->rss += rss;
+                        flush_start = MIN(flush_start, va);
+                        flush_end = MAX(flush_end, va + PAGE_SIZE);
+                }
+                radix_del(pmo->radix, index);
+                radix_add(pmo->radix, index, entry);
+                free_pages((void *)phys_to_virt(pa));
+
+                zswap_stat.swap_outs++;
+                reclaimed++;
+        }
+
+        /*
+         * Flush cached translations, so that cleared access flags would be
+         * set again on access and unmapped pages would fault.
+         */
+        if (flush_start < flush_end)
+                flush_tlb_by_range(
+                        vmspace, flush_start, flush_end - flush_start);
+
+        unlock(&vmspace->pgtbl_lock);
+        unlock(&vmspace->vmspace_lock);
+        return reclaimed;
+}
+
+unsigned long zswap_reclaim(unsigned long nr_pages, bool direct)
+{
+        struct pmobject *pmo;
+        unsigned long i, nr_pmos, reclaimed = 0;
+
+        if (direct) {
+                if (try_lock(&zswap_lock) != 0)
+                        return 0;
+        } else {
+                lock(&zswap_lock);
+        }
+
+        nr_pmos = zswap_pmo_nr;
+        for (i = 0; i < nr_pmos && reclaimed < nr_pages; i++) {
+                pmo = container_of(
+                        zswap_pmo_list.next, struct pmobject, swap_node);
+                /* Rotate it, so that the next round starts from another */
+                list_del(&pmo->swap_node);
+                list_append(&pmo->swap_node, &zswap_pmo_list);
+
+                reclaimed += zswap_reclaim_pmo(pmo, nr_pages - reclaimed);
+        }
+
+        unlock(&zswap_lock);
+        return reclaimed;
+}
+
+/*
+ * Invoked periodically by the reclaim thread in user space. Start reclaiming
+ * if free memory is below the low watermark, and go on until it reaches the
+ * high watermark or nothing more can be reclaimed.
+ */
+long sys_zswap_reclaim(void)
+{
+        unsigned long free, reclaimed, total = 0;
+
+        if (current_cap_group->badge != PROCMGR_BADGE)
+                return -EPERM;
+
+        free = get_free_mem_size();
+        if (free >= zswap_stat.low_watermark)
+                return 0;
+
+        while (free < zswap_stat.high_watermark) {
+                reclaimed = zswap_reclaim(
+                        (zswap_stat.high_watermark - free) / PAGE_SIZE, false);
+                if (reclaimed == 0)
+                        break;
+                total += reclaimed;
+                free = get_free_mem_size();
+        }
+
+        return total;
+}
+
+int sys_zswap_get_stat(struct zswap_stat *user_stat)
+{
+        struct zswap_stat stat;
+
+        if (check_user_addr_range((vaddr_t)user_stat, sizeof(*user_stat)) != 0)
+                return -EINVAL;
+
+        lock(&zswap_lock);
+        stat = zswap_stat;
+        unlock(&zswap_lock);
+
+        if (copy_to_user(user_stat, &stat, sizeof(stat)))
+                return -EINVAL;
+        return 0;
+}
@@ -74,6 +74,9 @@ out_fail:
         return r;
 }
 
+struct list_head cap_group_list = {&cap_group_list, &cap_group_list};
+DEFINE_SPINLOCK(cap_group_list_lock);
+
 int cap_group_init(struct cap_group *cap_group, unsigned int size,
                    badge_t badge)
 {
@@ -92,6 +95,13 @@ int cap_group_init(struct cap_group *cap_group, unsigned int size,
         /* Set the futex info for the new cap group */
         futex_init(cap_group);
 
+        fair_group_init(&cap_group->fair_group);
+
+        memset(&cap_group->exited_acct, 0, sizeof(cap_group->exited_acct));
+        lock(&cap_group_list_lock);
+        list_append(&cap_group->acct_node, &cap_group_list);
+        unlock(&cap_group_list_lock);
+
         return 0;
 }
 
@@ -106,6 +116,10 @@ void cap_group_deinit(void *ptr)
         kfree(slot_table->slots_bmp);
         kfree(slot_table->full_slots_bmp);
         futex_deinit(cap_group);
+
+        lock(&cap_group_list_lock);
+        list_del(&cap_group->acct_node);
+        unlock(&cap_group_list_lock);
 }
 
 /* slot allocation */
@@ -115,8 +129,13 @@ static int expand_slot_table(struct slot_table *slot_table)
         struct slot_table new_slot_table;
         int r;
 
+        /*
+         * Grow geometrically, so that copying the old table, which is done
+         * with the table_guard held and thus not preemptible, takes amortized
+         * constant time per slot.
+         */
         old_size = slot_table->slots_size;
-        new_size = old_size + BASE_OBJECT_NUM;
+        new_size = old_size * 2;
         r = slot_table_init(&new_slot_table, new_size);
         if (r < 0)
                 return r;
@@ -292,6 +311,7 @@ cap_t sys_create_cap_group(unsigned long cap_group_args_p)
                 goto out_fail;
         }
         cap_group_init(new_cap_group, BASE_OBJECT_NUM, args.badge);
+        cpuset_init_cap_group(new_cap_group, current_cap_group);
 
         cap = cap_alloc(current_cap_group, new_cap_group);
         if (cap < 0) {
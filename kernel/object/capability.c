@@ -25,6 +25,7 @@
 #include <mm/vmspace.h>
 #include <lib/printk.h>
 #include <sched/context.h>
+#include <sched/preempt.h>
 
 const obj_deinit_func obj_deinit_tbl[TYPE_NR] = {
         [0 ... TYPE_NR - 1] = NULL,
@@ -344,10 +345,18 @@ again:
                 r = __cap_free(iter_cap_group, iter_slot_id, false, true);
                 if (r == -EAGAIN) {
                         unlock(&object->copies_lock);
+                        cond_resched();
                         goto again;
                 }
                 
                 BUG_ON(r != 0);
+
+                /* Lock-break for objects with many copies */
+                if (need_lockbreak()) {
+                        unlock(&object->copies_lock);
+                        cond_resched();
+                        goto again;
+                }
         }
         unlock(&object->copies_lock);
 
@@ -448,10 +457,13 @@ int sys_revoke_cap(cap_t obj_cap, bool revoke_copy)
         }
         if (obj) obj_put(obj);
 
+        /* Freeing the object, e.g., a whole vmspace, can take long */
+        preempt_section_enter();
         if (revoke_copy)
                 ret = cap_free_all(current_cap_group, obj_cap);
         else
                 ret = cap_free(current_cap_group, obj_cap);
+        preempt_section_exit();
         return ret;
 
 out_fail:
@@ -22,6 +22,9 @@
 #include <object/user_fault.h>
 #include <syscall/syscall_hooks.h>
 #include <mm/cache.h>
+#include <mm/ksm.h>
+#include <mm/zswap.h>
+#include <sched/preempt.h>
 
 #include "mmap.h"
 
@@ -153,29 +156,41 @@ static int read_write_pmo(cap_t pmo_cap, unsigned long offset,
                 unsigned long to_read_write;
                 unsigned long offset_in_page;
 
+                /* Pages are accessed without the vmspace_lock of mappings */
+                zswap_pin_pmo(pmo);
                 while (size > 0) {
                         index = ROUND_DOWN(offset, PAGE_SIZE) / PAGE_SIZE;
-                        pa = get_page_from_pmo(pmo, index);
-                        if (pa == 0) {
+                        r = try_get_page_from_pmo(pmo, index, &pa);
+                        if (r != 0)
+                                goto out_unpin;
+                        if (pa == 0 && op_type == READ) {
+                                /* Nothing to commit for reading zeros */
+                                kva = phys_to_virt(zero_page_pa);
+                        } else if (pa == 0) {
                                 /* Allocate a physical page for the anonymous
-                                 * pmo like a page fault happens.
-                                 */
-                                kva = (vaddr_t)get_pages(0);
-                                if (kva == 0) {
-                                        r = -ENOMEM;
-                                        goto out_obj_put;
-                                }
-
-                                pa = virt_to_phys((void *)kva);
-                                memset((void *)kva, 0, PAGE_SIZE);
-                                commit_page_to_pmo(pmo, index, pa);
-
-                                /* No need to map the physical page in the page
+                                 * pmo like a page fault happens, and unmap the
+                                 * zero page mapped for it.
+                                 *
+                                 * No need to map the physical page in the page
                                  * table of current process because it uses
                                  * write/read_pmo which means it does not need
                                  * the mappings.
                                  */
+                                pa = ksm_break_page(pmo, index);
+                                if (pa == 0) {
+                                        r = -ENOMEM;
+                                        goto out_unpin;
+                                }
+                                kva = phys_to_virt(pa);
                         } else {
+                                /* Never write KSM frames */
+                                if (op_type == WRITE && ksm_is_page(pa)) {
+                                        pa = ksm_break_page(pmo, index);
+                                        if (pa == 0) {
+                                                r = -ENOMEM;
+                                                goto out_unpin;
+                                        }
+                                }
                                 kva = phys_to_virt(pa);
                         }
                         /* Now kva is the beginning of some page, we should add
@@ -195,12 +210,14 @@ static int read_write_pmo(cap_t pmo_cap, unsigned long offset,
 
                         if (r) {
                                 r = -EINVAL;
-                                goto out_obj_put;
+                                goto out_unpin;
                         }
 
                         offset += to_read_write;
                         size -= to_read_write;
                 }
+out_unpin:
+                zswap_unpin_pmo(pmo);
         }
 
 out_obj_put:
@@ -255,19 +272,49 @@ int sys_get_phys_addr(vaddr_t va, paddr_t *pa_buf)
         return 0;
 }
 
+/*
+ * The kernel keeps the kva for later use (e.g., ring buffers shared with
+ * procmgr or pagers), so the backing pmo is pinned against zswap and KSM for
+ * the rest of its life. And the kernel writes through it, so the zero page or
+ * a merged page mapped there is replaced with a private one.
+ */
 int trans_uva_to_kva(vaddr_t user_va, vaddr_t *kernel_va)
 {
         struct vmspace *vmspace = current_thread->vmspace;
+        struct vmregion *vmr;
+        struct pmobject *pmo = NULL;
+        unsigned long index;
         paddr_t pa;
         int ret;
 
+        lock(&vmspace->vmspace_lock);
+        vmr = find_vmr_for_va(vmspace, user_va);
+        if (vmr != NULL && vmr->pmo->type == PMO_ANONYM) {
+                pmo = vmr->pmo;
+                index = (ROUND_DOWN(user_va, PAGE_SIZE) - vmr->start
+                         + vmr->offset)
+                        / PAGE_SIZE;
+                zswap_pin_pmo(pmo);
+        }
+
         lock(&vmspace->pgtbl_lock);
         ret = query_in_pgtbl(vmspace->pgtbl, user_va, &pa, NULL);
         unlock(&vmspace->pgtbl_lock);
+        unlock(&vmspace->vmspace_lock);
 
         if (ret < 0)
                 return ret;
 
+        if (pmo != NULL
+            && (is_zero_page(ROUND_DOWN(pa, PAGE_SIZE))
+                || ksm_is_page(ROUND_DOWN(pa, PAGE_SIZE)))) {
+                /* Unmaps the shared page, and the user faults on the new one */
+                pa = ksm_break_page(pmo, index);
+                if (pa == 0)
+                        return -ENOMEM;
+                pa += user_va & (PAGE_SIZE - 1);
+        }
+
         *kernel_va = phys_to_virt(pa);
         return 0;
 }
@@ -395,7 +442,9 @@ int sys_unmap_pmo(cap_t target_cap_group_cap, cap_t pmo_cap, unsigned long addr)
                 goto out_obj_put_cap_group;
         }
 
+        preempt_section_enter();
         ret = vmspace_unmap_pmo(vmspace, addr, pmo);
+        preempt_section_exit();
 
         obj_put(vmspace);
 
@@ -481,6 +530,8 @@ static int pmo_init(struct pmobject *pmo, pmo_type_t type, size_t len,
                  */
                 pmo->radix = new_radix();
                 init_radix(pmo->radix);
+                if (type == PMO_ANONYM)
+                        zswap_register_pmo(pmo);
                 break;
         }
         case PMO_DEVICE: {
@@ -516,18 +567,61 @@ void commit_page_to_pmo(struct pmobject *pmo, unsigned long index, paddr_t pa)
         BUG_ON(ret != 0);
 }
 
-/* Return 0 (NULL) when not found */
+/*
+ * Replace the page recorded at @index of @pmo (if any) with @pa, since the
+ * radix refuses to overwrite a key. The slot is empty for a moment, so it
+ * should be called with zswap_lock_mappings held, under which lookups of an
+ * empty slot are retried.
+ */
+void replace_page_in_pmo(struct pmobject *pmo, unsigned long index, paddr_t pa)
+{
+        radix_del(pmo->radix, index);
+        commit_page_to_pmo(pmo, index, pa);
+}
+
+/*
+ * Store the page at @index of @pmo in @pa, which is 0 (NULL) when not found.
+ * Pages of PMO_ANONYM swapped out by zswap are loaded transparently, and
+ * -ENOMEM is returned if that fails.
+ */
+int try_get_page_from_pmo(struct pmobject *pmo, unsigned long index,
+                          paddr_t *pa)
+{
+        if (pmo->type == PMO_ANONYM)
+                return zswap_load_page(pmo, index, pa);
+
+        /* The radix interfaces are thread-safe */
+        *pa = (paddr_t)radix_get(pmo->radix, index);
+        return 0;
+}
+
+/*
+ * Return 0 (NULL) when not found.
+ * Callers take 0 as a page to commit, which must not happen to a page
+ * swapped out, so failing to load it is fatal here.
+ */
 paddr_t get_page_from_pmo(struct pmobject *pmo, unsigned long index)
 {
         paddr_t pa;
+        int ret;
 
-        /* The radix interfaces are thread-safe */
-        pa = (paddr_t)radix_get(pmo->radix, index);
+        ret = try_get_page_from_pmo(pmo, index, &pa);
+        BUG_ON(ret != 0);
         return pa;
 }
 
 static void __free_pmo_page(void *addr)
 {
+        if (is_zero_page((paddr_t)addr))
+                return;
+        if (is_zswap_entry(addr)) {
+                zswap_free_entry(addr);
+                return;
+        }
+        if (ksm_is_page((paddr_t)addr)) {
+                ksm_put_page((paddr_t)addr);
+                return;
+        }
         kfree((void *)phys_to_virt(addr));
 }
 
@@ -547,6 +641,12 @@ void pmo_deinit(void *pmo_ptr)
         pmo = (struct pmobject *)pmo_ptr;
         type = pmo->type;
 
+        /* Stop reclaim and KSM from touching it before tearing down */
+        if (type == PMO_ANONYM) {
+                ksm_unregister_pmo(pmo);
+                zswap_unregister_pmo(pmo);
+        }
+
         remove_pmo_mappings(pmo);
 
         switch (type) {
@@ -744,6 +844,8 @@ int sys_handle_mprotect(unsigned long addr, unsigned long length, int prot)
         /* Modify the existing mappings in pgtbl */
         lock(&vmspace->pgtbl_lock);
         mprotect_in_pgtbl(vmspace->pgtbl, addr, length, target_prot);
+        if (target_prot & VMR_WRITE)
+                ksm_protect_range(vmspace, addr, length);
         unlock(&vmspace->pgtbl_lock);
         ret = 0;
 
@@ -41,6 +41,9 @@ int thread_init(struct thread *thread, struct cap_group *cap_group,
 #endif
                        vaddr_t stack, vaddr_t pc, u32 prio, u32 type, s32 aff)
 {
+        /* Checked by thread_deinit even if the initialization fails */
+        thread->futex_waiter.bucket = NULL;
+
         thread->cap_group =
                 obj_get(cap_group, CAP_GROUP_OBJ_ID, TYPE_CAP_GROUP);
         thread->vmspace = obj_get(cap_group, VMSPACE_OBJ_ID, TYPE_VMSPACE);
@@ -66,6 +69,13 @@ int thread_init(struct thread *thread, struct cap_group *cap_group,
 
         lock_init(&thread->sleep_state.queue_lock);
 
+        thread->base_prio = prio;
+        init_list_head(&thread->pi_futexes);
+        thread->pi_blocked_on = NULL;
+
+        fair_entity_init(&thread->fair_se);
+        memset(&thread->acct, 0, sizeof(thread->acct));
+
         return 0;
 }
 
@@ -83,11 +93,14 @@ void thread_deinit(void *thread_ptr)
         cap_group = thread->cap_group;
         lock(&cap_group->threads_lock);
         list_del(&thread->node);
+        sched_acct_add(&cap_group->exited_acct, &thread->acct);
         unlock(&cap_group->threads_lock);
 
         if (thread->general_ipc_config)
                 kfree(thread->general_ipc_config);
 
+        futex_waiter_deinit(thread);
+
         destroy_thread_ctx(thread);
 
         /* The thread struct itself will be freed in __free_object */
@@ -309,6 +322,7 @@ void create_root_thread(void)
         /* Allocate the cap for the init thread */
         thread_cap = cap_alloc(root_cap_group, thread);
         BUG_ON(thread_cap < 0);
+        thread->cap = thread_cap;
 
         /* L1 icache & dcache have no coherence on aarch64 */
         flush_idcache();
@@ -485,10 +499,16 @@ void sys_thread_exit(void)
                 /* The control flow will not go through */
         }
 
+        /* Robust release of PI futexes still held */
+        futex_exit_pi();
+
         if (current_thread->clear_child_tid) {
                 int val = 0;
                 copy_to_user(current_thread->clear_child_tid, &val, sizeof(int));
-                sys_futex_wake(current_thread->clear_child_tid, 0, 1);
+                sys_futex_wake(current_thread->clear_child_tid,
+                               FUTEX_PRIVATE,
+                               1,
+                               FUTEX_BITSET_MATCH_ANY);
         }
 
         kdebug("%s invokes sched\n", __func__);
@@ -552,7 +572,8 @@ int sys_set_prio(cap_t thread_cap, int prio)
         if (prio <= 0 || prio > MAX_PRIO)
                 return -EINVAL;
 
-        current_thread->thread_ctx->sc->prio = prio;
+        /* The running priority may be boosted by PI futexes it holds */
+        futex_pi_set_prio(current_thread, prio);
 
         return 0;
 }
@@ -566,8 +587,80 @@ int sys_get_prio(cap_t thread_cap)
         return current_thread->thread_ctx->sc->prio;
 }
 
+/*
+ * Nice values are used by the fair policy. @cap is a thread, or a cap_group
+ * whose share is then set as a whole, and 0 represents current thread.
+ */
+/*
+ * Others may only lower the weight of a thread, otherwise any process could
+ * take most of the CPU from the others. The weights of processes are set by
+ * procmgr.
+ */
+static int thread_set_nice(struct thread *thread, int nice)
+{
+        if (nice < thread->fair_se.nice
+            && current_cap_group->badge != PROCMGR_BADGE)
+                return -EPERM;
+        return sched_set_nice(thread, nice);
+}
+
+int sys_set_nice(cap_t cap, int nice)
+{
+        struct thread *thread;
+        struct cap_group *cap_group;
+        int ret;
+
+        if (cap == 0)
+                return thread_set_nice(current_thread, nice);
+
+        thread = obj_get(current_cap_group, cap, TYPE_THREAD);
+        if (thread) {
+                ret = thread_set_nice(thread, nice);
+                obj_put(thread);
+                return ret;
+        }
+
+        cap_group = obj_get(current_cap_group, cap, TYPE_CAP_GROUP);
+        if (cap_group == NULL)
+                return -ECAPBILITY;
+        if (current_cap_group->badge != PROCMGR_BADGE)
+                ret = -EPERM;
+        else
+                ret = sched_set_group_nice(cap_group, nice);
+        obj_put(cap_group);
+        return ret;
+}
+
+int sys_get_nice(cap_t cap)
+{
+        struct thread *thread;
+        struct cap_group *cap_group;
+        int nice;
+
+        if (cap == 0)
+                return current_thread->fair_se.nice;
+
+        thread = obj_get(current_cap_group, cap, TYPE_THREAD);
+        if (thread) {
+                nice = thread->fair_se.nice;
+                obj_put(thread);
+                return nice;
+        }
+
+        cap_group = obj_get(current_cap_group, cap, TYPE_CAP_GROUP);
+        if (cap_group == NULL)
+                return -ECAPBILITY;
+        nice = cap_group->fair_group.nice;
+        obj_put(cap_group);
+        return nice;
+}
+
+/*
+ * The TID of a thread is its cap in its own cap_group, which is also the
+ * owner TID stored in the word of PI futexes.
+ */
 int sys_set_tid_address(int *tidptr)
 {
         current_thread->clear_child_tid = tidptr;
-        return 0;
+        return current_thread->cap;
 }
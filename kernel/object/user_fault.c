@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) Licensed under the Mulan PSL v2. You can
+ * use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v2 for more details.
+ */
+
+#include <object/user_fault.h>
+#include <object/object.h>
+#include <object/thread.h>
+#include <object/memory.h>
+#include <mm/vmspace.h>
+#include <mm/uaccess.h>
+#include <mm/kmalloc.h>
+#include <mm/cache.h>
+#include <mm/mm.h>
+#include <common/errno.h>
+#include <common/util.h>
+#include <common/lock.h>
+#include <sched/context.h>
+#include <sched/sched.h>
+#include <lib/ring_buffer.h>
+#include <arch/mmu.h>
+#include <arch/sync.h>
+
+struct lock fmap_fault_pool_list_lock;
+struct list_head fmap_fault_pool_list;
+
+int sys_user_fault_register(cap_t notific_cap, vaddr_t msg_buffer)
+{
+        static int inited = 0;
+        struct fmap_fault_pool *pool;
+        struct notification *notific;
+        vaddr_t msg_buffer_kva;
+        badge_t badge;
+        int ret;
+
+        if (atomic_cmpxchg_32(&inited, 0, 1) == 0) {
+                lock_init(&fmap_fault_pool_list_lock);
+                init_list_head(&fmap_fault_pool_list);
+        }
+
+        badge = current_cap_group->badge;
+        /* The reference is kept by the pool */
+        notific = obj_get(current_cap_group, notific_cap, TYPE_NOTIFICATION);
+        if (notific == NULL)
+                return -EINVAL;
+
+        ret = trans_uva_to_kva(msg_buffer, &msg_buffer_kva);
+        if (ret != 0)
+                return -EINVAL;
+
+        lock(&fmap_fault_pool_list_lock);
+        for_each_in_list (
+                pool, struct fmap_fault_pool, node, &fmap_fault_pool_list) {
+                if (pool->cap_group_badge == badge) {
+                        /* Already registered */
+                        ret = -EINVAL;
+                        goto out_unlock;
+                }
+        }
+
+        pool = kmalloc(sizeof(*pool));
+        if (pool == NULL) {
+                ret = -ENOMEM;
+                goto out_unlock;
+        }
+        pool->cap_group_badge = badge;
+        pool->notific = notific;
+        pool->msg_buffer_kva = (struct ring_buffer *)msg_buffer_kva;
+        lock_init(&pool->lock);
+        lock_init(&pool->commit_lock);
+        init_list_head(&pool->pending_threads);
+        list_append(&pool->node, &fmap_fault_pool_list);
+
+out_unlock:
+        unlock(&fmap_fault_pool_list_lock);
+        return ret;
+}
+
+static struct fmap_fault_pool *get_current_fault_pool(void)
+{
+        struct fmap_fault_pool *pool, *ret = NULL;
+        badge_t badge;
+
+        badge = current_cap_group->badge;
+        lock(&fmap_fault_pool_list_lock);
+        for_each_in_list (
+                pool, struct fmap_fault_pool, node, &fmap_fault_pool_list) {
+                if (pool->cap_group_badge == badge) {
+                        ret = pool;
+                        break;
+                }
+        }
+        unlock(&fmap_fault_pool_list_lock);
+
+        return ret;
+}
+
+/*
+ * Remove the thread of @client_badge pending on @fault_va from the pool of
+ * the current (pager) process, the caller is responsible for waking it up.
+ */
+static struct thread *take_pending_thread(badge_t client_badge,
+                                          vaddr_t fault_va)
+{
+        struct fmap_fault_pool *pool;
+        struct fault_pending_thread *pending;
+        struct thread *thread = NULL;
+
+        pool = get_current_fault_pool();
+        if (pool == NULL)
+                return NULL;
+
+        lock(&pool->lock);
+        for_each_in_list (pending,
+                          struct fault_pending_thread,
+                          node,
+                          &pool->pending_threads) {
+                if (pending->fault_badge == client_badge
+                    && pending->fault_va == fault_va) {
+                        list_del(&pending->node);
+                        thread = pending->thread;
+                        kfree(pending);
+                        break;
+                }
+        }
+        unlock(&pool->lock);
+
+        return thread;
+}
+
+/*
+ * Get the physical page to be mapped for the client from the page at
+ * @remap_va of the pager. With @copy, the content is copied to a new page
+ * which is private to the client, and 0 @remap_va means a zeroed page.
+ */
+static int get_remap_page(vaddr_t remap_va, bool copy, paddr_t *pa)
+{
+        struct vmspace *vmspace;
+        paddr_t remap_pa;
+        void *page;
+        int ret;
+
+        if (remap_va == 0) {
+                if (!copy)
+                        return -EINVAL;
+                page = get_pages(0);
+                if (page == NULL)
+                        return -ENOMEM;
+                memset(page, 0, PAGE_SIZE);
+                *pa = virt_to_phys(page);
+                return 0;
+        }
+
+        vmspace = obj_get(current_cap_group, VMSPACE_OBJ_ID, TYPE_VMSPACE);
+        if (vmspace == NULL)
+                return -EINVAL;
+        lock(&vmspace->pgtbl_lock);
+        ret = query_in_pgtbl(vmspace->pgtbl, remap_va, &remap_pa, NULL);
+        unlock(&vmspace->pgtbl_lock);
+        obj_put(vmspace);
+        if (ret != 0)
+                return -EINVAL;
+
+        if (!copy) {
+                *pa = remap_pa;
+                return 0;
+        }
+
+        page = get_pages(0);
+        if (page == NULL)
+                return -ENOMEM;
+        memcpy(page, (void *)phys_to_virt(remap_pa), PAGE_SIZE);
+        *pa = virt_to_phys(page);
+        return 0;
+}
+
+/*
+ * Map @pas to the consecutive pages from @fault_va in the vmspace of
+ * @thread. Pages other than the first one are best-effort: mapping stops at
+ * the end of the vmr or at a page already mapped, e.g., by another thread
+ * of the client. Return the number of pages mapped.
+ */
+static long map_fault_pages(struct thread *thread, vaddr_t fault_va,
+                            paddr_t *pas, unsigned long nr_pages, bool copy,
+                            vmr_prop_t perm)
+{
+        struct vmspace *vmspace;
+        struct vmregion *vmr;
+        struct fmap_fault_pool *pool = NULL;
+        vaddr_t va, vmr_end;
+        paddr_t pa, existing;
+        pte_t *pte;
+        unsigned long i, index;
+        long rss = 0;
+        int ret;
+
+        vmspace = obj_get(thread->cap_group, VMSPACE_OBJ_ID, TYPE_VMSPACE);
+        if (vmspace == NULL)
+                return -EINVAL;
+
+        lock(&vmspace->vmspace_lock);
+        vmr = find_vmr_for_va(vmspace, fault_va);
+        if (vmr == NULL || (copy && vmr->pmo->type != PMO_FILE)) {
+                unlock(&vmspace->vmspace_lock);
+                obj_put(vmspace);
+                return -EINVAL;
+        }
+        vmr_end = vmr->start + vmr->size;
+
+        /*
+         * A file pmo is shared by all the processes mapping the file, each of
+         * which may have a fault on the same page queued to the pager.
+         */
+        if (copy) {
+                pool = (struct fmap_fault_pool *)vmr->pmo->private;
+                lock(&pool->commit_lock);
+        }
+        lock(&vmspace->pgtbl_lock);
+        for (i = 0; i < nr_pages; i++) {
+                va = fault_va + i * PAGE_SIZE;
+                if (i > 0
+                    && (va >= vmr_end
+                        || query_in_pgtbl(vmspace->pgtbl, va, &pa, &pte)
+                                   == 0))
+                        break;
+                /* Private copies are owned by the pmo, shared pages not */
+                if (copy) {
+                        index = (va - vmr->start + vmr->offset) / PAGE_SIZE;
+                        existing = get_page_from_pmo(vmr->pmo, index);
+                        if (existing != 0) {
+                                /* Map ahead only pages nobody has committed */
+                                if (i > 0)
+                                        break;
+                                free_pages((void *)phys_to_virt(pas[0]));
+                                pas[0] = existing;
+                        } else {
+                                commit_page_to_pmo(vmr->pmo, index, pas[i]);
+                        }
+                }
+                ret = map_range_in_pgtbl(
+                        vmspace->pgtbl, va, pas[i], PAGE_SIZE, perm, &rss);
+                BUG_ON(ret != 0);
+        }
+        vmspace->rss += rss;
+        unlock(&vmspace->pgtbl_lock);
+        if (copy)
+                unlock(&pool->commit_lock);
+        unlock(&vmspace->vmspace_lock);
+        obj_put(vmspace);
+
+        return i;
+}
+
+/*
+ * Resolve the fault of @client_badge on @fault_va with @nr_pages pages of
+ * the pager starting from @remap_vas[0]. The following ones are mapped
+ * ahead to the following pages, which saves the faults on them if the
+ * client accesses sequentially. A 0 in @remap_vas other than the first ends
+ * the batch.
+ *
+ * The faulting thread is always woken up once found: if the page is not
+ * mapped, it faults again and the fault is handled from the beginning.
+ */
+static long user_fault_map(badge_t client_badge, vaddr_t fault_va,
+                           vaddr_t *remap_vas, unsigned long nr_pages,
+                           bool copy, vmr_prop_t perm)
+{
+        struct thread *thread_to_wake;
+        paddr_t pas[USER_FAULT_MAP_BATCH_MAX];
+        unsigned long i, nr_ready;
+        long ret;
+
+        fault_va = ROUND_DOWN(fault_va, PAGE_SIZE);
+        thread_to_wake = take_pending_thread(client_badge, fault_va);
+        if (thread_to_wake == NULL)
+                return -EINVAL;
+
+        ret = 0;
+        for (nr_ready = 0; nr_ready < nr_pages; nr_ready++) {
+                if (nr_ready > 0 && remap_vas[nr_ready] == 0)
+                        break;
+                ret = get_remap_page(ROUND_DOWN(remap_vas[nr_ready], PAGE_SIZE),
+                                     copy,
+                                     &pas[nr_ready]);
+                if (ret != 0)
+                        break;
+        }
+
+        if (nr_ready > 0)
+                ret = map_fault_pages(
+                        thread_to_wake, fault_va, pas, nr_ready, copy, perm);
+
+        /* Private copies not mapped are useless */
+        if (copy) {
+                for (i = ret > 0 ? ret : 0; i < nr_ready; i++)
+                        free_pages((void *)phys_to_virt(pas[i]));
+        }
+
+        if (ret > 0 && (perm & VMR_EXEC)) {
+                switch_thread_vmspace_to(thread_to_wake);
+                arch_flush_cache(fault_va, ret * PAGE_SIZE, SYNC_IDCACHE);
+                switch_thread_vmspace_to(current_thread);
+        }
+
+        thread_to_wake->thread_ctx->state = TS_INTER;
+        BUG_ON(sched_enqueue(thread_to_wake));
+
+        return ret;
+}
+
+int sys_user_fault_map(badge_t client_badge, vaddr_t fault_va, vaddr_t remap_va,
+                       bool copy, unsigned long perm)
+{
+        long ret;
+
+        ret = user_fault_map(client_badge, fault_va, &remap_va, 1, copy, perm);
+        return ret < 0 ? ret : 0;
+}
+
+long sys_user_fault_map_batch(badge_t client_badge, vaddr_t fault_va,
+                              vaddr_t remap_vas, unsigned long nr_pages,
+                              bool copy, unsigned long perm)
+{
+        vaddr_t vas[USER_FAULT_MAP_BATCH_MAX];
+
+        if (nr_pages == 0 || nr_pages > USER_FAULT_MAP_BATCH_MAX)
+                return -EINVAL;
+        if (copy_from_user(vas, (void *)remap_vas, nr_pages * sizeof(*vas)))
+                return -EFAULT;
+
+        return user_fault_map(client_badge, fault_va, vas, nr_pages, copy, perm);
+}
+
+void handle_user_fault(struct pmobject *pmo, vaddr_t fault_va)
+{
+        struct fmap_fault_pool *fault_pool;
+        struct fault_pending_thread *pending_thread;
+        struct user_fault_msg msg;
+        int ret;
+
+        fault_pool = (struct fmap_fault_pool *)pmo->private;
+        pending_thread = kmalloc(sizeof(*pending_thread));
+        BUG_ON(pending_thread == NULL);
+        pending_thread->fault_badge = current_cap_group->badge;
+        pending_thread->fault_va = fault_va;
+        pending_thread->thread = current_thread;
+
+        lock(&fault_pool->lock);
+        BUG_ON(if_buffer_full(fault_pool->msg_buffer_kva));
+        msg.fault_badge = current_cap_group->badge;
+        msg.fault_va = fault_va;
+        set_one_msg(fault_pool->msg_buffer_kva, &msg);
+        list_append(&pending_thread->node, &fault_pool->pending_threads);
+
+        ret = signal_notific(fault_pool->notific);
+        BUG_ON(ret != 0);
+
+        /* Woken up by sys_user_fault_map once the page is mapped */
+        current_thread->thread_ctx->state = TS_WAITING;
+        sched();
+        unlock(&fault_pool->lock);
+
+        eret_to_thread(switch_context());
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <sched/acct.h>
+#include <sched/sched.h>
+#include <common/errno.h>
+#include <common/macro.h>
+#include <common/util.h>
+#include <irq/timer.h>
+#include <mm/kmalloc.h>
+#include <mm/uaccess.h>
+#include <object/cap_group.h>
+#include <object/thread.h>
+
+/* At most this many records are returned by one sys_get_sched_stat */
+#define SCHED_STAT_MAX_RECORDS 512
+
+/* Shadow and register threads run on the scheduling context of the caller */
+static inline bool thread_serves_ipc(struct thread *thread)
+{
+        return thread->thread_ctx->type == TYPE_SHADOW
+               || thread->thread_ctx->type == TYPE_REGISTER;
+}
+
+static inline void sched_acct_charge(struct thread *thread, u64 *counter,
+                                     u64 now)
+{
+        u64 delta = now - thread->acct.stamp;
+
+        *counter += delta;
+        if (thread_serves_ipc(thread))
+                thread->acct.ipc_ns += delta;
+        thread->acct.stamp = now;
+}
+
+void sched_acct_enter_kernel(void)
+{
+        struct thread *thread = current_thread;
+
+        sched_acct_charge(thread, &thread->acct.user_ns, plat_get_mono_time());
+}
+
+void sched_acct_exit_kernel(void)
+{
+        struct thread *thread = current_thread;
+
+        if (thread)
+                sched_acct_charge(
+                        thread, &thread->acct.kernel_ns, plat_get_mono_time());
+}
+
+void sched_acct_switch(struct thread *prev, struct thread *next)
+{
+        u64 now = plat_get_mono_time();
+
+        if (prev) {
+                sched_acct_charge(prev, &prev->acct.kernel_ns, now);
+                if (prev->thread_ctx->state == TS_READY)
+                        prev->acct.nr_preempted++;
+        }
+
+        if (next->acct.ready_stamp) {
+                next->acct.wait_ns += now - next->acct.ready_stamp;
+                next->acct.ready_stamp = 0;
+        }
+        next->acct.nr_switches++;
+        next->acct.stamp = now;
+}
+
+void sched_acct_ready(struct thread *thread)
+{
+        /* Keep the earliest one if dequeued and enqueued again */
+        if (!thread->acct.ready_stamp)
+                thread->acct.ready_stamp = plat_get_mono_time();
+}
+
+void sched_acct_add(struct sched_acct *dst, const struct sched_acct *src)
+{
+        dst->user_ns += src->user_ns;
+        dst->kernel_ns += src->kernel_ns;
+        dst->ipc_ns += src->ipc_ns;
+        dst->wait_ns += src->wait_ns;
+        dst->nr_switches += src->nr_switches;
+        dst->nr_preempted += src->nr_preempted;
+}
+
+static void fill_sched_stat(struct sched_stat_info *info, int kind,
+                            struct cap_group *cap_group,
+                            const struct sched_acct *acct)
+{
+        memset(info, 0, sizeof(*info));
+        memcpy(info->name,
+               cap_group->cap_group_name,
+               MIN(strlen(cap_group->cap_group_name), SCHED_STAT_NAME_LEN - 1));
+        info->kind = kind;
+        info->badge = cap_group->badge;
+        info->cpu = -1;
+        info->state = -1;
+        info->type = -1;
+        info->prio = -1;
+        info->user_time = acct->user_ns;
+        info->kernel_time = acct->kernel_ns;
+        info->ipc_time = acct->ipc_ns;
+        info->wait_time = acct->wait_ns;
+        info->nr_switches = acct->nr_switches;
+        info->nr_preempted = acct->nr_preempted;
+}
+
+static void fill_thread_stat(struct sched_stat_info *info, int kind,
+                             struct thread *thread)
+{
+        struct thread_ctx *ctx = thread->thread_ctx;
+
+        fill_sched_stat(info, kind, thread->cap_group, &thread->acct);
+        info->id = thread->cap;
+        info->cpu = ctx->cpuid;
+        info->state = ctx->state;
+        info->type = ctx->type;
+        info->prio = ctx->sc ? ctx->sc->prio : -1;
+}
+
+/*
+ * Fill @ubuf with the idle thread of each CPU, followed by each cap_group and
+ * its threads. Return the number of records filled.
+ *
+ * The records are collected into a kernel buffer first, so that no lock is
+ * held while touching user memory.
+ */
+int sys_get_sched_stat(struct sched_stat_info *ubuf, unsigned long nr)
+{
+        struct sched_stat_info *buf;
+        struct cap_group *cap_group;
+        struct thread *thread;
+        struct sched_acct total;
+        unsigned int cpuid;
+        int cnt = 0, group_idx, ret;
+
+        nr = MIN(nr, SCHED_STAT_MAX_RECORDS);
+        if (nr == 0)
+                return 0;
+        if (check_user_addr_range((vaddr_t)ubuf, sizeof(*ubuf) * nr) != 0)
+                return -EINVAL;
+
+        buf = kmalloc(sizeof(*buf) * nr);
+        if (!buf)
+                return -ENOMEM;
+
+        for (cpuid = 0; cpuid < PLAT_CPU_NUM && cnt < nr; cpuid++) {
+                fill_thread_stat(&buf[cnt], SCHED_STAT_IDLE, &idle_threads[cpuid]);
+                buf[cnt].id = -1;
+                cnt++;
+        }
+
+        lock(&cap_group_list_lock);
+        for_each_in_list (
+                cap_group, struct cap_group, acct_node, &cap_group_list) {
+                if (cnt >= nr)
+                        break;
+
+                group_idx = cnt++;
+                lock(&cap_group->threads_lock);
+                total = cap_group->exited_acct;
+                for_each_in_list (
+                        thread, struct thread, node, &cap_group->thread_list) {
+                        sched_acct_add(&total, &thread->acct);
+                        if (cnt < nr)
+                                fill_thread_stat(
+                                        &buf[cnt++], SCHED_STAT_THREAD, thread);
+                }
+                fill_sched_stat(
+                        &buf[group_idx], SCHED_STAT_GROUP, cap_group, &total);
+                buf[group_idx].id = cap_group->thread_cnt;
+                unlock(&cap_group->threads_lock);
+        }
+        unlock(&cap_group_list_lock);
+
+        ret = copy_to_user(ubuf, buf, sizeof(*buf) * cnt) ? -EINVAL : cnt;
+        kfree(buf);
+        return ret;
+}
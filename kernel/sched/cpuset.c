@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <sched/cpuset.h>
+#include <sched/sched.h>
+#include <common/errno.h>
+#include <common/lock.h>
+#include <common/util.h>
+#include <mm/uaccess.h>
+#include <object/cap_group.h>
+#include <object/object.h>
+#include <object/thread.h>
+
+struct cpuset {
+        /* Empty for unused ones */
+        char name[CPUSET_NAME_LEN];
+        cpumask_t mask;
+};
+
+/* Masks are read by the scheduler without the lock */
+static struct cpuset cpusets[CPUSET_MAX] = {
+        [CPUSET_ROOT] = {.name = "root", .mask = CPUMASK_ALL},
+};
+/* Protects defining the sets */
+static DEFINE_SPINLOCK(cpuset_lock);
+
+void cpuset_init_cap_group(struct cap_group *cap_group,
+                           struct cap_group *creator)
+{
+        cap_group->cpuset = creator ? creator->cpuset : CPUSET_ROOT;
+}
+
+cpumask_t sched_allowed_cpus(struct thread *thread)
+{
+        int affinity = thread->thread_ctx->affinity;
+        cpumask_t set, mask;
+
+        if (affinity != NO_AFF)
+                return 1UL << affinity;
+
+        set = thread->cap_group ? cpusets[thread->cap_group->cpuset].mask :
+                                  CPUMASK_ALL;
+        mask = set & thread->cpu_mask;
+        return mask ? mask : set;
+}
+
+unsigned int sched_pick_allowed_cpu(cpumask_t allowed, unsigned int hint)
+{
+        unsigned int i, cpuid;
+
+        for (i = 0; i < PLAT_CPU_NUM; i++) {
+                cpuid = (hint + i) % PLAT_CPU_NUM;
+                if (allowed & (1UL << cpuid))
+                        return cpuid;
+        }
+        return hint;
+}
+
+static int cpuset_copy_name(char *name, const char *uname)
+{
+        int i;
+
+        for (i = 0; i < CPUSET_NAME_LEN; i++) {
+                if (check_user_addr_range((vaddr_t)(uname + i), 1) != 0
+                    || copy_from_user(&name[i], (void *)(uname + i), 1))
+                        return -EINVAL;
+                if (name[i] == '\0')
+                        return i == 0 ? -EINVAL : 0;
+        }
+        return -ENAMETOOLONG;
+}
+
+/* Returns the id of the set named @name, with cpuset_lock held */
+static int cpuset_find(const char *name)
+{
+        int id;
+
+        for (id = 0; id < CPUSET_MAX; id++) {
+                if (strcmp(cpusets[id].name, name) == 0)
+                        return id;
+        }
+        return -ENOENT;
+}
+
+static long cpuset_define(const char *uname, cpumask_t mask)
+{
+        char name[CPUSET_NAME_LEN];
+        long ret;
+        int id;
+
+        if ((mask & CPUMASK_ALL) == 0 || (mask & ~CPUMASK_ALL) != 0)
+                return -EINVAL;
+        ret = cpuset_copy_name(name, uname);
+        if (ret < 0)
+                return ret;
+
+        lock(&cpuset_lock);
+        id = cpuset_find(name);
+        if (id == CPUSET_ROOT) {
+                ret = -EPERM;
+                goto out_unlock;
+        }
+        if (id < 0) {
+                for (id = 0; id < CPUSET_MAX; id++) {
+                        if (cpusets[id].name[0] == '\0')
+                                break;
+                }
+                if (id == CPUSET_MAX) {
+                        ret = -ENOSPC;
+                        goto out_unlock;
+                }
+                memcpy(cpusets[id].name, name, CPUSET_NAME_LEN);
+        }
+        cpusets[id].mask = mask;
+        ret = id;
+out_unlock:
+        unlock(&cpuset_lock);
+        return ret;
+}
+
+static long cpuset_lookup(const char *uname)
+{
+        char name[CPUSET_NAME_LEN];
+        long ret;
+
+        ret = cpuset_copy_name(name, uname);
+        if (ret < 0)
+                return ret;
+
+        lock(&cpuset_lock);
+        ret = cpuset_find(name);
+        unlock(&cpuset_lock);
+        return ret;
+}
+
+static bool cpuset_valid(unsigned long id)
+{
+        return id < CPUSET_MAX && cpusets[id].name[0] != '\0';
+}
+
+static struct cap_group *cpuset_get_cap_group(cap_t cap)
+{
+        if (cap == 0) {
+                obj_ref(current_cap_group);
+                return current_cap_group;
+        }
+        return obj_get(current_cap_group, cap, TYPE_CAP_GROUP);
+}
+
+long sys_cpuset(int op, unsigned long arg0, unsigned long arg1)
+{
+        struct cap_group *cap_group;
+        long ret;
+
+        switch (op) {
+        case CPUSET_DEFINE:
+                /* Others ask procmgr, which owns the sets (PROC_REQ_SET_CPUSET) */
+                if (current_cap_group->badge != PROCMGR_BADGE)
+                        return -EPERM;
+                return cpuset_define((const char *)arg0, arg1);
+        case CPUSET_LOOKUP:
+                return cpuset_lookup((const char *)arg0);
+        case CPUSET_ATTACH:
+                if (!cpuset_valid(arg1))
+                        return -EINVAL;
+                cap_group = cpuset_get_cap_group(arg0);
+                if (!cap_group)
+                        return -ECAPBILITY;
+                /* Only procmgr may move a process to another set */
+                if (arg1 != cap_group->cpuset
+                    && current_cap_group->badge != PROCMGR_BADGE) {
+                        obj_put(cap_group);
+                        return -EPERM;
+                }
+                cap_group->cpuset = arg1;
+                obj_put(cap_group);
+                /* The caller may have to move */
+                add_pending_resched(smp_get_cpu_id());
+                return 0;
+        case CPUSET_GET:
+                cap_group = cpuset_get_cap_group(arg0);
+                if (!cap_group)
+                        return -ECAPBILITY;
+                ret = cap_group->cpuset;
+                obj_put(cap_group);
+                return ret;
+        case CPUSET_INFO:
+                if (!cpuset_valid(arg0))
+                        return -EINVAL;
+                if (arg1) {
+                        if (check_user_addr_range(arg1, CPUSET_NAME_LEN) != 0)
+                                return -EINVAL;
+                        if (copy_to_user((void *)arg1,
+                                         cpusets[arg0].name,
+                                         CPUSET_NAME_LEN))
+                                return -EINVAL;
+                }
+                return cpusets[arg0].mask;
+        default:
+                return -EINVAL;
+        }
+}
+
+int sys_set_cpu_mask(cap_t thread_cap, unsigned long mask)
+{
+        struct thread *thread;
+
+        if ((mask & ~CPUMASK_ALL) != 0)
+                return -EINVAL;
+
+        if (thread_cap == 0)
+                /* 0 represents current thread */
+                thread = current_thread;
+        else
+                thread = obj_get(current_cap_group, thread_cap, TYPE_THREAD);
+
+        if (thread == NULL)
+                return -ECAPBILITY;
+
+        thread->cpu_mask = mask;
+
+        if (thread_cap != 0)
+                obj_put(thread);
+        else
+                add_pending_resched(smp_get_cpu_id());
+
+        return 0;
+}
+
+long sys_get_cpu_mask(cap_t thread_cap)
+{
+        struct thread *thread;
+        long mask;
+
+        if (thread_cap == 0)
+                /* 0 represents current thread */
+                thread = current_thread;
+        else
+                thread = obj_get(current_cap_group, thread_cap, TYPE_THREAD);
+
+        if (thread == NULL)
+                return -ECAPBILITY;
+
+        mask = sched_allowed_cpus(thread);
+
+        if (thread_cap != 0)
+                obj_put(thread);
+
+        return mask;
+}
@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <sched/sched.h>
+#include <sched/fair.h>
+#include <sched/trace.h>
+#include <common/errno.h>
+#include <common/kprint.h>
+#include <common/lockstat.h>
+#include <common/macro.h>
+#include <irq/timer.h>
+#include <machine.h>
+#include <object/cap_group.h>
+#include <object/thread.h>
+
+/*
+ * Weighted fair policy, see sched/fair.h.
+ *
+ * The running thread is not in the trees. Its runtime is charged to it and
+ * to its cap_group on this CPU whenever the scheduler runs, so the time of a
+ * thread switched to directly (e.g., by IPC) is charged as well. Like RR, a
+ * thread runs for DEFAULT_BUDGET ticks before it is preempted, and idle
+ * threads are not in the trees.
+ *
+ * Virtual runtime is only comparable within one CPU. A thread moved to
+ * another CPU restarts from the min_vruntime of its cap_group there.
+ */
+
+struct fair_rq {
+        /* cap_groups with ready threads, ordered by vruntime */
+        struct rb_root groups;
+        u64 min_vruntime;
+        /* When the runtime of the current thread was last charged */
+        u64 clock;
+        unsigned int nr_running;
+        struct lock lock;
+} __attribute__((aligned(CACHELINE_SZ)));
+
+static struct fair_rq fair_rqs[PLAT_CPU_NUM];
+
+/* From Linux: weight of nice n is 1024 / 1.25^n */
+static const u32 fair_nice_to_weight[FAIR_MAX_NICE - FAIR_MIN_NICE + 1] = {
+        /* -20 */ 88761, 71755, 56483, 46273, 36291,
+        /* -15 */ 29154, 23254, 18705, 14949, 11916,
+        /* -10 */ 9548,  7620,  6100,  4904,  3906,
+        /*  -5 */ 3121,  2501,  1991,  1586,  1277,
+        /*   0 */ 1024,  820,   655,   526,   423,
+        /*   5 */ 335,   272,   215,   172,   137,
+        /*  10 */ 110,   87,    70,    56,    45,
+        /*  15 */ 36,    29,    23,    18,    15,
+};
+
+void fair_entity_init(struct fair_entity *se)
+{
+        se->vruntime = 0;
+        se->nice = 0;
+        se->weight = FAIR_NICE_0_WEIGHT;
+        se->last_cpu = -1;
+        se->sum_exec = 0;
+}
+
+void fair_group_init(struct fair_group *group)
+{
+        int cpuid;
+        struct fair_group_rq *grq;
+
+        group->nice = 0;
+        group->weight = FAIR_NICE_0_WEIGHT;
+        for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
+                grq = &group->rqs[cpuid];
+                grq->vruntime = 0;
+                grq->min_vruntime = 0;
+                init_rb_root(&grq->threads);
+                grq->nr_queued = 0;
+        }
+}
+
+/*
+ * The weight is only used when charging runtime, so it can be changed
+ * without touching the trees.
+ */
+int sched_set_nice(struct thread *thread, int nice)
+{
+        if (nice < FAIR_MIN_NICE || nice > FAIR_MAX_NICE)
+                return -EINVAL;
+        thread->fair_se.nice = nice;
+        thread->fair_se.weight = fair_nice_to_weight[nice - FAIR_MIN_NICE];
+        return 0;
+}
+
+int sched_set_group_nice(struct cap_group *cap_group, int nice)
+{
+        if (nice < FAIR_MIN_NICE || nice > FAIR_MAX_NICE)
+                return -EINVAL;
+        cap_group->fair_group.nice = nice;
+        cap_group->fair_group.weight =
+                fair_nice_to_weight[nice - FAIR_MIN_NICE];
+        return 0;
+}
+
+static bool fair_entity_less(const struct rb_node *lhs,
+                             const struct rb_node *rhs)
+{
+        return rb_entry(lhs, struct fair_entity, node)->vruntime
+               < rb_entry(rhs, struct fair_entity, node)->vruntime;
+}
+
+static bool fair_group_rq_less(const struct rb_node *lhs,
+                               const struct rb_node *rhs)
+{
+        return rb_entry(lhs, struct fair_group_rq, node)->vruntime
+               < rb_entry(rhs, struct fair_group_rq, node)->vruntime;
+}
+
+static inline struct thread *fair_entity_thread(struct rb_node *node)
+{
+        return container_of(
+                rb_entry(node, struct fair_entity, node), struct thread, fair_se);
+}
+
+static inline struct fair_group_rq *fair_group_rq_of(struct thread *thread,
+                                                     unsigned int cpuid)
+{
+        return &thread->cap_group->fair_group.rqs[cpuid];
+}
+
+static inline u64 fair_scale(u64 delta, u32 weight)
+{
+        return delta * FAIR_NICE_0_WEIGHT / weight;
+}
+
+/* Insert @thread into the trees of @cpuid, with the lock of @rq held */
+static int __fair_sched_enqueue(struct fair_rq *rq, struct thread *thread,
+                                unsigned int cpuid)
+{
+        struct fair_entity *se = &thread->fair_se;
+        struct fair_group_rq *grq = fair_group_rq_of(thread, cpuid);
+
+        /* Already in the ready queue */
+        if (thread->thread_ctx->state == TS_READY)
+                return -EINVAL;
+
+        if (se->last_cpu != (int)cpuid) {
+                se->vruntime = grq->min_vruntime;
+                se->last_cpu = cpuid;
+        } else {
+                /* Sleeping does not save up CPU time */
+                se->vruntime = MAX(se->vruntime, grq->min_vruntime);
+        }
+        rb_insert(&grq->threads, &se->node, fair_entity_less);
+
+        if (grq->nr_queued++ == 0) {
+                grq->vruntime = MAX(grq->vruntime, rq->min_vruntime);
+                rb_insert(&rq->groups, &grq->node, fair_group_rq_less);
+        }
+        rq->nr_running++;
+
+        thread->thread_ctx->cpuid = cpuid;
+        thread->thread_ctx->state = TS_READY;
+        sched_acct_ready(thread);
+        sched_trace(SCHED_EV_ENQUEUE, thread, cpuid);
+        obj_ref(thread);
+        return 0;
+}
+
+/* Remove @thread from the trees, with the lock of @rq held */
+static void __fair_sched_dequeue(struct fair_rq *rq, struct thread *thread)
+{
+        struct fair_group_rq *grq =
+                fair_group_rq_of(thread, thread->thread_ctx->cpuid);
+
+        rb_erase(&grq->threads, &thread->fair_se.node);
+        if (--grq->nr_queued == 0)
+                rb_erase(&rq->groups, &grq->node);
+        rq->nr_running--;
+
+        thread->thread_ctx->state = TS_INTER;
+        sched_trace(SCHED_EV_DEQUEUE, thread, 0);
+        obj_put(thread);
+}
+
+/* The config can be tuned. */
+#define FAIR_LOADBALANCE_THRESHOLD 5
+#define FAIR_MIGRATE_THRESHOLD     5
+
+/* A simple load balance among the @allowed CPUs when enqueue threads */
+static unsigned int fair_sched_choose_cpu(cpumask_t allowed)
+{
+        unsigned int i, cpuid, min_len, local_cpuid, len;
+
+        local_cpuid = smp_get_cpu_id();
+        if (allowed & BIT(local_cpuid)) {
+                min_len = fair_rqs[local_cpuid].nr_running;
+                if (min_len <= FAIR_LOADBALANCE_THRESHOLD)
+                        return local_cpuid;
+        } else {
+                min_len = -1U;
+        }
+
+        cpuid = sched_pick_allowed_cpu(allowed, local_cpuid);
+        for (i = 0; i < PLAT_CPU_NUM; i++) {
+                if (i == local_cpuid || !(allowed & BIT(i)))
+                        continue;
+                len = fair_rqs[i].nr_running + FAIR_MIGRATE_THRESHOLD;
+                if (len < min_len) {
+                        min_len = len;
+                        cpuid = i;
+                }
+        }
+        return cpuid;
+}
+
+int fair_sched_enqueue(struct thread *thread)
+{
+        struct fair_rq *rq;
+        unsigned int cpuid;
+        int cpubind, ret;
+
+        BUG_ON(!thread);
+        BUG_ON(!thread->thread_ctx);
+
+        if (thread->thread_ctx->type == TYPE_IDLE)
+                return 0;
+
+        cpubind = get_cpubind(thread);
+        cpuid = cpubind == NO_AFF ?
+                        fair_sched_choose_cpu(sched_allowed_cpus(thread)) :
+                        cpubind;
+        if (unlikely(cpuid >= PLAT_CPU_NUM))
+                return -EINVAL;
+
+        rq = &fair_rqs[cpuid];
+        lock(&rq->lock);
+        ret = __fair_sched_enqueue(rq, thread, cpuid);
+        unlock(&rq->lock);
+
+        if (ret == 0)
+                add_pending_resched(cpuid);
+        return ret;
+}
+
+int fair_sched_dequeue(struct thread *thread)
+{
+        struct fair_rq *rq;
+        int ret = 0;
+
+        BUG_ON(!thread);
+        BUG_ON(!thread->thread_ctx);
+        BUG_ON(thread->thread_ctx->type == TYPE_IDLE);
+
+        rq = &fair_rqs[thread->thread_ctx->cpuid];
+        lock(&rq->lock);
+        if (thread->thread_ctx->state != TS_READY) {
+                ret = -EINVAL;
+                goto out_unlock;
+        }
+        __fair_sched_dequeue(rq, thread);
+out_unlock:
+        unlock(&rq->lock);
+        return ret;
+}
+
+/* Charge the runtime since the last call to @curr, with the lock held */
+static void fair_update_curr(struct fair_rq *rq, struct thread *curr,
+                             unsigned int cpuid)
+{
+        struct fair_entity *se;
+        struct fair_group_rq *grq;
+        struct fair_group *group;
+        u64 now, delta;
+
+        now = plat_get_mono_time();
+        delta = now - rq->clock;
+        rq->clock = now;
+
+        if (!curr || curr->thread_ctx->type == TYPE_IDLE || !curr->cap_group)
+                return;
+
+        se = &curr->fair_se;
+        group = &curr->cap_group->fair_group;
+        grq = &group->rqs[cpuid];
+
+        if (se->last_cpu != (int)cpuid) {
+                se->vruntime = grq->min_vruntime;
+                se->last_cpu = cpuid;
+        }
+        se->sum_exec += delta;
+        se->vruntime += fair_scale(delta, se->weight);
+
+        /* Keep the tree ordered if other threads of the group are ready */
+        if (grq->nr_queued) {
+                rb_erase(&rq->groups, &grq->node);
+                grq->vruntime += fair_scale(delta, group->weight);
+                rb_insert(&rq->groups, &grq->node, fair_group_rq_less);
+        } else {
+                grq->vruntime += fair_scale(delta, group->weight);
+        }
+}
+
+static inline bool fair_thread_runnable(struct thread *thread)
+{
+        return !thread->thread_ctx->is_suspended
+               && (thread->thread_ctx->kernel_stack_state == KS_FREE
+                   || thread == current_thread);
+}
+
+/* Choose the next thread and dequeue it, with the lock held */
+static struct thread *fair_sched_choose_thread(struct fair_rq *rq)
+{
+        struct rb_node *gnode, *tnode;
+        struct fair_group_rq *grq;
+        struct thread *thread;
+
+again:
+        gnode = rb_first(&rq->groups);
+        if (!gnode)
+                return NULL;
+        grq = rb_entry(gnode, struct fair_group_rq, node);
+        rq->min_vruntime = MAX(rq->min_vruntime, grq->vruntime);
+
+        /*
+         * A thread just moved from another CPU may still be running on its
+         * kernel stack, so look further for runnable ones.
+         */
+        for (; gnode; gnode = rb_next(gnode)) {
+                grq = rb_entry(gnode, struct fair_group_rq, node);
+                for (tnode = rb_first(&grq->threads); tnode;
+                     tnode = rb_next(tnode)) {
+                        thread = fair_entity_thread(tnode);
+                        if (fair_thread_runnable(thread))
+                                goto found;
+                }
+        }
+        return NULL;
+
+found:
+        tnode = rb_first(&grq->threads);
+        grq->min_vruntime = MAX(
+                grq->min_vruntime,
+                rb_entry(tnode, struct fair_entity, node)->vruntime);
+
+        __fair_sched_dequeue(rq, thread);
+        if (thread_should_exit(thread)) {
+                /* Thread need to exit. Set the state to TS_EXIT */
+                thread->thread_ctx->state = TS_EXIT;
+                thread->thread_ctx->thread_exit_state = TE_EXITED;
+                goto again;
+        }
+        return thread;
+}
+
+int fair_sched(void)
+{
+        struct thread *old = current_thread;
+        struct thread *new;
+        unsigned int cpuid = smp_get_cpu_id();
+        struct fair_rq *rq = &fair_rqs[cpuid];
+
+        /* Charge before the cap_group of an exiting thread may go away */
+        lock(&rq->lock);
+        fair_update_curr(rq, old, cpuid);
+        unlock(&rq->lock);
+
+        if (old) {
+                BUG_ON(!old->thread_ctx);
+
+                /* Check whether the thread is going to exit */
+                if (thread_should_exit(old)) {
+                        old->thread_ctx->state = TS_EXIT;
+                        old->thread_ctx->thread_exit_state = TE_EXITED;
+                }
+
+                if (old->thread_ctx->state == TS_RUNNING
+                    && old->thread_ctx->type != TYPE_IDLE) {
+                        /* A thread without SC should not be TS_RUNNING. */
+                        BUG_ON(!old->thread_ctx->sc);
+                        if (old->thread_ctx->sc->budget != 0
+                            && !old->thread_ctx->is_suspended
+                            && sched_cpu_allowed(old, cpuid)) {
+                                switch_to_thread(old);
+                                return 0; /* no schedule needed */
+                        }
+                        old->thread_ctx->sc->budget = DEFAULT_BUDGET;
+                        old->thread_ctx->state = TS_INTER;
+                        BUG_ON(fair_sched_enqueue(old));
+                }
+        }
+
+        lock(&rq->lock);
+        new = fair_sched_choose_thread(rq);
+        unlock(&rq->lock);
+        if (!new)
+                new = &idle_threads[cpuid];
+
+        if (new->thread_ctx->sc && new->thread_ctx->sc->budget == 0)
+                new->thread_ctx->sc->budget = DEFAULT_BUDGET;
+        switch_to_thread(new);
+        return 0;
+}
+
+int fair_sched_init(void)
+{
+        unsigned int cpuid;
+        struct fair_rq *rq;
+
+        for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
+                rq = &fair_rqs[cpuid];
+                init_rb_root(&rq->groups);
+                rq->min_vruntime = 0;
+                rq->clock = 0;
+                rq->nr_running = 0;
+                mcs_lock_init(&rq->lock);
+                lockstat_register(&rq->lock, "fair_rq_lock");
+        }
+        return 0;
+}
+
+void fair_top(void)
+{
+        unsigned int cpuid;
+        struct rb_node *gnode, *tnode;
+        struct fair_group_rq *grq;
+        struct fair_rq *rq;
+        struct thread *thread;
+
+        printk("\n*****CPU RQ Info*****\n");
+        for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
+                rq = &fair_rqs[cpuid];
+                lock(&rq->lock);
+                printk("== CPU %d RQ LEN %u MIN_VRUNTIME %lu ==\n",
+                       cpuid,
+                       rq->nr_running,
+                       rq->min_vruntime);
+                thread = current_threads[cpuid];
+                if (thread != NULL) {
+                        printk("Current ");
+                        print_thread(thread);
+                }
+                for (gnode = rb_first(&rq->groups); gnode;
+                     gnode = rb_next(gnode)) {
+                        grq = rb_entry(gnode, struct fair_group_rq, node);
+                        printk("-- vruntime %lu --\n", grq->vruntime);
+                        for (tnode = rb_first(&grq->threads); tnode;
+                             tnode = rb_next(tnode)) {
+                                thread = fair_entity_thread(tnode);
+                                printk("vruntime %lu nice %d ",
+                                       thread->fair_se.vruntime,
+                                       thread->fair_se.nice);
+                                print_thread(thread);
+                        }
+                }
+                unlock(&rq->lock);
+                printk("\n");
+        }
+}
+
+struct sched_ops fair = {.sched_init = fair_sched_init,
+                         .sched = fair_sched,
+                         .sched_periodic = fair_sched,
+                         .sched_enqueue = fair_sched_enqueue,
+                         .sched_dequeue = fair_sched_dequeue,
+                         .sched_top = fair_top};
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <sched/sched.h>
+#include <sched/trace.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <common/lockstat.h>
+#include <common/util.h>
+#include <machine.h>
+#include <mm/kmalloc.h>
+#include <object/thread.h>
+
+/*
+ * Priority based policies (PBRR and PBFIFO).
+ *
+ * Each CPU has one ready queue per priority, and a two-level bitmap
+ * recording which queues are not empty. Unlike RR, idle threads are kept in
+ * the queue of IDLE_PRIO, so there is always something to choose.
+ */
+
+#define PRIOS_PER_LEVEL 32
+
+struct prio_bitmap {
+        u32 bitmap_lvl0;
+        u32 bitmap_lvl1[PRIOS_PER_LEVEL];
+};
+
+struct pb_ready_queue {
+        struct list_head queues[PRIO_NUM];
+        struct prio_bitmap bitmap;
+        struct lock queue_lock;
+};
+
+static struct pb_ready_queue pb_ready_queues[PLAT_CPU_NUM];
+
+static inline void prio_bitmap_set(struct prio_bitmap *bitmap,
+                                   unsigned int prio)
+{
+        unsigned int index_lvl0 = prio / PRIOS_PER_LEVEL;
+        unsigned int index_lvl1 = prio % PRIOS_PER_LEVEL;
+
+        bitmap->bitmap_lvl0 |= BIT(index_lvl0);
+        bitmap->bitmap_lvl1[index_lvl0] |= BIT(index_lvl1);
+}
+
+static inline void prio_bitmap_clear(struct prio_bitmap *bitmap,
+                                     unsigned int prio)
+{
+        unsigned int index_lvl0 = prio / PRIOS_PER_LEVEL;
+        unsigned int index_lvl1 = prio % PRIOS_PER_LEVEL;
+
+        BUG_ON(index_lvl0 >= PRIOS_PER_LEVEL);
+        bitmap->bitmap_lvl1[index_lvl0] &= ~BIT(index_lvl1);
+        if (bitmap->bitmap_lvl1[index_lvl0] == 0)
+                bitmap->bitmap_lvl0 &= ~BIT(index_lvl0);
+}
+
+static inline bool prio_bitmap_is_empty(struct prio_bitmap *bitmap)
+{
+        return bitmap->bitmap_lvl0 == 0;
+}
+
+/* Should not be called on an empty bitmap */
+static inline unsigned int prio_bitmap_highest(struct prio_bitmap *bitmap)
+{
+        unsigned int index_lvl0, index_lvl1;
+
+        index_lvl0 = 31 - __builtin_clz(bitmap->bitmap_lvl0);
+        index_lvl1 = 31 - __builtin_clz(bitmap->bitmap_lvl1[index_lvl0]);
+        return index_lvl0 * PRIOS_PER_LEVEL + index_lvl1;
+}
+
+/* Enqueue @thread to the head (@ahead) or the tail of its priority queue */
+static int __pb_sched_enqueue(struct thread *thread, bool ahead)
+{
+        struct pb_ready_queue *ready_queue;
+        unsigned int prio, cpuid;
+        int cpubind;
+
+        BUG_ON(thread == NULL);
+        BUG_ON(thread->thread_ctx == NULL);
+
+        /* Already in the ready queue */
+        if (thread->thread_ctx->state == TS_READY)
+                return -EINVAL;
+
+        prio = thread->thread_ctx->sc->prio;
+        BUG_ON(prio >= PRIO_NUM);
+
+        cpubind = get_cpubind(thread);
+        cpuid = cpubind == NO_AFF ?
+                        sched_pick_allowed_cpu(sched_allowed_cpus(thread),
+                                               smp_get_cpu_id()) :
+                        cpubind;
+        ready_queue = &pb_ready_queues[cpuid];
+
+        thread->thread_ctx->state = TS_READY;
+        sched_acct_ready(thread);
+        sched_trace(SCHED_EV_ENQUEUE, thread, cpuid);
+        thread->thread_ctx->cpuid = cpuid;
+
+        lock(&ready_queue->queue_lock);
+        if (thread->thread_ctx->type != TYPE_IDLE)
+                obj_ref(thread);
+        if (ahead)
+                list_add(&thread->ready_queue_node,
+                         &ready_queue->queues[prio]);
+        else
+                list_append(&thread->ready_queue_node,
+                            &ready_queue->queues[prio]);
+        prio_bitmap_set(&ready_queue->bitmap, prio);
+        unlock(&ready_queue->queue_lock);
+
+        add_pending_resched(cpuid);
+        return 0;
+}
+
+int pb_sched_enqueue(struct thread *thread)
+{
+        return __pb_sched_enqueue(thread, false);
+}
+
+int pb_sched_enqueue_ahead(struct thread *thread)
+{
+        return __pb_sched_enqueue(thread, true);
+}
+
+/* Dequeue w/o lock. The caller should hold the lock of @ready_queue */
+static void __pb_sched_dequeue(struct pb_ready_queue *ready_queue,
+                               struct thread *thread)
+{
+        unsigned int prio = thread->thread_ctx->sc->prio;
+
+        thread->thread_ctx->state = TS_INTER;
+        sched_trace(SCHED_EV_DEQUEUE, thread, 0);
+        list_del(&thread->ready_queue_node);
+        if (list_empty(&ready_queue->queues[prio]))
+                prio_bitmap_clear(&ready_queue->bitmap, prio);
+        if (thread->thread_ctx->type != TYPE_IDLE)
+                obj_put(thread);
+}
+
+/*
+ * Remove @thread from the ready queue it resides in, e.g., to move it to the
+ * queue of another priority. Fail if it has been chosen to run meanwhile.
+ */
+static int pb_sched_dequeue(struct thread *thread)
+{
+        struct pb_ready_queue *ready_queue;
+        int ret = 0;
+
+        BUG_ON(thread == NULL);
+        BUG_ON(thread->thread_ctx == NULL);
+        /* Idle threads should always stay in the ready queue */
+        BUG_ON(thread->thread_ctx->type == TYPE_IDLE);
+
+        ready_queue = &pb_ready_queues[thread->thread_ctx->cpuid];
+        lock(&ready_queue->queue_lock);
+        if (thread->thread_ctx->state != TS_READY) {
+                ret = -EINVAL;
+                goto out_unlock;
+        }
+        __pb_sched_dequeue(ready_queue, thread);
+out_unlock:
+        unlock(&ready_queue->queue_lock);
+        return ret;
+}
+
+/*
+ * Choose the thread to run next on this CPU and dequeue it. The current
+ * thread keeps running if no ready thread has a higher priority (or the same
+ * one, if it still has budget).
+ */
+static struct thread *pb_sched_choose_thread(void)
+{
+        unsigned int cpuid = smp_get_cpu_id();
+        struct pb_ready_queue *ready_queue = &pb_ready_queues[cpuid];
+        struct thread *thread;
+        bool current_thread_runnable;
+        unsigned int highest_prio, prio;
+
+        current_thread_runnable =
+                current_thread != NULL
+                && current_thread->thread_ctx->state == TS_RUNNING
+                && !current_thread->thread_ctx->is_suspended
+                && sched_cpu_allowed(current_thread, cpuid);
+
+        lock(&ready_queue->queue_lock);
+again:
+        thread = current_thread;
+        if (prio_bitmap_is_empty(&ready_queue->bitmap)) {
+                /* The idle thread is not in the queue only if it is running */
+                BUG_ON(thread->thread_ctx->type != TYPE_IDLE);
+                BUG_ON(!current_thread_runnable);
+                goto out;
+        }
+
+        highest_prio = prio_bitmap_highest(&ready_queue->bitmap);
+        if (current_thread_runnable) {
+                prio = thread->thread_ctx->sc->prio;
+                if (prio > highest_prio
+                    || (prio == highest_prio
+                        && thread->thread_ctx->sc->budget != 0))
+                        goto out;
+        }
+
+        /*
+         * A thread just moved from another CPU may still be running on its
+         * kernel stack, so look for runnable ones in lower queues as well.
+         */
+        thread = NULL;
+        for (prio = highest_prio; prio > IDLE_PRIO; prio--) {
+                if (list_empty(&ready_queue->queues[prio]))
+                        continue;
+                thread = find_runnable_thread(&ready_queue->queues[prio]);
+                if (thread)
+                        break;
+        }
+        if (!thread) {
+                thread = &idle_threads[cpuid];
+                if (thread == current_thread) {
+                        BUG_ON(!current_thread_runnable);
+                        goto out;
+                }
+        }
+
+        __pb_sched_dequeue(ready_queue, thread);
+        if (thread_should_exit(thread)) {
+                /* Thread need to exit. Set the state to TS_EXIT */
+                thread->thread_ctx->state = TS_EXIT;
+                thread->thread_ctx->thread_exit_state = TE_EXITED;
+                goto again;
+        }
+out:
+        unlock(&ready_queue->queue_lock);
+        return thread;
+}
+
+int pbrr_sched(void)
+{
+        struct thread *old = current_thread;
+        struct thread *new;
+
+        /* Check whether the thread is going to exit */
+        if (old && thread_should_exit(old)) {
+                old->thread_ctx->state = TS_EXIT;
+                old->thread_ctx->thread_exit_state = TE_EXITED;
+        }
+
+        BUG_ON((new = pb_sched_choose_thread()) == NULL);
+        if (old && old->thread_ctx->state == TS_RUNNING && old != new)
+                BUG_ON(pb_sched_enqueue(old));
+
+        if (new->thread_ctx->sc->budget == 0)
+                new->thread_ctx->sc->budget = DEFAULT_BUDGET;
+        switch_to_thread(new);
+        return 0;
+}
+
+/*
+ * Periodic scheduling of PBFIFO: the current thread goes back to the head of
+ * its queue, so it is only preempted by threads of higher priorities.
+ */
+int pbfifo_sched(void)
+{
+        struct thread *old = current_thread;
+        struct thread *new;
+
+        /* Check whether the thread is going to exit */
+        if (old && thread_should_exit(old)) {
+                old->thread_ctx->state = TS_EXIT;
+                old->thread_ctx->thread_exit_state = TE_EXITED;
+        }
+
+        if (old && old->thread_ctx->state == TS_RUNNING)
+                BUG_ON(pb_sched_enqueue_ahead(old));
+
+        BUG_ON((new = pb_sched_choose_thread()) == NULL);
+        if (new->thread_ctx->sc->budget == 0)
+                new->thread_ctx->sc->budget = DEFAULT_BUDGET;
+        switch_to_thread(new);
+        return 0;
+}
+
+int pb_sched_init(void)
+{
+        unsigned int cpuid, prio;
+        struct pb_ready_queue *ready_queue;
+
+        for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
+                ready_queue = &pb_ready_queues[cpuid];
+                memset(&ready_queue->bitmap, 0, sizeof(ready_queue->bitmap));
+                mcs_lock_init(&ready_queue->queue_lock);
+                lockstat_register(&ready_queue->queue_lock, "pb_queue_lock");
+                for (prio = 0; prio < PRIO_NUM; prio++)
+                        init_list_head(&ready_queue->queues[prio]);
+        }
+
+        /* Idle threads stay in the queue of IDLE_PRIO when not running */
+        for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++)
+                BUG_ON(pb_sched_enqueue(&idle_threads[cpuid]));
+
+        return 0;
+}
+
+static void pb_top(void)
+{
+        printk("[INFO] pbrr_top unimplemented\n");
+}
+
+struct sched_ops pbrr = {.sched_init = pb_sched_init,
+                         .sched = pbrr_sched,
+                         .sched_periodic = pbrr_sched,
+                         .sched_enqueue = pb_sched_enqueue,
+                         .sched_dequeue = pb_sched_dequeue,
+                         .sched_top = pb_top};
+
+struct sched_ops pbfifo = {.sched_init = pb_sched_init,
+                           .sched = pbrr_sched,
+                           .sched_periodic = pbfifo_sched,
+                           .sched_enqueue = pb_sched_enqueue,
+                           .sched_dequeue = pb_sched_dequeue,
+                           .sched_top = pb_top};
@@ -11,8 +11,10 @@
  */
 
 #include <sched/sched.h>
+#include <sched/trace.h>
 #include <common/kprint.h>
 #include <common/macro.h>
+#include <common/lockstat.h>
 #include <machine.h>
 #include <mm/kmalloc.h>
 #include <object/thread.h>
@@ -50,6 +52,8 @@ int __rr_sched_enqueue(struct thread *thread, int cpuid)
         }
         thread->thread_ctx->cpuid = cpuid;
         thread->thread_ctx->state = TS_READY;
+        sched_acct_ready(thread);
+        sched_trace(SCHED_EV_ENQUEUE, thread, cpuid);
         obj_ref(thread); // add reference to thread by 1
 
         /* LAB 4 TODO BEGIN (exercise 2) */
@@ -69,22 +73,25 @@ int __rr_sched_enqueue(struct thread *thread, int cpuid)
 #define LOADBALANCE_THRESHOLD 5
 #define MIGRATE_THRESHOLD     5
 
-/* A simple load balance when enqueue threads */
-unsigned int rr_sched_choose_cpu(void)
+/* A simple load balance among the @allowed CPUs when enqueue threads */
+unsigned int rr_sched_choose_cpu(cpumask_t allowed)
 {
         unsigned int i, cpuid, min_rr_len, local_cpuid, queue_len;
 
         local_cpuid = smp_get_cpu_id();
-        min_rr_len = rr_ready_queue_meta[local_cpuid].queue_len;
-
-        if (min_rr_len <= LOADBALANCE_THRESHOLD) {
-                return local_cpuid;
+        if (allowed & BIT(local_cpuid)) {
+                min_rr_len = rr_ready_queue_meta[local_cpuid].queue_len;
+                if (min_rr_len <= LOADBALANCE_THRESHOLD) {
+                        return local_cpuid;
+                }
+        } else {
+                min_rr_len = -1U;
         }
 
         /* Find the cpu with the shortest ready queue */
-        cpuid = local_cpuid;
+        cpuid = sched_pick_allowed_cpu(allowed, local_cpuid);
         for (i = 0; i < PLAT_CPU_NUM; i++) {
-                if (i == local_cpuid) {
+                if (i == local_cpuid || !(allowed & BIT(i))) {
                         continue;
                 }
 
@@ -118,7 +125,9 @@ int rr_sched_enqueue(struct thread *thread)
                 return 0;
 
         cpubind = get_cpubind(thread);
-        cpuid = cpubind == NO_AFF ? rr_sched_choose_cpu() : cpubind;
+        cpuid = cpubind == NO_AFF ?
+                        rr_sched_choose_cpu(sched_allowed_cpus(thread)) :
+                        cpubind;
 
         if (unlikely(thread->thread_ctx->sc->prio > MAX_PRIO))
                 return -EINVAL;
@@ -152,6 +161,7 @@ int __rr_sched_dequeue(struct thread *thread)
     
         /* LAB 4 TODO END (exercise 3) */
         thread->thread_ctx->state = TS_INTER;
+        sched_trace(SCHED_EV_DEQUEUE, thread, 0);
         obj_put(thread);
         return 0;
 }
@@ -203,8 +213,7 @@ struct thread *rr_sched_choose_thread(void)
                 }
 
                 BUG_ON(__rr_sched_dequeue(thread));
-                if (thread->thread_ctx->thread_exit_state == TE_EXITING ||
-                  thread->thread_ctx->thread_exit_state == TE_EXITED) {
+                if (thread_should_exit(thread)) {
                         /* Thread need to exit. Set the state to TS_EXIT */
                         thread->thread_ctx->state = TS_EXIT;
                         thread->thread_ctx->thread_exit_state = TE_EXITED;
@@ -247,7 +256,7 @@ int rr_sched(void)
                 /* Set TE_EXITING after check won't cause any trouble, the
                  * thread will be recycle afterwards. Just a fast path. */
                 /* Check whether the thread is going to exit */
-                if (old->thread_ctx->thread_exit_state == TE_EXITING) {
+                if (thread_should_exit(old)) {
                         /* Set the state to TS_EXIT */
                         old->thread_ctx->state = TS_EXIT;
                         old->thread_ctx->thread_exit_state = TE_EXITED;
@@ -262,7 +271,8 @@ int rr_sched(void)
                         /* A thread without SC should not be TS_RUNNING. */
                         BUG_ON(!old->thread_ctx->sc);
                         if (old->thread_ctx->sc->budget != 0
-                            && !old->thread_ctx->is_suspended) {
+                            && !old->thread_ctx->is_suspended
+                            && sched_cpu_allowed(old, smp_get_cpu_id())) {
                                 switch_to_thread(old);
                                 return 0; /* no schedule needed */
                         }
@@ -309,7 +319,9 @@ int rr_sched_init(void)
                 rr_ready_queue_meta[i].queue_len = 0;
                 
                 /* Initialize the lock for the queue */
-                lock_init(&rr_ready_queue_meta[i].queue_lock);
+                mcs_lock_init(&rr_ready_queue_meta[i].queue_lock);
+                lockstat_register(&rr_ready_queue_meta[i].queue_lock,
+                                  "rr_queue_lock");
         }
 
         /* LAB 4 TODO END (exercise 1) */
@@ -318,74 +330,34 @@ int rr_sched_init(void)
         return 0;
 }
 
+/*
+ * Print the ready queues for debugging. Each queue is locked only while it is
+ * printed. Use sys_get_sched_stat for CPU usage of threads and cap_groups.
+ */
 void rr_top(void)
 {
         unsigned int cpuid;
         struct thread *thread;
-#define MAX_CAP_GROUP_BUF 128
-        struct cap_group *cap_group_buf[MAX_CAP_GROUP_BUF] = {0};
-        unsigned int cap_group_num = 0;
-        int i = 0;
-
-        for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
-                lock(&(rr_ready_queue_meta[cpuid].queue_lock));
-        }
 
         printk("\n*****CPU RQ Info*****\n");
         for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
+                lock(&(rr_ready_queue_meta[cpuid].queue_lock));
                 printk("== CPU %d RQ LEN %lu==\n",
                        cpuid,
                        rr_ready_queue_meta[cpuid].queue_len);
                 thread = current_threads[cpuid];
                 if (thread != NULL) {
-                        for (i = 0; i < cap_group_num; i++)
-                                if (thread->cap_group == cap_group_buf[i])
-                                        break;
-                        if (i == cap_group_num
-                            && cap_group_num < MAX_CAP_GROUP_BUF) {
-                                cap_group_buf[cap_group_num] =
-                                        thread->cap_group;
-                                cap_group_num++;
-                        }
                         printk("Current ");
                         print_thread(thread);
                 }
-                if (!list_empty(&(rr_ready_queue_meta[cpuid].queue_head))) {
-                        for_each_in_list (
-                                thread,
-                                struct thread,
-                                ready_queue_node,
-                                &(rr_ready_queue_meta[cpuid].queue_head)) {
-                                for (i = 0; i < cap_group_num; i++)
-                                        if (thread->cap_group
-                                            == cap_group_buf[i])
-                                                break;
-                                if (i == cap_group_num
-                                    && cap_group_num < MAX_CAP_GROUP_BUF) {
-                                        cap_group_buf[cap_group_num] =
-                                                thread->cap_group;
-                                        cap_group_num++;
-                                }
-                                print_thread(thread);
-                        }
-                }
-                printk("\n");
-        }
-
-        printk("\n*****CAP GROUP Info*****\n");
-        for (i = 0; i < cap_group_num; i++) {
-                printk("== CAP GROUP:%s ==\n",
-                       cap_group_buf[i]->cap_group_name);
                 for_each_in_list (thread,
                                   struct thread,
-                                  node,
-                                  &(cap_group_buf[i]->thread_list)) {
+                                  ready_queue_node,
+                                  &(rr_ready_queue_meta[cpuid].queue_head)) {
                         print_thread(thread);
                 }
-                printk("\n");
-        }
-        for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
                 unlock(&(rr_ready_queue_meta[cpuid].queue_lock));
+                printk("\n");
         }
 }
 
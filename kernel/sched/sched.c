@@ -13,8 +13,11 @@
 #include <sched/sched.h>
 #include <sched/context.h>
 #include <sched/fpu.h>
+#include <sched/preempt.h>
+#include <sched/trace.h>
 #include <mm/kmalloc.h>
 #include <irq/ipi.h>
+#include <irq/timer.h>
 #include <common/kprint.h>
 #include <common/util.h>
 
@@ -53,6 +56,7 @@ int switch_to_thread(struct thread *target)
         /* No thread switch happens actually */
         if (target == current_thread) {
                 target->thread_ctx->state = TS_RUNNING;
+                sched_trace_pair(SCHED_EV_SWITCH, target, target);
 
                 /* The previous thread is the thread itself */
                 target->prev_thread = THREAD_ITSELF;
@@ -68,6 +72,8 @@ int switch_to_thread(struct thread *target)
 
         target->thread_ctx->kernel_stack_state = KS_LOCKED;
 
+        sched_acct_switch(current_thread, target);
+        sched_trace_pair(SCHED_EV_SWITCH, target, current_thread);
         current_thread = target;
 
         return 0;
@@ -76,6 +82,7 @@ int switch_to_thread(struct thread *target)
 /*
  * Return the thread's affinity if possible.
  * Otherwise, return its previously running CPU (FPU owner).
+ * NO_AFF means any CPU in sched_allowed_cpus(thread).
  */
 int get_cpubind(struct thread *thread)
 {
@@ -98,13 +105,19 @@ int get_cpubind(struct thread *thread)
         if (is_fpu_owner < 0) {
                 return affinity;
         } else if (is_fpu_owner == local_cpuid) {
-                if (affinity == local_cpuid || affinity == NO_AFF) {
+                if (affinity == local_cpuid
+                    || (affinity == NO_AFF
+                        && sched_cpu_allowed(thread, local_cpuid))) {
                         return local_cpuid;
                 } else {
                         save_and_release_fpu(thread);
                         return affinity;
                 }
         } else {
+                /*
+                 * Even if not allowed there anymore, as its FPU state can
+                 * only be saved by that CPU.
+                 */
                 return is_fpu_owner;
         }
 #else
@@ -135,13 +148,13 @@ struct thread *find_runnable_thread(struct list_head *thread_list)
                 if (!thread->thread_ctx->is_suspended &&
                 (thread->thread_ctx->kernel_stack_state == KS_FREE ||
                 thread == current_thread)) {
-                /* Found a runnable thread, so break the loop */
-                break;
+                /* Found a runnable thread */
+                return thread;
                 }
         }
         /* LAB 4 TODO END (exercise 3) */
 
-        return thread;
+        return NULL;
 }
 
 /* Global interfaces */
@@ -192,6 +205,7 @@ vaddr_t switch_context(void)
         struct thread *target_thread;
         struct thread_ctx *target_ctx;
         struct thread *prev_thread;
+        vaddr_t ctx;
 
         target_thread = current_thread;
         if (!target_thread || !target_thread->thread_ctx) {
@@ -200,10 +214,19 @@ vaddr_t switch_context(void)
         }
 
         target_ctx = target_thread->thread_ctx;
+        ctx = (vaddr_t)target_ctx;
+
+#ifdef CHCORE_KERNEL_RT
+        /* Resume a thread preempted in kernel mode where it stopped */
+        if (target_thread->preempted_ctx) {
+                ctx = target_thread->preempted_ctx;
+                target_thread->preempted_ctx = 0;
+        }
+#endif
 
         prev_thread = target_thread->prev_thread;
         if (prev_thread == THREAD_ITSELF)
-                return (vaddr_t)target_ctx;
+                return ctx;
 
 #if FPU_SAVING_MODE == EAGER_FPU_MODE
         save_fpu_state(prev_thread);
@@ -238,11 +261,12 @@ vaddr_t switch_context(void)
 
         arch_switch_context(target_thread);
 
-        return (vaddr_t)target_ctx;
+        return ctx;
 }
 
 #ifdef CHCORE_KERNEL_RT
-void do_pending_resched(void)
+/* Send the pending resched IPIs, and return whether the local CPU needs one */
+static bool flush_pending_resched(void)
 {
         unsigned int cpuid;
         unsigned int local_cpuid = smp_get_cpu_id();
@@ -257,17 +281,71 @@ void do_pending_resched(void)
                         local_cpu_need_resched = true;
                 }
         }
+        return local_cpu_need_resched;
+}
 
-        if (local_cpu_need_resched) {
+void do_pending_resched(void)
+{
+        if (flush_pending_resched()) {
                 sched();
                 eret_to_thread(switch_context());
         }
 }
+
+bool need_resched(void)
+{
+        return resched_bitmaps[smp_get_cpu_id()] != 0 || arch_irq_pending();
+}
+
+/* Called by arch_preempt_schedule with the context to resume the thread */
+void preempt_schedule(vaddr_t ctx)
+{
+        current_thread->preempted_ctx = ctx;
+        sched();
+        eret_to_thread(switch_context());
+}
+
+/*
+ * The slow path of cond_resched. The thread may be switched out either by
+ * the interrupts taken (see handle_irq_el1) or by the pending reschedulings,
+ * and may come back on another CPU. The preempt count stays 1 meanwhile, as
+ * the CPU goes on outside preemptible sections, and is back to 0 on the CPU
+ * resuming the thread.
+ */
+void __cond_resched(void)
+{
+        struct thread *thread = current_thread;
+
+        if (!thread || thread->thread_ctx->type == TYPE_IDLE)
+                return;
+
+        preempt_disable();
+        if (arch_irq_pending())
+                arch_take_pending_irq();
+        if (flush_pending_resched())
+                arch_preempt_schedule();
+        preempt_enable();
+}
 #endif
 
+/*
+ * Make @cpuid look for threads if it is idle, e.g., as it skipped a thread
+ * whose kernel stack was still in use. The interrupt is enough (see
+ * handle_irq), so no IPI data is sent and the local CPU does not wait.
+ */
+static void kick_idle_cpu(unsigned int cpuid)
+{
+        struct thread *thread = current_threads[cpuid];
+
+        if (thread && thread->thread_ctx->type == TYPE_IDLE)
+                arch_send_ipi(cpuid, IPI_RESCHED);
+}
+
 void finish_switch(void)
 {
         struct thread *prev_thread;
+        unsigned int prev_cpuid;
+        bool prev_ready;
 
         prev_thread = current_thread->prev_thread;
         if ((prev_thread == THREAD_ITSELF) || (prev_thread == NULL))
@@ -280,8 +358,20 @@ void finish_switch(void)
                 return;
         }
 
+        /*
+         * If prev_thread has been enqueued to another CPU, it may be freed
+         * after it runs there, so check it before freeing its stack.
+         */
+        prev_cpuid = prev_thread->thread_ctx->cpuid;
+        prev_ready = prev_thread->thread_ctx->state == TS_READY
+                     && prev_cpuid != smp_get_cpu_id();
+
+        /* Also wakes up wait_for_kernel_stack, see cmpwait_or_event_32 */
         prev_thread->thread_ctx->kernel_stack_state = KS_FREE;
 
+        if (prev_ready)
+                kick_idle_cpu(prev_cpuid);
+
 #ifdef CHCORE_KERNEL_RT
         /* If a resched IPI is received during send_ipi(), the local CPU will
          * re-schedule. */
@@ -295,6 +385,7 @@ void finish_switch(void)
  */
 void eret_to_thread(vaddr_t sp)
 {
+        sched_acct_exit_kernel();
 #ifndef CHCORE_KERNEL_RT
         finish_switch();
 #endif
@@ -357,6 +448,7 @@ void sched_to_thread(struct thread *target)
                  * Slow path: if target thread is fpu_owner of some other CPUs,
                  * local CPU cannot direct switch to it.
                  */
+                sched_trace(SCHED_EV_SLOW_PATH, target, is_fpu_owner);
 
                 target->thread_ctx->state = TS_INTER;
                 BUG_ON(sched_enqueue(target));
@@ -384,7 +476,30 @@ void sched_to_thread(struct thread *target)
         eret_to_thread(switch_context());
 }
 
-/* Pending rescheduling will be done when the kernel returns to userspace */
+/*
+ * Change the priority of @thread. A ready thread is moved to the queue of the
+ * new priority, so that the change takes effect before it runs again.
+ */
+void sched_set_prio(struct thread *thread, unsigned int prio)
+{
+        sched_ctx_t *sc = thread->thread_ctx->sc;
+
+        if (sc->prio == prio)
+                return;
+
+        if (thread->thread_ctx->state == TS_READY
+            && sched_dequeue(thread) == 0) {
+                sc->prio = prio;
+                BUG_ON(sched_enqueue(thread));
+                return;
+        }
+        sc->prio = prio;
+}
+
+/*
+ * Pending rescheduling will be done when the kernel returns to userspace, or
+ * at the next preemption point (see sched/preempt.h).
+ */
 void add_pending_resched(unsigned int cpuid)
 {
         BUG_ON(cpuid >= PLAT_CPU_NUM);
@@ -393,6 +508,12 @@ void add_pending_resched(unsigned int cpuid)
 
 void wait_for_kernel_stack(struct thread *thread)
 {
+        u64 start;
+
+        if (thread->thread_ctx->kernel_stack_state == KS_FREE)
+                return;
+        start = plat_get_current_tick();
+
         /*
          * Handle IPI tx while waiting to avoid deadlock.
          *
@@ -405,7 +526,17 @@ void wait_for_kernel_stack(struct thread *thread)
          */
         while (thread->thread_ctx->kernel_stack_state != KS_FREE) {
                 handle_ipi();
+                /*
+                 * Sleep until the stack is freed (the store clears the
+                 * exclusive monitor) or an IPI is sent (arch_send_ipi does
+                 * sev), instead of spinning.
+                 */
+                cmpwait_or_event_32(&thread->thread_ctx->kernel_stack_state,
+                                    KS_LOCKED);
         }
+        sched_trace(SCHED_EV_KSTACK_WAIT,
+                    thread,
+                    plat_get_current_tick() - start);
 }
 
 static void init_idle_threads(void)
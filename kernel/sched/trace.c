@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <sched/trace.h>
+#include <common/errno.h>
+#include <common/kprint.h>
+#include <common/lock.h>
+#include <common/macro.h>
+#include <common/util.h>
+#include <arch/sync.h>
+#include <arch/machine/smp.h>
+#include <irq/timer.h>
+#include <ipc/notification.h>
+#include <lib/ring_buffer.h>
+#include <machine.h>
+#include <mm/kmalloc.h>
+#include <mm/uaccess.h>
+#include <object/cap_group.h>
+#include <object/thread.h>
+#include <sched/sched.h>
+
+#ifdef CHCORE_KERNEL_SCHED_TRACE
+
+/* Events kept for each CPU until drained */
+#define SCHED_TRACE_NR_EVENTS 8192
+/* At most these many events are drained by one syscall */
+#define SCHED_TRACE_MAX_DRAIN 1024
+
+struct sched_trace_cpu {
+        /* Only contended by draining */
+        struct lock lock;
+        struct ring_buffer *buf;
+        /* Events dropped as buf is full, reported by the next drain */
+        unsigned long dropped;
+} __attribute__((aligned(64)));
+
+bool sched_trace_enabled;
+
+static struct sched_trace_cpu sched_trace_cpus[PLAT_CPU_NUM];
+/* Serializes the commands */
+static DEFINE_SPINLOCK(sched_trace_ctl_lock);
+
+static void sched_trace_reset_buf(struct ring_buffer *buf)
+{
+        buf->consumer_offset = sizeof(struct ring_buffer);
+        buf->producer_offset = sizeof(struct ring_buffer);
+}
+
+static struct ring_buffer *sched_trace_new_buf(void)
+{
+        struct ring_buffer *buf;
+        size_t size;
+
+        /* One slot is always left empty by the ring buffer */
+        size = sizeof(struct ring_buffer)
+               + (SCHED_TRACE_NR_EVENTS + 1) * sizeof(struct sched_trace_event);
+        buf = kmalloc(size);
+        if (!buf)
+                return NULL;
+        buf->buffer_size = size;
+        buf->msg_size = sizeof(struct sched_trace_event);
+        sched_trace_reset_buf(buf);
+        return buf;
+}
+
+static unsigned long sched_trace_tid(struct thread *thread)
+{
+        if (!thread || !thread->cap_group)
+                return SCHED_TRACE_NO_TID;
+        return SCHED_TRACE_TID((unsigned long)thread->cap_group->badge,
+                               (unsigned long)thread->cap);
+}
+
+void __sched_trace(unsigned int type, struct thread *thread,
+                   unsigned long arg)
+{
+        struct sched_trace_event ev;
+        struct sched_trace_cpu *tc;
+
+        ev.tick = plat_get_current_tick();
+        ev.cpu = smp_get_cpu_id();
+        ev.tid = sched_trace_tid(thread);
+        ev.arg = arg;
+        ev.type = type;
+
+        tc = &sched_trace_cpus[ev.cpu];
+        lock(&tc->lock);
+        if (set_one_msg(tc->buf, &ev) != MSG_OP_SUCCESS)
+                tc->dropped++;
+        unlock(&tc->lock);
+}
+
+void __sched_trace_pair(unsigned int type, struct thread *thread,
+                        struct thread *other)
+{
+        __sched_trace(type, thread, sched_trace_tid(other));
+}
+
+static int sched_trace_enable(void)
+{
+        struct sched_trace_cpu *tc;
+        struct ring_buffer *buf;
+        int cpu;
+
+        for (cpu = 0; cpu < PLAT_CPU_NUM; cpu++) {
+                tc = &sched_trace_cpus[cpu];
+                if (tc->buf) {
+                        /* Start over, dropping what is not drained */
+                        lock(&tc->lock);
+                        sched_trace_reset_buf(tc->buf);
+                        tc->dropped = 0;
+                        unlock(&tc->lock);
+                        continue;
+                }
+
+                buf = sched_trace_new_buf();
+                if (!buf)
+                        return -ENOMEM;
+                lock_init(&tc->lock);
+                tc->dropped = 0;
+                tc->buf = buf;
+        }
+
+        /* Buffers are set before recording starts */
+        smp_mb();
+        sched_trace_enabled = true;
+        return 0;
+}
+
+/* Move the events of @cpu to @events, returns the number moved */
+static unsigned long sched_trace_drain_cpu(int cpu,
+                                           struct sched_trace_event *events,
+                                           unsigned long nr)
+{
+        struct sched_trace_cpu *tc = &sched_trace_cpus[cpu];
+        unsigned long cnt = 0;
+
+        if (!tc->buf)
+                return 0;
+
+        lock(&tc->lock);
+        if (tc->dropped && nr > 0) {
+                events[cnt].tick = plat_get_current_tick();
+                events[cnt].tid = SCHED_TRACE_NO_TID;
+                events[cnt].arg = tc->dropped;
+                events[cnt].type = SCHED_EV_DROPPED;
+                events[cnt].cpu = cpu;
+                tc->dropped = 0;
+                cnt++;
+        }
+        while (cnt < nr && get_one_msg(tc->buf, &events[cnt]) == MSG_OP_SUCCESS)
+                cnt++;
+        unlock(&tc->lock);
+        return cnt;
+}
+
+static long sched_trace_drain(struct sched_trace_event *ubuf, unsigned long nr)
+{
+        struct sched_trace_event *events;
+        unsigned long cnt = 0;
+        long ret;
+        int cpu;
+
+        nr = MIN(nr, SCHED_TRACE_MAX_DRAIN);
+        if (nr == 0)
+                return 0;
+        if (check_user_addr_range((vaddr_t)ubuf, sizeof(*ubuf) * nr) != 0)
+                return -EINVAL;
+
+        events = kmalloc(sizeof(*events) * nr);
+        if (!events)
+                return -ENOMEM;
+
+        for (cpu = 0; cpu < PLAT_CPU_NUM && cnt < nr; cpu++)
+                cnt += sched_trace_drain_cpu(cpu, &events[cnt], nr - cnt);
+
+        ret = cnt;
+        if (cnt && copy_to_user(ubuf, events, sizeof(*events) * cnt))
+                ret = -EINVAL;
+        kfree(events);
+        return ret;
+}
+
+long sys_sched_trace(int cmd, struct sched_trace_event *ubuf,
+                     unsigned long nr)
+{
+        long ret;
+
+        lock(&sched_trace_ctl_lock);
+        switch (cmd) {
+        case SCHED_TRACE_DISABLE:
+                /* Buffers are kept for draining what is recorded */
+                sched_trace_enabled = false;
+                ret = 0;
+                break;
+        case SCHED_TRACE_ENABLE:
+                ret = sched_trace_enable();
+                break;
+        case SCHED_TRACE_DRAIN:
+                ret = sched_trace_drain(ubuf, nr);
+                break;
+        case SCHED_TRACE_TICKS_PER_US:
+                ret = tick_per_us;
+                break;
+        default:
+                ret = -EINVAL;
+                break;
+        }
+        unlock(&sched_trace_ctl_lock);
+        return ret;
+}
+
+/*
+ * Notifications are provided as an object file (notification.c.obj), so waits
+ * and notifies are recorded at their syscall entries.
+ */
+int sys_traced_wait(cap_t notifc_cap, bool is_block, struct timespec *timeout)
+{
+        sched_trace(SCHED_EV_WAIT, current_thread, notifc_cap);
+        return sys_wait(notifc_cap, is_block, timeout);
+}
+
+int sys_traced_notify(cap_t notifc_cap)
+{
+        sched_trace(SCHED_EV_NOTIFY, current_thread, notifc_cap);
+        return sys_notify(notifc_cap);
+}
+
+#else /* CHCORE_KERNEL_SCHED_TRACE */
+
+long sys_sched_trace(int cmd, struct sched_trace_event *ubuf,
+                     unsigned long nr)
+{
+        return -ENOSYS;
+}
+
+#endif /* CHCORE_KERNEL_SCHED_TRACE */
@@ -16,9 +16,15 @@
 #include <mm/kmalloc.h>
 #include <mm/cache.h>
 #include <mm/mm.h>
+#include <mm/ksm.h>
+#include <mm/zswap.h>
 #include <common/kprint.h>
 #include <common/debug.h>
 #include <common/lock.h>
+#include <common/lockstat.h>
+#include <sched/acct.h>
+#include <sched/trace.h>
+#include <sched/cpuset.h>
 #include <object/memory.h>
 #include <object/thread.h>
 #include <object/cap_group.h>
@@ -166,6 +172,11 @@ const void *syscall_table[NR_SYSCALL] = {
         [CHCORE_SYS_get_prio] = sys_get_prio,
         [CHCORE_SYS_suspend] = sys_suspend,
         [CHCORE_SYS_resume] = sys_resume,
+        [CHCORE_SYS_set_nice] = sys_set_nice,
+        [CHCORE_SYS_get_nice] = sys_get_nice,
+        [CHCORE_SYS_set_cpu_mask] = sys_set_cpu_mask,
+        [CHCORE_SYS_get_cpu_mask] = sys_get_cpu_mask,
+        [CHCORE_SYS_cpuset] = sys_cpuset,
         /* ptrace */
 	[CHCORE_SYS_ptrace] = sys_ptrace,
 
@@ -181,8 +192,13 @@ const void *syscall_table[NR_SYSCALL] = {
         [CHCORE_SYS_ipc_set_cap] = sys_ipc_set_cap,
         /* - notification */
         [CHCORE_SYS_create_notifc] = sys_create_notifc,
+#ifdef CHCORE_KERNEL_SCHED_TRACE
+        [CHCORE_SYS_wait] = sys_traced_wait,
+        [CHCORE_SYS_notify] = sys_traced_notify,
+#else
         [CHCORE_SYS_wait] = sys_wait,
         [CHCORE_SYS_notify] = sys_notify,
+#endif
 
         /* Exception */
         /* - irq */
@@ -196,6 +212,7 @@ const void *syscall_table[NR_SYSCALL] = {
         /* - page fault */
         [CHCORE_SYS_user_fault_register] = sys_user_fault_register,
         [CHCORE_SYS_user_fault_map] = sys_user_fault_map,
+        [CHCORE_SYS_user_fault_map_batch] = sys_user_fault_map_batch,
 
         /* POSIX */
         /* - time */
@@ -204,6 +221,10 @@ const void *syscall_table[NR_SYSCALL] = {
         /* - memory */
         [CHCORE_SYS_handle_brk] = sys_handle_brk,
         [CHCORE_SYS_handle_mprotect] = sys_handle_mprotect,
+        [CHCORE_SYS_zswap_reclaim] = sys_zswap_reclaim,
+        [CHCORE_SYS_zswap_get_stat] = sys_zswap_get_stat,
+        [CHCORE_SYS_ksm_advise] = sys_ksm_advise,
+        [CHCORE_SYS_ksm_scan] = sys_ksm_scan,
 
         /* Hardware Access */
         [CHCORE_SYS_cache_flush] = sys_cache_flush,
@@ -214,9 +235,12 @@ const void *syscall_table[NR_SYSCALL] = {
         /* Utils */
         [CHCORE_SYS_empty_syscall] = sys_empty_syscall,
         [CHCORE_SYS_top] = sys_top,
+        [CHCORE_SYS_get_sched_stat] = sys_get_sched_stat,
         [CHCORE_SYS_get_free_mem_size] = sys_get_free_mem_size,
-        [CHCORE_SYS_get_mem_usage_msg] = get_mem_usage_msg,
+        [CHCORE_SYS_get_mem_usage_msg] = sys_get_mem_usage_msg,
         [CHCORE_SYS_get_system_info] = sys_get_system_info,
+        [CHCORE_SYS_get_lockstat] = sys_get_lockstat,
+        [CHCORE_SYS_sched_trace] = sys_sched_trace,
 
         /* - futex */
         [CHCORE_SYS_futex] = sys_futex,      
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef UAPI_CPUSET_H
+#define UAPI_CPUSET_H
+
+/*
+ * A cpuset is a named set of CPUs. Each process is in one cpuset, and its
+ * threads only run on the CPUs of it (and of their own CPU masks, if set).
+ * A CPU mask has bit i set for CPU i.
+ */
+
+#define CPUSET_MAX      8
+#define CPUSET_NAME_LEN 16
+/* All the CPUs, which processes are in unless moved. It cannot be changed. */
+#define CPUSET_ROOT     0
+
+/* Operations of sys_cpuset; DEFINE and changing a set by ATTACH are procmgr's */
+/* Create the set named arg0 with CPU mask arg1 or change its mask, returns id */
+#define CPUSET_DEFINE   0
+/* Returns the id of the set named arg0 */
+#define CPUSET_LOOKUP   1
+/* Move the process of cap_group cap arg0 (0 for the caller) to set arg1 */
+#define CPUSET_ATTACH   2
+/* Returns the id of the set of the process of cap_group cap arg0 */
+#define CPUSET_GET      3
+/* Returns the CPU mask of set arg0, and copies its name to buffer arg1 */
+#define CPUSET_INFO     4
+
+#endif /* UAPI_CPUSET_H */
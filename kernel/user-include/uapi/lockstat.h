@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef UAPI_LOCKSTAT_H
+#define UAPI_LOCKSTAT_H
+
+#define LOCKSTAT_NAME_LEN 32
+
+/* Statistics of one class of kernel locks, times are in cycles */
+struct lockstat_info {
+        char name[LOCKSTAT_NAME_LEN];
+        /* Number of locks registered to the class */
+        unsigned long nr_locks;
+        /* Acquisitions, and the ones which had to wait */
+        unsigned long acquisitions;
+        unsigned long contentions;
+        /* Time spent waiting by contended acquisitions */
+        unsigned long total_wait;
+        unsigned long max_wait;
+        /* Time between acquisition and release */
+        unsigned long total_hold;
+        unsigned long max_hold;
+};
+
+#endif /* UAPI_LOCKSTAT_H */
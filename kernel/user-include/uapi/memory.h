@@ -37,4 +37,28 @@ typedef unsigned long vmr_prop_t;
 #define VMR_NOCACHE (1 << 4)
 #define VMR_COW     (1 << 5)
 
+/* Max number of pages resolved by one user_fault_map_batch syscall */
+#define USER_FAULT_MAP_BATCH_MAX 16
+
+#ifndef __ASSEMBLER__
+/* Statistics of the compressed in-memory swap (zswap) for PMO_ANONYM */
+struct zswap_stat {
+        /* Pages currently stored in compressed form */
+        unsigned long stored_pages;
+        /* Physical pages consumed by the compressed pool */
+        unsigned long pool_pages;
+        /* Total size of compressed data in the pool */
+        unsigned long compressed_bytes;
+        /* Pages compressed and unmapped so far */
+        unsigned long swap_outs;
+        /* Pages decompressed on fault so far */
+        unsigned long swap_ins;
+        /* Cold pages kept resident because they are not compressible */
+        unsigned long rejected;
+        /* Reclaim starts below low_watermark and stops at high_watermark */
+        unsigned long low_watermark;
+        unsigned long high_watermark;
+};
+#endif
+
 #endif /* UAPI_MEMORY_H */
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef UAPI_SCHED_STAT_H
+#define UAPI_SCHED_STAT_H
+
+#define SCHED_STAT_NAME_LEN 32
+
+/* Kinds of records */
+#define SCHED_STAT_IDLE   0 /* The idle thread of a CPU */
+#define SCHED_STAT_GROUP  1 /* A cap_group, including its exited threads */
+#define SCHED_STAT_THREAD 2 /* A thread of the last SCHED_STAT_GROUP record */
+
+/* CPU usage of a thread or a cap_group, times are in ns */
+struct sched_stat_info {
+        char name[SCHED_STAT_NAME_LEN];
+        int kind;
+        /* Thread cap in its cap_group, or the number of threads for groups */
+        int id;
+        unsigned long badge;
+        /* The following four are only valid for threads */
+        int cpu;
+        int state;
+        int type;
+        int prio;
+        unsigned long user_time;
+        unsigned long kernel_time;
+        /* Part of the above spent serving IPC on the caller's budget */
+        unsigned long ipc_time;
+        /* Time spent in ready queues */
+        unsigned long wait_time;
+        /* Times being switched to, and being switched out while runnable */
+        unsigned long nr_switches;
+        unsigned long nr_preempted;
+};
+
+#endif /* UAPI_SCHED_STAT_H */
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef UAPI_SCHED_TRACE_H
+#define UAPI_SCHED_TRACE_H
+
+/* Commands of sys_sched_trace */
+#define SCHED_TRACE_DISABLE 0
+#define SCHED_TRACE_ENABLE  1
+/* Move the recorded events to the buffer, returns the number moved */
+#define SCHED_TRACE_DRAIN   2
+/* Returns the number of ticks (as in events) per microsecond */
+#define SCHED_TRACE_TICKS_PER_US 3
+
+/* Types of events, and what the thread and arg of them are */
+#define SCHED_EV_ENQUEUE     0 /* Ready thread, CPU of the queue */
+#define SCHED_EV_DEQUEUE     1 /* Thread removed from a queue, - */
+#define SCHED_EV_SWITCH      2 /* Thread switched to, the previous one */
+#define SCHED_EV_IPC_CALL    3 /* Client, server handler thread */
+#define SCHED_EV_IPC_RETURN  4 /* Server handler thread, client */
+#define SCHED_EV_NOTIFY      5 /* Notifier, notification cap */
+#define SCHED_EV_WAIT        6 /* Waiter, notification cap */
+#define SCHED_EV_TIMER_IRQ   7 /* Interrupted thread, - */
+#define SCHED_EV_KSTACK_WAIT 8 /* Target thread, ticks spent waiting */
+#define SCHED_EV_SLOW_PATH   9 /* Target of sched_to_thread, its FPU CPU */
+#define SCHED_EV_DROPPED     10 /* -, number of events lost as buffer full */
+#define SCHED_EV_NR          11
+
+/* Thread ID in events: the badge of its cap_group and its cap in it */
+#define SCHED_TRACE_TID(badge, cap) (((badge) << 16) | ((cap)&0xffff))
+#define SCHED_TRACE_NO_TID          (~0UL)
+
+struct sched_trace_event {
+        unsigned long tick;
+        unsigned long tid;
+        unsigned long arg;
+        unsigned int type;
+        unsigned int cpu;
+};
+
+#endif /* UAPI_SCHED_TRACE_H */
@@ -13,7 +13,7 @@
 #ifndef UAPI_SYSCALL_NUM_H
 #define UAPI_SYSCALL_NUM_H
 
-#define NR_SYSCALL 64
+#define NR_SYSCALL 96
 
 /* Character IO */
 #define CHCORE_SYS_putstr 0
@@ -50,6 +50,11 @@
 #define CHCORE_SYS_get_prio     22
 #define CHCORE_SYS_suspend      23
 #define CHCORE_SYS_resume       24
+#define CHCORE_SYS_set_nice     66
+#define CHCORE_SYS_get_nice     67
+#define CHCORE_SYS_set_cpu_mask 70
+#define CHCORE_SYS_get_cpu_mask 71
+#define CHCORE_SYS_cpuset       72
 /* - ptrace */
 #define CHCORE_SYS_ptrace       25
 
@@ -76,6 +81,7 @@
 /* - page fault */
 #define CHCORE_SYS_user_fault_register     41
 #define CHCORE_SYS_user_fault_map          42
+#define CHCORE_SYS_user_fault_map_batch    73
 
 /* POSIX */
 /* - time */
@@ -84,6 +90,10 @@
 /* - memory */
 #define CHCORE_SYS_handle_brk              45
 #define CHCORE_SYS_handle_mprotect         46
+#define CHCORE_SYS_zswap_reclaim           61
+#define CHCORE_SYS_zswap_get_stat          62
+#define CHCORE_SYS_ksm_advise              63
+#define CHCORE_SYS_ksm_scan                64
 
 /* Hardware Access */
 /* - cache */
@@ -99,9 +109,12 @@
 /* Utils */
 #define CHCORE_SYS_empty_syscall           52
 #define CHCORE_SYS_top                     53
+#define CHCORE_SYS_get_sched_stat          68
 #define CHCORE_SYS_get_free_mem_size       54
 #define CHCORE_SYS_get_mem_usage_msg       55
 #define CHCORE_SYS_get_system_info         56
+#define CHCORE_SYS_get_lockstat            65
+#define CHCORE_SYS_sched_trace             69
 
 /* - futex */
 #define CHCORE_SYS_futex      57
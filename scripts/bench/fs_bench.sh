@@ -0,0 +1,76 @@
+#!/bin/bash
+# Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+# Licensed under the Mulan PSL v2.
+# You can use this software according to the terms and conditions of the Mulan PSL v2.
+# You may obtain a copy of Mulan PSL v2 at:
+#     http://license.coscl.org.cn/MulanPSL2
+# THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+# PURPOSE.
+# See the Mulan PSL v2 for more details.
+
+# Run fs_bench.bin under QEMU and save its results, e.g.,
+#   ./scripts/bench/fs_bench.sh -o before.txt
+#   (change something)
+#   ./scripts/bench/fs_bench.sh -b before.txt -o after.txt
+# With a baseline, the tests whose average latency grows by more than the
+# tolerance are reported, and the script fails.
+#
+# Usage: fs_bench.sh [-n] [-o out] [-b baseline] [-p tolerance_pct]
+#                    [-- fs_bench args]
+#   -n  do not build before running
+
+set -e -o pipefail
+
+make="${MAKE:-make}"
+bench_dir=$(dirname $0)
+out=fs_bench.txt
+baseline=
+tolerance=10
+build=1
+
+while getopts "no:b:p:" opt; do
+    case $opt in
+    n) build=0 ;;
+    o) out=$OPTARG ;;
+    b) baseline=$OPTARG ;;
+    p) tolerance=$OPTARG ;;
+    *) echo "Usage: $0 [-n] [-o out] [-b baseline] [-p tolerance_pct]" \
+            "[-- fs_bench args]"; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $build -eq 1 ]; then
+    $make build
+fi
+
+log=$(mktemp)
+trap "rm -f $log" EXIT
+if ! $bench_dir/fs_bench.exp "$@" | tr -d '\r' | tee $log; then
+    echo "fs_bench failed, see the output above"
+    exit 1
+fi
+
+# Keep the rows of the tests, with the names of the columns
+sed -n '/^TEST /,/^fs_bench: done/p' $log | grep -v '^fs_bench:\|^    ' > $out
+echo "Results saved to $out"
+
+if [ -n "$baseline" ]; then
+    # Compare AVG(us) of the same TEST and BS
+    awk -v tol=$tolerance '
+        NR == FNR { if ($1 != "TEST") base[$1 " " $2] = $5; next }
+        $1 == "TEST" { next }
+        {
+            key = $1 " " $2
+            if (!(key in base) || base[key] == 0)
+                next
+            pct = ($5 - base[key]) * 100 / base[key]
+            printf "%-12s %6s %9.1f -> %9.1f us %+6.1f%%%s\n", $1, $2,
+                   base[key], $5, pct, (pct > tol ? "  REGRESSION" : "")
+            if (pct > tol)
+                bad++
+        }
+        END { exit (bad > 0) }
+    ' $baseline $out
+fi
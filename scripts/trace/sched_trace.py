@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+# Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+# Licensed under the Mulan PSL v2.
+# You can use this software according to the terms and conditions of the Mulan PSL v2.
+# You may obtain a copy of Mulan PSL v2 at:
+#     http://license.coscl.org.cn/MulanPSL2
+# THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+# PURPOSE.
+# See the Mulan PSL v2 for more details.
+
+"""
+Analyze the scheduler events dumped by sched_trace.bin.
+
+Reads a console log (e.g., saved from QEMU), prints histograms of the
+wakeup-to-run latency, the IPC call-to-return latency and the time spent
+waiting for kernel stacks, and optionally writes a Chrome trace (open it in
+chrome://tracing or Perfetto) with the threads running on each CPU and the
+IPC chains.
+"""
+
+import argparse
+import json
+import sys
+from collections import defaultdict
+from typing import Dict, List, Optional, TextIO
+
+# Keep in sync with kernel/user-include/uapi/sched_trace.h
+EV_ENQUEUE = 0
+EV_DEQUEUE = 1
+EV_SWITCH = 2
+EV_IPC_CALL = 3
+EV_IPC_RETURN = 4
+EV_NOTIFY = 5
+EV_WAIT = 6
+EV_TIMER_IRQ = 7
+EV_KSTACK_WAIT = 8
+EV_SLOW_PATH = 9
+EV_DROPPED = 10
+
+EV_NAMES = [
+    'enqueue', 'dequeue', 'switch', 'ipc_call', 'ipc_return', 'notify',
+    'wait', 'timer_irq', 'kstack_wait', 'slow_path', 'dropped'
+]
+
+NO_TID = (1 << 64) - 1
+IDLE_TID = 0
+
+
+class Event:
+    def __init__(self, cpu: int, tick: int, type: int, tid: int, arg: int):
+        self.cpu = cpu
+        self.tick = tick
+        self.type = type
+        self.tid = tid
+        self.arg = arg
+
+
+def tid_str(tid: int) -> str:
+    if tid == NO_TID:
+        return '-'
+    if tid == IDLE_TID:
+        return 'idle'
+    return '{}:{}'.format(tid >> 16, tid & 0xffff)
+
+
+class Histogram:
+    """Latencies in log2 buckets of us, same as latency.bin"""
+
+    NR_BUCKETS = 24
+
+    def __init__(self, name: str):
+        self.name = name
+        self.buckets = [0] * Histogram.NR_BUCKETS
+        self.samples: List[float] = []
+
+    def add(self, us: float):
+        i, v = 0, int(us)
+        while v and i < Histogram.NR_BUCKETS - 1:
+            v >>= 1
+            i += 1
+        self.buckets[i] += 1
+        self.samples.append(us)
+
+    def percentile(self, p: float) -> float:
+        s = sorted(self.samples)
+        return s[min(len(s) - 1, int(len(s) * p))]
+
+    def dump(self, out: TextIO):
+        out.write('\n== {} ==\n'.format(self.name))
+        if not self.samples:
+            out.write('no samples\n')
+            return
+        n = len(self.samples)
+        out.write('samples {}  avg {:.1f} us  max {:.1f} us\n'.format(
+            n, sum(self.samples) / n, max(self.samples)))
+        out.write('p50 {:.1f} us  p99 {:.1f} us  p99.9 {:.1f} us\n'.format(
+            self.percentile(0.5), self.percentile(0.99),
+            self.percentile(0.999)))
+        top = max(self.buckets)
+        for i, cnt in enumerate(self.buckets):
+            if not cnt:
+                continue
+            lo = 0 if i == 0 else 1 << (i - 1)
+            out.write('{:>20} {:>8} {}\n'.format(
+                '[{}, {})'.format(lo, 1 << i), cnt,
+                '#' * max(1, cnt * 40 // top)))
+
+
+def parse(log: TextIO):
+    ticks_per_us = 0
+    events: List[Event] = []
+    for line in log:
+        pos = line.find('SCHEDTRACE ')
+        if pos < 0:
+            continue
+        fields = line[pos:].split()
+        if fields[1] == 'ticks_per_us':
+            ticks_per_us = int(fields[2])
+            # Only the last dump is analyzed
+            events = []
+        elif fields[1] == 'end':
+            continue
+        elif len(fields) == 6:
+            events.append(Event(int(fields[1]), int(fields[2]), int(fields[3]),
+                                int(fields[4], 16), int(fields[5], 16)))
+    if not ticks_per_us:
+        sys.exit('no SCHEDTRACE dump found')
+    # Events of different CPUs are drained separately
+    events.sort(key=lambda ev: ev.tick)
+    return ticks_per_us, events
+
+
+class Analyzer:
+    def __init__(self, ticks_per_us: int, events: List[Event]):
+        self.ticks_per_us = ticks_per_us
+        self.events = events
+        self.base = events[0].tick if events else 0
+        self.wakeup = Histogram('wakeup-to-run latency (us)')
+        self.ipc = Histogram('IPC call-to-return latency (us)')
+        self.kstack = Histogram('kernel stack wait (us)')
+        self.counts: Dict[int, int] = defaultdict(int)
+        self.dropped = 0
+        self.chrome: List[dict] = []
+
+    def us(self, tick: int) -> float:
+        return (tick - self.base) / self.ticks_per_us
+
+    def run(self):
+        ready_since: Dict[int, int] = {}
+        ipc_stacks: Dict[int, List[int]] = defaultdict(list)
+        running: Dict[int, Optional[Event]] = {}
+        ipc_id = 0
+
+        for ev in self.events:
+            self.counts[ev.type] += 1
+            if ev.type == EV_ENQUEUE:
+                # Re-enqueueing (e.g., changing prio) keeps it ready
+                ready_since.setdefault(ev.tid, ev.tick)
+            elif ev.type == EV_SWITCH:
+                since = ready_since.pop(ev.tid, None)
+                if since is not None and ev.tid != IDLE_TID:
+                    self.wakeup.add((ev.tick - since) / self.ticks_per_us)
+                prev = running.get(ev.cpu)
+                if prev is not None and prev.tid != ev.tid:
+                    self.slice(prev, ev.tick)
+                if prev is None or prev.tid != ev.tid:
+                    running[ev.cpu] = ev
+            elif ev.type == EV_IPC_CALL:
+                ipc_stacks[ev.tid].append(ev.tick)
+                ipc_id += 1
+                self.chrome.append({
+                    'name': 'ipc {}'.format(tid_str(ev.arg)),
+                    'cat': 'ipc', 'ph': 'b', 'id': ipc_id,
+                    'pid': 'IPC', 'tid': tid_str(ev.tid),
+                    'ts': self.us(ev.tick)})
+                ipc_stacks[ev.tid].append(ipc_id)
+            elif ev.type == EV_IPC_RETURN:
+                stack = ipc_stacks.get(ev.arg)
+                if not stack:
+                    continue
+                call_id = stack.pop()
+                call_tick = stack.pop()
+                self.ipc.add((ev.tick - call_tick) / self.ticks_per_us)
+                self.chrome.append({
+                    'name': 'ipc {}'.format(tid_str(ev.tid)),
+                    'cat': 'ipc', 'ph': 'e', 'id': call_id,
+                    'pid': 'IPC', 'tid': tid_str(ev.arg),
+                    'ts': self.us(ev.tick)})
+            elif ev.type == EV_KSTACK_WAIT:
+                self.kstack.add(ev.arg / self.ticks_per_us)
+            elif ev.type == EV_DROPPED:
+                self.dropped += ev.arg
+
+            if ev.type not in (EV_SWITCH, EV_IPC_CALL, EV_IPC_RETURN):
+                self.chrome.append({
+                    'name': EV_NAMES[ev.type], 'cat': 'sched', 'ph': 'i',
+                    's': 't', 'pid': 'CPUs', 'tid': 'CPU{}'.format(ev.cpu),
+                    'ts': self.us(ev.tick),
+                    'args': {'thread': tid_str(ev.tid), 'arg': ev.arg}})
+
+        if self.events:
+            for prev in running.values():
+                self.slice(prev, self.events[-1].tick)
+
+    def slice(self, ev: Event, end: int):
+        self.chrome.append({
+            'name': tid_str(ev.tid), 'cat': 'run', 'ph': 'X',
+            'pid': 'CPUs', 'tid': 'CPU{}'.format(ev.cpu),
+            'ts': self.us(ev.tick), 'dur': (end - ev.tick) / self.ticks_per_us})
+
+    def report(self, out: TextIO):
+        if self.events:
+            out.write('{} events in {:.1f} ms, {} dropped\n'.format(
+                len(self.events), self.us(self.events[-1].tick) / 1000,
+                self.dropped))
+        out.write('  '.join('{} {}'.format(EV_NAMES[t], c)
+                            for t, c in sorted(self.counts.items())) + '\n')
+        self.wakeup.dump(out)
+        self.ipc.dump(out)
+        self.kstack.dump(out)
+        out.write('\nslow-path switches (target owns FPU of another CPU): {}\n'
+                  .format(self.counts[EV_SLOW_PATH]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('log', type=argparse.FileType('r', errors='replace'),
+                        help='console log with the output of sched_trace.bin')
+    parser.add_argument('-o', '--chrome', type=argparse.FileType('w'),
+                        help='write a Chrome trace (JSON) here')
+    args = parser.parse_args()
+
+    ticks_per_us, events = parse(args.log)
+    analyzer = Analyzer(ticks_per_us, events)
+    analyzer.run()
+    analyzer.report(sys.stdout)
+    if args.chrome:
+        json.dump({'traceEvents': analyzer.chrome,
+                   'displayTimeUnit': 'ns'}, args.chrome)
+
+
+if __name__ == '__main__':
+    main()
@@ -72,7 +72,7 @@ enum fs_req_type {
         FS_REQ_FSYNC,
         FS_REQ_FDATASYNC,
 
-        /* Test the page cache miss/hit count，disk I/O count . */
+        /* Get the counters of the server, see struct fs_perf_stat */
         FS_REQ_TEST_PERF,
 
         FS_REQ_MAX
@@ -221,9 +221,45 @@ struct fs_request {
                         char buf[FS_REQ_PATH_BUF_LEN];
                         size_t bufsiz;
                 } readlinkat;
+                struct {
+                        int cmd;
+                } test_perf;
         };
 };
 
+/* Commands of FS_REQ_TEST_PERF, each replies the counters */
+enum fs_perf_cmd {
+        FS_PERF_GET = 0,
+        /* Reset the counters and time the requests */
+        FS_PERF_START,
+        FS_PERF_STOP,
+};
+
+/*
+ * Counters of an FS server, written over the request of FS_REQ_TEST_PERF.
+ * Server time of a request is from its dispatch to its reply, the rest of
+ * the latency seen by the client is spent in IPC. Requests are only timed
+ * between FS_PERF_START and FS_PERF_STOP.
+ */
+struct fs_perf_stat {
+        unsigned long nr_reqs[FS_REQ_MAX];
+        unsigned long server_ns[FS_REQ_MAX];
+
+        /* Page cache, only used by some FSs */
+        unsigned long page_cache_hit;
+        unsigned long page_cache_miss;
+        unsigned long disk_read_bytes;
+        unsigned long disk_write_bytes;
+
+        /* Dentry cache */
+        unsigned long dcache_hit;
+        unsigned long dcache_negative_hit;
+        unsigned long dcache_miss;
+};
+
+/* Issue FS_REQ_TEST_PERF to the server of @fd, in libchcore */
+int chcore_fs_perf(int fd, enum fs_perf_cmd cmd, struct fs_perf_stat *stat);
+
 struct fsm_request {
         /* Request Type */
         enum fsm_req_type req;
@@ -245,6 +281,42 @@ struct fsm_request {
         int new_cap_flag;
 };
 
+/*
+ * Mount points added by FSM_REQ_MOUNT, in a page shared by all the clients
+ * (get the cap from procmgr by PROC_REQ_GET_MOUNT_TABLE_CAP). With it, clients
+ * resolve paths to mount points locally, the same way as fsm, and only ask fsm
+ * for the mount ids they do not know. "/" (tmpfs booted by fsm) is not listed.
+ *
+ * Only procmgr writes the table and the clients map it read-only. After fsm
+ * mounts or unmounts, the client asks procmgr by PROC_REQ_UPDATE_MOUNT_TABLE,
+ * and procmgr checks the change with fsm before applying it.
+ */
+#define FS_MOUNT_TABLE_MAX       8
+#define FS_MOUNT_SPECIAL_BUF_LEN 64
+#define FS_MOUNT_TABLE_SIZE      0x1000
+
+struct fs_mount_point {
+        char special[FS_MOUNT_SPECIAL_BUF_LEN];
+        char path[FS_REQ_PATH_BUF_LEN];
+        int path_len;
+};
+
+struct fs_mount_table {
+        /* Odd while being updated, readers retry if it changes under them */
+        unsigned long gen;
+        /* -1 after some mount point does not fit, so fsm must be asked */
+        int nr;
+        struct fs_mount_point mounts[FS_MOUNT_TABLE_MAX];
+};
+
+/*
+ * Update @table, mapped writable by procmgr, after fsm mounted @path or
+ * unmounted @special. In libchcore, the caller serializes them.
+ */
+int mount_table_add(struct fs_mount_table *table, const char *special,
+                    const char *path);
+int mount_table_remove(struct fs_mount_table *table, const char *special);
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,6 +14,8 @@
 #define PROCMGR_DEFS_H
 
 #include <chcore/ipc.h>
+#include <chcore-internal/fs_defs.h>
+#include <uapi/cpuset.h>
 #include <sys/types.h>
 
 #ifdef __cplusplus
@@ -33,6 +35,9 @@ enum PROC_REQ {
         PROC_REQ_SET_TERMINAL_CAP,
         PROC_REQ_KILL,
         PROC_REQ_GET_SYSTEM_INFO,
+        PROC_REQ_GET_MOUNT_TABLE_CAP,
+        PROC_REQ_SET_CPUSET,
+        PROC_REQ_UPDATE_MOUNT_TABLE,
         PROC_REQ_MAX
 };
 
@@ -105,6 +110,16 @@ struct proc_request {
                 struct {
                         pid_t pid;
                 } kill;
+                struct {
+                        char name[CPUSET_NAME_LEN];
+                        unsigned long mask;
+                } set_cpuset;
+                struct {
+                        /* 1 if @path is mounted, 0 if @special is unmounted */
+                        int mounted;
+                        char special[FS_MOUNT_SPECIAL_BUF_LEN];
+                        char path[FS_REQ_PATH_BUF_LEN];
+                } update_mount_table;
         };
 };
 
@@ -40,7 +40,7 @@ typedef struct ipc_struct {
         unsigned long shared_buf;
         unsigned long shared_buf_len;
 
-        /* A spin lock: used to coordinate the access to shared memory */
+        /* A chcore_lock: used to coordinate the access to shared memory */
         volatile int lock;
         enum system_server_identifier server_id;
 } ipc_struct_t;
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef CHCORE_LOCK_H
+#define CHCORE_LOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Locks for libchcore internals (and applications) which are cheaper than
+ * pthread_mutex_t and need no initialization besides zeroing.
+ *
+ * chcore_lock: an adaptive mutex on a plain int. The word is 0 when free, 1
+ * when locked, and 2 when locked with (possible) waiters. A contended locker
+ * spins for a while with exponential backoff, then parks on the word with
+ * FUTEX_WAIT. Unlocking only enters the kernel if the word was 2.
+ */
+
+void __chcore_lock_slow(volatile int *lk);
+void __chcore_unlock_slow(volatile int *lk);
+
+static inline void chcore_lock(volatile int *lk)
+{
+        int expected = 0;
+
+        if (__atomic_compare_exchange_n(lk, &expected, 1, 0, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED))
+                return;
+        __chcore_lock_slow(lk);
+}
+
+/* Return 0 on success, or -1 if the lock is held */
+static inline int chcore_trylock(volatile int *lk)
+{
+        int expected = 0;
+
+        return __atomic_compare_exchange_n(lk, &expected, 1, 0,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ?
+                       0 :
+                       -1;
+}
+
+static inline void chcore_unlock(volatile int *lk)
+{
+        if (__atomic_exchange_n(lk, 0, __ATOMIC_RELEASE) == 2)
+                __chcore_unlock_slow(lk);
+}
+
+/*
+ * Contention counters, summed over all locks of the process. Uncontended
+ * acquisitions are not counted, to keep the fast paths free of shared writes.
+ */
+struct chcore_lock_stat {
+        /* chcore_lock calls which missed the fast path */
+        unsigned long contended;
+        /* ... and then got the lock by spinning */
+        unsigned long spin_acquired;
+        /* FUTEX_WAIT calls made by lockers */
+        unsigned long futex_waits;
+        /* FUTEX_WAKE calls made by unlockers */
+        unsigned long futex_wakes;
+};
+
+void chcore_lock_get_stat(struct chcore_lock_stat *stat);
+void chcore_lock_reset_stat(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHCORE_LOCK_H */
@@ -16,6 +16,10 @@
 #include <chcore/type.h>
 #include <stdio.h>
 #include <chcore/memory.h>
+#include <uapi/lockstat.h>
+#include <uapi/sched_stat.h>
+#include <uapi/sched_trace.h>
+#include <uapi/cpuset.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -65,15 +69,28 @@ int usys_set_affinity(cap_t thread_cap, s32 aff);
 s32 usys_get_affinity(cap_t thread_cap);
 int usys_set_prio(cap_t thread_cap, int prio);
 int usys_get_prio(cap_t thread_cap);
+int usys_set_nice(cap_t cap, int nice);
+int usys_get_nice(cap_t cap);
+int usys_set_cpu_mask(cap_t thread_cap, unsigned long mask);
+long usys_get_cpu_mask(cap_t thread_cap);
+long usys_cpuset(int op, unsigned long arg0, unsigned long arg1);
 
 unsigned long usys_get_free_mem_size(void);
 void usys_get_mem_usage_msg(void);
+long usys_zswap_reclaim(void);
+int usys_zswap_get_stat(struct zswap_stat *stat);
+int usys_ksm_advise(unsigned long addr, size_t len, bool mergeable);
+long usys_ksm_scan(unsigned long nr_pages);
 void usys_empty_syscall(void);
 void usys_top(void);
+int usys_get_sched_stat(struct sched_stat_info *buf, unsigned long nr);
 
 int usys_user_fault_register(cap_t notific_cap, vaddr_t msg_buffer);
 int usys_user_fault_map(badge_t client_badge, vaddr_t fault_va,
                         vaddr_t remap_va, bool copy, vmr_prop_t perm);
+long usys_user_fault_map_batch(badge_t client_badge, vaddr_t fault_va,
+                               vaddr_t *remap_vas, unsigned long nr_pages,
+                               bool copy, vmr_prop_t perm);
 int usys_map_pmo_with_length(cap_t pmo_cap, vaddr_t addr, unsigned long perm,
                              size_t length);
 
@@ -105,6 +122,8 @@ void usys_poweroff(void);
 
 int usys_get_system_info(int op, void *ubuffer,
                          unsigned long size, long arg);
+int usys_get_lockstat(struct lockstat_info *buf, unsigned long nr, bool reset);
+long usys_sched_trace(int cmd, struct sched_trace_event *buf, unsigned long nr);
 
 int usys_ptrace(int req, unsigned long cap, unsigned long tid,
 		void *addr, void *data);
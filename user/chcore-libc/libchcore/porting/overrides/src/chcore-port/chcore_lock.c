@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <chcore/defs.h>
+#include <chcore/lock.h>
+#include <chcore/syscall.h>
+#include <syscall_arch.h>
+#include <raw_syscall.h>
+
+/* Same values as FUTEX_* in pthread_impl.h */
+#define LOCK_FUTEX_WAIT    0
+#define LOCK_FUTEX_WAKE    1
+#define LOCK_FUTEX_PRIVATE 128
+
+/* Rounds of spinning before parking, and the cap of one backoff round */
+#define LOCK_SPIN_ROUNDS  10
+#define LOCK_BACKOFF_MAX  1024
+
+static struct chcore_lock_stat lock_stat;
+
+#define stat_inc(field) \
+        __atomic_fetch_add(&lock_stat.field, 1, __ATOMIC_RELAXED)
+
+/*
+ * WFE cannot be used for waiting here: SCTLR_EL1.nTWE is clear, so WFE traps
+ * at EL0. YIELD is only a hint and never traps.
+ */
+static inline void cpu_relax(unsigned int n)
+{
+        while (n--)
+                __asm__ __volatile__("yield" ::: "memory");
+}
+
+void __chcore_lock_slow(volatile int *lk)
+{
+        unsigned int round, backoff = 1;
+        int c, expected;
+
+        stat_inc(contended);
+
+        for (round = 0; round < LOCK_SPIN_ROUNDS; round++) {
+                cpu_relax(backoff);
+                if (backoff < LOCK_BACKOFF_MAX)
+                        backoff <<= 1;
+                /* Do not spin once others have given up and parked */
+                c = __atomic_load_n(lk, __ATOMIC_RELAXED);
+                if (c == 2)
+                        break;
+                expected = 0;
+                if (c == 0
+                    && __atomic_compare_exchange_n(lk, &expected, 1, 0,
+                                                   __ATOMIC_ACQUIRE,
+                                                   __ATOMIC_RELAXED)) {
+                        stat_inc(spin_acquired);
+                        return;
+                }
+        }
+
+        /*
+         * Mark the lock as contended before sleeping. Getting it in this way
+         * leaves the word at 2 even if no one else waits, which only costs a
+         * spurious FUTEX_WAKE on unlock.
+         */
+        while ((c = __atomic_exchange_n(lk, 2, __ATOMIC_ACQUIRE)) != 0) {
+                stat_inc(futex_waits);
+                chcore_syscall6(CHCORE_SYS_futex,
+                                (long)lk,
+                                LOCK_FUTEX_WAIT | LOCK_FUTEX_PRIVATE,
+                                2,
+                                0,
+                                0,
+                                0);
+        }
+}
+
+void __chcore_unlock_slow(volatile int *lk)
+{
+        stat_inc(futex_wakes);
+        chcore_syscall6(CHCORE_SYS_futex,
+                        (long)lk,
+                        LOCK_FUTEX_WAKE | LOCK_FUTEX_PRIVATE,
+                        1,
+                        0,
+                        0,
+                        0);
+}
+
+void chcore_lock_get_stat(struct chcore_lock_stat *stat)
+{
+        stat->contended = __atomic_load_n(&lock_stat.contended, __ATOMIC_RELAXED);
+        stat->spin_acquired =
+                __atomic_load_n(&lock_stat.spin_acquired, __ATOMIC_RELAXED);
+        stat->futex_waits =
+                __atomic_load_n(&lock_stat.futex_waits, __ATOMIC_RELAXED);
+        stat->futex_wakes =
+                __atomic_load_n(&lock_stat.futex_wakes, __ATOMIC_RELAXED);
+}
+
+void chcore_lock_reset_stat(void)
+{
+        __atomic_store_n(&lock_stat.contended, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&lock_stat.spin_acquired, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&lock_stat.futex_waits, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&lock_stat.futex_wakes, 0, __ATOMIC_RELAXED);
+}
@@ -22,7 +22,7 @@
 #include <chcore/services.h>
 #include <stdlib.h>
 #include <pthread.h>
-#include <debug_lock.h>
+#include <chcore/lock.h>
 #include <errno.h>
 
 #include "chcore_shm.h"
@@ -49,12 +49,12 @@ int chcore_shmget(key_t key, size_t size, int flag)
         int ret;
 
         /* If already connected to shmmgr, skip connection */
-        chcore_spin_lock(&connect_shmmgr_lock);
+        chcore_lock(&connect_shmmgr_lock);
         if (!shmmgr_ipc_struct) {
                 // printf("connect_to_shmmgr\n");
                 shmmgr_ipc_struct = chcore_conn_srv(SERVER_SYSTEMV_SHMMGR);
         }
-        chcore_spin_unlock(&connect_shmmgr_lock);
+        chcore_unlock(&connect_shmmgr_lock);
 
         /* Send IPC to shmmgr to get shm_cap */
         shm_msg = ipc_create_msg(
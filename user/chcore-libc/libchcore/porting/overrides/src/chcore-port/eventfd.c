@@ -11,7 +11,7 @@
  */
 
 #include <atomic.h>
-#include <debug_lock.h>
+#include <chcore/lock.h>
 #include <errno.h>
 #include <poll.h>
 #include <stdbool.h>
@@ -104,7 +104,7 @@ static ssize_t chcore_eventfd_read(int fd, void *buf, size_t count)
         int ret = 0;
 
         while (1) {
-                chcore_spin_lock(&efdp->efd_lock);
+                chcore_lock(&efdp->efd_lock);
 
                 /* Fast Path */
                 if ((val = efdp->efd_val) != 0) {
@@ -149,7 +149,7 @@ static ssize_t chcore_eventfd_read(int fd, void *buf, size_t count)
                 /* going to wait notific */
                 BUG_ON(efdp->reader_waiter_cnt == 0xffffffffffffffff);
                 efdp->reader_waiter_cnt++;
-                chcore_spin_unlock(&efdp->efd_lock);
+                chcore_unlock(&efdp->efd_lock);
 
                 ret = chcore_syscall3(
                         CHCORE_SYS_wait, efdp->reader_notifc_cap, true, 0);
@@ -157,7 +157,7 @@ static ssize_t chcore_eventfd_read(int fd, void *buf, size_t count)
         }
 
 out:
-        chcore_spin_unlock(&efdp->efd_lock);
+        chcore_unlock(&efdp->efd_lock);
         return ret;
 }
 
@@ -177,7 +177,7 @@ static ssize_t chcore_eventfd_write(int fd, void *buf, size_t count)
 
         while (1) {
                 /* Should wait until all value has written */
-                chcore_spin_lock(&efdp->efd_lock);
+                chcore_lock(&efdp->efd_lock);
                 /* Fast Path */
                 if (*(uint64_t *)buf < 0xffffffffffffffff - efdp->efd_val) {
                         efdp->efd_val += *(uint64_t *)buf;
@@ -217,7 +217,7 @@ static ssize_t chcore_eventfd_write(int fd, void *buf, size_t count)
                 /* going to wait notific */
                 BUG_ON(efdp->writer_waiter_cnt == 0xffffffffffffffff);
                 efdp->writer_waiter_cnt++;
-                chcore_spin_unlock(&efdp->efd_lock);
+                chcore_unlock(&efdp->efd_lock);
 
                 ret = chcore_syscall3(
                         CHCORE_SYS_wait, efdp->writer_notifc_cap, true, 0);
@@ -225,7 +225,7 @@ static ssize_t chcore_eventfd_write(int fd, void *buf, size_t count)
         }
 
 out:
-        chcore_spin_unlock(&efdp->efd_lock);
+        chcore_unlock(&efdp->efd_lock);
         return ret;
 }
 
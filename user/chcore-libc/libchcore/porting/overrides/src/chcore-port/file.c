@@ -118,14 +118,25 @@ static int generate_full_path(int dirfd, const char *path, char **full_path_out)
  * [OUT] server_path: is the path sending to fs_server,
  * 		removing the prefix of mount_point from `full_path`
  * return: 0 for success, -1 for some error
+ *
+ * FSM is only asked if the mount point is not in the mount table cache.
  */
 static inline int parse_full_path(char *full_path, int *mount_id,
                                   char *server_path)
 {
         ipc_msg_t *ipc_msg;
         struct fsm_request *fsm_req;
+        unsigned long gen;
+        int mount_path_len;
         int ret = 0;
 
+        *mount_id = mount_cache_lookup(full_path, &mount_path_len, &gen);
+        if (*mount_id >= 0)
+                return pathcpy(server_path,
+                               FS_REQ_PATH_BUF_LEN,
+                               full_path + mount_path_len,
+                               strlen(full_path + mount_path_len));
+
         ipc_msg = ipc_create_msg(fsm_ipc_struct, sizeof(*fsm_req));
         if (ipc_msg == NULL) {
                 return -1;
@@ -136,10 +147,12 @@ static inline int parse_full_path(char *full_path, int *mount_id,
                 goto out;
         }
         *mount_id = fsm_req->mount_id;
+        mount_path_len = fsm_req->mount_path_len;
+        mount_cache_fill(full_path, *mount_id, mount_path_len, gen);
         if (pathcpy(server_path,
                     FS_REQ_PATH_BUF_LEN,
-                    full_path + fsm_req->mount_path_len,
-                    strlen(full_path + fsm_req->mount_path_len))
+                    full_path + mount_path_len,
+                    strlen(full_path + mount_path_len))
             != 0) {
                 ret = -1;
                 goto out;
@@ -827,6 +840,35 @@ int chcore_fdatasync(int fd)
         return ret;
 }
 
+int chcore_fs_perf(int fd, enum fs_perf_cmd cmd, struct fs_perf_stat *stat)
+{
+        ipc_msg_t *ipc_msg;
+        ipc_struct_t *_fs_ipc_struct;
+        struct fd_record_extension *fd_ext;
+        struct fs_request *fr_ptr;
+        int ret;
+
+        if (fd_not_exists(fd))
+                return -EBADF;
+
+        fd_ext = (struct fd_record_extension *)fd_dic[fd]->private_data;
+
+        _fs_ipc_struct = get_ipc_struct_by_mount_id(fd_ext->mount_id);
+        /* The counters are replied over the request */
+        ipc_msg = ipc_create_msg(_fs_ipc_struct, IPC_SHM_AVAILABLE);
+        fr_ptr = (struct fs_request *)ipc_get_msg_data(ipc_msg);
+
+        fr_ptr->req = FS_REQ_TEST_PERF;
+        fr_ptr->test_perf.cmd = cmd;
+
+        ret = ipc_call(_fs_ipc_struct, ipc_msg);
+        if (ret == 0 && stat)
+                memcpy(stat, ipc_get_msg_data(ipc_msg), sizeof(*stat));
+        ipc_destroy_msg(ipc_msg);
+
+        return ret;
+}
+
 /* When open we need to alloco fd number first and call to fs server */
 int chcore_openat(int dirfd, const char *pathname, int flags, mode_t mode)
 {
@@ -1209,6 +1251,8 @@ int chcore_mount(const char *special, const char *dir, const char *fstype,
         ret = ipc_call(fsm_ipc_struct, ipc_msg);
         ipc_destroy_msg(ipc_msg);
 
+        if (ret >= 0)
+                mount_table_publish(1, special, dir);
         return ret;
 }
 
@@ -1225,7 +1269,7 @@ int chcore_umount(const char *special)
         ipc_msg = ipc_create_msg_with_cap(fsm_ipc_struct, sizeof(struct fsm_request), 1);
         fsm_req = (struct fsm_request *)ipc_get_msg_data(ipc_msg);
 
-        fsm_req->req = FS_REQ_UMOUNT;
+        fsm_req->req = FSM_REQ_UMOUNT;
 
         /* fs_req_data->path = special (device_name) */
         if (pathcpy(fsm_req->path, FS_REQ_PATH_BUF_LEN, special, strlen(special))
@@ -1238,6 +1282,8 @@ int chcore_umount(const char *special)
         ret = ipc_call(fsm_ipc_struct, ipc_msg);
         ipc_destroy_msg(ipc_msg);
 
+        if (ret >= 0)
+                mount_table_publish(0, special, "");
         return ret;
 }
 
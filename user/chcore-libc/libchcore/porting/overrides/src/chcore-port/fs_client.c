@@ -21,6 +21,9 @@
 #include <string.h>
 #include <chcore-internal/fs_debug.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <chcore/memory.h>
+#include <chcore-internal/procmgr_defs.h>
 
 #include "fs_client_defs.h"
 
@@ -238,6 +241,318 @@ struct fsm_request *fsm_parse_path_forward(ipc_msg_t *ipc_msg,
         return fsm_req;
 }
 
+/* +++++++++++++++++++++++++ Mount Table Cache +++++++++++++++++++++++++++++ */
+
+/* Shared by all the processes, NULL if not available */
+static struct fs_mount_table *mount_table;
+static pthread_once_t mount_table_once = PTHREAD_ONCE_INIT;
+
+struct mount_cache_entry {
+        char path[FS_REQ_PATH_BUF_LEN];
+        int path_len;
+        /* -1 until learned from fsm */
+        int mount_id;
+};
+
+/*
+ * The mount points in mount_table of generation gen, and "/" in mounts[0].
+ * nr is 0 when fsm has to be asked for all the paths.
+ */
+static struct {
+        pthread_rwlock_t lock;
+        unsigned long gen;
+        int nr;
+        struct mount_cache_entry mounts[FS_MOUNT_TABLE_MAX + 1];
+} mount_cache = {
+        .lock = PTHREAD_RWLOCK_INITIALIZER,
+        /* Not a valid generation, to fill it at the first lookup */
+        .gen = 1,
+};
+
+cap_t __get_mount_table_cap(void)
+{
+        ipc_msg_t *ipc_msg;
+        struct proc_request *pr;
+        cap_t cap;
+        int ret;
+
+        ipc_msg = ipc_create_msg(procmgr_ipc_struct,
+                                 sizeof(struct proc_request));
+        if (ipc_msg == NULL)
+                return -1;
+        pr = (struct proc_request *)ipc_get_msg_data(ipc_msg);
+        pr->req = PROC_REQ_GET_MOUNT_TABLE_CAP;
+
+        ret = ipc_call(procmgr_ipc_struct, ipc_msg);
+        cap = ret < 0 ? ret : ipc_get_msg_cap(ipc_msg, 0);
+        ipc_destroy_msg(ipc_msg);
+        return cap;
+}
+/* Overridden by procmgr, which owns the table */
+weak_alias(__get_mount_table_cap, get_mount_table_cap);
+
+static void map_mount_table(void)
+{
+        cap_t cap;
+
+        cap = get_mount_table_cap();
+        if (cap < 0)
+                return;
+        /* Only procmgr writes it, see mount_table_add() */
+        mount_table = chcore_auto_map_pmo(cap, FS_MOUNT_TABLE_SIZE, PROT_READ);
+}
+
+static struct fs_mount_table *get_mount_table(void)
+{
+        pthread_once(&mount_table_once, map_mount_table);
+        return mount_table;
+}
+
+/*
+ * Copy the mount points in mount_table to mount_cache, with mount_cache.lock
+ * held for writing. Returns -1 if mount_table is being updated.
+ */
+static int mount_cache_refill(void)
+{
+        struct mount_cache_entry *entry;
+        struct fs_mount_point *mp;
+        unsigned long gen;
+        int i, nr;
+
+        gen = __atomic_load_n(&mount_table->gen, __ATOMIC_ACQUIRE);
+        if (gen & 1)
+                return -1;
+
+        nr = mount_table->nr;
+        if (nr < 0 || nr > FS_MOUNT_TABLE_MAX)
+                nr = -1;
+        for (i = 0; i < nr; i++) {
+                mp = &mount_table->mounts[i];
+                entry = &mount_cache.mounts[i + 1];
+                memcpy(entry->path, mp->path, FS_REQ_PATH_BUF_LEN);
+                entry->path[FS_REQ_PATH_LEN] = '\0';
+                entry->path_len = mp->path_len;
+                entry->mount_id = -1;
+                if (entry->path_len <= 0
+                    || entry->path_len != strlen(entry->path))
+                        nr = -1;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&mount_table->gen, __ATOMIC_RELAXED) != gen)
+                return -1;
+
+        strcpy(mount_cache.mounts[0].path, "/");
+        mount_cache.mounts[0].path_len = 1;
+        mount_cache.mounts[0].mount_id = -1;
+        mount_cache.nr = nr + 1;
+        mount_cache.gen = gen;
+        return 0;
+}
+
+/*
+ * Returns the index in mount_cache.mounts of the mount point of @full_path,
+ * which is the longest one matching whole path components, as in fsm.
+ */
+static int mount_cache_match(const char *full_path)
+{
+        int i, len, path_len, best = -1, best_len = 0;
+
+        path_len = strlen(full_path);
+        for (i = 0; i < mount_cache.nr; i++) {
+                len = mount_cache.mounts[i].path_len;
+                if (len <= best_len || len > path_len)
+                        continue;
+                if (!(len == 1 && full_path[0] == '/')) {
+                        if (strncmp(mount_cache.mounts[i].path, full_path, len)
+                            != 0)
+                                continue;
+                        if (len != path_len && full_path[len] != '/')
+                                continue;
+                }
+                best = i;
+                best_len = len;
+        }
+        return best;
+}
+
+/*
+ * Find the mount point of @full_path without asking fsm.
+ * Returns the mount id, or -1 if fsm has to be asked, then @gen is set for
+ * mount_cache_fill().
+ */
+int mount_cache_lookup(const char *full_path, int *mount_path_len,
+                       unsigned long *gen)
+{
+        struct mount_cache_entry *entry;
+        unsigned long cur;
+        int i, mount_id = -1;
+
+        *gen = 1;
+        if (get_mount_table() == NULL)
+                return -1;
+
+        cur = __atomic_load_n(&mount_table->gen, __ATOMIC_ACQUIRE);
+        pthread_rwlock_rdlock(&mount_cache.lock);
+        if (mount_cache.gen != cur) {
+                pthread_rwlock_unlock(&mount_cache.lock);
+                pthread_rwlock_wrlock(&mount_cache.lock);
+                if (mount_cache.gen != cur && mount_cache_refill() != 0) {
+                        pthread_rwlock_unlock(&mount_cache.lock);
+                        return -1;
+                }
+        }
+
+        i = mount_cache_match(full_path);
+        if (i >= 0) {
+                entry = &mount_cache.mounts[i];
+                mount_id = entry->mount_id;
+                *mount_path_len = entry->path_len;
+        }
+        *gen = mount_cache.gen;
+        pthread_rwlock_unlock(&mount_cache.lock);
+        return mount_id;
+}
+
+/* Record the mount point of @full_path told by fsm after a lookup miss */
+void mount_cache_fill(const char *full_path, int mount_id, int mount_path_len,
+                      unsigned long gen)
+{
+        int i;
+
+        if (mount_table == NULL || mount_id < 0 || mount_id >= MAX_MOUNT_ID)
+                return;
+
+        pthread_rwlock_wrlock(&mount_cache.lock);
+        /* The table may have changed while asking fsm */
+        if (mount_cache.gen != gen
+            || __atomic_load_n(&mount_table->gen, __ATOMIC_ACQUIRE) != gen)
+                goto out;
+
+        i = mount_cache_match(full_path);
+        if (i >= 0 && mount_cache.mounts[i].path_len == mount_path_len) {
+                mount_cache.mounts[i].mount_id = mount_id;
+        } else {
+                /* Mounted without updating the table, stop trusting it */
+                mount_cache.nr = 0;
+        }
+out:
+        pthread_rwlock_unlock(&mount_cache.lock);
+}
+
+/*
+ * Ask procmgr, which owns mount_table, to update it after fsm mounted @path
+ * (@mounted is 1) or unmounted @special (@mounted is 0)
+ */
+void mount_table_publish(int mounted, const char *special, const char *path)
+{
+        ipc_msg_t *ipc_msg;
+        struct proc_request *pr;
+
+        if (strlen(special) >= FS_MOUNT_SPECIAL_BUF_LEN
+            || strlen(path) > FS_REQ_PATH_LEN)
+                return;
+
+        ipc_msg = ipc_create_msg(procmgr_ipc_struct,
+                                 sizeof(struct proc_request));
+        if (ipc_msg == NULL)
+                return;
+        pr = (struct proc_request *)ipc_get_msg_data(ipc_msg);
+        pr->req = PROC_REQ_UPDATE_MOUNT_TABLE;
+        pr->update_mount_table.mounted = mounted;
+        strcpy(pr->update_mount_table.special, special);
+        strcpy(pr->update_mount_table.path, path);
+
+        /* The clients only fall back to fsm if it fails */
+        ipc_call(procmgr_ipc_struct, ipc_msg);
+        ipc_destroy_msg(ipc_msg);
+}
+
+/* Whether fsm resolves @path to the mount point @path itself */
+static bool fsm_is_mount_point(const char *path)
+{
+        ipc_msg_t *ipc_msg;
+        struct fsm_request *fsm_req;
+        bool ret;
+
+        ipc_msg = ipc_create_msg(fsm_ipc_struct, sizeof(struct fsm_request));
+        if (ipc_msg == NULL)
+                return false;
+        fsm_req = fsm_parse_path_forward(ipc_msg, path);
+        ret = fsm_req != NULL && fsm_req->mount_path_len == strlen(path)
+              && strncmp(fsm_req->mount_path, path, fsm_req->mount_path_len)
+                         == 0;
+        ipc_destroy_msg(ipc_msg);
+        return ret;
+}
+
+static void mount_table_begin_update(struct fs_mount_table *table)
+{
+        __atomic_store_n(&table->gen, table->gen + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void mount_table_end_update(struct fs_mount_table *table)
+{
+        __atomic_store_n(&table->gen, table->gen + 1, __ATOMIC_RELEASE);
+}
+
+int mount_table_add(struct fs_mount_table *table, const char *special,
+                    const char *path)
+{
+        struct fs_mount_point *mp;
+        int i;
+
+        /* Requested by any client, so believe fsm only */
+        if (!fsm_is_mount_point(path))
+                return -EINVAL;
+
+        mount_table_begin_update(table);
+        if (table->nr < 0)
+                goto out;
+        for (i = 0; i < table->nr; i++) {
+                if (strcmp(table->mounts[i].path, path) == 0)
+                        break;
+        }
+        if (i == FS_MOUNT_TABLE_MAX
+            || strlen(special) >= FS_MOUNT_SPECIAL_BUF_LEN
+            || strlen(path) > FS_REQ_PATH_LEN) {
+                /* Not listed, so the clients have to ask fsm from now on */
+                table->nr = -1;
+                goto out;
+        }
+        mp = &table->mounts[i];
+        strcpy(mp->special, special);
+        strcpy(mp->path, path);
+        mp->path_len = strlen(path);
+        if (i == table->nr)
+                table->nr++;
+out:
+        mount_table_end_update(table);
+        return 0;
+}
+
+int mount_table_remove(struct fs_mount_table *table, const char *special)
+{
+        int i, last;
+
+        for (i = 0; i < table->nr; i++) {
+                if (strcmp(table->mounts[i].special, special) == 0)
+                        break;
+        }
+        if (i >= table->nr)
+                return -ENOENT;
+        /* Still mounted as fsm says, so the request is bogus */
+        if (fsm_is_mount_point(table->mounts[i].path))
+                return -EBUSY;
+
+        mount_table_begin_update(table);
+        last = --table->nr;
+        table->mounts[i] = table->mounts[last];
+        mount_table_end_update(table);
+        return 0;
+}
+
 /* ++++++++++++++++++++++++++++++++ Others +++++++++++++++++++++++++++++++++ */
 
 void init_fs_client_side(void)
@@ -66,6 +66,16 @@ char *get_server_path(char *full_path, int full_len, char *mount_path,
 struct fsm_request *fsm_parse_path_forward(ipc_msg_t *ipc_msg,
                                            const char *full_path);
 
+/* ++++++++++++++++++++++++ Mount Table Cache +++++++++++++++++++++++++++ */
+
+/* Weak, procmgr overrides it as it creates the table */
+cap_t get_mount_table_cap(void);
+int mount_cache_lookup(const char *full_path, int *mount_path_len,
+                       unsigned long *gen);
+void mount_cache_fill(const char *full_path, int mount_id, int mount_path_len,
+                      unsigned long gen);
+void mount_table_publish(int mounted, const char *special, const char *path);
+
 /* ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
 void init_fs_client_side(void);
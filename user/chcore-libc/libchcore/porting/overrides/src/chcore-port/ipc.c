@@ -27,7 +27,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <chcore/bug.h>
-#include <debug_lock.h>
+#include <chcore/lock.h>
 #include <errno.h>
 #include <assert.h>
 #include "pthread_impl.h"
@@ -104,7 +104,7 @@ ipc_msg_t *ipc_create_msg_with_cap(ipc_struct_t *icb, unsigned int data_len,
         }
 
         /* Grab the ipc lock before setting ipc msg */
-        chcore_spin_lock(&(icb->lock));
+        chcore_lock(&(icb->lock));
 
         buf_len = icb->shared_buf_len;
 
@@ -136,7 +136,7 @@ ipc_msg_t *ipc_create_msg_with_cap(ipc_struct_t *icb, unsigned int data_len,
                   
         return ipc_msg;
 out_unlock:
-        chcore_spin_unlock(&(icb->lock));
+        chcore_unlock(&(icb->lock));
         return NULL;
 }
 
@@ -221,7 +221,7 @@ void ipc_set_msg_return_cap_num(ipc_msg_t *ipc_msg, unsigned int cap_num)
 int ipc_destroy_msg(ipc_msg_t *ipc_msg)
 {
         /* Release the ipc lock */
-        chcore_spin_unlock(&(ipc_msg->icb->lock));
+        chcore_unlock(&(ipc_msg->icb->lock));
 
         free(ipc_msg);
 
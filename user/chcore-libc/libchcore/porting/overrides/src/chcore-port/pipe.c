@@ -19,7 +19,7 @@
 #include <chcore/pthread.h>
 #include <string.h>
 #include <pthread.h>
-#include <debug_lock.h>
+#include <chcore/lock.h>
 #include "atomic.h"
 
 #include "pipe.h"
@@ -181,7 +181,7 @@ static long chcore_pipe_read_local(int fd, void *buf, long count)
                 return -EINVAL;
 
         pf = fd_dic[fd]->private_data;
-        chcore_spin_lock(&pf->pipe_lock);
+        chcore_lock(&pf->pipe_lock);
         if (pf->read_fd != fd) {
                 r = -EINVAL;
                 goto out_unlock;
@@ -208,7 +208,7 @@ static long chcore_pipe_read_local(int fd, void *buf, long count)
         }
 
 out_unlock:
-        chcore_spin_unlock(&pf->pipe_lock);
+        chcore_unlock(&pf->pipe_lock);
         return r;
 }
 
@@ -245,7 +245,7 @@ static long chcore_pipe_write_local(int fd, void *buf, long count)
                 return -EINVAL;
 
         pf = fd_dic[fd]->private_data;
-        chcore_spin_lock(&pf->pipe_lock);
+        chcore_lock(&pf->pipe_lock);
         if (pf->write_fd != fd) {
                 r = -EINVAL;
                 goto out_unlock;
@@ -273,7 +273,7 @@ static long chcore_pipe_write_local(int fd, void *buf, long count)
         }
 
 out_unlock:
-        chcore_spin_unlock(&pf->pipe_lock);
+        chcore_unlock(&pf->pipe_lock);
         return r;
 }
 
@@ -123,7 +123,7 @@ int chcore_epoll_ctl(int epfd, int op, int fd, struct epoll_event *events)
         if (fd_dic[fd]->fd_op == NULL)
                 return -EPERM;
 
-        chcore_spin_lock(&ep->epi_lock);
+        chcore_lock(&ep->epi_lock);
         switch (op) {
         case EPOLL_CTL_ADD:
                 /* Check if already exist */
@@ -185,7 +185,7 @@ int chcore_epoll_ctl(int epfd, int op, int fd, struct epoll_event *events)
         }
 
 out:
-        chcore_spin_unlock(&ep->epi_lock);
+        chcore_unlock(&ep->epi_lock);
         return ret;
 }
 
@@ -222,17 +222,17 @@ int chcore_epoll_pwait(int epfd, struct epoll_event *events, int maxevents,
         if (sigmask)
                 pthread_sigmask(SIG_SETMASK, sigmask, &origmask);
 
-        chcore_spin_lock(&ep->epi_lock);
+        chcore_lock(&ep->epi_lock);
         if ((fds = (struct pollfd *)malloc(ep->wait_count * sizeof(*fds)))
             == NULL) {
-                chcore_spin_unlock(&ep->epi_lock);
+                chcore_unlock(&ep->epi_lock);
                 return -ENOMEM;
         }
         if ((epdata = (epoll_data_t *)malloc(ep->wait_count
                                              * sizeof(epoll_data_t)))
             == NULL) {
                 free(fds);
-                chcore_spin_unlock(&ep->epi_lock);
+                chcore_unlock(&ep->epi_lock);
                 return -ENOMEM;
         }
 
@@ -256,7 +256,7 @@ int chcore_epoll_pwait(int epfd, struct epoll_event *events, int maxevents,
                 epdata[nfds] = epi->event.data;
                 nfds++;
         }
-        chcore_spin_unlock(&ep->epi_lock);
+        chcore_unlock(&ep->epi_lock);
 
         ret = chcore_poll(fds, nfds, timeout);
         if (ret > 0) {
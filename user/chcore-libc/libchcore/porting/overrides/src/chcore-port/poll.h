@@ -13,7 +13,7 @@
 #ifndef CHCORE_PORT_POLL_H
 #define CHCORE_PORT_POLL_H
 
-#include <debug_lock.h>
+#include <chcore/lock.h>
 #include <errno.h>
 #include <poll.h>
 #include <signal.h>
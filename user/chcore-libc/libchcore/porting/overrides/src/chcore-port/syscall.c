@@ -105,6 +105,31 @@ int usys_get_prio(cap_t thread_cap)
         return chcore_syscall1(CHCORE_SYS_get_prio, thread_cap);
 }
 
+int usys_set_nice(cap_t cap, int nice)
+{
+        return chcore_syscall2(CHCORE_SYS_set_nice, cap, (unsigned long)nice);
+}
+
+int usys_get_nice(cap_t cap)
+{
+        return chcore_syscall1(CHCORE_SYS_get_nice, cap);
+}
+
+int usys_set_cpu_mask(cap_t thread_cap, unsigned long mask)
+{
+        return chcore_syscall2(CHCORE_SYS_set_cpu_mask, thread_cap, mask);
+}
+
+long usys_get_cpu_mask(cap_t thread_cap)
+{
+        return chcore_syscall1(CHCORE_SYS_get_cpu_mask, thread_cap);
+}
+
+long usys_cpuset(int op, unsigned long arg0, unsigned long arg1)
+{
+        return chcore_syscall3(CHCORE_SYS_cpuset, op, arg0, arg1);
+}
+
 int usys_get_phys_addr(void *vaddr, unsigned long *paddr)
 {
         return chcore_syscall2(CHCORE_SYS_get_phys_addr,
@@ -215,6 +240,12 @@ void usys_top(void)
         chcore_syscall0(CHCORE_SYS_top);
 }
 
+int usys_get_sched_stat(struct sched_stat_info *buf, unsigned long nr)
+{
+        return chcore_syscall2(
+                CHCORE_SYS_get_sched_stat, (unsigned long)buf, nr);
+}
+
 int usys_user_fault_register(cap_t notific_cap, vaddr_t msg_buffer)
 {
         return chcore_syscall2(
@@ -232,6 +263,19 @@ int usys_user_fault_map(badge_t client_badge, vaddr_t fault_va,
                                perm);
 }
 
+long usys_user_fault_map_batch(badge_t client_badge, vaddr_t fault_va,
+                               vaddr_t *remap_vas, unsigned long nr_pages,
+                               bool copy, vmr_prop_t perm)
+{
+        return chcore_syscall6(CHCORE_SYS_user_fault_map_batch,
+                               client_badge,
+                               fault_va,
+                               (unsigned long)remap_vas,
+                               nr_pages,
+                               copy,
+                               perm);
+}
+
 int usys_map_pmo_with_length(cap_t pmo_cap, vaddr_t addr, unsigned long perm,
                              size_t length)
 {
@@ -335,6 +379,26 @@ void usys_get_mem_usage_msg(void)
         chcore_syscall0(CHCORE_SYS_get_mem_usage_msg);
 }
 
+long usys_zswap_reclaim(void)
+{
+        return chcore_syscall0(CHCORE_SYS_zswap_reclaim);
+}
+
+int usys_zswap_get_stat(struct zswap_stat *stat)
+{
+        return chcore_syscall1(CHCORE_SYS_zswap_get_stat, (unsigned long)stat);
+}
+
+int usys_ksm_advise(unsigned long addr, size_t len, bool mergeable)
+{
+        return chcore_syscall3(CHCORE_SYS_ksm_advise, addr, len, mergeable);
+}
+
+long usys_ksm_scan(unsigned long nr_pages)
+{
+        return chcore_syscall1(CHCORE_SYS_ksm_scan, nr_pages);
+}
+
 int usys_cache_flush(unsigned long start, unsigned long size, int op_type)
 {
         return chcore_syscall3(CHCORE_SYS_cache_flush, start, size, op_type);
@@ -363,6 +427,18 @@ int usys_get_system_info(int op, void *ubuffer,
                                size, arg);
 }
 
+int usys_get_lockstat(struct lockstat_info *buf, unsigned long nr, bool reset)
+{
+        return chcore_syscall3(CHCORE_SYS_get_lockstat, (unsigned long)buf,
+                               nr, reset);
+}
+
+long usys_sched_trace(int cmd, struct sched_trace_event *buf, unsigned long nr)
+{
+        return chcore_syscall3(CHCORE_SYS_sched_trace, cmd,
+                               (unsigned long)buf, nr);
+}
+
 int usys_ptrace(int req, unsigned long cap, unsigned long tid,
                 void *addr, void *data)
 {
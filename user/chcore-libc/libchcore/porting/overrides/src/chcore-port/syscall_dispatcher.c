@@ -361,10 +361,11 @@ long __syscall1(long n, long a)
                 printf("[libc] error: process_exit should never return.\n");
                 return 0;
         case SYS_set_tid_address: {
-                /* TODO: use the impl of oh-tee */
-                chcore_syscall1(CHCORE_SYS_set_tid_address, a);
-                static long fake_tid_val = 10086;
-                return fake_tid_val++;
+                /*
+                 * The TID is the thread cap in its own cap_group, which is
+                 * the owner TID of PI futexes as well.
+                 */
+                return chcore_syscall1(CHCORE_SYS_set_tid_address, a);
         }
         case SYS_brk:
                 /*
@@ -634,6 +635,9 @@ long __syscall3(long n, long a, long b, long c)
                 return 0;
         }
         case SYS_madvise: {
+                /* madvise: @a addr, @b len, @c advice */
+                if (c == MADV_MERGEABLE || c == MADV_UNMERGEABLE)
+                        return usys_ksm_advise(a, b, c == MADV_MERGEABLE);
                 warn_once("SYS_madvise is not implemented.\n");
                 return 0;
         }
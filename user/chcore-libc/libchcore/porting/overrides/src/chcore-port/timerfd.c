@@ -23,6 +23,7 @@
 
 #include <chcore/bug.h>
 #include <chcore/syscall.h>
+#include <chcore/lock.h>
 
 struct timer_file {
         struct itimerspec it;
@@ -123,7 +124,7 @@ int chcore_timerfd_settime(int fd, int flags, struct itimerspec *new_value,
         }
 
         timer_file = fd_dic[fd]->private_data;
-        chcore_spin_lock(&timer_file->timer_lock);
+        chcore_lock(&timer_file->timer_lock);
         /* Passing the old_value */
         if (old_value) {
                 old_value->it_interval = timer_file->it.it_interval;
@@ -143,7 +144,7 @@ int chcore_timerfd_settime(int fd, int flags, struct itimerspec *new_value,
                         timer_file->it.it_value =
                                 ns_to_timespec(cur_ns + val_ns);
         }
-        chcore_spin_unlock(&timer_file->timer_lock);
+        chcore_unlock(&timer_file->timer_lock);
         return 0;
 }
 
@@ -168,7 +169,7 @@ int chcore_timerfd_gettime(int fd, struct itimerspec *curr_value)
 
         timer_file = fd_dic[fd]->private_data;
 
-        chcore_spin_lock(&timer_file->timer_lock);
+        chcore_lock(&timer_file->timer_lock);
         curr_value->it_interval = timer_file->it.it_interval;
         if (timer_file->it.it_value.tv_sec == 0
             && timer_file->it.it_value.tv_nsec == 0) {
@@ -192,7 +193,7 @@ int chcore_timerfd_gettime(int fd, struct itimerspec *curr_value)
                                 interval_ns - (cur_ns - val_ns) % interval_ns;
                 curr_value->it_value = ns_to_timespec(remain_ns);
         }
-        chcore_spin_unlock(&timer_file->timer_lock);
+        chcore_unlock(&timer_file->timer_lock);
         return 0;
 }
 
@@ -218,12 +219,12 @@ static ssize_t chcore_timerfd_read(int fd, void *buf, size_t count)
                 return -EINVAL;
 
         timer_file = fd_dic[fd]->private_data;
-        chcore_spin_lock(&timer_file->timer_lock);
+        chcore_lock(&timer_file->timer_lock);
         val_ns = timespec_to_ns(&timer_file->it.it_value);
         interval_ns = timespec_to_ns(&timer_file->it.it_interval);
         /* Check whether the timer has been disarmed */
         if (interval_ns == 0 && val_ns == 0) {
-                chcore_spin_unlock(&timer_file->timer_lock);
+                chcore_unlock(&timer_file->timer_lock);
                 *(uint64_t *)buf = 0;
                 return sizeof(tick);
         }
@@ -231,7 +232,7 @@ static ssize_t chcore_timerfd_read(int fd, void *buf, size_t count)
         cur_ns = timespec_to_ns(&cur_time);
         /* Non-blocking mode */
         if (cur_ns < val_ns && (fd_dic[fd]->flags & TFD_NONBLOCK)) {
-                chcore_spin_unlock(&timer_file->timer_lock);
+                chcore_unlock(&timer_file->timer_lock);
                 return -EAGAIN;
         }
         if (cur_ns < val_ns) {
@@ -254,7 +255,7 @@ static ssize_t chcore_timerfd_read(int fd, void *buf, size_t count)
         *(uint64_t *)buf = tick;
         /* update timer for the next read */
         timer_file->it.it_value = ns_to_timespec(next_expire_ns);
-        chcore_spin_unlock(&timer_file->timer_lock);
+        chcore_unlock(&timer_file->timer_lock);
         return sizeof(tick);
 }
 
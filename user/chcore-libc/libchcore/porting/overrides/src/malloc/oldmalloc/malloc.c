@@ -40,11 +40,12 @@ static struct {
 
 /* Synchronization tools */
 
-#include <debug_lock.h>
+/* Adaptive locks which park contended threads on a futex, see chcore/lock.h */
+#include <chcore/lock.h>
 
 static inline void lock(volatile int *lk)
 {
-	chcore_spin_lock(lk);
+	chcore_lock(lk);
 #if 0
 	int need_locks = libc.need_locks;
 	if (need_locks) {
@@ -56,7 +57,7 @@ static inline void lock(volatile int *lk)
 
 static inline void unlock(volatile int *lk)
 {
-	chcore_spin_unlock(lk);
+	chcore_unlock(lk);
 #if 0
 	if (lk[0]) {
 		a_store(lk, 0);
@@ -6,7 +6,8 @@ int __pthread_mutex_lock(pthread_mutex_t *m)
 	int cur_prio = 0, r;
 	bool set_ceil = false;
 
-	if (m->ceil) {
+	/* PI mutexes are boosted by the kernel instead */
+	if (m->ceil && !(m->_m_type&8)) {
 		cur_prio = usys_get_prio(0);
 
 		if (cur_prio < m->ceil) {
@@ -12,7 +12,9 @@ int __pthread_mutex_unlock(pthread_mutex_t *m)
 	int old;
 	int old_prio;
 
+	/* Only restore the priority raised by the lock which is released */
 	old_prio = m->old_prio;
+	m->old_prio = 0;
 
 	if (type != PTHREAD_MUTEX_NORMAL) {
 		self = __pthread_self();
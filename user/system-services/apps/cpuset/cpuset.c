@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * cpuset: list the cpusets, or set the CPUs of one.
+ *
+ * procmgr puts servers and drivers in the "system" set and the other
+ * processes in the "app" set, e.g., to keep apps off CPUs 0 and 1:
+ *   cpuset.bin system 0-1
+ *   cpuset.bin app 2-3
+ *
+ * Only procmgr may define the sets, so the CPUs are set by asking it.
+ *
+ * Usage: cpuset.bin [name cpus]
+ *        cpus is a list of CPUs and ranges, e.g., 0,2-3
+ */
+
+#include <errno.h>
+#include <chcore/syscall.h>
+#include <chcore-internal/procmgr_defs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_cpus(unsigned long mask)
+{
+        int cpu, first = 1;
+
+        for (cpu = 0; mask >> cpu; cpu++) {
+                if (!(mask & (1UL << cpu)))
+                        continue;
+                printf("%s%d", first ? "" : ",", cpu);
+                first = 0;
+        }
+}
+
+static int list_cpusets(void)
+{
+        char name[CPUSET_NAME_LEN];
+        long mask;
+        int id;
+
+        printf("%-4s %-16s %s\n", "ID", "NAME", "CPUS");
+        for (id = 0; id < CPUSET_MAX; id++) {
+                mask = usys_cpuset(CPUSET_INFO, id, (unsigned long)name);
+                if (mask < 0)
+                        continue;
+                printf("%-4d %-16s ", id, name);
+                print_cpus(mask);
+                printf("\n");
+        }
+        return 0;
+}
+
+/* Returns 0 on errors, which is not a valid mask either */
+static unsigned long parse_cpus(const char *str)
+{
+        unsigned long mask = 0, from, to;
+        char *end;
+
+        while (*str) {
+                from = strtoul(str, &end, 10);
+                if (end == str)
+                        return 0;
+                to = from;
+                if (*end == '-') {
+                        str = end + 1;
+                        to = strtoul(str, &end, 10);
+                        if (end == str || to < from)
+                                return 0;
+                }
+                if (to >= sizeof(mask) * 8)
+                        return 0;
+                for (; from <= to; from++)
+                        mask |= 1UL << from;
+                if (*end == ',')
+                        end++;
+                else if (*end)
+                        return 0;
+                str = end;
+        }
+        return mask;
+}
+
+static long set_cpuset(const char *name, unsigned long mask)
+{
+        struct proc_request *proc_req;
+        ipc_msg_t *proc_ipc_msg;
+        long ret;
+
+        if (strlen(name) >= CPUSET_NAME_LEN)
+                return -EINVAL;
+
+        proc_ipc_msg =
+                ipc_create_msg(procmgr_ipc_struct, sizeof(struct proc_request));
+        proc_req = (struct proc_request *)ipc_get_msg_data(proc_ipc_msg);
+        proc_req->req = PROC_REQ_SET_CPUSET;
+        strcpy(proc_req->set_cpuset.name, name);
+        proc_req->set_cpuset.mask = mask;
+
+        ret = ipc_call(procmgr_ipc_struct, proc_ipc_msg);
+        ipc_destroy_msg(proc_ipc_msg);
+        return ret;
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned long mask;
+        long ret;
+
+        if (argc == 1)
+                return list_cpusets();
+        if (argc != 3) {
+                printf("Usage: %s [name cpus]\n", argv[0]);
+                return -1;
+        }
+
+        mask = parse_cpus(argv[2]);
+        if (!mask) {
+                printf("cpuset: invalid CPU list %s\n", argv[2]);
+                return -1;
+        }
+        ret = set_cpuset(argv[1], mask);
+        if (ret < 0) {
+                printf("cpuset: failed to set %s: %ld\n", argv[1], ret);
+                return -1;
+        }
+        return 0;
+}
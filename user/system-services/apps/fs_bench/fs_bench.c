@@ -0,0 +1,667 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * fs_bench: measure the throughput and the latency of FS operations.
+ *
+ * Tests, selected by -T (all by default):
+ *   seq   sequential pwrite and pread of a file, at each block size
+ *   rand  random pwrite and pread of the file, at each block size
+ *   meta  create, stat, open and unlink of many files
+ *   mix   random 4K reads (70%) and writes from 1, 2, 4, ... threads
+ *   fmap  reading the file with pread against touching its mapping
+ *
+ * Each test prints one row with the latency percentiles of its operations.
+ * The FS server times the requests (FS_REQ_TEST_PERF), SRV is the time it
+ * spends per operation and IPC the rest of the latency, i.e., IPC and the
+ * client. Run it in a directory of the FS to measure, and use
+ * scripts/bench/fs_bench.sh to run it under QEMU and compare with the
+ * results of a previous run.
+ *
+ * Usage: fs_bench.bin [-d dir] [-s size_kb] [-n nr_files] [-t max_threads]
+ *                     [-T tests] [-v]
+ */
+
+#include <chcore-internal/fs_defs.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NS_PER_US 1000UL
+#define NS_PER_S  1000000000UL
+
+#define BENCH_PAGE    4096
+#define BENCH_MAX_BS  65536
+#define MIX_READ_PCT  70
+
+static const unsigned long block_sizes[] = {512, 4096, 16384, BENCH_MAX_BS};
+#define NR_BLOCK_SIZES (sizeof(block_sizes) / sizeof(block_sizes[0]))
+
+static const char *dir = "/";
+static const char *tests = "seq,rand,meta,mix,fmap";
+static unsigned long file_size = 1024 * 1024;
+static int nr_files = 256;
+static int max_threads = 4;
+static int verbose;
+
+/* The file of the I/O tests, also used to reach the server */
+static char data_path[256];
+static int data_fd = -1;
+/* Whether the server answers FS_REQ_TEST_PERF */
+static int perf_ok;
+
+static const char *req_names[FS_REQ_MAX] = {
+        [FS_REQ_OPEN] = "open",           [FS_REQ_CLOSE] = "close",
+        [FS_REQ_CREAT] = "creat",         [FS_REQ_MKDIR] = "mkdir",
+        [FS_REQ_RMDIR] = "rmdir",         [FS_REQ_SYMLINKAT] = "symlinkat",
+        [FS_REQ_UNLINK] = "unlink",       [FS_REQ_RENAME] = "rename",
+        [FS_REQ_READLINKAT] = "readlinkat",
+        [FS_REQ_READ] = "read",           [FS_REQ_PREAD] = "pread",
+        [FS_REQ_WRITE] = "write",         [FS_REQ_PWRITE] = "pwrite",
+        [FS_REQ_FSTAT] = "fstat",         [FS_REQ_FSTATAT] = "fstatat",
+        [FS_REQ_STATFS] = "statfs",       [FS_REQ_FSTATFS] = "fstatfs",
+        [FS_REQ_LSEEK] = "lseek",         [FS_REQ_GETDENTS64] = "getdents64",
+        [FS_REQ_FTRUNCATE] = "ftruncate", [FS_REQ_FALLOCATE] = "fallocate",
+        [FS_REQ_FACCESSAT] = "faccessat", [FS_REQ_FCNTL] = "fcntl",
+        [FS_REQ_FMAP] = "fmap",           [FS_REQ_MOUNT] = "mount",
+        [FS_REQ_UMOUNT] = "umount",       [FS_REQ_SYNC] = "sync",
+        [FS_REQ_FSYNC] = "fsync",         [FS_REQ_FDATASYNC] = "fdatasync",
+        [FS_REQ_TEST_PERF] = "test_perf",
+};
+
+struct io_arg {
+        int fd;
+        unsigned long bs;
+        char *buf;
+        unsigned long long seed;
+        char *map;
+};
+
+struct mix_worker {
+        pthread_t tid;
+        struct io_arg io;
+        unsigned long *lat;
+        unsigned long nr_ops;
+        int ret;
+};
+
+typedef int (*bench_op_t)(unsigned long i, void *arg);
+
+static unsigned long now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+static unsigned long long xorshift64(unsigned long long *s)
+{
+        *s ^= *s << 13;
+        *s ^= *s >> 7;
+        *s ^= *s << 17;
+        return *s;
+}
+
+static int test_enabled(const char *name)
+{
+        size_t len = strlen(name);
+        const char *p;
+
+        for (p = strstr(tests, name); p; p = strstr(p + 1, name)) {
+                if ((p == tests || p[-1] == ',')
+                    && (p[len] == '\0' || p[len] == ','))
+                        return 1;
+        }
+        return 0;
+}
+
+static int cmp_ul(const void *a, const void *b)
+{
+        unsigned long x = *(const unsigned long *)a;
+        unsigned long y = *(const unsigned long *)b;
+
+        return x < y ? -1 : x > y;
+}
+
+static double ns_to_us(unsigned long ns)
+{
+        return (double)ns / NS_PER_US;
+}
+
+static void perf_start(void)
+{
+        if (perf_ok)
+                chcore_fs_perf(data_fd, FS_PERF_START, NULL);
+}
+
+static int perf_get(struct fs_perf_stat *stat)
+{
+        if (!perf_ok)
+                return -1;
+        return chcore_fs_perf(data_fd, FS_PERF_GET, stat);
+}
+
+static void print_header(void)
+{
+        printf("%-12s %6s %8s %9s %9s %9s %9s %9s %9s %9s %9s\n",
+               "TEST",
+               "BS",
+               "OPS",
+               "MB/s",
+               "AVG(us)",
+               "P50",
+               "P90",
+               "P99",
+               "MAX",
+               "SRV(us)",
+               "IPC(us)");
+}
+
+static void print_server_stat(struct fs_perf_stat *stat)
+{
+        int i;
+
+        for (i = FS_REQ_UNDEFINED + 1; i < FS_REQ_MAX; i++) {
+                if (i == FS_REQ_TEST_PERF || stat->nr_reqs[i] == 0)
+                        continue;
+                printf("    %-12s %8lu reqs %9.1f us/req\n",
+                       req_names[i] ? req_names[i] : "?",
+                       stat->nr_reqs[i],
+                       ns_to_us(stat->server_ns[i] / stat->nr_reqs[i]));
+        }
+        printf("    page cache hit %lu miss %lu, disk read %lu written %lu, "
+               "dcache hit %lu (negative %lu) miss %lu\n",
+               stat->page_cache_hit,
+               stat->page_cache_miss,
+               stat->disk_read_bytes,
+               stat->disk_write_bytes,
+               stat->dcache_hit,
+               stat->dcache_negative_hit,
+               stat->dcache_miss);
+}
+
+/*
+ * Print the row of a test, @lat (sorted here) is the latency of each of the
+ * @nr_ops operations and @ns the wall time of all of them.
+ */
+static void report(const char *name, unsigned long bs, unsigned long *lat,
+                   unsigned long nr_ops, unsigned long bytes, unsigned long ns)
+{
+        struct fs_perf_stat stat;
+        unsigned long sum = 0, srv = 0, avg, i;
+        int have_stat;
+        char srv_str[16] = "-", ipc_str[16] = "-", mbs_str[16] = "-";
+
+        if (nr_ops == 0)
+                return;
+
+        for (i = 0; i < nr_ops; i++)
+                sum += lat[i];
+        avg = sum / nr_ops;
+        qsort(lat, nr_ops, sizeof(*lat), cmp_ul);
+
+        have_stat = perf_get(&stat) == 0;
+        if (have_stat) {
+                for (i = FS_REQ_UNDEFINED + 1; i < FS_REQ_MAX; i++) {
+                        if (i != FS_REQ_TEST_PERF)
+                                srv += stat.server_ns[i];
+                }
+                srv /= nr_ops;
+                snprintf(srv_str, sizeof(srv_str), "%.1f", ns_to_us(srv));
+                snprintf(ipc_str,
+                         sizeof(ipc_str),
+                         "%.1f",
+                         ns_to_us(avg > srv ? avg - srv : 0));
+        }
+        if (bytes && ns)
+                snprintf(mbs_str,
+                         sizeof(mbs_str),
+                         "%.1f",
+                         (double)bytes * NS_PER_US / ns);
+
+        printf("%-12s %6lu %8lu %9s %9.1f %9.1f %9.1f %9.1f %9.1f %9s %9s\n",
+               name,
+               bs,
+               nr_ops,
+               mbs_str,
+               ns_to_us(avg),
+               ns_to_us(lat[nr_ops * 50 / 100]),
+               ns_to_us(lat[nr_ops * 90 / 100]),
+               ns_to_us(lat[nr_ops * 99 / 100]),
+               ns_to_us(lat[nr_ops - 1]),
+               srv_str,
+               ipc_str);
+        if (verbose && have_stat)
+                print_server_stat(&stat);
+}
+
+/* Run @op @nr_ops times, each moving @bs bytes, and report it */
+static int run_ops(const char *name, unsigned long bs, unsigned long nr_ops,
+                   bench_op_t op, void *arg)
+{
+        unsigned long *lat, start, t, i;
+        int ret = 0;
+
+        lat = malloc(sizeof(*lat) * nr_ops);
+        if (!lat)
+                return -1;
+
+        perf_start();
+        start = now_ns();
+        for (i = 0; i < nr_ops; i++) {
+                t = now_ns();
+                if (op(i, arg) != 0) {
+                        printf("fs_bench: %s failed at op %lu\n", name, i);
+                        ret = -1;
+                        goto out;
+                }
+                lat[i] = now_ns() - t;
+        }
+        report(name, bs, lat, nr_ops, bs * nr_ops, now_ns() - start);
+
+out:
+        free(lat);
+        return ret;
+}
+
+static int op_seq_read(unsigned long i, void *arg)
+{
+        struct io_arg *io = arg;
+
+        return pread(io->fd, io->buf, io->bs, i * io->bs) == io->bs ? 0 : -1;
+}
+
+static int op_seq_write(unsigned long i, void *arg)
+{
+        struct io_arg *io = arg;
+
+        return pwrite(io->fd, io->buf, io->bs, i * io->bs) == io->bs ? 0 : -1;
+}
+
+static off_t rand_offset(struct io_arg *io)
+{
+        return (xorshift64(&io->seed) % (file_size / io->bs)) * io->bs;
+}
+
+static int op_rand_read(unsigned long i, void *arg)
+{
+        struct io_arg *io = arg;
+
+        return pread(io->fd, io->buf, io->bs, rand_offset(io)) == io->bs ? 0 :
+                                                                          -1;
+}
+
+static int op_rand_write(unsigned long i, void *arg)
+{
+        struct io_arg *io = arg;
+
+        return pwrite(io->fd, io->buf, io->bs, rand_offset(io)) == io->bs ?
+                       0 :
+                       -1;
+}
+
+/* The first access maps the file, so its latency includes FS_REQ_FMAP */
+static int op_fmap_read(unsigned long i, void *arg)
+{
+        struct io_arg *io = arg;
+
+        if (i == 0) {
+                io->map = mmap(
+                        NULL, file_size, PROT_READ, MAP_SHARED, io->fd, 0);
+                if (io->map == MAP_FAILED) {
+                        io->map = NULL;
+                        return -1;
+                }
+        }
+        memcpy(io->buf, io->map + i * io->bs, io->bs);
+        return 0;
+}
+
+static void meta_path(char *path, size_t len, unsigned long i)
+{
+        snprintf(path, len, "%s/fs_bench.m%lu", dir, i);
+}
+
+static int op_create(unsigned long i, void *arg)
+{
+        char path[256];
+        int fd;
+
+        meta_path(path, sizeof(path), i);
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+                return -1;
+        close(fd);
+        return 0;
+}
+
+static int op_stat(unsigned long i, void *arg)
+{
+        char path[256];
+        struct stat st;
+
+        meta_path(path, sizeof(path), i);
+        return stat(path, &st);
+}
+
+static int op_open(unsigned long i, void *arg)
+{
+        char path[256];
+        int fd;
+
+        meta_path(path, sizeof(path), i);
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return -1;
+        close(fd);
+        return 0;
+}
+
+static int op_unlink(unsigned long i, void *arg)
+{
+        char path[256];
+
+        meta_path(path, sizeof(path), i);
+        return unlink(path);
+}
+
+static int bench_seq(struct io_arg *io)
+{
+        unsigned long i;
+        int ret;
+
+        for (i = 0; i < NR_BLOCK_SIZES; i++) {
+                io->bs = block_sizes[i];
+                ret = run_ops("seq_write",
+                              io->bs,
+                              file_size / io->bs,
+                              op_seq_write,
+                              io);
+                if (ret)
+                        return ret;
+                ret = run_ops(
+                        "seq_read", io->bs, file_size / io->bs, op_seq_read, io);
+                if (ret)
+                        return ret;
+        }
+        return 0;
+}
+
+static int bench_rand(struct io_arg *io)
+{
+        unsigned long i;
+        int ret;
+
+        for (i = 0; i < NR_BLOCK_SIZES; i++) {
+                io->bs = block_sizes[i];
+                ret = run_ops("rand_write",
+                              io->bs,
+                              file_size / io->bs,
+                              op_rand_write,
+                              io);
+                if (ret)
+                        return ret;
+                ret = run_ops("rand_read",
+                              io->bs,
+                              file_size / io->bs,
+                              op_rand_read,
+                              io);
+                if (ret)
+                        return ret;
+        }
+        return 0;
+}
+
+static int bench_meta(void)
+{
+        int ret;
+
+        ret = run_ops("create", 0, nr_files, op_create, NULL);
+        if (!ret)
+                ret = run_ops("stat", 0, nr_files, op_stat, NULL);
+        if (!ret)
+                ret = run_ops("open", 0, nr_files, op_open, NULL);
+        /* Clean up even if some of them failed */
+        if (run_ops("unlink", 0, nr_files, op_unlink, NULL))
+                ret = -1;
+        return ret;
+}
+
+static void *mix_worker(void *arg)
+{
+        struct mix_worker *w = arg;
+        unsigned long i, t;
+        ssize_t n;
+
+        w->ret = 0;
+        for (i = 0; i < w->nr_ops; i++) {
+                t = now_ns();
+                if (xorshift64(&w->io.seed) % 100 < MIX_READ_PCT)
+                        n = pread(w->io.fd,
+                                  w->io.buf,
+                                  w->io.bs,
+                                  rand_offset(&w->io));
+                else
+                        n = pwrite(w->io.fd,
+                                   w->io.buf,
+                                   w->io.bs,
+                                   rand_offset(&w->io));
+                if (n != w->io.bs) {
+                        w->ret = -1;
+                        break;
+                }
+                w->lat[i] = now_ns() - t;
+        }
+        return NULL;
+}
+
+/* All the threads share the file, each does the same number of operations */
+static int run_mix(int nr_threads)
+{
+        unsigned long per_thread = file_size / BENCH_PAGE;
+        unsigned long *lat, start, ns;
+        struct mix_worker *workers;
+        char name[16];
+        int i, ret = 0;
+
+        workers = calloc(nr_threads, sizeof(*workers));
+        lat = malloc(sizeof(*lat) * per_thread * nr_threads);
+        if (!workers || !lat) {
+                ret = -1;
+                goto out;
+        }
+        for (i = 0; i < nr_threads; i++) {
+                workers[i].io.fd = data_fd;
+                workers[i].io.bs = BENCH_PAGE;
+                workers[i].io.seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+                workers[i].io.buf = malloc(BENCH_PAGE);
+                workers[i].lat = lat + per_thread * i;
+                workers[i].nr_ops = per_thread;
+                if (!workers[i].io.buf) {
+                        ret = -1;
+                        goto out;
+                }
+                memset(workers[i].io.buf, 'a' + i % 26, BENCH_PAGE);
+        }
+
+        perf_start();
+        start = now_ns();
+        for (i = 0; i < nr_threads; i++)
+                pthread_create(&workers[i].tid, NULL, mix_worker, &workers[i]);
+        for (i = 0; i < nr_threads; i++) {
+                pthread_join(workers[i].tid, NULL);
+                ret |= workers[i].ret;
+        }
+        ns = now_ns() - start;
+        if (ret) {
+                printf("fs_bench: mix failed\n");
+                goto out;
+        }
+
+        snprintf(name, sizeof(name), "mix_t%d", nr_threads);
+        report(name,
+               BENCH_PAGE,
+               lat,
+               per_thread * nr_threads,
+               per_thread * nr_threads * BENCH_PAGE,
+               ns);
+
+out:
+        if (workers) {
+                for (i = 0; i < nr_threads; i++)
+                        free(workers[i].io.buf);
+        }
+        free(workers);
+        free(lat);
+        return ret;
+}
+
+static int bench_mix(void)
+{
+        int n, ret;
+
+        for (n = 1; n <= max_threads; n *= 2) {
+                ret = run_mix(n);
+                if (ret)
+                        return ret;
+        }
+        return 0;
+}
+
+static int bench_fmap(struct io_arg *io)
+{
+        int ret;
+
+        io->bs = BENCH_PAGE;
+        ret = run_ops(
+                "read", io->bs, file_size / io->bs, op_seq_read, io);
+        if (ret)
+                return ret;
+
+        io->map = NULL;
+        ret = run_ops(
+                "fmap", io->bs, file_size / io->bs, op_fmap_read, io);
+        if (io->map)
+                munmap(io->map, file_size);
+        return ret;
+}
+
+/* Fill the file so that the read tests never meet its end */
+static int prepare_data_file(char *buf)
+{
+        unsigned long off;
+
+        snprintf(data_path, sizeof(data_path), "%s/fs_bench.data", dir);
+        data_fd = open(data_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (data_fd < 0) {
+                printf("fs_bench: failed to create %s\n", data_path);
+                return -1;
+        }
+        for (off = 0; off < file_size; off += BENCH_MAX_BS) {
+                if (pwrite(data_fd, buf, BENCH_MAX_BS, off) != BENCH_MAX_BS) {
+                        printf("fs_bench: failed to write %s\n", data_path);
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+int main(int argc, char *argv[])
+{
+        struct io_arg io;
+        int opt, ret;
+
+        while ((opt = getopt(argc, argv, "d:s:n:t:T:v")) != -1) {
+                switch (opt) {
+                case 'd':
+                        dir = optarg;
+                        break;
+                case 's':
+                        file_size = strtoul(optarg, NULL, 10) * 1024;
+                        break;
+                case 'n':
+                        nr_files = atoi(optarg);
+                        break;
+                case 't':
+                        max_threads = atoi(optarg);
+                        break;
+                case 'T':
+                        tests = optarg;
+                        break;
+                case 'v':
+                        verbose = 1;
+                        break;
+                default:
+                        printf("Usage: %s [-d dir] [-s size_kb] [-n nr_files] "
+                               "[-t max_threads] [-T tests] [-v]\n",
+                               argv[0]);
+                        return -1;
+                }
+        }
+        file_size -= file_size % BENCH_MAX_BS;
+        if (file_size == 0 || nr_files <= 0 || max_threads <= 0) {
+                printf("fs_bench: the file must be at least %d KB\n",
+                       BENCH_MAX_BS / 1024);
+                return -1;
+        }
+
+        memset(&io, 0, sizeof(io));
+        io.seed = 0x2545F4914F6CDD1DULL;
+        io.buf = malloc(BENCH_MAX_BS);
+        if (!io.buf)
+                return -1;
+        memset(io.buf, 'a', BENCH_MAX_BS);
+
+        ret = prepare_data_file(io.buf);
+        if (ret)
+                goto out;
+        io.fd = data_fd;
+
+        perf_ok = chcore_fs_perf(data_fd, FS_PERF_START, NULL) == 0;
+        printf("fs_bench: begin, %lu KB file, %d files, up to %d threads in "
+               "%s%s\n",
+               file_size / 1024,
+               nr_files,
+               max_threads,
+               dir,
+               perf_ok ? "" : ", no server time");
+        print_header();
+
+        if (test_enabled("seq") && (ret = bench_seq(&io)))
+                goto out;
+        if (test_enabled("rand") && (ret = bench_rand(&io)))
+                goto out;
+        if (test_enabled("meta") && (ret = bench_meta()))
+                goto out;
+        if (test_enabled("mix") && (ret = bench_mix()))
+                goto out;
+        if (test_enabled("fmap") && (ret = bench_fmap(&io)))
+                goto out;
+
+out:
+        if (perf_ok)
+                chcore_fs_perf(data_fd, FS_PERF_STOP, NULL);
+        if (data_fd >= 0) {
+                close(data_fd);
+                unlink(data_path);
+        }
+        free(io.buf);
+        printf("fs_bench: %s\n", ret ? "failed" : "done");
+        return ret;
+}
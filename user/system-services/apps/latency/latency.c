@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * latency: measure the wakeup latency of a high-priority thread, i.e., how
+ * late it runs after its sleep expires, and print a histogram.
+ *
+ * Loader threads of low priority on the same CPU keep the kernel busy with
+ * long operations meanwhile: mapping, touching and unmapping large regions,
+ * which ends in unmapping and freeing many pages in the kernel. Compare the
+ * results of kernels with and without CHCORE_KERNEL_RT.
+ *
+ * Usage: latency.bin [-n samples] [-i interval_us] [-l loaders] [-m load_mb]
+ *                    [-c cpu]
+ */
+
+#include <chcore/syscall.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NS_PER_US 1000UL
+#define NS_PER_S  1000000000UL
+
+/* Bucket 0 is for < 1us, and bucket i for [2^(i-1), 2^i) us */
+#define NR_BUCKETS 24
+
+#define MEASURE_PRIO 200
+#define LOADER_PRIO  10
+
+static unsigned long histogram[NR_BUCKETS];
+static volatile int stop_loaders;
+static int cpu;
+static unsigned long load_size;
+
+static unsigned long now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+static void run_on(int cpuid, int prio)
+{
+        usys_set_prio(0, prio);
+        usys_set_affinity(0, cpuid);
+        /* The affinity takes effect when enqueued again */
+        sched_yield();
+}
+
+static void *loader(void *arg)
+{
+        unsigned long off;
+        char *buf;
+
+        run_on(cpu, LOADER_PRIO);
+        while (!stop_loaders) {
+                buf = mmap(NULL,
+                           load_size,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1,
+                           0);
+                if (buf == MAP_FAILED) {
+                        printf("latency: mmap failed\n");
+                        break;
+                }
+                for (off = 0; off < load_size; off += PAGE_SIZE)
+                        buf[off] = 1;
+                munmap(buf, load_size);
+        }
+        return NULL;
+}
+
+static int bucket_of(unsigned long lat_us)
+{
+        int i = 0;
+
+        while (lat_us && i < NR_BUCKETS - 1) {
+                lat_us >>= 1;
+                i++;
+        }
+        return i;
+}
+
+/* Upper bound (in us) of the latency of @permille of the samples */
+static unsigned long percentile(unsigned long samples, int permille)
+{
+        unsigned long cnt = 0;
+        int i;
+
+        for (i = 0; i < NR_BUCKETS - 1; i++) {
+                cnt += histogram[i];
+                if (cnt * 1000 >= samples * permille)
+                        break;
+        }
+        return 1UL << i;
+}
+
+static void print_report(unsigned long samples, unsigned long min,
+                         unsigned long max, unsigned long sum)
+{
+        char range[32];
+        int i;
+
+        printf("samples %lu  min %lu us  avg %lu us  max %lu us\n",
+               samples,
+               min / NS_PER_US,
+               sum / samples / NS_PER_US,
+               max / NS_PER_US);
+        printf("p50 < %lu us  p99 < %lu us  p99.9 < %lu us\n\n",
+               percentile(samples, 500),
+               percentile(samples, 990),
+               percentile(samples, 999));
+
+        printf("%-20s %10s\n", "LATENCY(us)", "COUNT");
+        for (i = 0; i < NR_BUCKETS; i++) {
+                if (!histogram[i])
+                        continue;
+                snprintf(range,
+                         sizeof(range),
+                         "[%lu, %lu)",
+                         i == 0 ? 0 : 1UL << (i - 1),
+                         1UL << i);
+                printf("%-20s %10lu\n", range, histogram[i]);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned long samples = 1000, interval_us = 1000, load_mb = 64;
+        unsigned long i, start, lat, min = -1UL, max = 0, sum = 0;
+        struct timespec req;
+        pthread_t *loaders;
+        int nr_loaders = 1, opt, j;
+
+        while ((opt = getopt(argc, argv, "n:i:l:m:c:")) != -1) {
+                switch (opt) {
+                case 'n':
+                        samples = strtoul(optarg, NULL, 10);
+                        break;
+                case 'i':
+                        interval_us = strtoul(optarg, NULL, 10);
+                        break;
+                case 'l':
+                        nr_loaders = atoi(optarg);
+                        break;
+                case 'm':
+                        load_mb = strtoul(optarg, NULL, 10);
+                        break;
+                case 'c':
+                        cpu = atoi(optarg);
+                        break;
+                default:
+                        printf("Usage: %s [-n samples] [-i interval_us] "
+                               "[-l loaders] [-m load_mb] [-c cpu]\n",
+                               argv[0]);
+                        return -1;
+                }
+        }
+        if (samples == 0 || nr_loaders < 0)
+                return -1;
+
+        load_size = load_mb << 20;
+        loaders = malloc(sizeof(*loaders) * (nr_loaders + 1));
+        if (!loaders)
+                return -1;
+        for (j = 0; j < nr_loaders; j++)
+                pthread_create(&loaders[j], NULL, loader, NULL);
+
+        run_on(cpu, MEASURE_PRIO);
+        printf("latency: %lu samples, %lu us interval, %d loaders of %lu MB "
+               "on CPU %d\n",
+               samples,
+               interval_us,
+               nr_loaders,
+               load_mb,
+               cpu);
+
+        req.tv_sec = interval_us * NS_PER_US / NS_PER_S;
+        req.tv_nsec = interval_us * NS_PER_US % NS_PER_S;
+        for (i = 0; i < samples; i++) {
+                start = now_ns();
+                nanosleep(&req, NULL);
+                lat = now_ns() - start;
+                lat = lat > interval_us * NS_PER_US ?
+                              lat - interval_us * NS_PER_US :
+                              0;
+
+                histogram[bucket_of(lat / NS_PER_US)]++;
+                min = lat < min ? lat : min;
+                max = lat > max ? lat : max;
+                sum += lat;
+        }
+
+        stop_loaders = 1;
+        for (j = 0; j < nr_loaders; j++)
+                pthread_join(loaders[j], NULL);
+        free(loaders);
+
+        print_report(samples, min, max, sum);
+        return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * pc_bench: measure how reads from the page cache scale with threads.
+ *
+ * Each thread reads its own file in 4K reads, and the throughput with 1, 2,
+ * 4, ... up to max_threads threads is printed. The files are read once
+ * before measuring so that the rounds hit the cache. Run it in a directory
+ * of an FS served by fs_base with the page cache on, tmpfs does not use it.
+ *
+ * read() is used instead of pread(): fs_base only lets FS_REQ_READ and
+ * FS_REQ_WRITE run in parallel, the other requests are serialized before
+ * reaching the page cache.
+ *
+ * Usage: pc_bench.bin [-d dir] [-s size_kb] [-t max_threads] [-r rounds]
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NS_PER_S 1000000000UL
+
+#define BENCH_BLOCK 4096
+
+static const char *dir = "/";
+static unsigned long file_size = 1024 * 1024;
+static int rounds = 8;
+
+struct worker {
+        pthread_t tid;
+        int fd;
+        int ret;
+};
+
+static unsigned long now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+static int read_file(int fd)
+{
+        char buf[BENCH_BLOCK];
+        unsigned long off;
+
+        if (lseek(fd, 0, SEEK_SET) != 0)
+                return -1;
+        for (off = 0; off < file_size; off += BENCH_BLOCK) {
+                if (read(fd, buf, BENCH_BLOCK) != BENCH_BLOCK)
+                        return -1;
+        }
+        return 0;
+}
+
+static void *reader(void *arg)
+{
+        struct worker *w = arg;
+        int i;
+
+        w->ret = 0;
+        for (i = 0; i < rounds; i++) {
+                if (read_file(w->fd) != 0) {
+                        w->ret = -1;
+                        break;
+                }
+        }
+        return NULL;
+}
+
+static int create_file(int idx)
+{
+        char path[256], buf[BENCH_BLOCK];
+        unsigned long off;
+        int fd;
+
+        snprintf(path, sizeof(path), "%s/pc_bench.%d", dir, idx);
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+                printf("pc_bench: failed to create %s\n", path);
+                return -1;
+        }
+        memset(buf, 'a' + idx % 26, sizeof(buf));
+        for (off = 0; off < file_size; off += BENCH_BLOCK) {
+                if (write(fd, buf, BENCH_BLOCK) != BENCH_BLOCK) {
+                        printf("pc_bench: failed to write %s\n", path);
+                        close(fd);
+                        return -1;
+                }
+        }
+        /* Warm up the cache */
+        if (read_file(fd) != 0) {
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+static void remove_file(int idx)
+{
+        char path[256];
+
+        snprintf(path, sizeof(path), "%s/pc_bench.%d", dir, idx);
+        unlink(path);
+}
+
+static int run(struct worker *workers, int nr_threads)
+{
+        unsigned long start, ns, bytes;
+        int i, ret = 0;
+
+        start = now_ns();
+        for (i = 0; i < nr_threads; i++)
+                pthread_create(&workers[i].tid, NULL, reader, &workers[i]);
+        for (i = 0; i < nr_threads; i++) {
+                pthread_join(workers[i].tid, NULL);
+                ret |= workers[i].ret;
+        }
+        ns = now_ns() - start;
+        if (ret) {
+                printf("pc_bench: read failed\n");
+                return -1;
+        }
+
+        bytes = file_size * rounds * nr_threads;
+        printf("%-8d %12lu %12lu\n",
+               nr_threads,
+               ns / 1000,
+               ns ? bytes * 1000 / ns : 0);
+        return 0;
+}
+
+int main(int argc, char *argv[])
+{
+        int max_threads = 4, opt, i, n, ret = 0;
+        struct worker *workers;
+
+        while ((opt = getopt(argc, argv, "d:s:t:r:")) != -1) {
+                switch (opt) {
+                case 'd':
+                        dir = optarg;
+                        break;
+                case 's':
+                        file_size = strtoul(optarg, NULL, 10) * 1024;
+                        break;
+                case 't':
+                        max_threads = atoi(optarg);
+                        break;
+                case 'r':
+                        rounds = atoi(optarg);
+                        break;
+                default:
+                        printf("Usage: %s [-d dir] [-s size_kb] "
+                               "[-t max_threads] [-r rounds]\n",
+                               argv[0]);
+                        return -1;
+                }
+        }
+        file_size -= file_size % BENCH_BLOCK;
+        if (file_size == 0 || max_threads <= 0 || rounds <= 0)
+                return -1;
+
+        workers = calloc(max_threads, sizeof(*workers));
+        if (!workers)
+                return -1;
+        for (i = 0; i < max_threads; i++) {
+                workers[i].fd = create_file(i);
+                if (workers[i].fd < 0) {
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        printf("pc_bench: %lu KB per thread, %d rounds in %s\n",
+               file_size / 1024,
+               rounds,
+               dir);
+        printf("%-8s %12s %12s\n", "THREADS", "TIME(us)", "MB/s");
+        for (n = 1; n <= max_threads; n *= 2) {
+                ret = run(workers, n);
+                if (ret)
+                        goto out;
+        }
+
+out:
+        for (i = 0; i < max_threads; i++) {
+                if (workers[i].fd > 0) {
+                        close(workers[i].fd);
+                        remove_file(i);
+                }
+        }
+        free(workers);
+        return ret;
+}
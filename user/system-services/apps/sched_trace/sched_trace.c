@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * sched_trace: record scheduler events (kernel built with
+ * CHCORE_KERNEL_SCHED_TRACE) for a while, and dump them to the console after
+ * recording, so that printing does not disturb what is traced.
+ *
+ * Each dumped line starts with "SCHEDTRACE", to be picked from the console
+ * log by scripts/trace/sched_trace.py.
+ *
+ * Usage: sched_trace.bin [-d duration_ms] [-i drain_interval_ms]
+ *                        [-n max_events]
+ */
+
+#include <chcore/syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NS_PER_MS   1000000UL
+#define DRAIN_BATCH 1024
+
+static struct sched_trace_event *events;
+static unsigned long nr_events, max_events;
+static unsigned long dropped_drains;
+
+static unsigned long now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/* Move the recorded events to events[], returns < 0 on errors */
+static int drain(void)
+{
+        static struct sched_trace_event discard[DRAIN_BATCH];
+        struct sched_trace_event *buf;
+        long ret;
+
+        do {
+                if (nr_events + DRAIN_BATCH <= max_events) {
+                        buf = &events[nr_events];
+                } else {
+                        /* Keep the kernel buffers from filling up */
+                        buf = discard;
+                        dropped_drains++;
+                }
+                ret = usys_sched_trace(SCHED_TRACE_DRAIN, buf, DRAIN_BATCH);
+                if (ret < 0) {
+                        printf("sched_trace: drain failed: %ld\n", ret);
+                        return ret;
+                }
+                if (buf != discard)
+                        nr_events += ret;
+        } while (ret == DRAIN_BATCH);
+        return 0;
+}
+
+static void dump(long ticks_per_us)
+{
+        struct sched_trace_event *ev;
+        unsigned long i;
+
+        printf("SCHEDTRACE ticks_per_us %ld\n", ticks_per_us);
+        for (i = 0; i < nr_events; i++) {
+                ev = &events[i];
+                printf("SCHEDTRACE %u %lu %u %lx %lx\n",
+                       ev->cpu,
+                       ev->tick,
+                       ev->type,
+                       ev->tid,
+                       ev->arg);
+        }
+        printf("SCHEDTRACE end\n");
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned long duration_ms = 1000, interval_ms = 10, start;
+        long ticks_per_us;
+        int opt, ret;
+
+        max_events = 65536;
+        while ((opt = getopt(argc, argv, "d:i:n:")) != -1) {
+                switch (opt) {
+                case 'd':
+                        duration_ms = strtoul(optarg, NULL, 10);
+                        break;
+                case 'i':
+                        interval_ms = strtoul(optarg, NULL, 10);
+                        break;
+                case 'n':
+                        max_events = strtoul(optarg, NULL, 10);
+                        break;
+                default:
+                        printf("Usage: %s [-d duration_ms] "
+                               "[-i drain_interval_ms] [-n max_events]\n",
+                               argv[0]);
+                        return -1;
+                }
+        }
+
+        events = malloc(sizeof(*events) * max_events);
+        if (!events)
+                return -1;
+
+        ticks_per_us = usys_sched_trace(SCHED_TRACE_TICKS_PER_US, NULL, 0);
+        if (ticks_per_us < 0) {
+                printf("sched_trace: not supported by the kernel: %ld\n",
+                       ticks_per_us);
+                return -1;
+        }
+
+        ret = usys_sched_trace(SCHED_TRACE_ENABLE, NULL, 0);
+        if (ret < 0) {
+                printf("sched_trace: enable failed: %d\n", ret);
+                return -1;
+        }
+        start = now_ns();
+        while (now_ns() - start < duration_ms * NS_PER_MS) {
+                usleep(interval_ms * 1000);
+                if (drain() < 0)
+                        break;
+        }
+        usys_sched_trace(SCHED_TRACE_DISABLE, NULL, 0);
+        drain();
+
+        dump(ticks_per_us);
+        if (dropped_drains)
+                printf("sched_trace: %lu batches discarded, try a larger -n\n",
+                       dropped_drains);
+        free(events);
+        return 0;
+}
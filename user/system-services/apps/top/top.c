@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+/*
+ * top: show the CPU usage of processes (and threads with -t) over an interval.
+ *
+ * Usage: top.bin [-d delay_ms] [-n iterations] [-t]
+ */
+
+#include <chcore/syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_RECORDS 512
+#define NS_PER_MS   1000000UL
+
+static struct sched_stat_info snapshots[2][MAX_RECORDS];
+static int nr_records[2];
+
+struct usage {
+        struct sched_stat_info *info;
+        unsigned long user, kernel, ipc, wait, switches, preempted;
+};
+
+static struct usage usages[MAX_RECORDS];
+
+static const char *state_str(int state)
+{
+        static const char *states[] = {
+                "INIT", "READY", "INTER", "RUN", "EXIT", "WAIT"};
+
+        if (state < 0 || state >= (int)(sizeof(states) / sizeof(states[0])))
+                return "-";
+        return states[state];
+}
+
+static unsigned long now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static int take_snapshot(int idx)
+{
+        int ret;
+
+        ret = usys_get_sched_stat(snapshots[idx], MAX_RECORDS);
+        if (ret < 0) {
+                printf("top: usys_get_sched_stat failed: %d\n", ret);
+                return ret;
+        }
+        nr_records[idx] = ret;
+        return 0;
+}
+
+static struct sched_stat_info *find_old(struct sched_stat_info *info)
+{
+        struct sched_stat_info *old;
+        int i;
+
+        for (i = 0; i < nr_records[0]; i++) {
+                old = &snapshots[0][i];
+                if (old->kind != info->kind || old->badge != info->badge)
+                        continue;
+                if (info->kind == SCHED_STAT_IDLE && old->cpu != info->cpu)
+                        continue;
+                if (info->kind == SCHED_STAT_THREAD && old->id != info->id)
+                        continue;
+                return old;
+        }
+        return NULL;
+}
+
+/* Usage of each record in the new snapshot since the old one */
+static void compute_usages(void)
+{
+        struct sched_stat_info *info, *old;
+        struct sched_stat_info zero;
+        struct usage *u;
+        int i;
+
+        memset(&zero, 0, sizeof(zero));
+        for (i = 0; i < nr_records[1]; i++) {
+                info = &snapshots[1][i];
+                old = find_old(info);
+                if (!old)
+                        old = &zero;
+                u = &usages[i];
+                u->info = info;
+                u->user = info->user_time - old->user_time;
+                u->kernel = info->kernel_time - old->kernel_time;
+                u->ipc = info->ipc_time - old->ipc_time;
+                u->wait = info->wait_time - old->wait_time;
+                u->switches = info->nr_switches - old->nr_switches;
+                u->preempted = info->nr_preempted - old->nr_preempted;
+        }
+}
+
+static int cmp_usage(const void *a, const void *b)
+{
+        const struct usage *ua = a, *ub = b;
+        unsigned long ta = ua->user + ua->kernel, tb = ub->user + ub->kernel;
+
+        if (ua->info->kind != ub->info->kind)
+                return ua->info->kind - ub->info->kind;
+        return ta < tb ? 1 : (ta > tb ? -1 : 0);
+}
+
+static double percent(unsigned long t, unsigned long interval)
+{
+        return interval ? 100.0 * t / interval : 0;
+}
+
+static void print_usage_line(struct usage *u, unsigned long interval)
+{
+        printf("%6.1f %6.1f %6.1f %8lu %8lu %7lu %7lu",
+               percent(u->user + u->kernel, interval),
+               percent(u->user, interval),
+               percent(u->kernel, interval),
+               u->ipc / NS_PER_MS,
+               u->wait / NS_PER_MS,
+               u->switches,
+               u->preempted);
+}
+
+static void print_report(unsigned long interval, int show_threads)
+{
+        struct sched_stat_info *info;
+        struct usage *u;
+        int i, j, nr = nr_records[1];
+
+        printf("\n---- %lu ms ----\n", interval / NS_PER_MS);
+        for (i = 0; i < nr; i++) {
+                if (usages[i].info->kind != SCHED_STAT_IDLE)
+                        continue;
+                printf("CPU%d idle %.1f%%  ",
+                       usages[i].info->cpu,
+                       percent(usages[i].kernel + usages[i].user, interval));
+        }
+        printf("\n\n%-24s %5s %4s %6s %6s %6s %8s %8s %7s %7s\n",
+               "NAME",
+               "BADGE",
+               "THR",
+               "%CPU",
+               "%USR",
+               "%SYS",
+               "IPC(ms)",
+               "WAIT(ms)",
+               "CSW",
+               "PREEMPT");
+
+        /* Sorting breaks the threads following groups, so sort groups only */
+        qsort(usages, nr, sizeof(usages[0]), cmp_usage);
+        for (i = 0; i < nr; i++) {
+                u = &usages[i];
+                if (u->info->kind != SCHED_STAT_GROUP)
+                        continue;
+                printf("%-24s %5lu %4d ",
+                       u->info->name,
+                       u->info->badge,
+                       u->info->id);
+                print_usage_line(u, interval);
+                printf("\n");
+
+                if (!show_threads)
+                        continue;
+                for (j = 0; j < nr; j++) {
+                        info = usages[j].info;
+                        if (info->kind != SCHED_STAT_THREAD
+                            || info->badge != u->info->badge)
+                                continue;
+                        printf("  tid %-6d %-5s cpu%-2d p%-3d     ",
+                               info->id,
+                               state_str(info->state),
+                               info->cpu,
+                               info->prio);
+                        print_usage_line(&usages[j], interval);
+                        printf("\n");
+                }
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned long delay_ms = 1000, start, interval;
+        int iterations = 1, show_threads = 0, opt, i;
+
+        while ((opt = getopt(argc, argv, "d:n:t")) != -1) {
+                switch (opt) {
+                case 'd':
+                        delay_ms = strtoul(optarg, NULL, 10);
+                        break;
+                case 'n':
+                        iterations = atoi(optarg);
+                        break;
+                case 't':
+                        show_threads = 1;
+                        break;
+                default:
+                        printf("Usage: %s [-d delay_ms] [-n iterations] [-t]\n",
+                               argv[0]);
+                        return -1;
+                }
+        }
+
+        if (take_snapshot(1) < 0)
+                return -1;
+        start = now_ns();
+        for (i = 0; i < iterations; i++) {
+                memcpy(snapshots[0], snapshots[1], sizeof(snapshots[1]));
+                nr_records[0] = nr_records[1];
+
+                usleep(delay_ms * 1000);
+
+                if (take_snapshot(1) < 0)
+                        return -1;
+                interval = now_ns() - start;
+                start += interval;
+
+                compute_usages();
+                print_report(interval, show_threads);
+        }
+        return 0;
+}
@@ -0,0 +1,475 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <chcore/container/hashtable.h>
+#include <chcore/container/list.h>
+
+#include "fs_dcache.h"
+
+#define DCACHE_HASH_SIZE 1024
+/* Dentries checked for eviction at most when the cache is full */
+#define DCACHE_EVICT_SCAN 32
+
+enum dentry_state {
+        /* Only known to be on the way to cached descendants */
+        DENTRY_UNKNOWN = 0,
+        DENTRY_POSITIVE,
+        DENTRY_NEGATIVE,
+};
+
+struct dentry {
+        struct dentry *parent;
+        char *name;
+        int name_len;
+        u32 hash;
+        enum dentry_state state;
+
+        struct hlist_node hash_node;
+        struct list_head lru_node;
+        /* Negative dentries have no children */
+        struct list_head children;
+        struct list_head child_node;
+};
+
+struct fs_dcache_stat dcache_stat;
+__attribute__((weak)) const bool fs_dcache_disabled = false;
+
+/* Operations of the FS, called on misses */
+static struct fs_server_ops fs_ops;
+
+static struct dentry dcache_root = {.state = DENTRY_POSITIVE};
+static struct htable dcache_table;
+/* Most recently used first */
+static struct list_head dcache_lru;
+static int nr_dentries;
+/*
+ * Bumped by invalidations, so that results of lookups racing with them are
+ * not recorded.
+ */
+static unsigned long dcache_gen;
+static bool dcache_off;
+static pthread_mutex_t dcache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static u32 dentry_hash(struct dentry *parent, const char *name, int len)
+{
+        u32 hash = 2166136261u;
+        int i;
+
+        /* FNV-1a */
+        for (i = 0; i < len; i++) {
+                hash ^= (unsigned char)name[i];
+                hash *= 16777619u;
+        }
+        return hash ^ (u32)((unsigned long)parent >> 4);
+}
+
+static struct dentry *dentry_find(struct dentry *parent, const char *name,
+                                  int len)
+{
+        struct dentry *d;
+        u32 hash;
+
+        hash = dentry_hash(parent, name, len);
+        for_each_in_hlist (d, hash_node, htable_get_bucket(&dcache_table, hash)) {
+                if (d->hash == hash && d->parent == parent
+                    && d->name_len == len && memcmp(d->name, name, len) == 0)
+                        return d;
+        }
+        return NULL;
+}
+
+static void dentry_free(struct dentry *d)
+{
+        struct dentry *child, *tmp;
+
+        for_each_in_list_safe (child, tmp, child_node, &d->children)
+                dentry_free(child);
+
+        htable_del(&d->hash_node);
+        list_del(&d->lru_node);
+        list_del(&d->child_node);
+        nr_dentries--;
+        free(d->name);
+        free(d);
+}
+
+static void dentry_free_children(struct dentry *d)
+{
+        struct dentry *child, *tmp;
+
+        for_each_in_list_safe (child, tmp, child_node, &d->children)
+                dentry_free(child);
+}
+
+/* Drop some least recently used dentries without children, except @keep */
+static void dcache_evict(struct dentry *keep)
+{
+        struct dentry *d, *tmp;
+        int scanned = 0;
+
+        for (d = list_entry(dcache_lru.prev, struct dentry, lru_node);
+             &d->lru_node != &dcache_lru && scanned < DCACHE_EVICT_SCAN;
+             d = tmp, scanned++) {
+                tmp = list_entry(d->lru_node.prev, struct dentry, lru_node);
+                if (d != keep && list_empty(&d->children))
+                        dentry_free(d);
+                if (nr_dentries < FS_DCACHE_MAX_DENTRIES)
+                        break;
+        }
+}
+
+static struct dentry *dentry_new(struct dentry *parent, const char *name,
+                                 int len)
+{
+        struct dentry *d;
+
+        if (nr_dentries >= FS_DCACHE_MAX_DENTRIES)
+                dcache_evict(parent);
+
+        d = malloc(sizeof(*d));
+        if (!d)
+                return NULL;
+        d->name = strndup(name, len);
+        if (!d->name) {
+                free(d);
+                return NULL;
+        }
+        d->parent = parent;
+        d->name_len = len;
+        d->hash = dentry_hash(parent, name, len);
+        d->state = DENTRY_UNKNOWN;
+        init_list_head(&d->children);
+
+        htable_add(&dcache_table, d->hash, &d->hash_node);
+        list_add(&d->lru_node, &dcache_lru);
+        list_append(&d->child_node, &parent->children);
+        nr_dentries++;
+        return d;
+}
+
+/* Returns the length of the next component, skipping the leading '/'s */
+static int next_component(const char **path)
+{
+        const char *p = *path;
+        int len = 0;
+
+        while (*p == '/')
+                p++;
+        while (p[len] && p[len] != '/')
+                len++;
+        *path = p;
+        return len;
+}
+
+/*
+ * Walk @path from the root with dcache_lock held, and return its dentry.
+ * Missing dentries are created if @create, or NULL is returned. A negative
+ * dentry on the way is returned at once, and NULL for paths not cached as
+ * they are written (e.g., with "..").
+ */
+static struct dentry *dcache_walk(const char *path, bool create)
+{
+        struct dentry *d = &dcache_root, *child;
+        int len;
+
+        while ((len = next_component(&path)) > 0) {
+                if (d->state == DENTRY_NEGATIVE)
+                        return d;
+                if (len > NAME_MAX || (path[0] == '.' && len == 1)
+                    || (path[0] == '.' && path[1] == '.' && len == 2))
+                        return NULL;
+
+                child = dentry_find(d, path, len);
+                if (!child) {
+                        if (!create)
+                                return NULL;
+                        child = dentry_new(d, path, len);
+                        if (!child)
+                                return NULL;
+                }
+                list_del(&child->lru_node);
+                list_add(&child->lru_node, &dcache_lru);
+
+                d = child;
+                path += len;
+        }
+        return d;
+}
+
+/*
+ * Returns what is known about @path, and the generation to record the result
+ * from the FS with.
+ */
+static enum dentry_state dcache_lookup(const char *path, unsigned long *gen)
+{
+        enum dentry_state state = DENTRY_UNKNOWN;
+        struct dentry *d;
+
+        pthread_mutex_lock(&dcache_lock);
+        *gen = dcache_gen;
+        if (!dcache_off) {
+                d = dcache_walk(path, false);
+                if (d)
+                        state = d->state;
+        }
+        if (state == DENTRY_NEGATIVE) {
+                dcache_stat.hit++;
+                dcache_stat.negative_hit++;
+        } else if (state == DENTRY_POSITIVE) {
+                dcache_stat.hit++;
+        } else {
+                dcache_stat.miss++;
+        }
+        pthread_mutex_unlock(&dcache_lock);
+        return state;
+}
+
+/* Record the result of looking up @path in the FS, @ret as returned by it */
+static void dcache_record(const char *path, int ret, unsigned long gen)
+{
+        struct dentry *d;
+
+        if (ret < 0 && ret != -ENOENT)
+                return;
+
+        pthread_mutex_lock(&dcache_lock);
+        if (dcache_off || gen != dcache_gen)
+                goto out;
+        d = dcache_walk(path, true);
+        if (!d || d == &dcache_root || d->state == DENTRY_NEGATIVE)
+                goto out;
+
+        if (ret == -ENOENT) {
+                dentry_free_children(d);
+                d->state = DENTRY_NEGATIVE;
+        } else {
+                /* So are the directories on the way */
+                for (; d != &dcache_root; d = d->parent)
+                        d->state = DENTRY_POSITIVE;
+        }
+out:
+        pthread_mutex_unlock(&dcache_lock);
+}
+
+/* @path is added or removed (or may be) */
+static void dcache_invalidate(const char *path)
+{
+        struct dentry *d;
+
+        pthread_mutex_lock(&dcache_lock);
+        dcache_gen++;
+        d = dcache_walk(path, false);
+        if (d == &dcache_root)
+                dentry_free_children(d);
+        else if (d)
+                dentry_free(d);
+        pthread_mutex_unlock(&dcache_lock);
+}
+
+void fs_dcache_flush(void)
+{
+        pthread_mutex_lock(&dcache_lock);
+        dcache_gen++;
+        dentry_free_children(&dcache_root);
+        pthread_mutex_unlock(&dcache_lock);
+}
+
+static void dcache_turn_off(void)
+{
+        pthread_mutex_lock(&dcache_lock);
+        dcache_off = true;
+        dcache_gen++;
+        dentry_free_children(&dcache_root);
+        pthread_mutex_unlock(&dcache_lock);
+}
+
+/* ++++++++++++++++++++++++ Wrapped Operations ++++++++++++++++++++++++++++ */
+
+static int dcache_mount(ipc_msg_t *ipc_msg, struct fs_request *fr)
+{
+        int ret;
+
+        ret = fs_ops.mount(ipc_msg, fr);
+        fs_dcache_flush();
+        return ret;
+}
+
+static int dcache_umount(ipc_msg_t *ipc_msg, struct fs_request *fr)
+{
+        int ret;
+
+        ret = fs_ops.umount(ipc_msg, fr);
+        fs_dcache_flush();
+        return ret;
+}
+
+static int dcache_open(char *path, int flags, int mode, ino_t *vnode_id,
+                       off_t *vnode_size, int *vnode_type, void **private)
+{
+        unsigned long gen;
+        int ret;
+
+        if (flags & O_CREAT) {
+                ret = fs_ops.open(path, flags, mode, vnode_id, vnode_size,
+                                  vnode_type, private);
+                dcache_invalidate(path);
+                return ret;
+        }
+
+        if (dcache_lookup(path, &gen) == DENTRY_NEGATIVE)
+                return -ENOENT;
+        ret = fs_ops.open(
+                path, flags, mode, vnode_id, vnode_size, vnode_type, private);
+        dcache_record(path, ret, gen);
+        return ret;
+}
+
+static int dcache_creat(ipc_msg_t *ipc_msg, struct fs_request *fr)
+{
+        int ret;
+
+        ret = fs_ops.creat(ipc_msg, fr);
+        dcache_invalidate(fr->creat.pathname);
+        return ret;
+}
+
+static int dcache_unlink(const char *path, int flags)
+{
+        int ret;
+
+        ret = fs_ops.unlink(path, flags);
+        dcache_invalidate(path);
+        return ret;
+}
+
+static int dcache_mkdir(const char *path, mode_t mode)
+{
+        int ret;
+
+        ret = fs_ops.mkdir(path, mode);
+        dcache_invalidate(path);
+        return ret;
+}
+
+static int dcache_rmdir(const char *path, int flags)
+{
+        int ret;
+
+        ret = fs_ops.rmdir(path, flags);
+        dcache_invalidate(path);
+        return ret;
+}
+
+static int dcache_rename(const char *oldpath, const char *newpath)
+{
+        int ret;
+
+        ret = fs_ops.rename(oldpath, newpath);
+        dcache_invalidate(oldpath);
+        dcache_invalidate(newpath);
+        return ret;
+}
+
+static int dcache_fstatat(const char *path, struct stat *st, int flags)
+{
+        unsigned long gen;
+        int ret;
+
+        if (dcache_lookup(path, &gen) == DENTRY_NEGATIVE)
+                return -ENOENT;
+        ret = fs_ops.fstatat(path, st, flags);
+        if (ret == 0 && S_ISLNK(st->st_mode))
+                dcache_turn_off();
+        else
+                dcache_record(path, ret, gen);
+        return ret;
+}
+
+static int dcache_faccessat(ipc_msg_t *ipc_msg, struct fs_request *fr)
+{
+        enum dentry_state state;
+        unsigned long gen;
+        int ret;
+
+        state = dcache_lookup(fr->faccessat.pathname, &gen);
+        if (state == DENTRY_NEGATIVE)
+                return -ENOENT;
+        if (state == DENTRY_POSITIVE && fr->faccessat.mode == F_OK)
+                return 0;
+        ret = fs_ops.faccessat(ipc_msg, fr);
+        dcache_record(fr->faccessat.pathname, ret, gen);
+        return ret;
+}
+
+static int dcache_symlinkat(ipc_msg_t *ipc_msg, struct fs_request *fr)
+{
+        int ret;
+
+        ret = fs_ops.symlinkat(ipc_msg, fr);
+        if (ret == 0)
+                dcache_turn_off();
+        else
+                dcache_invalidate(fr->symlinkat.linkpath);
+        return ret;
+}
+
+static ssize_t dcache_readlinkat(ipc_msg_t *ipc_msg, struct fs_request *fr)
+{
+        ssize_t ret;
+
+        ret = fs_ops.readlinkat(ipc_msg, fr);
+        if (ret >= 0)
+                dcache_turn_off();
+        return ret;
+}
+
+void fs_dcache_install(struct fs_server_ops *ops)
+{
+        init_htable(&dcache_table, DCACHE_HASH_SIZE);
+        if (!dcache_table.buckets)
+                return;
+        init_list_head(&dcache_lru);
+        init_list_head(&dcache_root.children);
+
+        fs_ops = *ops;
+#define DCACHE_WRAP(op)                     \
+        do {                                \
+                if (ops->op)                \
+                        ops->op = dcache_##op; \
+        } while (0)
+        DCACHE_WRAP(mount);
+        DCACHE_WRAP(umount);
+        DCACHE_WRAP(open);
+        DCACHE_WRAP(creat);
+        DCACHE_WRAP(unlink);
+        DCACHE_WRAP(mkdir);
+        DCACHE_WRAP(rmdir);
+        DCACHE_WRAP(rename);
+        DCACHE_WRAP(fstatat);
+        DCACHE_WRAP(faccessat);
+        DCACHE_WRAP(symlinkat);
+        DCACHE_WRAP(readlinkat);
+#undef DCACHE_WRAP
+}
+
+/* server_ops is initialized statically by each FS */
+__attribute__((constructor)) static void fs_dcache_init(void)
+{
+        if (!fs_dcache_disabled)
+                fs_dcache_install(&server_ops);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef FS_DCACHE_H
+#define FS_DCACHE_H
+
+#include <stdbool.h>
+
+#include "fs_wrapper_defs.h"
+
+/*
+ * Dentry cache shared by the FS servers linked with fs_base.
+ *
+ * Results of path lookups (open, fstatat and faccessat) are kept in a tree of
+ * dentries, hashed by (parent dentry, name). A negative dentry records that a
+ * path does not exist, so that probing missing files (e.g., searching PATH)
+ * is answered without walking the FS. Existing paths are remembered as well,
+ * to answer F_OK accesses and to find the dentries under them.
+ *
+ * The cache wraps the path operations of server_ops, so FSs need no changes:
+ * every operation adding or removing names invalidates the dentries of the
+ * paths involved. It is installed before main() unless the FS defines
+ * fs_dcache_disabled as true, which FSs with case-insensitive names should.
+ * It turns itself off after meeting a symlink, as paths are cached as they
+ * are written, without resolving symlinks.
+ */
+
+/* Dentries kept at most, the least recently used are dropped beyond */
+#define FS_DCACHE_MAX_DENTRIES 4096
+
+struct fs_dcache_stat {
+        /* Lookups answered by the cache, and of them, for missing paths */
+        unsigned long hit;
+        unsigned long negative_hit;
+        /* Lookups passed to the FS */
+        unsigned long miss;
+};
+
+extern struct fs_dcache_stat dcache_stat;
+/* Weak, false by default */
+extern const bool fs_dcache_disabled;
+
+void fs_dcache_install(struct fs_server_ops *ops);
+/* Drop all the dentries, e.g., after the FS is changed behind server_ops */
+void fs_dcache_flush(void);
+
+#endif /* FS_DCACHE_H */
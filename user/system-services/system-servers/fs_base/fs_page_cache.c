@@ -0,0 +1,1452 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <chcore/bug.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fs_page_cache.h"
+#include "fs_wrapper_defs.h"
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+static struct fs_page_cache page_cache;
+
+static inline void count_hit(void)
+{
+#ifdef TEST_COUNT_PAGE_CACHE
+        __atomic_fetch_add(&count.hit, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void count_miss(void)
+{
+#ifdef TEST_COUNT_PAGE_CACHE
+        __atomic_fetch_add(&count.miss, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static struct page_cache_shard *
+shard_of(struct page_cache_entity_of_inode *pce, pidx_t file_page_idx)
+{
+        u64 hash = (u64)pce->host_idx * 31 + (u64)file_page_idx;
+
+        return &page_cache.shards[hash % PAGE_CACHE_SHARDS];
+}
+
+static void flush_single_block(struct cached_page *p, int page_block_idx)
+{
+        int ret;
+
+        if (!p->dirty[page_block_idx])
+                return;
+
+        ret = page_cache.user_func.file_write(
+                p->content + page_block_idx * CACHED_BLOCK_SIZE,
+                p->file_page_idx,
+                page_block_idx,
+                p->owner->private_data);
+        if (ret <= 0)
+                BUG("[flush_single_block] file_write failed\n");
+        p->dirty[page_block_idx] = false;
+}
+
+static int dirty_key_cmp(ino_t host_idx, pidx_t file_page_idx,
+                         const struct cached_page *p)
+{
+        if (host_idx != p->owner->host_idx)
+                return host_idx < p->owner->host_idx ? -1 : 1;
+        if (file_page_idx != p->file_page_idx)
+                return file_page_idx < p->file_page_idx ? -1 : 1;
+        return 0;
+}
+
+static bool dirty_index_less(const struct rb_node *lhs,
+                             const struct rb_node *rhs)
+{
+        const struct cached_page *l, *r;
+
+        l = rb_entry(lhs, struct cached_page, dirty_node);
+        r = rb_entry(rhs, struct cached_page, dirty_node);
+        return dirty_key_cmp(l->owner->host_idx, l->file_page_idx, r) < 0;
+}
+
+/* Called with the page locked for write. */
+static void dirty_index_add(struct cached_page *p)
+{
+        if (p->in_dirty_index)
+                return;
+
+        pthread_mutex_lock(&page_cache.dirty_lock);
+        rb_insert(&page_cache.dirty_index, &p->dirty_node, dirty_index_less);
+        p->in_dirty_index = true;
+        page_cache.nr_dirty_pages++;
+        if (page_cache.nr_dirty_pages == DIRTY_BACKGROUND_PAGES + 1)
+                pthread_cond_signal(&page_cache.flusher_cond);
+        pthread_mutex_unlock(&page_cache.dirty_lock);
+}
+
+/*
+ * Called with the page locked, or the pce_lock held for write. Readers
+ * of the page may race here, so it is checked again with dirty_lock.
+ */
+static void dirty_index_del(struct cached_page *p)
+{
+        if (!p->in_dirty_index)
+                return;
+
+        pthread_mutex_lock(&page_cache.dirty_lock);
+        if (p->in_dirty_index) {
+                rb_erase(&page_cache.dirty_index, &p->dirty_node);
+                p->in_dirty_index = false;
+                page_cache.nr_dirty_pages--;
+        }
+        pthread_mutex_unlock(&page_cache.dirty_lock);
+}
+
+static bool page_is_dirty(struct cached_page *p)
+{
+        int i;
+
+        for (i = 0; i < BLOCK_PER_PAGE; i++) {
+                if (p->dirty[i])
+                        return true;
+        }
+        return false;
+}
+
+static void flush_single_page(struct cached_page *p)
+{
+        int i, nr_dirty = 0, ret;
+
+        BUG_ON(p == NULL);
+        for (i = 0; i < BLOCK_PER_PAGE; i++)
+                nr_dirty += p->dirty[i];
+
+        /*
+         * Merge the blocks into one write of the page if most of them are
+         * dirty. The clean blocks hold what was read from the file, and
+         * file_write clips the page at the end of file.
+         */
+        if (nr_dirty > BLOCK_PER_PAGE / 2) {
+                ret = page_cache.user_func.file_write(
+                        p->content, p->file_page_idx, -1, p->owner->private_data);
+                if (ret <= 0)
+                        BUG("[flush_single_page] file_write failed\n");
+                memset(p->dirty, false, sizeof(p->dirty));
+        } else if (nr_dirty) {
+                for (i = 0; i < BLOCK_PER_PAGE; i++)
+                        flush_single_block(p, i);
+        }
+
+        dirty_index_del(p);
+}
+
+/* Write back a block, or the page if @page_block_idx is -1. */
+static void flush_block_or_page(struct cached_page *p, int page_block_idx)
+{
+        if (page_block_idx == -1) {
+                flush_single_page(p);
+                return;
+        }
+        flush_single_block(p, page_block_idx);
+        if (!page_is_dirty(p))
+                dirty_index_del(p);
+}
+
+static void set_block_or_page_dirty(struct cached_page *p, int page_block_idx)
+{
+        if (page_block_idx == -1)
+                memset(p->dirty, true, sizeof(p->dirty));
+        else
+                p->dirty[page_block_idx] = true;
+}
+
+static void cached_pages_list_append_node(struct cached_pages_list *list,
+                                          struct list_head *node)
+{
+        list_append(node, &list->queue);
+        list->size++;
+}
+
+static void cached_pages_list_delete_node(struct cached_pages_list *list,
+                                          struct list_head *node)
+{
+        list_del(node);
+        list->size--;
+        BUG_ON(list->size < 0);
+}
+
+/*
+ * Put @p at the tail of the active, inactive or pinned list of @shard.
+ * Called with the shard locked.
+ */
+static void page_list_add(struct page_cache_shard *shard, struct cached_page *p,
+                          PAGE_CACHE_LIST_TYPE type)
+{
+        switch (type) {
+        case ACTIVE_LIST:
+                cached_pages_list_append_node(&shard->active_list,
+                                              &p->two_list_node);
+                break;
+        case INACTIVE_LIST:
+                cached_pages_list_append_node(&shard->inactive_list,
+                                              &p->two_list_node);
+                break;
+        case PINNED_PAGES_LIST:
+                cached_pages_list_append_node(&shard->pinned_pages_list,
+                                              &p->pinned_pages_node);
+                __atomic_fetch_add(
+                        &page_cache.nr_pinned_pages, 1, __ATOMIC_RELAXED);
+                break;
+        default:
+                BUG("Invalid list type.\n");
+        }
+        p->in_which_list = type;
+}
+
+/*
+ * Take @p out of the active, inactive or pinned list of @shard.
+ * Called with the shard locked.
+ */
+static void page_list_del(struct page_cache_shard *shard, struct cached_page *p)
+{
+        switch (p->in_which_list) {
+        case ACTIVE_LIST:
+                cached_pages_list_delete_node(&shard->active_list,
+                                              &p->two_list_node);
+                break;
+        case INACTIVE_LIST:
+                cached_pages_list_delete_node(&shard->inactive_list,
+                                              &p->two_list_node);
+                break;
+        case PINNED_PAGES_LIST:
+                cached_pages_list_delete_node(&shard->pinned_pages_list,
+                                              &p->pinned_pages_node);
+                __atomic_fetch_sub(
+                        &page_cache.nr_pinned_pages, 1, __ATOMIC_RELAXED);
+                break;
+        default:
+                BUG("Try to free a page that is not in ACTIVE_LIST, "
+                    "INACTIVE_LIST or PINNED_PAGES_LIST.\n");
+        }
+        p->in_which_list = INODE_PAGES_LIST;
+}
+
+/* Called with the owner's pce_lock held for write and the shard locked. */
+static void free_page(struct page_cache_shard *shard, struct cached_page *p)
+{
+        struct page_cache_entity_of_inode *pce;
+
+        BUG_ON(p == NULL);
+        pce = p->owner;
+
+        free(p->content);
+        dirty_index_del(p);
+        page_list_del(shard, p);
+        cached_pages_list_delete_node(&pce->pages, &p->inode_pages_node);
+        p->in_which_list = UNKNOWN_LIST;
+        radix_del(&pce->idx2page, p->file_page_idx, 0);
+
+        pce->pages_cnt--;
+        if (pce->pages_cnt == 0
+            && page_cache.user_func.handler_pce_turns_empty)
+                page_cache.user_func.handler_pce_turns_empty(
+                        pce->private_data);
+
+        pthread_rwlock_destroy(&p->page_rwlock);
+        free(p);
+}
+
+/*
+ * Write back and free @p unless it is in use. @locked_pce is the pce
+ * whose pce_lock is already held for write by the caller, if any.
+ * Called with the shard locked.
+ */
+static bool try_evict_page(struct page_cache_shard *shard, struct cached_page *p,
+                           struct page_cache_entity_of_inode *locked_pce)
+{
+        struct page_cache_entity_of_inode *pce = p->owner;
+
+        if (pce != locked_pce && pthread_rwlock_trywrlock(&pce->pce_lock) != 0)
+                return false;
+        if (pthread_rwlock_trywrlock(&p->page_rwlock) != 0) {
+                if (pce != locked_pce)
+                        pthread_rwlock_unlock(&pce->pce_lock);
+                return false;
+        }
+
+        flush_single_page(p);
+        pthread_rwlock_unlock(&p->page_rwlock);
+        free_page(shard, p);
+
+        if (pce != locked_pce)
+                pthread_rwlock_unlock(&pce->pce_lock);
+        return true;
+}
+
+static inline bool page_test_and_clear_referenced(struct cached_page *p)
+{
+        return __atomic_exchange_n(&p->referenced, false, __ATOMIC_RELAXED);
+}
+
+static void two_list_add_page(struct page_cache_shard *shard,
+                              struct cached_page *p)
+{
+        page_list_add(shard, p, INACTIVE_LIST);
+}
+
+static void two_list_balance(struct page_cache_shard *shard,
+                             struct page_cache_entity_of_inode *locked_pce)
+{
+        struct cached_page *p;
+        int scan;
+
+        for (scan = shard->active_list.size;
+             scan > 0 && shard->active_list.size > SHARD_ACTIVE_MAX;
+             scan--) {
+                p = list_entry(shard->active_list.queue.next,
+                               struct cached_page,
+                               two_list_node);
+                page_list_del(shard, p);
+                if (page_test_and_clear_referenced(p))
+                        page_list_add(shard, p, ACTIVE_LIST);
+                else
+                        page_list_add(shard, p, INACTIVE_LIST);
+        }
+
+        for (scan = shard->inactive_list.size;
+             scan > 0 && shard->inactive_list.size > SHARD_INACTIVE_MAX;
+             scan--) {
+                p = list_entry(shard->inactive_list.queue.next,
+                               struct cached_page,
+                               two_list_node);
+                if (page_test_and_clear_referenced(p)) {
+                        page_list_del(shard, p);
+                        page_list_add(shard, p, ACTIVE_LIST);
+                } else if (!try_evict_page(shard, p, locked_pce)) {
+                        /* In use, try it again later. */
+                        page_list_del(shard, p);
+                        page_list_add(shard, p, INACTIVE_LIST);
+                }
+        }
+}
+
+static const struct page_cache_policy_ops two_list_policy_ops = {
+        .add_page = two_list_add_page,
+        .balance = two_list_balance,
+};
+
+/* An evicted page remembered by ARC_POLICY. */
+struct ghost_entry {
+        ino_t host_idx;
+        pidx_t file_page_idx;
+        /* ACTIVE_LIST if in B2, INACTIVE_LIST if in B1. */
+        PAGE_CACHE_LIST_TYPE from;
+        struct list_head lru_node;
+        struct list_head hash_node;
+};
+
+static struct list_head *ghost_bucket(struct page_cache_shard *shard,
+                                      ino_t host_idx, pidx_t file_page_idx)
+{
+        /* The low bits choose the shard already. */
+        u64 hash = ((u64)host_idx * 31 + (u64)file_page_idx)
+                   / PAGE_CACHE_SHARDS;
+
+        return &shard->ghost_hash[hash % GHOST_HASH_SIZE];
+}
+
+static void ghost_del(struct page_cache_shard *shard, struct ghost_entry *g)
+{
+        list_del(&g->lru_node);
+        list_del(&g->hash_node);
+        if (g->from == INACTIVE_LIST)
+                shard->ghost_b1_size--;
+        else
+                shard->ghost_b2_size--;
+        free(g);
+}
+
+static struct ghost_entry *ghost_find(struct page_cache_shard *shard,
+                                      ino_t host_idx, pidx_t file_page_idx)
+{
+        struct list_head *bucket;
+        struct ghost_entry *g;
+
+        bucket = ghost_bucket(shard, host_idx, file_page_idx);
+        for_each_in_list (g, struct ghost_entry, hash_node, bucket) {
+                if (g->host_idx == host_idx
+                    && g->file_page_idx == file_page_idx)
+                        return g;
+        }
+        return NULL;
+}
+
+/*
+ * Remember a page evicted from @from, and forget the oldest entries so
+ * that |T1| + |B1| <= c and |T1| + |T2| + |B1| + |B2| <= 2c.
+ */
+static void ghost_add(struct page_cache_shard *shard, ino_t host_idx,
+                      pidx_t file_page_idx, PAGE_CACHE_LIST_TYPE from)
+{
+        struct ghost_entry *g;
+        int resident;
+
+        g = malloc(sizeof(*g));
+        if (g) {
+                g->host_idx = host_idx;
+                g->file_page_idx = file_page_idx;
+                g->from = from;
+                list_add(&g->hash_node,
+                         ghost_bucket(shard, host_idx, file_page_idx));
+                if (from == INACTIVE_LIST) {
+                        list_append(&g->lru_node, &shard->ghost_b1);
+                        shard->ghost_b1_size++;
+                } else {
+                        list_append(&g->lru_node, &shard->ghost_b2);
+                        shard->ghost_b2_size++;
+                }
+        }
+
+        while (shard->ghost_b1_size > 0
+               && shard->inactive_list.size + shard->ghost_b1_size
+                          > SHARD_CAPACITY) {
+                g = list_entry(
+                        shard->ghost_b1.next, struct ghost_entry, lru_node);
+                ghost_del(shard, g);
+        }
+
+        resident = shard->inactive_list.size + shard->active_list.size;
+        while (shard->ghost_b2_size > 0
+               && resident + shard->ghost_b1_size + shard->ghost_b2_size
+                          > 2 * SHARD_CAPACITY) {
+                g = list_entry(
+                        shard->ghost_b2.next, struct ghost_entry, lru_node);
+                ghost_del(shard, g);
+        }
+}
+
+static void arc_add_page(struct page_cache_shard *shard, struct cached_page *p)
+{
+        struct ghost_entry *g;
+        int b1, b2;
+
+        g = ghost_find(shard, p->owner->host_idx, p->file_page_idx);
+        if (g == NULL) {
+                page_list_add(shard, p, INACTIVE_LIST);
+                return;
+        }
+
+        /*
+         * Evicted too early. Grow T1 if it came from B1, and T2
+         * otherwise, by the ratio of the ghost lists.
+         */
+        b1 = MAX(shard->ghost_b1_size, 1);
+        b2 = MAX(shard->ghost_b2_size, 1);
+        if (g->from == INACTIVE_LIST)
+                shard->arc_target =
+                        MIN(shard->arc_target + MAX(b2 / b1, 1),
+                            SHARD_CAPACITY);
+        else
+                shard->arc_target =
+                        MAX(shard->arc_target - MAX(b1 / b2, 1), 0);
+        ghost_del(shard, g);
+
+        page_list_add(shard, p, ACTIVE_LIST);
+}
+
+static void arc_balance(struct page_cache_shard *shard,
+                        struct page_cache_entity_of_inode *locked_pce)
+{
+        struct cached_pages_list *list;
+        PAGE_CACHE_LIST_TYPE type;
+        struct cached_page *p;
+        pidx_t file_page_idx;
+        ino_t host_idx;
+        int scan;
+
+        /* Pages in use are skipped, so give up after two rounds. */
+        for (scan = 2 * (shard->inactive_list.size + shard->active_list.size);
+             scan > 0
+             && shard->inactive_list.size + shard->active_list.size
+                        > SHARD_CAPACITY;
+             scan--) {
+                if (shard->inactive_list.size > 0
+                    && (shard->inactive_list.size
+                                >= MAX(shard->arc_target, 1)
+                        || shard->active_list.size == 0)) {
+                        list = &shard->inactive_list;
+                        type = INACTIVE_LIST;
+                } else {
+                        list = &shard->active_list;
+                        type = ACTIVE_LIST;
+                }
+
+                p = list_entry(
+                        list->queue.next, struct cached_page, two_list_node);
+                if (page_test_and_clear_referenced(p)) {
+                        /* Seen again, to the tail of T2. */
+                        page_list_del(shard, p);
+                        page_list_add(shard, p, ACTIVE_LIST);
+                        continue;
+                }
+
+                host_idx = p->owner->host_idx;
+                file_page_idx = p->file_page_idx;
+                if (try_evict_page(shard, p, locked_pce)) {
+                        ghost_add(shard, host_idx, file_page_idx, type);
+                } else {
+                        page_list_del(shard, p);
+                        page_list_add(shard, p, type);
+                }
+        }
+}
+
+static const struct page_cache_policy_ops arc_policy_ops = {
+        .add_page = arc_add_page,
+        .balance = arc_balance,
+};
+
+/*
+ * Record an access to a cached page, no list is touched here.
+ * Called with pce_lock held.
+ */
+static void page_accessed(struct cached_page *p)
+{
+        /*
+         * The first access of a page read ahead is not a reuse, so that
+         * streaming reads never push the hot pages out of the active list.
+         */
+        if (__atomic_exchange_n(&p->readahead, false, __ATOMIC_RELAXED))
+                return;
+        __atomic_store_n(&p->referenced, true, __ATOMIC_RELAXED);
+}
+
+/*
+ * Allocate a page for @file_page_idx and put it into the inactive list.
+ * The page is returned write-locked, and the contents are left to the
+ * caller to read. Called with pce_lock held for write.
+ */
+static struct cached_page *new_page(struct page_cache_entity_of_inode *pce,
+                                    pidx_t file_page_idx)
+{
+        struct page_cache_shard *shard;
+        struct cached_page *p;
+
+        p = calloc(1, sizeof(*p));
+        if (p == NULL)
+                return NULL;
+
+        p->owner = pce;
+        p->file_page_idx = file_page_idx;
+        init_list_head(&p->two_list_node);
+        init_list_head(&p->pinned_pages_node);
+        init_list_head(&p->inode_pages_node);
+        pthread_rwlock_init(&p->page_rwlock, NULL);
+        /* Keeps the policy from evicting it right away. */
+        pthread_rwlock_wrlock(&p->page_rwlock);
+
+        p->content = aligned_alloc(CACHED_PAGE_SIZE, CACHED_PAGE_SIZE);
+        BUG_ON(!p->content);
+        memset(p->content, 0, CACHED_PAGE_SIZE);
+
+        cached_pages_list_append_node(&pce->pages, &p->inode_pages_node);
+        p->in_which_list = INODE_PAGES_LIST;
+        radix_add(&pce->idx2page, file_page_idx, p);
+
+        pce->pages_cnt++;
+        if (pce->pages_cnt == 1
+            && page_cache.user_func.handler_pce_turns_nonempty)
+                page_cache.user_func.handler_pce_turns_nonempty(
+                        pce->private_data);
+
+        shard = shard_of(pce, file_page_idx);
+        pthread_mutex_lock(&shard->shard_lock);
+        page_cache.policy_ops->add_page(shard, p);
+        page_cache.policy_ops->balance(shard, pce);
+        pthread_mutex_unlock(&shard->shard_lock);
+
+        return p;
+}
+
+/*
+ * Read a page not cached yet. Called with pce_lock held for write.
+ */
+static struct cached_page *
+find_or_new_page(struct page_cache_entity_of_inode *pce, pidx_t file_page_idx)
+{
+        struct cached_page *p;
+
+        p = radix_get(&pce->idx2page, file_page_idx);
+        if (p) {
+                count_hit();
+                page_accessed(p);
+                return p;
+        }
+
+        count_miss();
+        p = new_page(pce, file_page_idx);
+        if (p == NULL) {
+                printf("[find_or_new_page] new_page failed\n");
+                return NULL;
+        }
+        page_cache.user_func.file_read(
+                p->content, file_page_idx, pce->private_data);
+        pthread_rwlock_unlock(&p->page_rwlock);
+
+        return p;
+}
+
+/*
+ * Track the reads of @pce and queue the next window for the readahead
+ * thread. Once the window is set up, it is read again when half of it has
+ * been consumed, so that the pages are ready before they are read.
+ * Returns whether the last page read is read again.
+ * Called with pce_lock held.
+ */
+static bool page_cache_readahead(struct page_cache_entity_of_inode *pce,
+                                 pidx_t file_page_idx)
+{
+        struct readahead_request *req;
+        bool reread = false;
+
+        pthread_mutex_lock(&pce->ra_lock);
+
+        if (file_page_idx == pce->ra_prev_idx) {
+                reread = true;
+                goto out;
+        }
+
+        if (pce->ra_prev_idx < 0 || file_page_idx != pce->ra_prev_idx + 1) {
+                /* Random read, collapse the window. */
+                pce->ra_prev_idx = file_page_idx;
+                pce->ra_next_idx = file_page_idx + 1;
+                pce->ra_window = 0;
+                goto out;
+        }
+
+        pce->ra_prev_idx = file_page_idx;
+        if (pce->ra_next_idx <= file_page_idx)
+                pce->ra_next_idx = file_page_idx + 1;
+        if (pce->ra_window
+            && pce->ra_next_idx - file_page_idx > pce->ra_window / 2)
+                goto out;
+
+        pthread_mutex_lock(&page_cache.page_cache_lock);
+        /* Drop it if the readahead thread falls behind. */
+        if (page_cache.ra_tail - page_cache.ra_head < READAHEAD_QUEUE_LEN) {
+                pce->ra_window =
+                        pce->ra_window ?
+                                MIN(pce->ra_window * 2, READAHEAD_MAX_PAGES) :
+                                READAHEAD_INIT_PAGES;
+                req = &page_cache.ra_queue[page_cache.ra_tail
+                                           % READAHEAD_QUEUE_LEN];
+                req->pce = pce;
+                req->start = pce->ra_next_idx;
+                req->nr_pages = pce->ra_window;
+                page_cache.ra_tail++;
+                pce->ra_next_idx += pce->ra_window;
+                pthread_cond_signal(&page_cache.ra_cond);
+        }
+        pthread_mutex_unlock(&page_cache.page_cache_lock);
+
+out:
+        pthread_mutex_unlock(&pce->ra_lock);
+        return reread;
+}
+
+/*
+ * Drop the readahead of @pce whose pages are going away.
+ * Called with pce_lock held for write.
+ */
+static void page_cache_readahead_cancel(struct page_cache_entity_of_inode *pce)
+{
+        unsigned int i;
+
+        pthread_mutex_lock(&pce->ra_lock);
+        pce->ra_prev_idx = -1;
+        pce->ra_window = 0;
+        pthread_mutex_unlock(&pce->ra_lock);
+
+        pthread_mutex_lock(&page_cache.page_cache_lock);
+        for (i = page_cache.ra_head; i != page_cache.ra_tail; i++) {
+                if (page_cache.ra_queue[i % READAHEAD_QUEUE_LEN].pce == pce)
+                        page_cache.ra_queue[i % READAHEAD_QUEUE_LEN].nr_pages =
+                                0;
+        }
+        if (page_cache.ra_current == pce)
+                page_cache.ra_current = NULL;
+        pthread_mutex_unlock(&page_cache.page_cache_lock);
+}
+
+static bool readahead_cancelled(void)
+{
+        bool cancelled;
+
+        pthread_mutex_lock(&page_cache.page_cache_lock);
+        cancelled = page_cache.ra_current == NULL;
+        pthread_mutex_unlock(&page_cache.page_cache_lock);
+
+        return cancelled;
+}
+
+/*
+ * Read the queued windows into the inactive lists, one page at a time
+ * under the pce_lock like the reads on misses.
+ */
+static void *readahead_routine(void *args)
+{
+        struct readahead_request req;
+        struct cached_page *p;
+        pidx_t idx;
+        int ret;
+
+        for (;;) {
+                pthread_mutex_lock(&page_cache.page_cache_lock);
+                while (page_cache.ra_head == page_cache.ra_tail)
+                        pthread_cond_wait(&page_cache.ra_cond,
+                                          &page_cache.page_cache_lock);
+                req = page_cache.ra_queue[page_cache.ra_head
+                                          % READAHEAD_QUEUE_LEN];
+                page_cache.ra_head++;
+                page_cache.ra_current = req.pce;
+                pthread_mutex_unlock(&page_cache.page_cache_lock);
+
+                for (idx = req.start; idx < req.start + req.nr_pages; idx++) {
+                        pthread_rwlock_wrlock(&req.pce->pce_lock);
+                        if (readahead_cancelled()) {
+                                pthread_rwlock_unlock(&req.pce->pce_lock);
+                                break;
+                        }
+                        if (radix_get(&req.pce->idx2page, idx)) {
+                                pthread_rwlock_unlock(&req.pce->pce_lock);
+                                continue;
+                        }
+
+                        p = new_page(req.pce, idx);
+                        if (p == NULL) {
+                                pthread_rwlock_unlock(&req.pce->pce_lock);
+                                break;
+                        }
+                        p->readahead = true;
+                        ret = page_cache.user_func.file_read(
+                                p->content, idx, req.pce->private_data);
+                        pthread_rwlock_unlock(&p->page_rwlock);
+                        pthread_rwlock_unlock(&req.pce->pce_lock);
+
+                        /* Likely to be beyond the end of file. */
+                        if (ret <= 0)
+                                break;
+                }
+
+                pthread_mutex_lock(&page_cache.page_cache_lock);
+                page_cache.ra_current = NULL;
+                pthread_mutex_unlock(&page_cache.page_cache_lock);
+        }
+        return NULL;
+}
+
+struct flush_item {
+        struct page_cache_entity_of_inode *pce;
+        pidx_t file_page_idx;
+};
+
+/*
+ * Returns the first dirty page at or after (@host_idx, @file_page_idx).
+ * Called with dirty_lock held.
+ */
+static struct rb_node *dirty_index_lower_bound(ino_t host_idx,
+                                               pidx_t file_page_idx)
+{
+        struct rb_node *node, *found = NULL;
+        struct cached_page *p;
+
+        node = page_cache.dirty_index.root_node;
+        while (node) {
+                p = rb_entry(node, struct cached_page, dirty_node);
+                if (dirty_key_cmp(host_idx, file_page_idx, p) <= 0) {
+                        found = node;
+                        node = node->left_child;
+                } else {
+                        node = node->right_child;
+                }
+        }
+        return found;
+}
+
+/*
+ * Take up to FLUSH_BATCH dirty pages from (*@host_idx, *@file_page_idx)
+ * on, only the ones of @pce unless it is NULL, and move the cursor past
+ * them. Returns the number of pages taken.
+ */
+static int dirty_index_collect(struct flush_item *items,
+                               struct page_cache_entity_of_inode *pce,
+                               ino_t *host_idx, pidx_t *file_page_idx)
+{
+        struct cached_page *p;
+        struct rb_node *node;
+        int n = 0;
+
+        pthread_mutex_lock(&page_cache.dirty_lock);
+        for (node = dirty_index_lower_bound(*host_idx, *file_page_idx);
+             node && n < FLUSH_BATCH;
+             node = rb_next(node)) {
+                p = rb_entry(node, struct cached_page, dirty_node);
+                if (pce && p->owner != pce)
+                        break;
+                items[n].pce = p->owner;
+                items[n].file_page_idx = p->file_page_idx;
+                n++;
+                *host_idx = p->owner->host_idx;
+                *file_page_idx = p->file_page_idx + 1;
+        }
+        pthread_mutex_unlock(&page_cache.dirty_lock);
+
+        return n;
+}
+
+/*
+ * Write back the pages taken from the index, keeping the pce_lock over
+ * the pages of the same inode.
+ */
+static void flush_items(struct flush_item *items, int n)
+{
+        struct page_cache_entity_of_inode *locked = NULL;
+        struct cached_page *p;
+        int i;
+
+        for (i = 0; i < n; i++) {
+                if (items[i].pce != locked) {
+                        if (locked)
+                                pthread_rwlock_unlock(&locked->pce_lock);
+                        locked = items[i].pce;
+                        pthread_rwlock_rdlock(&locked->pce_lock);
+                }
+
+                /* May be freed meanwhile. */
+                p = radix_get(&locked->idx2page, items[i].file_page_idx);
+                if (p == NULL)
+                        continue;
+                pthread_rwlock_rdlock(&p->page_rwlock);
+                flush_single_page(p);
+                pthread_rwlock_unlock(&p->page_rwlock);
+        }
+        if (locked)
+                pthread_rwlock_unlock(&locked->pce_lock);
+
+        pthread_mutex_lock(&page_cache.dirty_lock);
+        pthread_cond_broadcast(&page_cache.dirty_cond);
+        pthread_mutex_unlock(&page_cache.dirty_lock);
+}
+
+/*
+ * Write back the dirty pages of @pce, or of all the inodes if @pce is
+ * NULL, in the order of the index. Pages dirtied behind the cursor are
+ * left to the next round.
+ */
+static void flush_dirty_pages(struct page_cache_entity_of_inode *pce)
+{
+        struct flush_item items[FLUSH_BATCH];
+        ino_t host_idx = pce ? pce->host_idx : 0;
+        pidx_t file_page_idx = 0;
+        int n;
+
+        while ((n = dirty_index_collect(
+                        items, pce, &host_idx, &file_page_idx))
+               > 0)
+                flush_items(items, n);
+}
+
+/* Sync the inodes in sync_list, in the order of their inode numbers. */
+static void flush_synced_inodes(void)
+{
+        struct page_cache_entity_of_inode *pce, *tmp, *next;
+        struct list_head synced;
+
+        init_list_head(&synced);
+        pthread_mutex_lock(&page_cache.dirty_lock);
+        for_each_in_list_safe (pce, tmp, sync_node, &page_cache.sync_list) {
+                list_del(&pce->sync_node);
+                /* Insertion sort, there are a few of them. */
+                for_each_in_list (next,
+                                  struct page_cache_entity_of_inode,
+                                  sync_node,
+                                  &synced) {
+                        if (next->host_idx > pce->host_idx)
+                                break;
+                }
+                list_append(&pce->sync_node, &next->sync_node);
+        }
+
+        /*
+         * sync_pending stays true while pce is in synced, so that fsync does
+         * not queue it again until it is taken out here.
+         */
+        while (!list_empty(&synced)) {
+                pce = list_entry(synced.next,
+                                 struct page_cache_entity_of_inode,
+                                 sync_node);
+                list_del(&pce->sync_node);
+                pce->sync_pending = false;
+                pthread_mutex_unlock(&page_cache.dirty_lock);
+                flush_dirty_pages(pce);
+                pthread_mutex_lock(&page_cache.dirty_lock);
+        }
+        pthread_mutex_unlock(&page_cache.dirty_lock);
+}
+
+/*
+ * The flusher thread. It syncs the inodes asked for, writes back all the
+ * dirty pages when there are too many of them or every WRITE_BACK_CYCLE
+ * seconds, and wakes the writers waiting for that.
+ */
+static void *flusher_routine(void *args)
+{
+        unsigned long sync_target;
+        struct timespec deadline;
+        bool flush_all;
+        int ret;
+
+        for (;;) {
+                pthread_mutex_lock(&page_cache.dirty_lock);
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += WRITE_BACK_CYCLE;
+                ret = 0;
+                while (page_cache.sync_requested == page_cache.sync_done
+                       && page_cache.nr_dirty_pages <= DIRTY_BACKGROUND_PAGES
+                       && ret != ETIMEDOUT)
+                        ret = pthread_cond_timedwait(&page_cache.flusher_cond,
+                                                     &page_cache.dirty_lock,
+                                                     &deadline);
+                sync_target = page_cache.sync_requested;
+                flush_all = ret == ETIMEDOUT
+                            || page_cache.nr_dirty_pages
+                                       > DIRTY_BACKGROUND_PAGES;
+                pthread_mutex_unlock(&page_cache.dirty_lock);
+
+                if (sync_target != page_cache.sync_done) {
+                        flush_synced_inodes();
+                        pthread_mutex_lock(&page_cache.dirty_lock);
+                        page_cache.sync_done = sync_target;
+                        pthread_cond_broadcast(&page_cache.dirty_cond);
+                        pthread_mutex_unlock(&page_cache.dirty_lock);
+                }
+                if (flush_all)
+                        flush_dirty_pages(NULL);
+        }
+        return NULL;
+}
+
+/*
+ * Make the writer wait while too many pages are dirty. Called without
+ * holding any page cache lock.
+ */
+static void throttle_dirty_pages(void)
+{
+        if (page_cache.nr_dirty_pages <= DIRTY_LIMIT_PAGES)
+                return;
+
+        pthread_mutex_lock(&page_cache.dirty_lock);
+        while (page_cache.nr_dirty_pages > DIRTY_LIMIT_PAGES) {
+                pthread_cond_signal(&page_cache.flusher_cond);
+                pthread_cond_wait(&page_cache.dirty_cond,
+                                  &page_cache.dirty_lock);
+        }
+        pthread_mutex_unlock(&page_cache.dirty_lock);
+}
+
+static void init_cached_pages_list(struct cached_pages_list *list)
+{
+        init_list_head(&list->queue);
+        list->size = 0;
+}
+
+void fs_page_cache_init_with_policy(PAGE_CACHE_STRATEGY strategy,
+                                    PAGE_CACHE_POLICY policy,
+                                    struct user_defined_funcs *user_func)
+{
+        struct page_cache_shard *shard;
+        pthread_t tid;
+        int i, j;
+
+        for (i = 0; i < PAGE_CACHE_SHARDS; i++) {
+                shard = &page_cache.shards[i];
+                init_cached_pages_list(&shard->active_list);
+                init_cached_pages_list(&shard->inactive_list);
+                init_cached_pages_list(&shard->pinned_pages_list);
+                pthread_mutex_init(&shard->shard_lock, NULL);
+
+                shard->arc_target = 0;
+                init_list_head(&shard->ghost_b1);
+                init_list_head(&shard->ghost_b2);
+                shard->ghost_b1_size = 0;
+                shard->ghost_b2_size = 0;
+                for (j = 0; j < GHOST_HASH_SIZE; j++)
+                        init_list_head(&shard->ghost_hash[j]);
+        }
+        page_cache.nr_pinned_pages = 0;
+
+        page_cache.cache_strategy = strategy;
+        switch (policy) {
+        case ARC_POLICY:
+                page_cache.policy_ops = &arc_policy_ops;
+                break;
+        case TWO_LIST_POLICY:
+                page_cache.policy_ops = &two_list_policy_ops;
+                break;
+        default:
+                BUG("Invalid page cache policy.\n");
+        }
+        page_cache.user_func = *user_func;
+
+        pthread_mutex_init(&page_cache.page_cache_lock, NULL);
+        pthread_cond_init(&page_cache.ra_cond, NULL);
+        page_cache.ra_head = 0;
+        page_cache.ra_tail = 0;
+        page_cache.ra_current = NULL;
+
+        pthread_mutex_init(&page_cache.dirty_lock, NULL);
+        init_rb_root(&page_cache.dirty_index);
+        page_cache.nr_dirty_pages = 0;
+        pthread_cond_init(&page_cache.flusher_cond, NULL);
+        pthread_cond_init(&page_cache.dirty_cond, NULL);
+        init_list_head(&page_cache.sync_list);
+        page_cache.sync_requested = 0;
+        page_cache.sync_done = 0;
+
+        pthread_create(&tid, NULL, flusher_routine, NULL);
+        pthread_create(&tid, NULL, readahead_routine, NULL);
+}
+
+void fs_page_cache_init(PAGE_CACHE_STRATEGY strategy,
+                        struct user_defined_funcs *user_func)
+{
+        fs_page_cache_init_with_policy(
+                strategy, PAGE_CACHE_DEFAULT_POLICY, user_func);
+}
+
+struct page_cache_entity_of_inode *
+new_page_cache_entity_of_inode(ino_t host_idx, void *private_data)
+{
+        struct page_cache_entity_of_inode *pce;
+
+        pce = calloc(1, sizeof(*pce));
+        if (pce == NULL)
+                return NULL;
+
+        pce->host_idx = host_idx;
+        pthread_rwlock_init(&pce->pce_lock, NULL);
+        init_cached_pages_list(&pce->pages);
+        init_radix(&pce->idx2page);
+        pce->pages_cnt = 0;
+        pce->private_data = private_data;
+
+        pthread_mutex_init(&pce->ra_lock, NULL);
+        pce->ra_prev_idx = -1;
+        pce->ra_next_idx = 0;
+        pce->ra_window = 0;
+
+        pce->sync_pending = false;
+        init_list_head(&pce->sync_node);
+
+        return pce;
+}
+
+int page_cache_switch_strategy(PAGE_CACHE_STRATEGY new_strategy)
+{
+        if (page_cache.cache_strategy == new_strategy)
+                return 0;
+
+        pthread_mutex_lock(&page_cache.page_cache_lock);
+        page_cache.cache_strategy = new_strategy;
+        pthread_mutex_unlock(&page_cache.page_cache_lock);
+
+        /* Write back dirty pages left by WRITE_BACK. */
+        flush_dirty_pages(NULL);
+
+        return 0;
+}
+
+int page_cache_check_page(struct page_cache_entity_of_inode *pce,
+                          pidx_t file_page_idx)
+{
+        struct cached_page *p;
+
+        pthread_rwlock_rdlock(&pce->pce_lock);
+        p = radix_get(&pce->idx2page, file_page_idx);
+        pthread_rwlock_unlock(&pce->pce_lock);
+
+        return p != NULL;
+}
+
+char *page_cache_get_block_or_page(struct page_cache_entity_of_inode *pce,
+                                   pidx_t file_page_idx, int page_block_idx,
+                                   PAGE_CACHE_OPERATION_TYPE op_type)
+{
+        bool hit = false, reread = false;
+        struct cached_page *p;
+        char *buf = NULL;
+
+        BUG_ON(page_block_idx < -1 || page_block_idx >= BLOCK_PER_PAGE);
+        BUG_ON(op_type != READ && op_type != WRITE);
+
+again:
+        pthread_rwlock_rdlock(&pce->pce_lock);
+        p = radix_get(&pce->idx2page, file_page_idx);
+        if (p) {
+                count_hit();
+                hit = true;
+        } else {
+                pthread_rwlock_unlock(&pce->pce_lock);
+                pthread_rwlock_wrlock(&pce->pce_lock);
+                /*
+                 * Added by others in between, whose users may wait for the
+                 * read lock to put it.
+                 */
+                if (radix_get(&pce->idx2page, file_page_idx)) {
+                        pthread_rwlock_unlock(&pce->pce_lock);
+                        goto again;
+                }
+                p = find_or_new_page(pce, file_page_idx);
+                if (p == NULL)
+                        goto out;
+        }
+
+        /*
+         * The page lock is released in page_cache_put_block_or_page, and
+         * holding pce_lock keeps the page from being freed before that.
+         */
+        if (op_type == READ)
+                pthread_rwlock_rdlock(&p->page_rwlock);
+        else
+                pthread_rwlock_wrlock(&p->page_rwlock);
+
+        buf = p->content;
+        if (page_block_idx != -1)
+                buf += page_block_idx * CACHED_BLOCK_SIZE;
+
+        if (op_type == READ)
+                reread = page_cache_readahead(pce, file_page_idx);
+        /*
+         * Reading the blocks of a page one after another is one use of
+         * it, otherwise every page of a scan would look reused.
+         */
+        if (hit && !reread)
+                page_accessed(p);
+
+out:
+        pthread_rwlock_unlock(&pce->pce_lock);
+        return buf;
+}
+
+void page_cache_put_block_or_page(struct page_cache_entity_of_inode *pce,
+                                  pidx_t file_page_idx, int page_block_idx,
+                                  PAGE_CACHE_OPERATION_TYPE op_type)
+{
+        struct page_cache_shard *shard;
+        struct cached_page *p;
+
+        BUG_ON(page_block_idx < -1 || page_block_idx >= BLOCK_PER_PAGE);
+        BUG_ON(op_type != READ && op_type != WRITE);
+
+        pthread_rwlock_rdlock(&pce->pce_lock);
+
+        p = radix_get(&pce->idx2page, file_page_idx);
+        BUG_ON(p == NULL);
+        count_hit();
+
+        if (op_type == READ) {
+                pthread_rwlock_unlock(&p->page_rwlock);
+                pthread_rwlock_unlock(&pce->pce_lock);
+                return;
+        }
+
+        set_block_or_page_dirty(p, page_block_idx);
+        switch (page_cache.cache_strategy) {
+        case DIRECT:
+                flush_single_page(p);
+                break;
+        case WRITE_THROUGH:
+                flush_block_or_page(p, page_block_idx);
+                break;
+        case WRITE_BACK:
+                /* Written by the flusher later. */
+                dirty_index_add(p);
+                break;
+        }
+        pthread_rwlock_unlock(&p->page_rwlock);
+        pthread_rwlock_unlock(&pce->pce_lock);
+
+        if (page_cache.cache_strategy == WRITE_BACK)
+                throttle_dirty_pages();
+        if (page_cache.cache_strategy != DIRECT)
+                return;
+
+        /* DIRECT does not keep written pages, unless others are using it. */
+        pthread_rwlock_wrlock(&pce->pce_lock);
+        p = radix_get(&pce->idx2page, file_page_idx);
+        if (p) {
+                shard = shard_of(pce, file_page_idx);
+                pthread_mutex_lock(&shard->shard_lock);
+                try_evict_page(shard, p, pce);
+                pthread_mutex_unlock(&shard->shard_lock);
+        }
+        pthread_rwlock_unlock(&pce->pce_lock);
+}
+
+int page_cache_flush_block_or_page(struct page_cache_entity_of_inode *pce,
+                                   pidx_t file_page_idx, int page_block_idx)
+{
+        struct cached_page *p;
+        int ret = 0;
+
+        BUG_ON(page_block_idx < -1 || page_block_idx >= BLOCK_PER_PAGE);
+
+        pthread_rwlock_rdlock(&pce->pce_lock);
+
+        p = radix_get(&pce->idx2page, file_page_idx);
+        if (p == NULL) {
+                ret = -1;
+                goto out;
+        }
+
+        pthread_rwlock_rdlock(&p->page_rwlock);
+        flush_block_or_page(p, page_block_idx);
+        pthread_rwlock_unlock(&p->page_rwlock);
+
+out:
+        pthread_rwlock_unlock(&pce->pce_lock);
+        return ret;
+}
+
+int page_cache_flush_pages_of_inode(struct page_cache_entity_of_inode *pce)
+{
+        unsigned long target;
+
+        pthread_mutex_lock(&page_cache.dirty_lock);
+        if (!pce->sync_pending) {
+                list_append(&pce->sync_node, &page_cache.sync_list);
+                pce->sync_pending = true;
+        }
+        /*
+         * Join the next round, the running one may have passed the pages
+         * dirtied before.
+         */
+        target = ++page_cache.sync_requested;
+        pthread_cond_signal(&page_cache.flusher_cond);
+        while ((long)(page_cache.sync_done - target) < 0)
+                pthread_cond_wait(&page_cache.dirty_cond,
+                                  &page_cache.dirty_lock);
+        pthread_mutex_unlock(&page_cache.dirty_lock);
+
+        return 0;
+}
+
+int page_cache_flush_all_pages(void)
+{
+        flush_dirty_pages(NULL);
+
+        return 0;
+}
+
+int page_cache_pin_single_page(struct page_cache_entity_of_inode *pce,
+                               pidx_t file_page_idx)
+{
+        struct page_cache_shard *shard;
+        struct cached_page *p;
+        int ret = 0;
+
+        if (__atomic_load_n(&page_cache.nr_pinned_pages, __ATOMIC_RELAXED)
+            >= MAX_PINNED_PAGE)
+                return -1;
+
+        pthread_rwlock_wrlock(&pce->pce_lock);
+
+        p = find_or_new_page(pce, file_page_idx);
+        if (p == NULL) {
+                ret = -1;
+                goto out;
+        }
+
+        shard = shard_of(pce, file_page_idx);
+        pthread_mutex_lock(&shard->shard_lock);
+        switch (p->in_which_list) {
+        case ACTIVE_LIST:
+        case INACTIVE_LIST:
+                page_list_del(shard, p);
+                page_list_add(shard, p, PINNED_PAGES_LIST);
+                break;
+        case PINNED_PAGES_LIST:
+                break;
+        default:
+                BUG("Invalid list type.\n");
+        }
+        pthread_mutex_unlock(&shard->shard_lock);
+
+out:
+        pthread_rwlock_unlock(&pce->pce_lock);
+        return ret;
+}
+
+int page_cache_unpin_single_page(struct page_cache_entity_of_inode *pce,
+                                 pidx_t file_page_idx)
+{
+        struct page_cache_shard *shard;
+        struct cached_page *p;
+        int ret = 0;
+
+        pthread_rwlock_wrlock(&pce->pce_lock);
+
+        p = radix_get(&pce->idx2page, file_page_idx);
+        if (p == NULL) {
+                ret = -1;
+                goto out;
+        }
+
+        /* Unpinned pages are evicted like the others. */
+        shard = shard_of(pce, file_page_idx);
+        pthread_mutex_lock(&shard->shard_lock);
+        if (p->in_which_list == PINNED_PAGES_LIST) {
+                page_list_del(shard, p);
+                page_list_add(shard, p, INACTIVE_LIST);
+                page_cache.policy_ops->balance(shard, pce);
+        } else {
+                ret = -1;
+        }
+        pthread_mutex_unlock(&shard->shard_lock);
+
+out:
+        pthread_rwlock_unlock(&pce->pce_lock);
+        return ret;
+}
+
+int page_cache_pin_multiple_pages(struct page_cache_entity_of_inode *pce,
+                                  pidx_t file_page_idx, u64 page_num)
+{
+        pidx_t idx;
+
+        for (idx = file_page_idx; idx < file_page_idx + page_num; idx++) {
+                if (page_cache_pin_single_page(pce, idx) != 0)
+                        return -1;
+        }
+        return 0;
+}
+
+int page_cache_unpin_multiple_pages(struct page_cache_entity_of_inode *pce,
+                                    pidx_t file_page_idx, u64 page_num)
+{
+        pidx_t idx;
+
+        for (idx = file_page_idx; idx < file_page_idx + page_num; idx++) {
+                if (page_cache_unpin_single_page(pce, idx) != 0)
+                        return -1;
+        }
+        return 0;
+}
+
+int page_cache_evict_single_page(struct page_cache_entity_of_inode *pce,
+                                 pidx_t file_page_idx)
+{
+        struct page_cache_shard *shard;
+        struct cached_page *p;
+        int ret = 0;
+
+        pthread_rwlock_wrlock(&pce->pce_lock);
+
+        page_cache_readahead_cancel(pce);
+        p = radix_get(&pce->idx2page, file_page_idx);
+        if (p == NULL) {
+                ret = -1;
+                goto out;
+        }
+
+        shard = shard_of(pce, file_page_idx);
+        pthread_mutex_lock(&shard->shard_lock);
+        if (!try_evict_page(shard, p, pce))
+                ret = -1;
+        pthread_mutex_unlock(&shard->shard_lock);
+
+out:
+        pthread_rwlock_unlock(&pce->pce_lock);
+        return ret;
+}
+
+int page_cache_evict_pages_of_inode(struct page_cache_entity_of_inode *pce)
+{
+        struct page_cache_shard *shard;
+        struct cached_page *p, *tmp;
+
+        pthread_rwlock_wrlock(&pce->pce_lock);
+
+        page_cache_readahead_cancel(pce);
+        /* Pages still in use are left cached. */
+        for_each_in_list_safe (p, tmp, inode_pages_node, &pce->pages.queue) {
+                shard = shard_of(pce, p->file_page_idx);
+                pthread_mutex_lock(&shard->shard_lock);
+                try_evict_page(shard, p, pce);
+                pthread_mutex_unlock(&shard->shard_lock);
+        }
+
+        pthread_rwlock_unlock(&pce->pce_lock);
+        return 0;
+}
+
+int page_cache_delete_single_page(struct page_cache_entity_of_inode *pce,
+                                  pidx_t file_page_idx)
+{
+        struct page_cache_shard *shard;
+        struct cached_page *p;
+        int ret = 0;
+
+        pthread_rwlock_wrlock(&pce->pce_lock);
+
+        page_cache_readahead_cancel(pce);
+        p = radix_get(&pce->idx2page, file_page_idx);
+        if (p == NULL) {
+                ret = -1;
+                goto out;
+        }
+
+        shard = shard_of(pce, file_page_idx);
+        pthread_mutex_lock(&shard->shard_lock);
+        free_page(shard, p);
+        pthread_mutex_unlock(&shard->shard_lock);
+
+out:
+        pthread_rwlock_unlock(&pce->pce_lock);
+        return ret;
+}
+
+int page_cache_delete_pages_of_inode(struct page_cache_entity_of_inode *pce)
+{
+        struct page_cache_shard *shard;
+        struct cached_page *p, *tmp;
+
+        pthread_rwlock_wrlock(&pce->pce_lock);
+
+        page_cache_readahead_cancel(pce);
+        for_each_in_list_safe (p, tmp, inode_pages_node, &pce->pages.queue) {
+                shard = shard_of(pce, p->file_page_idx);
+                pthread_mutex_lock(&shard->shard_lock);
+                free_page(shard, p);
+                pthread_mutex_unlock(&shard->shard_lock);
+        }
+
+        pthread_rwlock_unlock(&pce->pce_lock);
+        return 0;
+}
@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <chcore/container/list.h>
 #include <chcore/container/radix.h>
+#include <chcore/container/rbtree.h>
 #include <pthread.h>
 
 #define PAGE_CACHE_DEBUG 0
@@ -43,8 +44,51 @@
 #define MAX_PAGE_CACHE_PAGE \
         (ACTIVE_LIST_MAX + INACTIVE_LIST_MAX + MAX_PINNED_PAGE)
 
+/*
+ * The lists are split into shards with separate locks, pages are spread
+ * over the shards by their inode and index.
+ */
+#define PAGE_CACHE_SHARDS  8
+#define SHARD_ACTIVE_MAX   (ACTIVE_LIST_MAX / PAGE_CACHE_SHARDS)
+#define SHARD_INACTIVE_MAX (INACTIVE_LIST_MAX / PAGE_CACHE_SHARDS)
+#define SHARD_CAPACITY     (SHARD_ACTIVE_MAX + SHARD_INACTIVE_MAX)
+
+/*
+ * Buckets of the ghost entries of each shard, which are at most
+ * 2 * SHARD_CAPACITY under ARC_POLICY.
+ */
+#define GHOST_HASH_SIZE 1024
+
+/*
+ * Replacement policy used by fs_page_cache_init(), the servers can also
+ * choose one with fs_page_cache_init_with_policy().
+ */
+#ifndef PAGE_CACHE_DEFAULT_POLICY
+#define PAGE_CACHE_DEFAULT_POLICY TWO_LIST_POLICY
+#endif
+
+/* Seconds between two flushes of all the dirty pages. */
 #define WRITE_BACK_CYCLE 300
 
+/*
+ * The flusher is woken once more than DIRTY_BACKGROUND_PAGES pages are
+ * dirty, and writers under WRITE_BACK wait for it beyond DIRTY_LIMIT_PAGES.
+ */
+#define DIRTY_BACKGROUND_PAGES (MAX_PAGE_CACHE_PAGE / 10)
+#define DIRTY_LIMIT_PAGES      (MAX_PAGE_CACHE_PAGE / 5)
+
+/* Dirty pages taken from the index at a time by the flusher. */
+#define FLUSH_BATCH 64
+
+/*
+ * Readahead window (in pages) of sequential reads. It starts from
+ * READAHEAD_INIT_PAGES and doubles on each readahead up to
+ * READAHEAD_MAX_PAGES.
+ */
+#define READAHEAD_INIT_PAGES 4
+#define READAHEAD_MAX_PAGES  32
+#define READAHEAD_QUEUE_LEN  16
+
 typedef off_t pidx_t;
 
 /* List types. */
@@ -62,6 +106,23 @@ typedef enum {
         WRITE_BACK,
 } PAGE_CACHE_STRATEGY;
 
+typedef enum {
+        /*
+         * Pages referenced again on the inactive list are boosted to the
+         * active list, each list has a fixed size.
+         */
+        TWO_LIST_POLICY = 0,
+        /*
+         * CLOCK with Adaptive Replacement (CAR): the inactive list (T1)
+         * holds pages seen once and the active list (T2) pages seen at
+         * least twice. Evicted pages are remembered in ghost lists (B1 and
+         * B2), a miss hitting them moves the target size of T1 towards
+         * recency or frequency. Pages scanned once only stay in T1, so
+         * large scans do not push out the pages in T2.
+         */
+        ARC_POLICY,
+} PAGE_CACHE_POLICY;
+
 typedef enum {
         READ = 0,
         WRITE,
@@ -105,6 +166,23 @@ struct cached_page {
 
         /* Page lock. */
         pthread_rwlock_t page_rwlock;
+
+        /*
+         * Set on accesses without taking the shard lock, and cleared when
+         * the shard is scanned.
+         */
+        bool referenced;
+
+        /* Read ahead and not accessed yet. */
+        bool readahead;
+
+        /*
+         * Node in the dirty index, protected by dirty_lock. A page enters
+         * the index when it is left dirty under WRITE_BACK, and leaves it
+         * when it is written back or freed.
+         */
+        struct rb_node dirty_node;
+        bool in_dirty_index;
 };
 
 struct cached_pages_list {
@@ -119,6 +197,13 @@ struct page_cache_entity_of_inode {
         /* Owner inode index. */
         ino_t host_idx;
 
+        /*
+         * Protects pages, idx2page and pages_cnt. Looking up pages only
+         * needs the read lock, adding or removing pages needs the write
+         * lock.
+         */
+        pthread_rwlock_t pce_lock;
+
         /*
          * Used for easily traversing all pages and
          * quickly finding a specific page.
@@ -133,6 +218,25 @@ struct page_cache_entity_of_inode {
 
         /* Private data used for file read/write functions. */
         void *private_data;
+
+        /*
+         * Readahead state, protected by ra_lock. The window grows while
+         * the pages are read sequentially and collapses on random reads.
+         */
+        pthread_mutex_t ra_lock;
+        /* Last page read, -1 if none. */
+        pidx_t ra_prev_idx;
+        /* The first page that has not been read ahead. */
+        pidx_t ra_next_idx;
+        /* Pages of the last readahead, 0 if not reading sequentially. */
+        int ra_window;
+
+        /*
+         * Queued to be synced, in sync_list or being taken by the flusher,
+         * protected by dirty_lock.
+         */
+        bool sync_pending;
+        struct list_head sync_node;
 };
 
 /* Read a specific page from file. */
@@ -162,11 +266,21 @@ struct user_defined_funcs {
         event_handler_t handler_pce_turns_empty;
 };
 
-struct fs_page_cache {
+struct readahead_request {
+        struct page_cache_entity_of_inode *pce;
+        pidx_t start;
+        int nr_pages;
+};
+
+struct page_cache_shard {
         /*
-         * Using two-list strategy to maintain caches.
-         * Once a cold block is accessed, append it to second list. If a block
-         * in second list is accessed, boost to first list. Both lists use LRU.
+         * Using two lists to maintain caches, ordered by the policy.
+         * Accesses only set the referenced bit of the page, the lists are
+         * reordered when the shard is over its limits (CLOCK). Under
+         * TWO_LIST_POLICY, a new page is appended to the inactive list,
+         * referenced inactive pages are boosted to the active list,
+         * referenced active pages are rotated, and the others are demoted
+         * or evicted.
          */
         struct cached_pages_list active_list;
         struct cached_pages_list inactive_list;
@@ -174,13 +288,88 @@ struct fs_page_cache {
         /* pinned pages list. */
         struct cached_pages_list pinned_pages_list;
 
+        /* Protects the lists. */
+        pthread_mutex_t shard_lock;
+
+        /*
+         * ARC_POLICY only. The target size of the inactive list, and the
+         * ghost lists with the least recently evicted entries at the head.
+         */
+        int arc_target;
+        struct list_head ghost_b1;
+        struct list_head ghost_b2;
+        int ghost_b1_size;
+        int ghost_b2_size;
+        struct list_head ghost_hash[GHOST_HASH_SIZE];
+};
+
+struct page_cache_policy_ops {
+        /* Put a newly cached page into the lists. Shard locked. */
+        void (*add_page)(struct page_cache_shard *shard,
+                         struct cached_page *p);
+        /*
+         * Bring the shard back under its limits. The pce_lock of
+         * locked_pce is held by the caller. Shard locked.
+         */
+        void (*balance)(struct page_cache_shard *shard,
+                        struct page_cache_entity_of_inode *locked_pce);
+};
+
+struct fs_page_cache {
+        struct page_cache_shard shards[PAGE_CACHE_SHARDS];
+
+        /* Pinned pages in all shards. */
+        int nr_pinned_pages;
+
         /* Each inode can use different cache strategy. */
         PAGE_CACHE_STRATEGY cache_strategy;
 
+        /* Replacement policy, fixed since initialization. */
+        const struct page_cache_policy_ops *policy_ops;
+
         /* functions supported by page cache user */
         struct user_defined_funcs user_func;
 
+        /*
+         * Serializes strategy switching and protects the readahead queue.
+         * Lock order: pce_lock -> ra_lock -> page_cache_lock, and
+         * pce_lock -> shard_lock. Under a shard_lock, the pce_locks and
+         * page_rwlocks of other pages are only tried.
+         */
         pthread_mutex_t page_cache_lock;
+
+        /*
+         * Readahead requests, served asynchronously by the readahead
+         * thread. Protected by page_cache_lock.
+         */
+        struct readahead_request ra_queue[READAHEAD_QUEUE_LEN];
+        unsigned int ra_head;
+        unsigned int ra_tail;
+        /* Owner of the request being served, NULL if cancelled. */
+        struct page_cache_entity_of_inode *ra_current;
+        pthread_cond_t ra_cond;
+
+        /*
+         * Dirty pages sorted by (inode, page), written back in this order
+         * by the flusher thread. dirty_lock is taken after all the other
+         * locks and protects the index, nr_dirty_pages and the sync state.
+         */
+        pthread_mutex_t dirty_lock;
+        struct rb_root dirty_index;
+        int nr_dirty_pages;
+        /* Wakes the flusher. */
+        pthread_cond_t flusher_cond;
+        /* Wakes the throttled writers and the syncing threads. */
+        pthread_cond_t dirty_cond;
+
+        /*
+         * Inodes to sync. All of them are synced in one round, and the
+         * threads asking for round sync_requested wait until sync_done
+         * reaches it, so that concurrent fsyncs are committed together.
+         */
+        struct list_head sync_list;
+        unsigned long sync_requested;
+        unsigned long sync_done;
 };
 
 /*
@@ -189,6 +378,14 @@ struct fs_page_cache {
 void fs_page_cache_init(PAGE_CACHE_STRATEGY strategy,
                         struct user_defined_funcs *user_func);
 
+/*
+ * Initialize fs_page_cache with a replacement policy other than
+ * PAGE_CACHE_DEFAULT_POLICY.
+ */
+void fs_page_cache_init_with_policy(PAGE_CACHE_STRATEGY strategy,
+                                    PAGE_CACHE_POLICY policy,
+                                    struct user_defined_funcs *user_func);
+
 /*
  * Alloc a new page_cache_entity_of_inode.
  */
@@ -214,6 +411,7 @@ int page_cache_check_page(struct page_cache_entity_of_inode *pce,
  * Get a block or a page from corresponding page cache.
  * If page_block_idx == -1, read a page,
  * else read a block.
+ * Sequential reads make the following pages read ahead asynchronously.
  * Return: if failed, return NULL.
  */
 char *page_cache_get_block_or_page(struct page_cache_entity_of_inode *pce,
@@ -241,6 +439,8 @@ int page_cache_flush_block_or_page(struct page_cache_entity_of_inode *pce,
 /*
  * Flush all dirty pages that belongs to an inode,
  * the cache still remains.
+ * The flusher thread writes them back, together with the inodes synced
+ * by the other threads meanwhile.
  * Return: if succeed, return 0,
  *	 if failed, return -1.
  */
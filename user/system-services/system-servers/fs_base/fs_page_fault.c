@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <chcore/bug.h>
+#include <chcore/ring_buffer.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fs_page_fault.h"
+#include "fs_page_cache.h"
+#include "fs_wrapper_defs.h"
+
+#define MAX_FAULT_MSG_NUM 100
+
+/*
+ * Max number of pages mapped for one fault, including the faulting one.
+ * The following pages of the area are mapped ahead in the same syscall if
+ * they are at hand, so that sequential accesses fault once per batch.
+ */
+#define FMAP_FAULT_AROUND_PAGES USER_FAULT_MAP_BATCH_MAX
+
+struct ring_buffer *fault_msg_buffer;
+cap_t notific_cap;
+
+struct list_head fmap_area_mappings;
+pthread_rwlock_t fmap_area_lock;
+
+vaddr_t fs_wrapper_fmap_get_page_addr(struct fs_vnode *vnode, off_t offset)
+{
+        vaddr_t page_va = 0;
+
+        assert(offset % PAGE_SIZE == 0);
+
+        pthread_rwlock_rdlock(&vnode->rwlock);
+        if (offset >= ROUND_UP(vnode->size, PAGE_SIZE))
+                goto out;
+
+        if (using_page_cache)
+                page_va = (vaddr_t)page_cache_get_block_or_page(
+                        vnode->page_cache, offset / PAGE_SIZE, -1, READ);
+        else
+                page_va = server_ops.fmap_get_page_addr(vnode->private, offset);
+out:
+        pthread_rwlock_unlock(&vnode->rwlock);
+        return page_va;
+}
+
+/*
+ * Get the page of @offset to be mapped ahead. Pages not in the page cache are
+ * left to their own faults, mapping ahead should never wait for I/O.
+ */
+static vaddr_t fault_around_page_addr(struct fs_vnode *vnode, off_t offset)
+{
+        if (using_page_cache
+            && !page_cache_check_page(vnode->page_cache, offset / PAGE_SIZE))
+                return 0;
+        return fs_wrapper_fmap_get_page_addr(vnode, offset);
+}
+
+/* Writing to a shared mapping beyond the end of file extends the file */
+static vaddr_t extend_file_for_fault(struct fs_vnode *vnode, off_t offset)
+{
+        int ret;
+
+        pthread_rwlock_wrlock(&vnode->rwlock);
+        ret = server_ops.ftruncate(vnode->private, offset + PAGE_SIZE);
+        if (ret == 0)
+                vnode->size = offset + PAGE_SIZE;
+        pthread_rwlock_unlock(&vnode->rwlock);
+        if (ret != 0)
+                return 0;
+
+        return fs_wrapper_fmap_get_page_addr(vnode, offset);
+}
+
+static void handle_one_fault(struct user_fault_msg *msg)
+{
+        vaddr_t page_vas[FMAP_FAULT_AROUND_PAGES];
+        size_t area_off, area_len;
+        struct fs_vnode *vnode;
+        off_t file_offset, offset;
+        u64 flags;
+        vmr_prop_t prot, perm;
+        int nr_pages;
+        long ret;
+
+        ret = fmap_area_find(msg->fault_badge,
+                             msg->fault_va,
+                             &area_off,
+                             &area_len,
+                             &vnode,
+                             &file_offset,
+                             &flags,
+                             &prot);
+        if (ret < 0) {
+                BUG("why a fault happened when not recorded\n");
+        }
+        offset = file_offset + area_off;
+
+        page_vas[0] = fs_wrapper_fmap_get_page_addr(vnode, offset);
+        if (flags & MAP_SHARED) {
+                if (page_vas[0] == 0) {
+                        page_vas[0] = extend_file_for_fault(vnode, offset);
+                        if (page_vas[0] == 0)
+                                return;
+                }
+                perm = prot;
+        } else if (flags & MAP_PRIVATE) {
+                /* Shared with the server until written, which is CoW */
+                perm = (prot & VMR_EXEC) | VMR_READ;
+        } else {
+                perm = 0;
+        }
+
+        for (nr_pages = 1; nr_pages < FMAP_FAULT_AROUND_PAGES; nr_pages++) {
+                if (area_off + nr_pages * PAGE_SIZE >= area_len)
+                        break;
+                page_vas[nr_pages] = fault_around_page_addr(
+                        vnode, offset + nr_pages * PAGE_SIZE);
+                if (page_vas[nr_pages] == 0)
+                        break;
+        }
+
+        ret = usys_user_fault_map_batch(
+                msg->fault_badge, msg->fault_va, page_vas, nr_pages, false, perm);
+        if (ret < 0) {
+                BUG("this call should always be success here\n");
+        }
+}
+
+void *user_fault_handler(void *args)
+{
+        struct user_fault_msg msg;
+
+        while (1) {
+                usys_wait(notific_cap, true, NULL);
+                while (get_one_msg(fault_msg_buffer, &msg)) {
+                        handle_one_fault(&msg);
+                }
+        }
+        return NULL;
+}
+
+int fs_page_fault_init(void)
+{
+        pthread_t fault_handler_tid;
+        int ret;
+
+        fault_msg_buffer = new_ringbuffer(MAX_FAULT_MSG_NUM,
+                                          sizeof(struct user_fault_msg));
+        if (!fault_msg_buffer)
+                return -ENOMEM;
+
+        notific_cap = usys_create_notifc();
+        if (notific_cap < 0)
+                return notific_cap;
+
+        ret = usys_user_fault_register(notific_cap, (vaddr_t)fault_msg_buffer);
+        if (ret < 0)
+                goto out_free_buffer;
+
+        init_list_head(&fmap_area_mappings);
+        pthread_rwlock_init(&fmap_area_lock, NULL);
+
+        ret = pthread_create(
+                &fault_handler_tid, NULL, user_fault_handler, NULL);
+        if (ret < 0)
+                goto out_free_buffer;
+
+        return 0;
+
+out_free_buffer:
+        free_ringbuffer(fault_msg_buffer);
+        return ret;
+}
+
+int fmap_area_insert(badge_t client_badge, vaddr_t client_va_start,
+                     size_t length, struct fs_vnode *vnode, off_t file_offset,
+                     u64 flags, vmr_prop_t prot)
+{
+        struct fmap_area_mapping *area, *iter;
+
+        area = malloc(sizeof(*area));
+        if (!area)
+                return -ENOMEM;
+        area->client_badge = client_badge;
+        area->client_va_start = client_va_start;
+        area->length = length;
+        area->vnode = vnode;
+        area->file_offset = file_offset;
+        area->flags = flags;
+        area->prot = prot;
+
+        pthread_rwlock_wrlock(&fmap_area_lock);
+        for_each_in_list (
+                iter, struct fmap_area_mapping, node, &fmap_area_mappings) {
+                if (iter->client_badge == client_badge
+                    && client_va_start < iter->client_va_start + iter->length
+                    && iter->client_va_start < client_va_start + length) {
+                        pthread_rwlock_unlock(&fmap_area_lock);
+                        free(area);
+                        return -EEXIST;
+                }
+        }
+        inc_ref_fs_vnode(vnode);
+        list_append(&area->node, &fmap_area_mappings);
+        pthread_rwlock_unlock(&fmap_area_lock);
+
+        return 0;
+}
+
+int fmap_area_find(badge_t client_badge, vaddr_t client_va, size_t *area_off,
+                   size_t *area_len, struct fs_vnode **vnode,
+                   off_t *file_offset, u64 *flags, vmr_prop_t *prot)
+{
+        struct fmap_area_mapping *area;
+        int ret = -1;
+
+        pthread_rwlock_rdlock(&fmap_area_lock);
+        for_each_in_list (
+                area, struct fmap_area_mapping, node, &fmap_area_mappings) {
+                if (area->client_badge == client_badge
+                    && area->client_va_start <= client_va
+                    && area->client_va_start + area->length > client_va) {
+                        *area_off = client_va - area->client_va_start;
+                        *area_len = area->length;
+                        *vnode = area->vnode;
+                        *file_offset = area->file_offset;
+                        *flags = area->flags;
+                        *prot = area->prot;
+                        ret = 0;
+                        break;
+                }
+        }
+        pthread_rwlock_unlock(&fmap_area_lock);
+
+        return ret;
+}
+
+int fmap_area_remove(badge_t client_badge, vaddr_t client_va_start,
+                     size_t length)
+{
+        struct fmap_area_mapping *area, *tmp;
+        int ret = -EINVAL;
+
+        pthread_rwlock_wrlock(&fmap_area_lock);
+        for_each_in_list_safe (area, tmp, node, &fmap_area_mappings) {
+                if (area->client_badge == client_badge
+                    && area->client_va_start == client_va_start
+                    && area->length == length) {
+                        list_del(&area->node);
+                        dec_ref_fs_vnode(area->vnode);
+                        free(area);
+                        ret = 0;
+                        break;
+                }
+        }
+        pthread_rwlock_unlock(&fmap_area_lock);
+
+        return ret;
+}
+
+void fmap_area_recycle(badge_t client_badge)
+{
+        struct fmap_area_mapping *area, *tmp;
+
+        pthread_rwlock_wrlock(&fmap_area_lock);
+        for_each_in_list_safe (area, tmp, node, &fmap_area_mappings) {
+                if (area->client_badge == client_badge) {
+                        list_del(&area->node);
+                        dec_ref_fs_vnode(area->vnode);
+                        free(area);
+                }
+        }
+        pthread_rwlock_unlock(&fmap_area_lock);
+}
@@ -50,13 +50,14 @@ extern struct list_head fmap_area_mappings;
 extern pthread_rwlock_t fmap_area_lock;
 
 int fs_page_fault_init(void);
+vaddr_t fs_wrapper_fmap_get_page_addr(struct fs_vnode *vnode, off_t offset);
 
 int fmap_area_insert(badge_t client_badge, vaddr_t client_va_start,
                      size_t length, struct fs_vnode *vnode, off_t file_offset,
                      u64 flags, vmr_prop_t prot);
 int fmap_area_find(badge_t client_badge, vaddr_t client_va, size_t *area_off,
-                   struct fs_vnode **vnode, off_t *file_offset, u64 *flags,
-                   vmr_prop_t *prot);
+                   size_t *area_len, struct fs_vnode **vnode,
+                   off_t *file_offset, u64 *flags, vmr_prop_t *prot);
 int fmap_area_remove(badge_t client_badge, vaddr_t client_va_start,
                      size_t length);
 void fmap_area_recycle(badge_t client_badge);
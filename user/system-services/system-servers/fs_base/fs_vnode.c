@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <chcore/syscall.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fs_vnode.h"
+
+struct fs_vnode_table fs_vnode_table;
+
+/* Protects the slots of server_entrys in each stripe */
+static pthread_mutex_t server_entry_stripe_locks[SERVER_ENTRY_STRIPES];
+/* The stripe to try first, rotated so that allocations spread out */
+static unsigned int server_entry_next_stripe;
+
+void free_entry(int entry_idx)
+{
+        pthread_mutex_t *lock;
+
+        lock = &server_entry_stripe_locks[entry_idx % SERVER_ENTRY_STRIPES];
+        pthread_mutex_lock(lock);
+        free(server_entrys[entry_idx]->path);
+        free(server_entrys[entry_idx]);
+        server_entrys[entry_idx] = NULL;
+        pthread_mutex_unlock(lock);
+}
+
+/* Returns the slot taken in @stripe, or -1 if it is full */
+static int alloc_entry_in_stripe(int stripe)
+{
+        struct server_entry *e;
+        int i, ret = -1;
+
+        pthread_mutex_lock(&server_entry_stripe_locks[stripe]);
+        for (i = stripe; i < MAX_SERVER_ENTRY_NUM; i += SERVER_ENTRY_STRIPES) {
+                if (server_entrys[i] == NULL)
+                        break;
+        }
+        if (i >= MAX_SERVER_ENTRY_NUM)
+                goto out;
+
+        e = malloc(sizeof(*e));
+        if (e == NULL) {
+                ret = -ENOMEM;
+                goto out;
+        }
+        pthread_mutex_init(&e->lock, NULL);
+        server_entrys[i] = e;
+        ret = i;
+out:
+        pthread_mutex_unlock(&server_entry_stripe_locks[stripe]);
+        return ret;
+}
+
+int alloc_entry(void)
+{
+        int start, i, ret;
+
+        start = __atomic_fetch_add(
+                &server_entry_next_stripe, 1, __ATOMIC_RELAXED);
+        for (i = 0; i < SERVER_ENTRY_STRIPES; i++) {
+                ret = alloc_entry_in_stripe((start + i) % SERVER_ENTRY_STRIPES);
+                if (ret >= 0)
+                        return ret;
+                if (ret == -ENOMEM)
+                        break;
+        }
+        return -1;
+}
+
+void assign_entry(struct server_entry *e, u64 f, off_t o, int t, void *p,
+                  struct fs_vnode *n)
+{
+        e->flags = f;
+        e->offset = o;
+        e->refcnt = t;
+        e->path = p;
+        e->vnode = n;
+}
+
+static inline unsigned long vnode_hash(ino_t id)
+{
+        /* Inode numbers are often sequential, spread them */
+        return (unsigned long)id * 0x9E3779B97F4A7C15UL;
+}
+
+static struct fs_vnode_bucket *vnode_bucket(ino_t id)
+{
+        unsigned long hash = vnode_hash(id);
+
+        return &fs_vnode_table.buckets[(hash >> 32)
+                                       & (fs_vnode_table.nr_buckets - 1)];
+}
+
+static struct fs_vnode_bucket *alloc_vnode_buckets(unsigned long nr)
+{
+        struct fs_vnode_bucket *buckets;
+        unsigned long i;
+
+        buckets = malloc(sizeof(*buckets) * nr);
+        if (buckets == NULL)
+                return NULL;
+        for (i = 0; i < nr; i++) {
+                init_list_head(&buckets[i].vnodes);
+                pthread_mutex_init(&buckets[i].lock, NULL);
+        }
+        return buckets;
+}
+
+/*
+ * Double the buckets if the table is still too full. Failing to grow only
+ * makes the chains longer.
+ */
+static void grow_vnode_table(void)
+{
+        struct fs_vnode_bucket *old, *buckets;
+        struct fs_vnode *n, *tmp;
+        unsigned long i, old_nr;
+
+        pthread_rwlock_wrlock(&fs_vnode_table.resize_lock);
+        old = fs_vnode_table.buckets;
+        old_nr = fs_vnode_table.nr_buckets;
+        if (fs_vnode_table.nr_vnodes <= old_nr * VNODE_HASH_LOAD)
+                goto out_unlock;
+
+        buckets = alloc_vnode_buckets(old_nr * 2);
+        if (buckets == NULL)
+                goto out_unlock;
+
+        fs_vnode_table.buckets = buckets;
+        fs_vnode_table.nr_buckets = old_nr * 2;
+        for (i = 0; i < old_nr; i++) {
+                for_each_in_list_safe (n, tmp, hash_node, &old[i].vnodes) {
+                        list_del(&n->hash_node);
+                        list_append(&n->hash_node,
+                                    &vnode_bucket(n->vnode_id)->vnodes);
+                }
+                pthread_mutex_destroy(&old[i].lock);
+        }
+        free(old);
+
+out_unlock:
+        pthread_rwlock_unlock(&fs_vnode_table.resize_lock);
+}
+
+void fs_vnode_init(void)
+{
+        int i;
+
+        pthread_rwlock_init(&fs_vnode_table.resize_lock, NULL);
+        fs_vnode_table.buckets = alloc_vnode_buckets(VNODE_HASH_INIT_SIZE);
+        if (!fs_vnode_table.buckets) {
+                printf("[fs_base] no enough memory to initialize, "
+                       "exiting...\n");
+                exit(-1);
+        }
+        fs_vnode_table.nr_buckets = VNODE_HASH_INIT_SIZE;
+        fs_vnode_table.nr_vnodes = 0;
+
+        for (i = 0; i < SERVER_ENTRY_STRIPES; i++)
+                pthread_mutex_init(&server_entry_stripe_locks[i], NULL);
+}
+
+struct fs_vnode *alloc_fs_vnode(ino_t id, enum fs_vnode_type type, off_t size,
+                                void *private)
+{
+        struct fs_vnode *ret = (struct fs_vnode *)malloc(sizeof(*ret));
+        if (ret == NULL) {
+                return NULL;
+        }
+
+        /* Filling Initial State */
+        ret->vnode_id = id;
+        ret->type = type;
+        ret->size = size;
+        ret->private = private;
+
+        /* Ref Count start as 1 */
+        ret->refcnt = 1;
+
+        ret->pmo_cap = -1;
+
+        /* Create page cache entity for vnode */
+        ret->page_cache = NULL;
+        if (using_page_cache)
+                ret->page_cache =
+                        new_page_cache_entity_of_inode(ret->vnode_id, ret);
+        init_list_head(&ret->hash_node);
+        pthread_rwlock_init(&ret->rwlock, NULL);
+
+        return ret;
+}
+
+void push_fs_vnode(struct fs_vnode *n)
+{
+        struct fs_vnode_bucket *bucket;
+        bool grow;
+
+        pthread_rwlock_rdlock(&fs_vnode_table.resize_lock);
+        bucket = vnode_bucket(n->vnode_id);
+        pthread_mutex_lock(&bucket->lock);
+        list_append(&n->hash_node, &bucket->vnodes);
+        pthread_mutex_unlock(&bucket->lock);
+        grow = __atomic_add_fetch(
+                       &fs_vnode_table.nr_vnodes, 1, __ATOMIC_RELAXED)
+               > fs_vnode_table.nr_buckets * VNODE_HASH_LOAD;
+        pthread_rwlock_unlock(&fs_vnode_table.resize_lock);
+
+        if (grow)
+                grow_vnode_table();
+}
+
+void pop_free_fs_vnode(struct fs_vnode *n)
+{
+        struct fs_vnode_bucket *bucket;
+
+        pthread_rwlock_rdlock(&fs_vnode_table.resize_lock);
+        bucket = vnode_bucket(n->vnode_id);
+        pthread_mutex_lock(&bucket->lock);
+        list_del(&n->hash_node);
+        pthread_mutex_unlock(&bucket->lock);
+        __atomic_sub_fetch(&fs_vnode_table.nr_vnodes, 1, __ATOMIC_RELAXED);
+        pthread_rwlock_unlock(&fs_vnode_table.resize_lock);
+
+        if (n->pmo_cap > 0)
+                usys_revoke_cap(n->pmo_cap, false);
+        free(n);
+}
+
+struct fs_vnode *get_fs_vnode_by_id(ino_t vnode_id)
+{
+        struct fs_vnode_bucket *bucket;
+        struct fs_vnode *n, *ret = NULL;
+
+        pthread_rwlock_rdlock(&fs_vnode_table.resize_lock);
+        bucket = vnode_bucket(vnode_id);
+        pthread_mutex_lock(&bucket->lock);
+        for_each_in_list (n, struct fs_vnode, hash_node, &bucket->vnodes) {
+                if (n->vnode_id == vnode_id) {
+                        ret = n;
+                        break;
+                }
+        }
+        pthread_mutex_unlock(&bucket->lock);
+        pthread_rwlock_unlock(&fs_vnode_table.resize_lock);
+
+        return ret;
+}
+
+/* refcnt for vnode */
+int inc_ref_fs_vnode(void *n)
+{
+        struct fs_vnode *vnode = (struct fs_vnode *)n;
+
+        __atomic_add_fetch(&vnode->refcnt, 1, __ATOMIC_RELAXED);
+        return 0;
+}
+
+int dec_ref_fs_vnode(void *node)
+{
+        int ret, refcnt;
+        struct fs_vnode *n = (struct fs_vnode *)node;
+
+        refcnt = __atomic_sub_fetch(&n->refcnt, 1, __ATOMIC_ACQ_REL);
+        assert(refcnt >= 0);
+
+        if (refcnt == 0) {
+                ret = server_ops.close(
+                        n->private, (n->type == FS_NODE_DIR), true);
+                if (ret) {
+                        printf("Warning: close failed when deref vnode: %d\n",
+                               ret);
+                        return ret;
+                }
+
+                pop_free_fs_vnode(n);
+        }
+
+        return 0;
+}
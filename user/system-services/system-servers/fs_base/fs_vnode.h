@@ -23,9 +23,21 @@
 #include "fs_page_cache.h"
 #include "fs_wrapper_defs.h"
 
-#define MAX_FILE_PAGES       512
 #define MAX_SERVER_ENTRY_NUM 1024
 
+/*
+ * Server entries are allocated from SERVER_ENTRY_STRIPES stripes with
+ * separate locks, slot i belongs to stripe i % SERVER_ENTRY_STRIPES.
+ */
+#define SERVER_ENTRY_STRIPES 16
+
+/*
+ * The vnode table starts with VNODE_HASH_INIT_SIZE buckets, and doubles
+ * when there are more than VNODE_HASH_LOAD vnodes per bucket.
+ */
+#define VNODE_HASH_INIT_SIZE 64
+#define VNODE_HASH_LOAD      2
+
 enum fs_vnode_type { FS_NODE_RESERVED = 0, FS_NODE_REG, FS_NODE_DIR };
 
 /*
@@ -34,7 +46,7 @@ enum fs_vnode_type { FS_NODE_RESERVED = 0, FS_NODE_REG, FS_NODE_DIR };
 #define PC_HASH_SIZE 512
 struct fs_vnode {
         ino_t vnode_id; /* identifier */
-        struct rb_node node; /* rbtree node */
+        struct rb_node node; /* not used, keeps the layout of the fields */
 
         enum fs_vnode_type type; /* regular or directory */
         int refcnt; /* reference count */
@@ -44,6 +56,8 @@ struct fs_vnode {
         void *private;
 
         pthread_rwlock_t rwlock; /* vnode rwlock */
+
+        struct list_head hash_node; /* in the bucket of vnode_id */
 };
 
 /*
@@ -80,8 +94,23 @@ extern void assign_entry(struct server_entry *e, u64 f, off_t o, int t, void *p,
  * fs_vnode pool
  * key: ino_t vnode_id
  * value: struct fs_vnode *vnode
+ * A hash table with a lock for each bucket. The buckets are replaced when
+ * the table grows, under the write lock of resize_lock.
  */
-extern struct rb_root *fs_vnode_list;
+struct fs_vnode_bucket {
+        struct list_head vnodes;
+        pthread_mutex_t lock;
+};
+
+struct fs_vnode_table {
+        pthread_rwlock_t resize_lock;
+        struct fs_vnode_bucket *buckets;
+        /* Power of 2 */
+        unsigned long nr_buckets;
+        unsigned long nr_vnodes;
+};
+
+extern struct fs_vnode_table fs_vnode_table;
 
 extern void fs_vnode_init(void);
 extern struct fs_vnode *alloc_fs_vnode(ino_t id, enum fs_vnode_type type,
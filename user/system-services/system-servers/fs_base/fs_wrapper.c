@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <chcore/bug.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fs_wrapper_defs.h"
+#include "fs_page_cache.h"
+#include "fs_page_fault.h"
+#include "fs_vnode.h"
+#include "fs_dcache.h"
+
+/* (client_badge, fd) -> fid */
+struct list_head server_entry_mapping;
+pthread_spinlock_t server_entry_mapping_lock;
+
+pthread_rwlock_t fs_wrapper_meta_rwlock;
+
+/* Counters replied by FS_REQ_TEST_PERF */
+static struct fs_perf_stat perf_stat;
+/* Whether the requests are timed, between FS_PERF_START and FS_PERF_STOP */
+static bool perf_timing;
+
+/* Write a block or a page (block_idx == -1) of the page cache to the file */
+int real_file_writer(char *buf, pidx_t file_page_idx, int block_idx,
+                     void *private)
+{
+        struct fs_vnode *vnode = (struct fs_vnode *)private;
+        off_t offset;
+        size_t size;
+
+        offset = (off_t)file_page_idx * CACHED_PAGE_SIZE;
+        if (block_idx == -1) {
+                size = CACHED_PAGE_SIZE;
+        } else {
+                offset += block_idx * CACHED_BLOCK_SIZE;
+                size = CACHED_BLOCK_SIZE;
+        }
+        if (offset + size > vnode->size)
+                size = vnode->size - offset;
+
+        count.disk_i += size;
+        return server_ops.write(vnode->private, offset, size, buf);
+}
+
+/* Read a page of the file into the page cache */
+int real_file_reader(char *buf, pidx_t file_page_idx, void *private)
+{
+        struct fs_vnode *vnode = (struct fs_vnode *)private;
+        off_t offset;
+        size_t size;
+
+        memset(buf, 0, CACHED_PAGE_SIZE);
+        offset = (off_t)file_page_idx * CACHED_PAGE_SIZE;
+        size = CACHED_PAGE_SIZE;
+        if (offset + size > vnode->size)
+                size = vnode->size - offset;
+
+        count.disk_o += size;
+        return server_ops.read(vnode->private, offset, size, buf);
+}
+
+void init_fs_wrapper(void)
+{
+        struct user_defined_funcs uf;
+
+        init_list_head(&server_entry_mapping);
+        pthread_spin_init(&server_entry_mapping_lock, 0);
+        fs_vnode_init();
+        pthread_rwlock_init(&fs_wrapper_meta_rwlock, NULL);
+
+        uf.file_read = real_file_reader;
+        uf.file_write = real_file_writer;
+        uf.handler_pce_turns_nonempty = inc_ref_fs_vnode;
+        uf.handler_pce_turns_empty = dec_ref_fs_vnode;
+        fs_page_cache_init(WRITE_THROUGH, &uf);
+
+        fs_page_fault_init();
+
+        memset(&count, 0, sizeof(count));
+}
+
+/* Get the fid of @fd of @client_badge, or -1 if it is not opened */
+int fs_wrapper_get_server_entry(badge_t client_badge, int fd)
+{
+        struct server_entry_node *n;
+        int fid = -1;
+
+        if (fd == AT_FDROOT)
+                return AT_FDROOT;
+        if (fd < 0 || fd >= MAX_SERVER_ENTRY_PER_CLIENT)
+                return -1;
+
+        pthread_spin_lock(&server_entry_mapping_lock);
+        for_each_in_list (n,
+                          struct server_entry_node,
+                          node,
+                          &server_entry_mapping) {
+                if (n->client_badge == client_badge) {
+                        fid = n->fd_to_fid[fd];
+                        break;
+                }
+        }
+        pthread_spin_unlock(&server_entry_mapping_lock);
+
+        return fid;
+}
+
+int fs_wrapper_set_server_entry(badge_t client_badge, int fd, int fid)
+{
+        struct server_entry_node *n;
+        int ret = 0;
+
+        BUG_ON(fd < 0 || fd >= MAX_SERVER_ENTRY_PER_CLIENT);
+
+        pthread_spin_lock(&server_entry_mapping_lock);
+        for_each_in_list (n,
+                          struct server_entry_node,
+                          node,
+                          &server_entry_mapping) {
+                if (n->client_badge == client_badge) {
+                        n->fd_to_fid[fd] = fid;
+                        goto out;
+                }
+        }
+
+        /* The first fd of the client */
+        n = malloc(sizeof(*n));
+        if (n == NULL) {
+                ret = -ENOMEM;
+                goto out;
+        }
+        n->client_badge = client_badge;
+        memset(n->fd_to_fid, -1, sizeof(n->fd_to_fid));
+        n->fd_to_fid[fd] = fid;
+        list_append(&n->node, &server_entry_mapping);
+
+out:
+        pthread_spin_unlock(&server_entry_mapping_lock);
+        return ret;
+}
+
+/* Forget the fds of @client_badge referring to @fid */
+void fs_wrapper_clear_server_entry(badge_t client_badge, int fid)
+{
+        struct server_entry_node *n;
+        int i;
+
+        pthread_spin_lock(&server_entry_mapping_lock);
+        for_each_in_list (n,
+                          struct server_entry_node,
+                          node,
+                          &server_entry_mapping) {
+                if (n->client_badge == client_badge) {
+                        for (i = 0; i < MAX_SERVER_ENTRY_PER_CLIENT; i++) {
+                                if (n->fd_to_fid[i] == fid)
+                                        n->fd_to_fid[i] = -1;
+                        }
+                        break;
+                }
+        }
+        pthread_spin_unlock(&server_entry_mapping_lock);
+}
+
+/* Replace the fds in @fr, which are of the client, with fids */
+int translate_fd_to_fid(badge_t client_badge, struct fs_request *fr)
+{
+        int fid;
+
+        switch (fr->req) {
+        case FS_REQ_READ:
+        case FS_REQ_PREAD:
+        case FS_REQ_WRITE:
+        case FS_REQ_PWRITE:
+        case FS_REQ_CLOSE:
+        case FS_REQ_LSEEK:
+        case FS_REQ_GETDENTS64:
+        case FS_REQ_FTRUNCATE:
+        case FS_REQ_FALLOCATE:
+        case FS_REQ_FCNTL:
+        case FS_REQ_FSYNC:
+        case FS_REQ_FDATASYNC:
+                /* The fd is the first field of these requests */
+                fid = fs_wrapper_get_server_entry(client_badge, fr->read.fd);
+                if (fid < 0)
+                        return -ENOENT;
+                fr->read.fd = fid;
+                break;
+        case FS_REQ_FMAP:
+                fid = fs_wrapper_get_server_entry(client_badge, fr->mmap.fd);
+                if (fid < 0)
+                        return -ENOENT;
+                fr->mmap.fd = fid;
+                break;
+        case FS_REQ_FSTAT:
+        case FS_REQ_FSTATAT:
+        case FS_REQ_STATFS:
+        case FS_REQ_FSTATFS:
+                fr->stat.dirfd = fs_wrapper_get_server_entry(client_badge,
+                                                             fr->stat.dirfd);
+                fr->stat.fd =
+                        fs_wrapper_get_server_entry(client_badge, fr->stat.fd);
+                if (fr->stat.fd < 0 && fr->stat.fd != AT_FDROOT)
+                        return -ENOENT;
+                if (fr->stat.dirfd < 0 && fr->stat.dirfd != AT_FDROOT)
+                        return -ENOENT;
+                break;
+        default:
+                break;
+        }
+
+        return 0;
+}
+
+static unsigned long perf_now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static void perf_account(enum fs_req_type req, unsigned long start)
+{
+        if (req <= FS_REQ_UNDEFINED || req >= FS_REQ_MAX)
+                return;
+        __atomic_add_fetch(&perf_stat.nr_reqs[req], 1, __ATOMIC_RELAXED);
+        if (start)
+                __atomic_add_fetch(&perf_stat.server_ns[req],
+                                   perf_now_ns() - start,
+                                   __ATOMIC_RELAXED);
+}
+
+/* Called with fs_wrapper_meta_rwlock held for write, no request is running */
+static int fs_wrapper_perf(ipc_msg_t *ipc_msg, struct fs_request *fr)
+{
+        struct fs_perf_stat *stat;
+
+        switch (fr->test_perf.cmd) {
+        case FS_PERF_GET:
+                break;
+        case FS_PERF_START:
+                memset(&perf_stat, 0, sizeof(perf_stat));
+                memset(&count, 0, sizeof(count));
+                memset(&dcache_stat, 0, sizeof(dcache_stat));
+                perf_timing = true;
+                break;
+        case FS_PERF_STOP:
+                perf_timing = false;
+                break;
+        default:
+                return -EINVAL;
+        }
+
+        /* Replied over the request */
+        stat = (struct fs_perf_stat *)ipc_get_msg_data(ipc_msg);
+        memcpy(stat, &perf_stat, sizeof(*stat));
+        stat->page_cache_hit = count.hit;
+        stat->page_cache_miss = count.miss;
+        stat->disk_read_bytes = count.disk_o;
+        stat->disk_write_bytes = count.disk_i;
+        stat->dcache_hit = dcache_stat.hit;
+        stat->dcache_negative_hit = dcache_stat.negative_hit;
+        stat->dcache_miss = dcache_stat.miss;
+
+        return 0;
+}
+
+DEFINE_SERVER_HANDLER(fs_server_dispatch)
+{
+        struct fs_request *fr;
+        enum fs_req_type req;
+        unsigned long start = 0;
+        bool ret_with_cap = false;
+        long ret;
+
+        fr = (struct fs_request *)ipc_get_msg_data(ipc_msg);
+        /* Replies may be written over the request */
+        req = fr->req;
+        if (perf_timing)
+                start = perf_now_ns();
+
+        /* Reads and writes do not change the metadata of the wrapper */
+        if (req == FS_REQ_READ || req == FS_REQ_WRITE)
+                pthread_rwlock_rdlock(&fs_wrapper_meta_rwlock);
+        else
+                pthread_rwlock_wrlock(&fs_wrapper_meta_rwlock);
+
+        if (!mounted && req != FS_REQ_MOUNT) {
+                printf("[fs server] Not fully initialized, send FS_REQ_MOUNT first\n");
+                ret = -EINVAL;
+                goto out;
+        }
+
+        ret = translate_fd_to_fid(client_badge, fr);
+        if (ret < 0)
+                goto out;
+
+        switch (req) {
+        case FS_REQ_OPEN:
+                ret = fs_wrapper_open(client_badge, ipc_msg, fr);
+                break;
+        case FS_REQ_CLOSE:
+                ret = fs_wrapper_close(client_badge, ipc_msg, fr);
+                break;
+        case FS_REQ_CREAT:
+                ret = fs_wrapper_creat(ipc_msg, fr);
+                break;
+        case FS_REQ_MKDIR:
+                ret = fs_wrapper_mkdir(ipc_msg, fr);
+                break;
+        case FS_REQ_RMDIR:
+                ret = fs_wrapper_rmdir(ipc_msg, fr);
+                break;
+        case FS_REQ_SYMLINKAT:
+                ret = fs_wrapper_symlinkat(ipc_msg, fr);
+                break;
+        case FS_REQ_UNLINK:
+                ret = fs_wrapper_unlink(ipc_msg, fr);
+                break;
+        case FS_REQ_RENAME:
+                ret = fs_wrapper_rename(ipc_msg, fr);
+                break;
+        case FS_REQ_READLINKAT:
+                ret = fs_wrapper_readlinkat(ipc_msg, fr);
+                break;
+        case FS_REQ_READ:
+                ret = fs_wrapper_read(ipc_msg, fr);
+                break;
+        case FS_REQ_PREAD:
+                ret = fs_wrapper_pread(ipc_msg, fr);
+                break;
+        case FS_REQ_WRITE:
+                ret = fs_wrapper_write(ipc_msg, fr);
+                break;
+        case FS_REQ_PWRITE:
+                ret = fs_wrapper_pwrite(ipc_msg, fr);
+                break;
+        case FS_REQ_FSTAT:
+                ret = fs_wrapper_fstat(ipc_msg, fr);
+                break;
+        case FS_REQ_FSTATAT:
+                ret = fs_wrapper_fstatat(ipc_msg, fr);
+                break;
+        case FS_REQ_STATFS:
+                ret = fs_wrapper_statfs(ipc_msg, fr);
+                break;
+        case FS_REQ_FSTATFS:
+                ret = fs_wrapper_fstatfs(ipc_msg, fr);
+                break;
+        case FS_REQ_LSEEK:
+                ret = fs_wrapper_lseek(ipc_msg, fr);
+                break;
+        case FS_REQ_GETDENTS64:
+                ret = fs_wrapper_getdents64(ipc_msg, fr);
+                break;
+        case FS_REQ_FTRUNCATE:
+                ret = fs_wrapper_ftruncate(ipc_msg, fr);
+                break;
+        case FS_REQ_FALLOCATE:
+                ret = fs_wrapper_fallocate(ipc_msg, fr);
+                break;
+        case FS_REQ_FACCESSAT:
+                ret = fs_wrapper_faccessat(ipc_msg, fr);
+                break;
+        case FS_REQ_FCNTL:
+                ret = fs_wrapper_fcntl(client_badge, ipc_msg, fr);
+                break;
+        case FS_REQ_FMAP:
+                ret = fs_wrapper_fmap(client_badge, ipc_msg, fr, &ret_with_cap);
+                break;
+        case FS_REQ_MOUNT:
+                ret = fs_wrapper_mount(ipc_msg, fr);
+                break;
+        case FS_REQ_UMOUNT:
+                ret = fs_wrapper_umount(ipc_msg, fr);
+                break;
+        case FS_REQ_SYNC:
+                ret = fs_wrapper_sync();
+                break;
+        case FS_REQ_FSYNC:
+        case FS_REQ_FDATASYNC:
+                ret = fs_wrapper_fsync(ipc_msg, fr);
+                break;
+        case FS_REQ_TEST_PERF:
+                ret = fs_wrapper_perf(ipc_msg, fr);
+                break;
+        default:
+                printf("[Error] Strange FS Server request number %d\n", req);
+                ret = -EINVAL;
+                break;
+        }
+
+out:
+        pthread_rwlock_unlock(&fs_wrapper_meta_rwlock);
+        perf_account(req, start);
+        if (ret_with_cap)
+                ipc_return_with_cap(ipc_msg, ret);
+        else
+                ipc_return(ipc_msg, ret);
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <chcore/container/list.h>
+#include <chcore/defs.h>
+#include <chcore/memory.h>
+#include <chcore/ring_buffer.h>
+#include <chcore/syscall.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elf_pager.h"
+#include "procmgr_dbg.h"
+
+#define MAX_FAULT_MSG_NUM 100
+
+/* Same structure in kernel, item of user-level ring buffer */
+struct user_fault_msg {
+        badge_t fault_badge;
+        vaddr_t fault_va;
+};
+
+/**
+ * An opened ELF file. It is shared by all demand-paged segments from the same
+ * path, and closed when no segment refers to it.
+ */
+struct elf_backing {
+        char path[ELF_PATH_LEN + 1];
+        int fd;
+        int refcnt;
+        struct list_head node;
+};
+
+/* A demand-paged segment mapped in a process */
+struct elf_fault_area {
+        badge_t badge;
+        vaddr_t va_start;
+        size_t length;
+        /* offset in the ELF file corresponding to @va_start */
+        off_t file_offset;
+        vmr_prop_t perm;
+        struct elf_backing *backing;
+
+        struct list_head node;
+};
+
+static struct list_head elf_backings;
+static struct list_head elf_fault_areas;
+/* Protect both lists above */
+static pthread_rwlock_t elf_pager_lock;
+
+static cap_t pager_notific_cap;
+static struct ring_buffer *pager_msg_buffer;
+
+/* Should be called with elf_pager_lock held as a writer */
+static struct elf_backing *get_elf_backing(const char *path)
+{
+        struct elf_backing *backing;
+        int fd;
+
+        for_each_in_list (backing, struct elf_backing, node, &elf_backings) {
+                if (strncmp(backing->path, path, ELF_PATH_LEN) == 0) {
+                        backing->refcnt++;
+                        return backing;
+                }
+        }
+
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                return NULL;
+        }
+
+        backing = malloc(sizeof(*backing));
+        if (!backing) {
+                close(fd);
+                return NULL;
+        }
+
+        strncpy(backing->path, path, ELF_PATH_LEN);
+        backing->path[ELF_PATH_LEN] = '\0';
+        backing->fd = fd;
+        backing->refcnt = 1;
+        list_add(&backing->node, &elf_backings);
+        return backing;
+}
+
+/* Should be called with elf_pager_lock held as a writer */
+static void put_elf_backing(struct elf_backing *backing)
+{
+        if (--backing->refcnt == 0) {
+                list_del(&backing->node);
+                close(backing->fd);
+                free(backing);
+        }
+}
+
+/* Should be called with elf_pager_lock held */
+static struct elf_fault_area *find_elf_fault_area(badge_t badge, vaddr_t va)
+{
+        struct elf_fault_area *area;
+
+        for_each_in_list (area, struct elf_fault_area, node, &elf_fault_areas) {
+                if (area->badge == badge && va >= area->va_start
+                    && va < area->va_start + area->length) {
+                        return area;
+                }
+        }
+        return NULL;
+}
+
+/* Should be called with elf_pager_lock held as a writer */
+static void __elf_pager_remove_process(badge_t badge)
+{
+        struct elf_fault_area *area, *tmp;
+
+        for_each_in_list_safe (area, tmp, node, &elf_fault_areas) {
+                if (area->badge == badge) {
+                        list_del(&area->node);
+                        put_elf_backing(area->backing);
+                        free(area);
+                }
+        }
+}
+
+int elf_pager_add_process(badge_t badge, struct user_elf *elf,
+                          vaddr_t load_offset)
+{
+        struct user_elf_seg *seg;
+        struct elf_fault_area *area;
+        struct elf_backing *backing;
+        int i, ret = 0;
+
+        pthread_rwlock_wrlock(&elf_pager_lock);
+        for (i = 0; i < elf->segs_nr; i++) {
+                seg = &elf->user_elf_segs[i];
+                if (!seg->demand_paged) {
+                        continue;
+                }
+
+                area = malloc(sizeof(*area));
+                if (!area) {
+                        ret = -ENOMEM;
+                        goto out_fail;
+                }
+
+                backing = get_elf_backing(elf->path);
+                if (!backing) {
+                        free(area);
+                        ret = -ENOENT;
+                        goto out_fail;
+                }
+
+                area->badge = badge;
+                area->va_start = ROUND_DOWN(seg->p_vaddr + load_offset,
+                                            PAGE_SIZE);
+                area->length = seg->map_sz;
+                area->file_offset = seg->file_offset;
+                area->perm = seg->perm;
+                area->backing = backing;
+                list_add(&area->node, &elf_fault_areas);
+        }
+        pthread_rwlock_unlock(&elf_pager_lock);
+        return 0;
+
+out_fail:
+        __elf_pager_remove_process(badge);
+        pthread_rwlock_unlock(&elf_pager_lock);
+        return ret;
+}
+
+void elf_pager_remove_process(badge_t badge)
+{
+        pthread_rwlock_wrlock(&elf_pager_lock);
+        __elf_pager_remove_process(badge);
+        pthread_rwlock_unlock(&elf_pager_lock);
+}
+
+/*
+ * Read the faulting page from the ELF file into @page, and let the kernel
+ * copy it into the PMO and map it for the faulting process.
+ */
+static void elf_pager_handle_fault(struct user_fault_msg *msg, char *page)
+{
+        struct elf_fault_area *area;
+        vmr_prop_t perm;
+        off_t offset;
+        ssize_t ret;
+
+        /* The tail of the last page beyond the file must be zero. */
+        memset(page, 0, PAGE_SIZE);
+
+        pthread_rwlock_rdlock(&elf_pager_lock);
+        area = find_elf_fault_area(msg->fault_badge, msg->fault_va);
+        if (!area) {
+                pthread_rwlock_unlock(&elf_pager_lock);
+                error("elf pager: no area for badge 0x%x va 0x%lx\n",
+                      msg->fault_badge,
+                      msg->fault_va);
+                return;
+        }
+
+        offset = area->file_offset
+                 + (ROUND_DOWN(msg->fault_va, PAGE_SIZE) - area->va_start);
+        ret = pread(area->backing->fd, page, PAGE_SIZE, offset);
+        perm = area->perm;
+        pthread_rwlock_unlock(&elf_pager_lock);
+
+        /*
+         * There is no way to fail a page fault, so the faulting thread would
+         * be blocked forever if we do not resolve it. Map a zero page and
+         * let the process crash on its own.
+         */
+        if (ret < 0) {
+                error("elf pager: read failed for badge 0x%x va 0x%lx\n",
+                      msg->fault_badge,
+                      msg->fault_va);
+        }
+
+        ret = usys_user_fault_map(
+                msg->fault_badge, msg->fault_va, (vaddr_t)page, true, perm);
+        if (ret < 0) {
+                error("elf pager: usys_user_fault_map failed: %ld\n", ret);
+        }
+}
+
+static void *elf_pager_routine(void *arg)
+{
+        struct user_fault_msg msg;
+        char *page;
+
+        page = memalign(PAGE_SIZE, PAGE_SIZE);
+        assert(page);
+
+        while (1) {
+                usys_wait(pager_notific_cap, true, NULL);
+                while (get_one_msg(pager_msg_buffer, &msg)) {
+                        elf_pager_handle_fault(&msg, page);
+                }
+        }
+        return NULL;
+}
+
+int elf_pager_init(void)
+{
+        pthread_t pager_tid;
+        int ret;
+
+        init_list_head(&elf_backings);
+        init_list_head(&elf_fault_areas);
+        pthread_rwlock_init(&elf_pager_lock, NULL);
+
+        pager_notific_cap = usys_create_notifc();
+        if (pager_notific_cap < 0) {
+                return pager_notific_cap;
+        }
+
+        pager_msg_buffer = new_ringbuffer(MAX_FAULT_MSG_NUM,
+                                          sizeof(struct user_fault_msg));
+        if (!pager_msg_buffer) {
+                ret = -ENOMEM;
+                goto out_revoke_notific;
+        }
+
+        ret = usys_user_fault_register(pager_notific_cap,
+                                       (vaddr_t)pager_msg_buffer);
+        if (ret < 0) {
+                goto out_free_buffer;
+        }
+
+        ret = pthread_create(&pager_tid, NULL, elf_pager_routine, NULL);
+        if (ret != 0) {
+                /* Faults can never be resolved, so never enable it. */
+                return -ret;
+        }
+
+        elf_set_demand_paging(true);
+        return 0;
+
+out_free_buffer:
+        free_ringbuffer(pager_msg_buffer);
+out_revoke_notific:
+        usys_revoke_cap(pager_notific_cap, false);
+        return ret;
+}
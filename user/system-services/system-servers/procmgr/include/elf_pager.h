@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef ELF_PAGER_H
+#define ELF_PAGER_H
+
+#include <chcore/type.h>
+#include "libchcoreelf.h"
+
+/**
+ * Procmgr serves as the pager of demand-paged ELF segments (see
+ * elf_set_demand_paging()). Read-only segments of programs loaded from fs are
+ * mapped as PMO_FILE, and the kernel forwards the first page fault on each
+ * page to procmgr, which reads the page from the ELF file and resolves the
+ * fault with usys_user_fault_map, which maps a private copy of the page. The
+ * copy is committed to the PMO at its page index, so other processes sharing
+ * the PMO (e.g., the cached loader) map it directly instead of faulting into
+ * procmgr again for that page.
+ */
+
+/**
+ * @brief Register procmgr as the pager and start the pager thread. Demand
+ * paging of ELF files is enabled only if this function succeeds.
+ *
+ * @return 0 if success, otherwise -errno is returned.
+ */
+int elf_pager_init(void);
+
+/**
+ * @brief Record demand-paged segments of @elf which would be mapped into the
+ * process identified by @badge, starting from @load_offset. This function
+ * should be invoked **before** the process starts running, otherwise its
+ * page faults cannot be resolved.
+ *
+ * @return 0 if success (or nothing to record), otherwise -errno is returned.
+ * All memory resources consumed by this function are guaranteed to be freed
+ * if not success.
+ */
+int elf_pager_add_process(badge_t badge, struct user_elf *elf,
+                          vaddr_t load_offset);
+
+/**
+ * @brief Forget all demand-paged segments recorded for process @badge. Should
+ * be invoked when the process exits or fails to launch.
+ */
+void elf_pager_remove_process(badge_t badge);
+
+#endif /* ELF_PAGER_H */
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef KSMD_H
+#define KSMD_H
+
+/**
+ * The kernel merges identical pages of anonymous memory opted in with
+ * madvise(MADV_MERGEABLE) (KSM). Procmgr hosts the scanner thread, which wakes
+ * up periodically and lets the kernel scan a batch of such pages.
+ */
+
+/**
+ * @brief Start the scanner thread.
+ *
+ * @return 0 if success, otherwise -errno is returned.
+ */
+int ksmd_init(void);
+
+#endif /* KSMD_H */
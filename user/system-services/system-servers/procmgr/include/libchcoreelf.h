@@ -199,6 +199,19 @@ struct user_elf_seg {
          * It has been translated from ELF format into ChCore VMR permission.
          */
         vmr_prop_t perm;
+        /**
+         * If true, @elf_pmo is a PMO_FILE and its content is not loaded yet.
+         * Each page would be faulted in from the ELF file on first touch by
+         * the pager of the PMO, see elf_set_demand_paging().
+         */
+        bool demand_paged;
+        /**
+         * page-aligned offset in the ELF file, corresponding to the first
+         * page of the segment in memory. Only valid if @demand_paged.
+         */
+        off_t file_offset;
+        /** page-aligned size of the segment in memory */
+        size_t map_sz;
 };
 
 /**
@@ -228,6 +241,22 @@ struct user_elf {
  */
 void free_user_elf(struct user_elf *user_elf);
 
+/**
+ * @brief Enable or disable demand paging for ELF files loaded from fs.
+ *
+ * When enabled, read-only PT_LOAD segments whose content is fully backed by
+ * the file (e.g., .text and .rodata) are not read into memory when loading.
+ * Instead, a PMO_FILE is created for each of them, and it's the caller's
+ * responsibility to serve page faults on those PMOs, i.e., the caller must
+ * have registered itself as a pager via usys_user_fault_register() before
+ * enabling it. Writable segments (.data, .bss and pages written by
+ * relocations) are always loaded eagerly. ELF files loaded from memory are
+ * not affected.
+ *
+ * @param enable [In]
+ */
+void elf_set_demand_paging(bool enable);
+
 /**
  * @brief Load header of an ELF file from a file, can be used for detecting
  * dynamically linked ELF file with very low overhead.
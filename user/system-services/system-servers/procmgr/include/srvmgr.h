@@ -58,6 +58,9 @@ void boot_secondary_servers(void);
 /* Initialize sys_servers and sys_server_locks */
 void init_srvmgr(void);
 void handle_get_server_cap(ipc_msg_t *ipc_msg, struct proc_request *pr);
+void handle_get_mount_table_cap(ipc_msg_t *ipc_msg);
+void handle_update_mount_table(ipc_msg_t *ipc_msg, struct proc_request *pr);
+void handle_set_cpuset(ipc_msg_t *ipc_msg, struct proc_request *pr);
 
 void start_daemon_service(void);
 
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#ifndef ZSWAPD_H
+#define ZSWAPD_H
+
+/**
+ * The kernel compresses cold anonymous pages into an in-memory pool (zswap)
+ * when memory runs low. Procmgr hosts the reclaim thread, which wakes up
+ * periodically and lets the kernel reclaim pages if free memory is below the
+ * low watermark, until it reaches the high watermark.
+ */
+
+/**
+ * @brief Start the reclaim thread.
+ *
+ * @return 0 if success, otherwise -errno is returned.
+ */
+int zswapd_init(void);
+
+#endif /* ZSWAPD_H */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <chcore/syscall.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ksmd.h"
+#include "procmgr_dbg.h"
+
+/* Interval between two scans */
+#define KSMD_INTERVAL_US (200 * 1000)
+/* Pages scanned per interval, bounded by the kernel as well */
+#define KSMD_SCAN_PAGES 1024
+
+static void *ksmd_routine(void *arg)
+{
+        long merged;
+
+        while (1) {
+                usleep(KSMD_INTERVAL_US);
+
+                merged = usys_ksm_scan(KSMD_SCAN_PAGES);
+                if (merged > 0) {
+                        debug("ksmd: merged %ld pages\n", merged);
+                }
+        }
+        return NULL;
+}
+
+int ksmd_init(void)
+{
+        pthread_t ksmd_tid;
+
+        return -pthread_create(&ksmd_tid, NULL, ksmd_routine, NULL);
+}
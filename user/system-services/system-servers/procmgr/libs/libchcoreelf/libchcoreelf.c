@@ -536,6 +536,29 @@ out_nomem:
 
 #define OFFSET_MASK 0xfff
 
+/**
+ * Whether read-only segments of ELF files loaded from fs should be faulted in
+ * on demand, see elf_set_demand_paging().
+ */
+static bool elf_demand_paging = false;
+
+void elf_set_demand_paging(bool enable)
+{
+        elf_demand_paging = enable;
+}
+
+/**
+ * @brief A segment can be faulted in from the ELF file directly only if it is
+ * never written, and every byte of it in memory comes from the file at the
+ * same offset inside a page. Otherwise (e.g., writable segments, or segments
+ * containing .bss), it should be loaded eagerly.
+ */
+static bool __can_demand_page_seg(struct elf_program_header *ph)
+{
+        return !(ph->p_flags & PF_W) && ph->p_filesz == ph->p_memsz
+               && (ph->p_offset & OFFSET_MASK) == (ph->p_vaddr & OFFSET_MASK);
+}
+
 /**
  * @brief Load each loadable (PT_LOAD) segment in elf_file into a ChCore
  * pmo from the range. Content of each segment is stored in memory backed
@@ -544,11 +567,16 @@ out_nomem:
  * is only used for loading ELF file content, not constructing ELF memory
  * image in the caller's address space, so we don't do that here.
  *
+ * If @demand_paging is true, eligible segments are not loaded here. A PMO_FILE
+ * is created for each of them instead, and the pager of the caller would
+ * fault in their content later. See elf_set_demand_paging().
+ *
  * @param elf_file [In] this function only borrow the pointer, and will not
  * free it. It's the caller's responsibility to control the life cycle of this
  * pointer.
  * @param loader [In] abstract range loader function
  * @param param [In] custom parameter for @loader
+ * @param demand_paging [In] whether to create demand-paged segments
  * @param user_elf [Out] returning pointer to newly loaded header if
  * successfully load and parse its content. The ownership of this pointer is
  * transfered to the caller, so the caller should free it after use.
@@ -557,7 +585,7 @@ out_nomem:
  */
 static int __load_elf_into_pmos(struct elf_file *elf_file,
                                 range_loader_t loader, void *param,
-                                struct user_elf **user_elf)
+                                bool demand_paging, struct user_elf **user_elf)
 {
         int ret = 0;
         int loadable_segs = 0;
@@ -612,6 +640,27 @@ static int __load_elf_into_pmos(struct elf_file *elf_file,
                 seg_map_sz = ROUND_UP(seg_sz + p_vaddr, PAGE_SIZE)
                              - ROUND_DOWN(p_vaddr, PAGE_SIZE);
 
+                cur_user_elf_seg->seg_sz = seg_sz;
+                cur_user_elf_seg->p_vaddr = p_vaddr;
+                cur_user_elf_seg->perm = PFLAGS2VMRFLAGS(cur_ph->p_flags);
+                cur_user_elf_seg->map_sz = seg_map_sz;
+
+                /**
+                 * For demand-paged segments, nothing is read here. If the
+                 * PMO_FILE cannot be created, fallback to eager loading.
+                 */
+                if (demand_paging && __can_demand_page_seg(cur_ph)) {
+                        ret = usys_create_pmo(seg_map_sz, PMO_FILE);
+                        if (ret >= 0) {
+                                cur_user_elf_seg->elf_pmo = ret;
+                                cur_user_elf_seg->demand_paged = true;
+                                cur_user_elf_seg->file_offset =
+                                        ROUND_DOWN(cur_ph->p_offset, PAGE_SIZE);
+                                j++;
+                                continue;
+                        }
+                }
+
                 ret = usys_create_pmo(seg_map_sz, PMO_ANONYM);
                 if (ret < 0) {
                         goto out_fail;
@@ -649,9 +698,6 @@ static int __load_elf_into_pmos(struct elf_file *elf_file,
                 }
 
                 cur_user_elf_seg->elf_pmo = seg_pmo;
-                cur_user_elf_seg->seg_sz = seg_sz;
-                cur_user_elf_seg->p_vaddr = p_vaddr;
-                cur_user_elf_seg->perm = PFLAGS2VMRFLAGS(cur_ph->p_flags);
 
                 if (cur_user_elf_seg->perm & VMR_EXEC) {
                         usys_cache_flush((unsigned long)seg_load_start,
@@ -732,8 +778,11 @@ int load_elf_by_header_from_fs(const char *path, struct elf_header *elf_header,
                 goto out_ph_sh_failed;
         }
 
-        ret = __load_elf_into_pmos(
-                elf_file, file_range_loader, (void *)(long)fd, elf);
+        ret = __load_elf_into_pmos(elf_file,
+                                   file_range_loader,
+                                   (void *)(long)fd,
+                                   elf_demand_paging,
+                                   elf);
 
         if (ret == 0) {
                 strncpy((*elf)->path, path, ELF_PATH_LEN);
@@ -774,13 +823,15 @@ out:
  * @param loader [In] abstracted range random access function
  * @param param [In] custom parameter which would be passed to @loader. It can
  * be used to store information about the start of the range.
+ * @param demand_paging [In] whether eligible segments should be faulted in
+ * later instead of being loaded here. Only makes sense for files.
  * @param elf [Out] returning pointer to newly loaded user_elf struct if
  * success. The ownership of this pointer is transfered to the caller, so the
  * caller should free it after use.
  * @return 0 if success, otherwise -errno is returned.
  */
 static int load_elf_from_range(range_loader_t loader, void *param,
-                               struct user_elf **elf)
+                               bool demand_paging, struct user_elf **elf)
 {
         int ret = 0;
         struct elf_header *elf_header;
@@ -796,7 +847,7 @@ static int load_elf_from_range(range_loader_t loader, void *param,
                 goto out_ph_sh_failed;
         }
 
-        ret = __load_elf_into_pmos(elf_file, loader, param, elf);
+        ret = __load_elf_into_pmos(elf_file, loader, param, demand_paging, elf);
 
         elf_free(elf_file);
 out_ph_sh_failed:
@@ -815,7 +866,8 @@ int load_elf_from_fs(const char *path, struct user_elf **elf)
 
         fd = ret;
 
-        ret = load_elf_from_range(file_range_loader, (void *)(long)fd, elf);
+        ret = load_elf_from_range(
+                file_range_loader, (void *)(long)fd, elf_demand_paging, elf);
 
         if (ret == 0) {
                 strncpy((*elf)->path, path, ELF_PATH_LEN);
@@ -828,5 +880,6 @@ int load_elf_from_fs(const char *path, struct user_elf **elf)
 
 int load_elf_from_mem(const char *code, struct user_elf **elf)
 {
-        return load_elf_from_range(memory_range_loader, (void *)code, elf);
+        return load_elf_from_range(
+                memory_range_loader, (void *)code, false, elf);
 }
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include "chcore/defs.h"
 #include "liblaunch.h"
 #include "libchcoreelf.h"
+#include "elf_pager.h"
 #include <chcore/container/list.h>
 #include <chcore/memory.h>
 #include <chcore/type.h>
@@ -319,7 +320,16 @@ static int elf_so_loader_launch_process(struct loader *_this,
                 LIBC_LDSO_BASE
                 + ASLR_RAND_OFFSET;
 
-        ret = launch_process_with_pmos_caps(lp_args);
+        /**
+         * Text of the loader is shared by all processes and faulted in on
+         * demand, so the pager should know where it is mapped in the new
+         * process before it runs.
+         */
+        ret = elf_pager_add_process(
+                lp_args->badge, this->elf_so, lp_args->load_offset);
+        if (ret == 0) {
+                ret = launch_process_with_pmos_caps(lp_args);
+        }
 
         /**
          * Backup and resume original lp_args content, because we just borrow
@@ -29,6 +29,9 @@
 #include "procmgr_dbg.h"
 #include "srvmgr.h"
 #include "shell_msg_handler.h"
+#include "elf_pager.h"
+#include "zswapd.h"
+#include "ksmd.h"
 
 #define READ_ONCE(t) (*(volatile typeof((t)) *)(&(t)))
 #define IRQ_NUM 32
@@ -398,6 +401,15 @@ DEFINE_SERVER_HANDLER(procmgr_dispatch)
 	case PROC_REQ_GET_SYSTEM_INFO:
 		handle_get_system_info(ipc_msg);
 		break;
+        case PROC_REQ_GET_MOUNT_TABLE_CAP:
+                handle_get_mount_table_cap(ipc_msg);
+                break;
+        case PROC_REQ_SET_CPUSET:
+                handle_set_cpuset(ipc_msg, pr);
+                break;
+        case PROC_REQ_UPDATE_MOUNT_TABLE:
+                handle_update_mount_table(ipc_msg, pr);
+                break;
         default:
                 error("Invalid request type!\n");
                 /* Client should check if the return value is correct */
@@ -576,6 +588,16 @@ int main(int argc, char *argv[], char *envp[])
         pthread_create(&recycle_thread, NULL, recycle_routine, NULL);
 
         init_procmgr();
+        /* Fallback to eager ELF loading if the pager is not available */
+        if (elf_pager_init() != 0) {
+                error("elf pager init failed, demand paging disabled\n");
+        }
+        if (zswapd_init() != 0) {
+                error("zswapd init failed, memory is never reclaimed\n");
+        }
+        if (ksmd_init() != 0) {
+                error("ksmd init failed, pages are never merged\n");
+        }
         cap = chcore_pthread_create(
                 &procmgr_handler_tid, NULL, handler_thread_routine, NULL);
 
@@ -21,6 +21,7 @@
 
 #include "proc_node.h"
 #include "procmgr_dbg.h"
+#include "elf_pager.h"
 
 pthread_mutex_t recycle_lock;
 
@@ -87,6 +88,7 @@ void *recycle_routine(void *arg)
                          * done.
                          */
 
+                        elf_pager_remove_process(msg.badge);
                         del_proc_node(proc_to_recycle);
                         pthread_mutex_unlock(&recycle_lock);
                 }
@@ -17,8 +17,10 @@
 #include <chcore/proc.h>
 #include <chcore/syscall.h>
 #include <chcore-internal/procmgr_defs.h>
+#include <chcore-internal/fs_defs.h>
 #include <string.h>
 #include <malloc.h>
+#include <sys/mman.h>
 
 #include "proc_node.h"
 #include "procmgr_dbg.h"
@@ -26,6 +28,7 @@
 #include "libchcoreelf.h"
 #include "liblaunch.h"
 #include "loader.h"
+#include "elf_pager.h"
 
 /*
  * Note: This is not an isolated server. It is still a part of procmgr and
@@ -51,6 +54,20 @@ static cap_t sys_servers[CONFIG_SERVER_MAX];
 /* To launch system server atomically */
 static pthread_mutex_t sys_server_locks[CONFIG_SERVER_MAX];
 
+/*
+ * Servers and drivers are put in the "system" cpuset and the others in the
+ * "app" cpuset, which have all the CPUs until redefined (e.g., by cpuset.bin)
+ * to keep apps off the CPUs of the servers.
+ */
+static int system_cpuset = CPUSET_ROOT;
+static int app_cpuset = CPUSET_ROOT;
+
+/* Mount points shared by the FS clients, see struct fs_mount_table */
+static cap_t mount_table_pmo = -1;
+/* Mapped writable only here, the clients map it read-only */
+static struct fs_mount_table *mount_table;
+static pthread_mutex_t mount_table_lock;
+
 /* For booting system servers. */
 static int boot_server(char *srv_name, char *srv_path, cap_t *srv_cap_p,
                        int proc_type)
@@ -156,14 +173,28 @@ static struct proc_node *do_launch_process(int argc, char **argv, char *name,
         if (loader) {
                 ret = launch_process_using_loader(loader, &lp_args);
         } else {
-                ret = launch_process_with_pmos_caps(&lp_args);
+                /*
+                 * Demand-paged segments should be known by the pager before
+                 * the new process starts running.
+                 */
+                ret = elf_pager_add_process(proc_node->badge, user_elf, 0);
+                if (ret == 0) {
+                        ret = launch_process_with_pmos_caps(&lp_args);
+                }
         }
 
         if (ret != 0) {
                 error("launch process failed\n");
+                elf_pager_remove_process(proc_node->badge);
                 return NULL;
         }
 
+        usys_cpuset(CPUSET_ATTACH,
+                    new_proc_cap,
+                    proc_type == SYSTEM_SERVER || proc_type == SYSTEM_DRIVER ?
+                            system_cpuset :
+                            app_cpuset);
+
         /* Set proc_node properties */
         proc_node->state = PROC_STATE_RUNNING;
         proc_node->proc_cap = new_proc_cap;
@@ -476,6 +507,42 @@ out:
         }
 }
 
+void handle_get_mount_table_cap(ipc_msg_t *ipc_msg)
+{
+        if (mount_table_pmo < 0)
+                ipc_return(ipc_msg, -ENOMEM);
+
+        ipc_set_msg_return_cap_num(ipc_msg, 1);
+        ipc_set_msg_cap(ipc_msg, 0, mount_table_pmo);
+        ipc_return_with_cap(ipc_msg, 0);
+}
+
+void handle_update_mount_table(ipc_msg_t *ipc_msg, struct proc_request *pr)
+{
+        char *special = pr->update_mount_table.special;
+        char *path = pr->update_mount_table.path;
+        int ret;
+
+        if (mount_table == NULL)
+                ipc_return(ipc_msg, -ENOMEM);
+
+        special[FS_MOUNT_SPECIAL_BUF_LEN - 1] = '\0';
+        path[FS_REQ_PATH_BUF_LEN - 1] = '\0';
+        pthread_mutex_lock(&mount_table_lock);
+        if (pr->update_mount_table.mounted)
+                ret = mount_table_add(mount_table, special, path);
+        else
+                ret = mount_table_remove(mount_table, special);
+        pthread_mutex_unlock(&mount_table_lock);
+        ipc_return(ipc_msg, ret);
+}
+
+/* Overrides the one of libc, which asks procmgr */
+cap_t get_mount_table_cap(void)
+{
+        return mount_table_pmo;
+}
+
 void boot_secondary_servers(void)
 {
 #ifdef CHCORE_PLAT_RASPI3
@@ -492,6 +559,45 @@ void boot_secondary_servers(void)
 #endif /* CHCORE_PLAT_RASPI3 */
 }
 
+static void init_cpusets(void)
+{
+        long all, ret;
+
+        all = usys_cpuset(CPUSET_INFO, CPUSET_ROOT, 0);
+        if (all < 0) {
+                error("cpusets are not supported: %ld\n", all);
+                return;
+        }
+
+        ret = usys_cpuset(CPUSET_DEFINE, (unsigned long)"system", all);
+        if (ret >= 0)
+                system_cpuset = ret;
+        ret = usys_cpuset(CPUSET_DEFINE, (unsigned long)"app", all);
+        if (ret >= 0)
+                app_cpuset = ret;
+
+        /* procmgr serves the others as well */
+        usys_cpuset(CPUSET_ATTACH, 0, system_cpuset);
+}
+
+/*
+ * Only procmgr may define cpusets, so others (e.g., cpuset.bin) ask it to
+ * change the CPUs of the sets it puts processes in.
+ */
+void handle_set_cpuset(ipc_msg_t *ipc_msg, struct proc_request *pr)
+{
+        char *name = pr->set_cpuset.name;
+        long ret;
+
+        name[CPUSET_NAME_LEN - 1] = '\0';
+        if (strcmp(name, "system") && strcmp(name, "app"))
+                ipc_return(ipc_msg, -EINVAL);
+
+        ret = usys_cpuset(CPUSET_DEFINE, (unsigned long)name,
+                          pr->set_cpuset.mask);
+        ipc_return(ipc_msg, ret);
+}
+
 void init_srvmgr(void)
 {
         /* Init read_elf_lock */
@@ -501,4 +607,17 @@ void init_srvmgr(void)
                 sys_servers[i] = -1;
                 pthread_mutex_init(&sys_server_locks[i], NULL);
         }
+        init_cpusets();
+
+        pthread_mutex_init(&mount_table_lock, NULL);
+        /* Zeroed, i.e., no mount points besides "/" */
+        mount_table_pmo = usys_create_pmo(FS_MOUNT_TABLE_SIZE, PMO_DATA);
+        if (mount_table_pmo < 0) {
+                error("failed to create the mount table: %d\n",
+                      mount_table_pmo);
+                return;
+        }
+        mount_table = chcore_auto_map_pmo(mount_table_pmo,
+                                          FS_MOUNT_TABLE_SIZE,
+                                          PROT_READ | PROT_WRITE);
 }
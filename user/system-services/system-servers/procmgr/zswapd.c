@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2023 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * Licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <chcore/syscall.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "zswapd.h"
+#include "procmgr_dbg.h"
+
+/* Interval between two checks of the watermarks */
+#define ZSWAPD_INTERVAL_US (100 * 1000)
+
+static void *zswapd_routine(void *arg)
+{
+        struct zswap_stat stat;
+        long reclaimed;
+
+        while (1) {
+                usleep(ZSWAPD_INTERVAL_US);
+
+                reclaimed = usys_zswap_reclaim();
+                if (reclaimed <= 0) {
+                        continue;
+                }
+
+                if (usys_zswap_get_stat(&stat) == 0) {
+                        debug("zswapd: reclaimed %ld pages, stored %lu pages "
+                              "in %lu pool pages\n",
+                              reclaimed,
+                              stat.stored_pages,
+                              stat.pool_pages);
+                }
+        }
+        return NULL;
+}
+
+int zswapd_init(void)
+{
+        pthread_t zswapd_tid;
+
+        return -pthread_create(&zswapd_tid, NULL, zswapd_routine, NULL);
+}